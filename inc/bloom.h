@@ -0,0 +1,118 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLOUDTIERING_BLOOM_H
+#define CLOUDTIERING_BLOOM_H
+
+/*******************************************************************************
+* BLOOM FILTER                                                                 *
+* ------------                                                                 *
+*                                                                              *
+* A compact probabilistic set of 64-bit keys. A test of a key never gives a    *
+* false negative for an added key and gives a false positive with              *
+* probability of about 1% as long as the filter holds not more keys than its   *
+* capacity. Keys can not be removed; a filter which has outgrown its capacity  *
+* should be cleared.                                                           *
+*                                                                              *
+* Bits are set and tested atomically, so keys may be added and tested by       *
+* several threads concurrently. A key added concurrently with bloom_clear()    *
+* may be lost.                                                                 *
+*******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* a number of bits probed per key */
+#define BLOOM_PROBES    7
+
+/* a definition of a bloom filter */
+typedef struct {
+        /* a bit array; its size in bits is a power of 2 */
+        uint64_t *bits;
+
+        /* a mask of a bit index */
+        uint64_t mask;
+
+        /* a number of keys the filter is sized for */
+        size_t capacity;
+
+        /* a number of keys added since the filter was cleared */
+        size_t count;
+
+        /* a seed of hash functions; changes on every clear, so that false
+           positives do not stick to the same keys */
+        uint64_t seed;
+} bloom_t;
+
+/**
+ * @brief bloom_init Allocates an empty filter.
+ *
+ * @param[out] bloom    A filter to be initialized.
+ * @param[in]  capacity A number of keys the filter is sized for (about ten
+ *                      bits per key rounded up to a power of 2).
+ *
+ * @return  0: the filter has been initialized
+ *         -1: the filter has not been initialized
+ */
+int bloom_init(bloom_t *bloom, size_t capacity);
+
+/**
+ * @brief bloom_free Releases memory of a filter.
+ *
+ * @param[in,out] bloom A filter.
+ */
+void bloom_free(bloom_t *bloom);
+
+/**
+ * @brief bloom_clear Removes all keys from a filter.
+ *
+ * @param[in,out] bloom A filter.
+ */
+void bloom_clear(bloom_t *bloom);
+
+/**
+ * @brief bloom_add Adds a key to a filter.
+ *
+ * @param[in,out] bloom A filter.
+ * @param[in]     key   A key.
+ */
+void bloom_add(bloom_t *bloom, uint64_t key);
+
+/**
+ * @brief bloom_test Tests whether a key has been added to a filter.
+ *
+ * @param[in] bloom A filter.
+ * @param[in] key   A key.
+ *
+ * @return 1: the key has probably been added
+ *         0: the key has not been added
+ */
+int bloom_test(const bloom_t *bloom, uint64_t key);
+
+/**
+ * @brief bloom_full Checks whether a filter holds more keys than it is sized
+ *                   for, so that its false positive rate is higher than
+ *                   expected.
+ *
+ * @param[in] bloom A filter.
+ *
+ * @return 1: the filter should be cleared
+ *         0: otherwise
+ */
+int bloom_full(const bloom_t *bloom);
+
+#endif    /* CLOUDTIERING_BLOOM_H */
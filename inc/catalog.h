@@ -0,0 +1,178 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLOUDTIERING_CATALOG_H
+#define CLOUDTIERING_CATALOG_H
+
+/*******************************************************************************
+* CATALOG                                                                      *
+* -------                                                                      *
+*                                                                              *
+* A persistent record of files and directories of the managed file system      *
+* which lets a file system scan skip metadata operations on unchanged parts    *
+* of the file system.                                                          *
+*                                                                              *
+* The catalog is a file mapped into memory. It contains a hash table with      *
+* open addressing keyed by an inode number (the scan never leaves a single     *
+* file system, so an inode number identifies a file). The table has no         *
+* deletion: entries of removed files stay until the table is overloaded,       *
+* then the catalog is cleared and rebuilt by the next scan pass.               *
+*                                                                              *
+* Every scan pass has a generation number; an entry remembers the generation   *
+* of the pass which has seen it last time.                                     *
+*                                                                              *
+* Entries are claimed with an atomic operation, so different threads may add   *
+* entries concurrently. Other members of an entry are not protected, hence     *
+* an entry should be modified by a single thread at a time. This holds for     *
+* the file system scan, where a directory and its files are handled by one     *
+* thread.                                                                      *
+*******************************************************************************/
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/* a state of a catalog's entry */
+enum catalog_state_enum {
+        e_catalog_unknown = 0, /* location of a file is not known */
+        e_catalog_local,       /* a file is in the local storage */
+        e_catalog_remote,      /* a file is in the remote storage */
+        e_catalog_dir,         /* an entry describes a directory */
+};
+
+/* a definition of a catalog's entry */
+typedef struct {
+        /* an inode number of a file; 0 marks an empty entry */
+        uint64_t ino;
+
+        /* a state of the file (see catalog_state_enum) */
+        uint32_t state;
+
+        /* a generation of the scan pass which has seen the file last time */
+        uint32_t generation;
+
+        /* a size of the file in bytes */
+        int64_t size;
+
+        /* a last access time of the file in seconds */
+        int64_t atime;
+
+        /* last modification and status change times of the file
+           in nanoseconds */
+        int64_t mtime_ns;
+        int64_t ctime_ns;
+} catalog_entry_t;
+
+/* a definition of a catalog's header; entries follow the header */
+typedef struct {
+        /* a magic number identifying a completely initialized catalog */
+        uint32_t magic;
+
+        /* a version of the catalog's layout */
+        uint32_t version;
+
+        /* a device of the file system described by the catalog */
+        uint64_t dev;
+
+        /* a maximum number of entries */
+        uint64_t capacity;
+
+        /* a number of occupied entries */
+        uint64_t count;
+
+        /* a generation of the current scan pass */
+        uint32_t generation;
+
+        /* non-zero if the catalog describes the whole file system, i.e.
+           at least one scan pass has been completed since the last reset */
+        uint32_t complete;
+
+        /* offset in bytes of the entries starting from the catalog pointer */
+        uint64_t entries_offset;
+
+        /* a total size in bytes of the catalog's file */
+        uint64_t total_size;
+} catalog_t;
+
+/**
+ * @brief catalog_open Maps a catalog's file into memory. The file is created
+ *                     if it does not exist and is reset if it does not
+ *                     contain a valid catalog of a given capacity.
+ *
+ * @param[out] catalog_p A pointer to the catalog to be initialized.
+ * @param[in]  path      A path of the catalog's file.
+ * @param[in]  capacity  A maximum number of entries in the catalog.
+ *
+ * @return  0: the catalog has been opened
+ *         -1: the catalog has not been opened
+ */
+int catalog_open(catalog_t **catalog_p, const char *path, size_t capacity);
+
+/**
+ * @brief catalog_close Unmaps a catalog; the catalog's file is kept.
+ *
+ * @param[in] catalog A catalog to be closed.
+ */
+void catalog_close(catalog_t *catalog);
+
+/**
+ * @brief catalog_begin_pass Starts a new scan pass. The catalog is cleared if
+ *                           it describes another file system or if it is
+ *                           overloaded.
+ *
+ * @warning This function is not thread-safe.
+ *
+ * @param[in,out] catalog A catalog.
+ * @param[in]     dev     A device of the file system to be scanned.
+ *
+ * @return  1: the catalog describes the whole file system, so unchanged
+ *             directories can be skipped by the pass
+ *          0: the pass should visit every file
+ */
+int catalog_begin_pass(catalog_t *catalog, dev_t dev);
+
+/**
+ * @brief catalog_end_pass Finishes a scan pass.
+ *
+ * @warning This function is not thread-safe.
+ *
+ * @param[in,out] catalog  A catalog.
+ * @param[in]     complete Non-zero if the pass has visited the whole
+ *                         file system.
+ */
+void catalog_end_pass(catalog_t *catalog, int complete);
+
+/**
+ * @brief catalog_lookup Finds an entry of a file.
+ *
+ * @param[in] catalog A catalog.
+ * @param[in] ino     An inode number of the file.
+ *
+ * @return an entry of the file or NULL if the catalog does not contain it
+ */
+catalog_entry_t *catalog_lookup(catalog_t *catalog, ino_t ino);
+
+/**
+ * @brief catalog_insert Finds an entry of a file or adds a new one.
+ *
+ * @param[in,out] catalog A catalog.
+ * @param[in]     ino     An inode number of the file.
+ *
+ * @return an entry of the file or NULL if the catalog is full
+ */
+catalog_entry_t *catalog_insert(catalog_t *catalog, ino_t ino);
+
+#endif    /* CLOUDTIERING_CATALOG_H */
@@ -26,14 +26,17 @@
 *******************************************************************************/
 
 #include <stddef.h>
+#include <stdint.h>
 #include <time.h>
 
 #include "defs.h"
+#include "rules.h"
 
 /* a list of sections' names in configuration file */
 #define SECTIONS(action, sep)     \
         action(General)      sep  \
         action(Internal)     sep  \
+        action(Policy)       sep  \
         action(S3RemoteStore)
 
 /* a macro-function to declare begining and end tokens for a given section */
@@ -61,6 +64,66 @@ typedef struct {
         /* the lowest time interval between file system scan iterations */
         time_t scanfs_iter_tm_sec;
 
+        /* a number of threads walking the file system during a scan */
+        size_t scanfs_threads;
+
+        /* a maximum delay of a walking thread after each directory when the
+           file system is busy (0 disables pacing) */
+        size_t scanfs_max_delay_msec;
+
+        /* a limit of I/O pressure (some avg10 of /proc/pressure/io) above
+           which the scan is slowed down (0 ignores I/O pressure) */
+        double scanfs_io_pressure_limit;
+
+        /* a path of the catalog of the file system which lets scan passes
+           skip unchanged directories; empty string disables the catalog */
+        char   catalog_path[4096];
+
+        /* a maximum number of files and directories in the catalog */
+        size_t catalog_max_entries;
+
+        /* every n-th scan pass visits all files regardless of the catalog
+           (0 makes every pass full) */
+        size_t catalog_full_scan_passes;
+
+        /* a directory on the shared file system with leases of daemons which
+           split the scan between them; empty string disables sharding */
+        char   shard_dir[4096];
+
+        /* a name of this daemon unique among daemons sharing the file
+           system; empty string stands for the host name */
+        char   shard_node_name[64];
+
+        /* a period after which a lease of a silent daemon expires and its
+           part of the file system is taken over by other daemons */
+        time_t shard_lease_sec;
+
+        /* a number of files whose locations are shared with processes opening
+           them (0 disables the shared location cache) */
+        size_t location_cache_entries;
+
+        /* a number of files the in-memory filter of remote files is sized for
+           (0 disables the filter) */
+        size_t remote_filter_max_entries;
+
+        /* a period of heartbeats of the daemon; processes waiting for
+           recalls give up after several missed heartbeats (see status.h) */
+        size_t heartbeat_period_msec;
+
+        /* files not bigger than this size in bytes are uploaded in packs
+           with other small files of the same directory (0 disables packs) */
+        uint64_t pack_max_file_size;
+
+        /* a maximum size in bytes of a pack's object */
+        uint64_t pack_max_object_size;
+
+        /* a maximum number of files in a pack */
+        size_t pack_max_files;
+
+        /* a number of files enqueued for background recall after a recall
+           reveals a sequential or directory access pattern (0 disables) */
+        size_t prefetch_depth;
+
         /* start evicting files when storage is
            move_out_start_rate * 100)% full */
         double move_out_start_rate;
@@ -74,6 +137,13 @@ typedef struct {
         size_t primary_upload_queue_max_size;
         size_t secondary_upload_queue_max_size;
 
+        /* a directory where secondary queues are journaled to survive
+           restarts of the daemon; empty string disables journaling */
+        char   queue_journal_dir[4096];
+
+        /* compiled eviction rules from the Policy section */
+        rules_t rules;
+
         /* maximum path length in fs_mount_point directory can not be lower
            than this value */
         size_t path_max;
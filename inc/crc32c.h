@@ -0,0 +1,69 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLOUDTIERING_CRC32C_H
+#define CLOUDTIERING_CRC32C_H
+
+/*******************************************************************************
+* CRC32C                                                                       *
+* ------                                                                       *
+*                                                                              *
+* A checksum of file data computed while the data pass to or from the remote   *
+* storage, so that a recalled file is verified without reading it once more.   *
+*                                                                              *
+* CRC32C (the Castagnoli polynomial, as in iSCSI and ext4) is computed with    *
+* the crc32 instruction of SSE4.2 when the processor has it and with a         *
+* slicing-by-8 table otherwise; the implementation is chosen once at run time, *
+* so the daemon does not need to be built for a particular processor.          *
+*******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief crc32c Updates a checksum with a chunk of data.
+ *
+ * @note The function is thread-safe. A checksum of a concatenation of chunks
+ *       is computed by passing a checksum of the previous chunks to the call
+ *       for the next chunk:
+ *               crc32c(crc32c(0, a, a_len), b, b_len)
+ *       is a checksum of a followed by b.
+ *
+ * @param[in] crc A checksum of preceding data or 0 for the first chunk.
+ * @param[in] buf A chunk of data.
+ * @param[in] len A length of the chunk in bytes.
+ *
+ * @return the checksum of the preceding data followed by the chunk
+ */
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+
+/**
+ * @brief crc32c_sw Updates a checksum with a chunk of data using the
+ *                  slicing-by-8 table regardless of the processor.
+ *
+ * @note crc32c() uses it on processors without SSE4.2; it is exposed for
+ *       testing.
+ *
+ * @param[in] crc A checksum of preceding data or 0 for the first chunk.
+ * @param[in] buf A chunk of data.
+ * @param[in] len A length of the chunk in bytes.
+ *
+ * @return the checksum of the preceding data followed by the chunk
+ */
+uint32_t crc32c_sw(uint32_t crc, const void *buf, size_t len);
+
+#endif    /* CLOUDTIERING_CRC32C_H */
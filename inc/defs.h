@@ -109,10 +109,38 @@
 #define PROC_PID_FD_FD_PATH_MAX_LEN         ( 10 + 20 + 20 + 1 )
 #define PROC_SELF_FD_FD_PATH_MAX_LEN        ( 14 + 20 + 1 )
 
-/* a list of all possible extended attributes */
+/* an environment variable which turns on deferred recalls in the library:
+   open() of a remote file returns at once and the file is recalled on the
+   first access to its data */
+#define LAZY_RECALL_ENV                     "CLOUDTIERING_LAZY_RECALL"
+
+/* an environment variable which selects an error reported by calls which
+   need a recall while the daemon is not running (EIO, EAGAIN, EBUSY,
+   ETIMEDOUT or EHOSTDOWN; EIO by default) */
+#define DAEMON_DOWN_ERRNO_ENV               "CLOUDTIERING_DAEMON_DOWN_ERRNO"
+
+/* an environment variable which selects a class of recalls requested by
+   the library in a process (one of RECALL_CLASSES); recalls of a higher
+   class overtake recalls of lower classes in the daemon */
+#define RECALL_CLASS_ENV                    "CLOUDTIERING_PRIORITY"
+
+/* a list of recall classes from the highest priority to the lowest one;
+   the first class is used by default */
+#define RECALL_CLASSES(action, sep) \
+        action(interactive) sep     \
+        action(batch)       sep     \
+        action(background)
+
+/* a number of recall classes */
+#define RECALL_CLASSES_NUM    ( RECALL_CLASSES(MAP_TO_ONE, PLUS) )
+
+/* a list of all possible extended attributes; a file is remote if it has
+   the meta attribute (see meta.h) or the legacy stub attribute, which
+   earlier versions set along with the legacy object_id attribute; a legacy
+   stub is converted to the meta attribute on its first recall */
 #define XATTRS(action, sep)     \
+        action(meta)        sep \
         action(stub)        sep \
-        action(locked)      sep \
         action(object_id)
 
 /* a macro-function producing full name of extended attribute */
@@ -29,6 +29,7 @@
 #include <sys/types.h>
 
 #include "defs.h"
+#include "meta.h"
 
 /* enum of supported extended attributes */
 enum xattr_enum {
@@ -46,6 +47,8 @@ enum xattr_enum {
  * @note Operation is atomic according to
  *       http://man7.org/linux/man-pages/man7/xattr.7.html.
  *
+ * @note Symbolic links are not followed.
+ *
  * @param[in] path Path of file to check location.
  *
  * @return  1: if file is in local storage
@@ -124,13 +127,18 @@ int is_remote_file_fd( int fd );
 int is_regular_file_fd( int fd );
 
 /**
- * @brief try_lock_file Try to lock file using extended attribute as an
- *                      indicator.
+ * @brief try_lock_file Try to lock file: other threads of the daemon are
+ *                      excluded by the inode lock table (see lock.h) and
+ *                      other processes by an open file description lock
+ *                      (see F_OFD_SETLK in fcntl(2)).
  *
- * @note Operation is atomic according to
- *       http://man7.org/linux/man-pages/man7/xattr.7.html.
+ * @note Neither lock survives the daemon, so a crash never leaves a file
+ *       locked. Unlike a process-associated record lock, the lock is not
+ *       released when the daemon closes another file descriptor of the
+ *       same file.
  *
- * @param[in] fd File descriptor of file to set lock.
+ * @param[in] fd File descriptor of file to set lock; the file should be
+ *               opened for writing.
  *
  * @return  0: file was locked
  *         -1: file was not locked due to failure or lock was already set on
@@ -139,10 +147,7 @@ int is_regular_file_fd( int fd );
 int try_lock_file( int fd );
 
 /**
- * @brief unlock_file Unlock file via removal of extended attribute.
- *
- * @note Operation is atomic according to
- *       http://man7.org/linux/man-pages/man7/xattr.7.html.
+ * @brief unlock_file Unlock file locked by try_lock_file().
  *
  * @param[in] fd File descriptor of file to unset lock.
  *
@@ -151,6 +156,48 @@ int try_lock_file( int fd );
  */
 int unlock_file( int fd );
 
+/**
+ * @brief set_meta Set a meta-data record of an evicted file with a single
+ *                 fsetxattr(2) call.
+ *
+ * @param[in] fd             File descriptor of the file.
+ * @param[in] meta           A record to be set.
+ * @param[in] object_id      An object identifier of the file's data.
+ * @param[in] object_id_size A maximum size of the object identifier
+ *                           including '\0'.
+ * @param[in] flags          Flags for fsetxattr(2) function.
+ *
+ * @return  0: the record has successfully been set on file
+ *         -1: error has happened while setting the record on file
+ */
+int set_meta( int fd,
+              const meta_t *meta,
+              const char *object_id,
+              size_t object_id_size,
+              int flags );
+
+/**
+ * @brief get_meta Get a meta-data record of a file with a single
+ *                 fgetxattr(2) call.
+ *
+ * @note A stub of an earlier version (stub and object_id attributes) is
+ *       converted to a record on the way.
+ *
+ * @param[in]  fd             File descriptor of the file.
+ * @param[out] meta           A buffer for the record.
+ * @param[out] object_id      A buffer for the object identifier of the file's
+ *                            data.
+ * @param[in]  object_id_size A size of the object_id buffer.
+ *
+ * @return  0: the record has been get; the file is in remote storage
+ *          1: the file has no record; it is in local storage
+ *         -1: error has happened while getting the record or it is malformed
+ */
+int get_meta( int fd,
+              meta_t *meta,
+              char *object_id,
+              size_t object_id_size );
+
 /**
  * @brief set_xattr Set an extended attribute to file.
  *
@@ -0,0 +1,155 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLOUDTIERING_LOCATION_H
+#define CLOUDTIERING_LOCATION_H
+
+/*******************************************************************************
+* LOCATION CACHE                                                               *
+* --------------                                                               *
+*                                                                              *
+* A table in a shared memory which the daemon fills with known locations of    *
+* files (local or remote), so that the library learns a location of an opened  *
+* file from fstat(2) and a lookup instead of an extended attribute request,    *
+* which is a network round trip on a distributed file system.                  *
+*                                                                              *
+* An entry is keyed by a device and an inode number and records ctime of the   *
+* file at the moment its location was known. A change of the location          *
+* changes extended attributes of the file and hence its ctime, so an entry     *
+* with the same ctime is valid regardless of its age and of the node which has *
+* changed the file. An entry with another ctime is stale and is ignored.       *
+*                                                                              *
+* The table is a cache: an entry is stored in one of LOCATION_WAYS slots       *
+* selected by a hash of its key and replaces one of them in turn if all the    *
+* slots are taken. Every slot is guarded by a sequence lock: a writer makes    *
+* the sequence odd while it changes the slot; a reader does not retry and      *
+* treats a slot which has changed under it as a miss. Readers map the table    *
+* read-only.                                                                   *
+*******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "defs.h"
+
+#define LOCATION_SHM_OBJ    "/" PROGRAM_NAME "-locations"
+
+/* a number of slots an entry may occupy */
+#define LOCATION_WAYS       8
+
+/* locations of files */
+enum location_enum {
+        e_location_unknown = 0, /* also marks an empty slot */
+        e_location_local,
+        e_location_remote,
+};
+
+/* a definition of a slot of the table */
+typedef struct {
+        /* a sequence number; odd while the slot is being changed */
+        uint32_t seq;
+
+        /* a location (see location_enum) */
+        uint32_t state;
+
+        /* a device and an inode number of a file */
+        uint64_t dev;
+        uint64_t ino;
+
+        /* ctime of the file in nanoseconds */
+        int64_t ctime_ns;
+} location_slot_t;
+
+/* a definition of the table's header; slots follow the header */
+typedef struct {
+        /* a magic number identifying a completely initialized table */
+        uint32_t magic;
+
+        /* a version of the table's layout */
+        uint32_t version;
+
+        /* a number of slots; a power of 2 */
+        uint64_t capacity;
+
+        /* a total size of the table in bytes */
+        uint64_t total_size;
+
+        /* a counter of replacements which selects a slot to be replaced */
+        uint64_t clock;
+} location_t;
+
+/**
+ * @brief location_create Creates a table in a shared memory or attaches to
+ *                        an existing one of the same capacity for writing.
+ *
+ * @param[out] loc_p    A pointer to the table to be initialized.
+ * @param[in]  shm_obj  A name of the shared memory object.
+ * @param[in]  capacity A minimum number of slots.
+ *
+ * @return  0: the table has been created
+ *         -1: the table has not been created
+ */
+int location_create(location_t **loc_p, const char *shm_obj, size_t capacity);
+
+/**
+ * @brief location_attach Maps an existing table read-only.
+ *
+ * @param[out] loc_p   A pointer to the table to be initialized.
+ * @param[in]  shm_obj A name of the shared memory object.
+ *
+ * @return  0: the table has been attached
+ *         -1: the table does not exist or is not valid
+ */
+int location_attach(const location_t **loc_p, const char *shm_obj);
+
+/**
+ * @brief location_set Records a location of a file.
+ *
+ * @note The function is thread-safe; a store racing with another store to
+ *       the same slot is dropped.
+ *
+ * @param[in,out] loc      A table.
+ * @param[in]     dev      A device of the file.
+ * @param[in]     ino      An inode number of the file.
+ * @param[in]     ctime_ns ctime of the file in nanoseconds.
+ * @param[in]     state    A location of the file (see location_enum).
+ */
+void location_set(location_t *loc,
+                  uint64_t dev,
+                  uint64_t ino,
+                  int64_t ctime_ns,
+                  enum location_enum state);
+
+/**
+ * @brief location_get Looks a location of a file up.
+ *
+ * @note The function is thread-safe and does not write to the table.
+ *
+ * @param[in] loc      A table.
+ * @param[in] dev      A device of the file.
+ * @param[in] ino      An inode number of the file.
+ * @param[in] ctime_ns ctime of the file in nanoseconds.
+ *
+ * @return a location of the file or e_location_unknown if the table does
+ *         not know it for this ctime
+ */
+enum location_enum location_get(const location_t *loc,
+                                uint64_t dev,
+                                uint64_t ino,
+                                int64_t ctime_ns);
+
+#endif    /* CLOUDTIERING_LOCATION_H */
@@ -0,0 +1,60 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLOUDTIERING_LOCK_H
+#define CLOUDTIERING_LOCK_H
+
+/*******************************************************************************
+* INODE LOCK TABLE                                                             *
+* ----------------                                                             *
+*                                                                              *
+* A record of files locked by threads of the daemon. It is a hash table keyed  *
+* by a device and an inode number with chained entries under a single mutex;   *
+* the daemon holds few locks at a time, so the mutex is not contended.         *
+*                                                                              *
+* The table tells threads of the daemon apart without a request to the file    *
+* system. Other processes are excluded by an open file description lock taken  *
+* after an entry has been added to the table (see try_lock_file() in file.h).  *
+* Both kinds of locks disappear together with the daemon, so a crash never     *
+* leaves a file locked.                                                        *
+*******************************************************************************/
+
+#include <sys/types.h>
+
+/**
+ * @brief lock_inode Adds a file to the table unless it is already there.
+ *
+ * @param[in] dev A device of the file.
+ * @param[in] ino An inode number of the file.
+ *
+ * @return  0: the file has been added to the table
+ *         -1: the file is already locked or there is no memory for an entry
+ */
+int lock_inode(dev_t dev, ino_t ino);
+
+/**
+ * @brief unlock_inode Removes a file from the table.
+ *
+ * @param[in] dev A device of the file.
+ * @param[in] ino An inode number of the file.
+ *
+ * @return  0: the file has been removed from the table
+ *         -1: the file is not in the table
+ */
+int unlock_inode(dev_t dev, ino_t ino);
+
+#endif    /* CLOUDTIERING_LOCK_H */
@@ -0,0 +1,111 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLOUDTIERING_META_H
+#define CLOUDTIERING_META_H
+
+/*******************************************************************************
+* META-DATA RECORD                                                             *
+* ----------------                                                             *
+*                                                                              *
+* Everything the daemon knows about an evicted file is kept in a single        *
+* extended attribute, so an eviction sets one attribute and a recall gets and  *
+* removes one attribute; each of these is a network round trip on a            *
+* distributed file system. A file is remote if and only if it has the record.  *
+*                                                                              *
+* The record has a fixed layout independent of the host: a header of           *
+* META_HEADER_SIZE bytes with little-endian integers followed by an object     *
+* identifier without the terminating '\0':                                     *
+*         magic (4) | version (2) | state (2) | flags (4) | id length (4) |    *
+*         size (8) | mtime in nanoseconds (8) | checksum (4) | reserved (4) |  *
+*         object identifier                                                    *
+* Records of version 1 have no checksum and reserved fields; they are still    *
+* decoded.                                                                     *
+*******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* a size in bytes of the record's header */
+#define META_HEADER_SIZE    40
+
+/* flags of a record */
+#define META_FLAG_PACKED      0x1    /* the object id points to a pack */
+#define META_FLAG_CHECKSUM    0x2    /* the checksum is valid */
+
+/* a state of a file described by a record */
+enum meta_state_enum {
+        e_meta_remote = 1,    /* the file's data is in the remote storage */
+};
+
+/* a decoded record without the object identifier */
+typedef struct {
+        /* a state of the file (see meta_state_enum) */
+        uint32_t state;
+
+        /* flags of the record (META_FLAG_*) */
+        uint32_t flags;
+
+        /* a size of the file in bytes at the moment of eviction */
+        uint64_t size;
+
+        /* a last modification time of the file in nanoseconds at the moment
+           of eviction */
+        int64_t mtime_ns;
+
+        /* a CRC32C of the file's data as it has been uploaded (see crc32c.h);
+           valid if META_FLAG_CHECKSUM is set */
+        uint32_t checksum;
+} meta_t;
+
+/**
+ * @brief meta_encode Encodes a record.
+ *
+ * @param[out] buf       A buffer for the encoded record.
+ * @param[in]  size      A size of the buffer.
+ * @param[in]  meta      A record to be encoded.
+ * @param[in]  object_id An object identifier of the file's data.
+ *
+ * @return a size of the encoded record in bytes or 0 if the buffer is too
+ *         small
+ */
+size_t meta_encode(void *buf,
+                   size_t size,
+                   const meta_t *meta,
+                   const char *object_id);
+
+/**
+ * @brief meta_decode Decodes a record.
+ *
+ * @param[in]  buf            An encoded record.
+ * @param[in]  len            A size of the encoded record in bytes.
+ * @param[out] meta           A decoded record.
+ * @param[out] object_id      A buffer for the object identifier, which is
+ *                            terminated with '\0'.
+ * @param[in]  object_id_size A size of the object_id buffer.
+ *
+ * @return  0: the record has been decoded
+ *         -1: the record is malformed, of an unknown version or its object
+ *             identifier does not fit the buffer
+ */
+int meta_decode(const void *buf,
+                size_t len,
+                meta_t *meta,
+                char *object_id,
+                size_t object_id_size);
+
+#endif    /* CLOUDTIERING_META_H */
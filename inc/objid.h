@@ -0,0 +1,61 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLOUDTIERING_OBJID_H
+#define CLOUDTIERING_OBJID_H
+
+/*******************************************************************************
+* OBJECT IDENTIFIERS                                                           *
+* ------------------                                                           *
+*                                                                              *
+* An object identifier of an individually uploaded file is a 128-bit number    *
+* written as OBJID_LEN hexadecimal digits, so it never contains '/' (see       *
+* pack.h) and fits a few dozen bytes of the file's meta-data record whatever   *
+* the length of the file's path is.                                            *
+*                                                                              *
+* The upper 64 bits are a hash of the file's path and inode generation; the    *
+* lower 64 bits are a nonce made of the upload time in seconds, the daemon's   *
+* pid and a counter of identifiers made within the daemon:                     *
+*         hash(path, generation) (64) | seconds (32) | pid (16) | counter (16) *
+* Hence identifiers made by a daemon never repeat unless it makes more than    *
+* 65536 of them in a second, and identifiers of different files collide only   *
+* if both their hashes and their nonces coincide.                              *
+*******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* a length of an object identifier without the terminating '\0' */
+#define OBJID_LEN    32
+
+/**
+ * @brief objid_make Makes an object identifier of a file being uploaded.
+ *
+ * @note The function is thread-safe.
+ *
+ * @param[out] buf        A buffer for the identifier.
+ * @param[in]  size       A size of the buffer (at least OBJID_LEN + 1).
+ * @param[in]  path       A path of the file.
+ * @param[in]  generation An inode generation of the file or 0 if the file
+ *                        system does not provide it.
+ *
+ * @return  0: the identifier has been made
+ *         -1: the buffer is too small
+ */
+int objid_make(char *buf, size_t size, const char *path, uint64_t generation);
+
+#endif    /* CLOUDTIERING_OBJID_H */
@@ -26,6 +26,8 @@
 * TODO: write description                                                      *
 *******************************************************************************/
 
+#include <stdint.h>
+#include <time.h>
 #include <sys/types.h>
 
 #include "defs.h"
@@ -46,6 +48,8 @@ enum protocol_enum {
                 .connect         = elem##_connect,              \
                 .download        = elem##_download,             \
                 .upload          = elem##_upload,               \
+                .download_range  = elem##_download_range,       \
+                .upload_pack     = elem##_upload_pack,          \
                 .disconnect      = elem##_disconnect,           \
                 .get_object_id_xattr_value = elem##_get_object_id_xattr_value, \
                 .get_object_id_xattr_size  = elem##_get_object_id_xattr_size,  \
@@ -59,19 +63,39 @@ typedef struct {
            to remote storage */
         int    (*connect)( void );
 
-        /* this function will be called to perform file download operation */
-        int    (*download)( int fd, const char *object_id );
-
-        /* this function will be called to perform file upload operation */
-        int    (*upload)( int fd, const char *object_id );
+        /* this function will be called to perform file download operation;
+           a CRC32C of the downloaded data is computed on the fly (see
+           crc32c.h) */
+        int    (*download)( int fd, const char *object_id, uint32_t *crc );
+
+        /* this function will be called to perform file upload operation;
+           a CRC32C of the uploaded data is computed on the fly */
+        int    (*upload)( int fd, const char *object_id, uint32_t *crc );
+
+        /* this function will be called to download a part of an object
+           (a file's data in a pack) */
+        int    (*download_range)( int fd,
+                                  const char *object_id,
+                                  uint64_t offset,
+                                  uint64_t length,
+                                  uint32_t *crc );
+
+        /* this function will be called to upload data of several files
+           as a single object (a pack); a CRC32C of each file's data is
+           computed on the fly */
+        int    (*upload_pack)( const int *fds,
+                               const uint64_t *sizes,
+                               size_t count,
+                               const char *object_id,
+                               uint32_t *crcs );
 
         /* this function will be called to gracefully disconnect from
            the remote storage */
         void   (*disconnect)( void );
 
-        /* get value of an object id xattr for the given path for the specific
-           remote storage */
-        char  *(*get_object_id_xattr_value)( const char *path );
+        /* get value of an object id xattr for the given file for the specific
+           remote storage; every call gives a new object id */
+        char  *(*get_object_id_xattr_value)( int fd, const char *path );
 
         /* get maximum size of an object id xattr for the given path for the
            specific remote storage */
@@ -84,13 +108,51 @@ ops_t  *get_ops();
  * S3 Protocol Specific Implementation of Function from ops_t.
  */
 int    s3_connect( void );
-int    s3_download( int fd, const char *object_id );
-int    s3_upload( int fd, const char *object_id );
+int    s3_download( int fd, const char *object_id, uint32_t *crc );
+int    s3_upload( int fd, const char *object_id, uint32_t *crc );
+int    s3_download_range( int fd,
+                          const char *object_id,
+                          uint64_t offset,
+                          uint64_t length,
+                          uint32_t *crc );
+int    s3_upload_pack( const int *fds,
+                       const uint64_t *sizes,
+                       size_t count,
+                       const char *object_id,
+                       uint32_t *crcs );
 void   s3_disconnect( void );
-char  *s3_get_object_id_xattr_value( const char *path );
+char  *s3_get_object_id_xattr_value( int fd, const char *path );
 size_t s3_get_object_id_xattr_size( void );
 
 
+/**
+ * @brief init_recall_progress Creates a table in a shared memory where
+ *                             progress of downloads is published, so that
+ *                             readers of a file being downloaded wait only
+ *                             for the data they read (see progress.h).
+ *
+ * @return  0: the table has been created
+ *         -1: the table has not been created; readers wait for the whole
+ *             file then
+ */
+int init_recall_progress( void );
+
+/**
+ * @brief report_download_progress Publishes that more data of a file being
+ *                                 downloaded by the calling thread have been
+ *                                 written to the file. Protocols call it as
+ *                                 data arrive.
+ *
+ * @note The last byte of a file with a checksum (see META_FLAG_CHECKSUM) is
+ *       published only when the checksum has matched, so readers which reach
+ *       the file's end fail if it does not.
+ *
+ * @param[in] bytes A number of bytes written to the file after the previous
+ *                  report; data are written sequentially from the file's
+ *                  beginning.
+ */
+void report_download_progress( uint64_t bytes );
+
 /**
  * @brief dowload_file Download file from remote storage to local storage.
  *
@@ -105,12 +167,29 @@ int download_file( const char *path );
 /**
  * @brief upload_file Upload file to remote storage from local storage.
  *
+ * @note If pack mode is enabled (see pack.h), a small file is only added to
+ *       a pack and is uploaded by a later call of this function or of
+ *       flush_packed_files().
+ *
  * @param[in] path Path to a file to upload.
  *
  * @return  0: file has been upload to remote storage properly and truncated
+ *             or it has been added to a pack
  *         -1: file has not been upload due to error or access to file
  *             has happen during eviction
  */
 int upload_file( const char *path );
 
+/**
+ * @brief flush_packed_files Upload small files collected by upload_file()
+ *                           as a single object and turn them into stubs.
+ *
+ * @param[in] min_age Files are uploaded only if the first of them has been
+ *                    waiting for at least this number of seconds.
+ *
+ * @return  0: files have been uploaded or there is nothing to upload yet
+ *         -1: at least one of files has not been uploaded
+ */
+int flush_packed_files( time_t min_age );
+
 #endif    /* CLOUDTIERING_OPS_H */
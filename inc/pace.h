@@ -0,0 +1,112 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLOUDTIERING_PACE_H
+#define CLOUDTIERING_PACE_H
+
+/*******************************************************************************
+* PACING                                                                       *
+* ------                                                                       *
+*                                                                              *
+* File system scan competes with user jobs for metadata throughput. A pacer    *
+* slows the scan down when the file system looks busy: each walking thread     *
+* sleeps for a delay after every directory. The delay follows an AIMD rule     *
+* (in terms of the scan rate): it is doubled when the file system is           *
+* congested and is reduced by a fixed step otherwise.                          *
+*                                                                              *
+* The file system is considered congested when either                          *
+*   - I/O pressure (some avg10 of /proc/pressure/io) exceeds a limit, or       *
+*   - an average latency of scanner's metadata operations is several times     *
+*     higher than its long-term baseline (network file systems do not account  *
+*     metadata round trips in I/O pressure).                                   *
+* The decision is updated once per PACE_UPDATE_NS.                             *
+*******************************************************************************/
+
+#include <stdint.h>
+
+/* an interval between updates of the delay */
+#define PACE_UPDATE_NS          1000000000ULL
+
+/* a step of the delay */
+#define PACE_STEP_NS            1000000ULL
+
+/* the latency is congested if it exceeds the baseline this many times */
+#define PACE_LATENCY_FACTOR     4
+
+/* a definition of a pacer; members are accessed atomically */
+typedef struct {
+        /* a current delay after every directory */
+        uint64_t delay_ns;
+
+        /* a maximum delay; 0 disables pacing */
+        uint64_t max_delay_ns;
+
+        /* a limit of I/O pressure in percents; 0 ignores I/O pressure */
+        double pressure_limit;
+
+        /* an exponentially weighted moving average of latency */
+        uint64_t latency_ns;
+
+        /* a long-term baseline of latency */
+        uint64_t base_latency_ns;
+
+        /* a time of the next update of the delay */
+        uint64_t next_update_ns;
+} pace_t;
+
+/**
+ * @brief pace_init Initializes a pacer.
+ *
+ * @param[out] pace           A pacer to be initialized.
+ * @param[in]  max_delay_ns   A maximum delay after a directory; 0 disables
+ *                            pacing.
+ * @param[in]  pressure_limit A limit of I/O pressure in percents; 0 ignores
+ *                            I/O pressure.
+ */
+void pace_init(pace_t *pace, uint64_t max_delay_ns, double pressure_limit);
+
+/**
+ * @brief pace_dir Accounts latency of a directory's metadata operations and
+ *                 sleeps for the current delay.
+ *
+ * @note The function is thread-safe.
+ *
+ * @param[in,out] pace       A pacer.
+ * @param[in]     latency_ns An average latency of the operations.
+ */
+void pace_dir(pace_t *pace, uint64_t latency_ns);
+
+/**
+ * @brief pace_update Recalculates the delay.
+ *
+ * @note It is called by pace_dir() once per PACE_UPDATE_NS; it is exposed
+ *       for testing.
+ *
+ * @param[in,out] pace     A pacer.
+ * @param[in]     pressure I/O pressure in percents or a negative value if it
+ *                         is not known.
+ */
+void pace_update(pace_t *pace, double pressure);
+
+/**
+ * @brief pace_io_pressure Reads "some avg10" value of /proc/pressure/io.
+ *
+ * @return I/O pressure in percents or -1.0 if it is not available
+ */
+double pace_io_pressure(void);
+
+#endif    /* CLOUDTIERING_PACE_H */
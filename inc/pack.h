@@ -0,0 +1,87 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLOUDTIERING_PACK_H
+#define CLOUDTIERING_PACK_H
+
+/*******************************************************************************
+* PACKS                                                                        *
+* -----                                                                        *
+*                                                                              *
+* Small files are uploaded in batches: their data is concatenated into a       *
+* single remote object (a pack) and each file's object identifier points to a  *
+* byte range of the pack. This identifier has a form                           *
+*         packs/<pack>@<offset>:<length>                                       *
+* where "packs/<pack>" is the pack's object identifier. Identifiers of files   *
+* uploaded individually never contain '/', so both kinds can be told apart.    *
+*******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* a prefix of object identifiers of packs */
+#define PACK_OBJECT_ID_PREFIX    "packs/"
+
+/**
+ * @brief pack_make_id Generates a unique object identifier of a new pack.
+ *
+ * @param[out] buf  A buffer for the identifier.
+ * @param[in]  size A size of the buffer.
+ *
+ * @return  0: the identifier has been generated
+ *         -1: the buffer is too small
+ */
+int pack_make_id(char *buf, size_t size);
+
+/**
+ * @brief pack_member_id Makes an object identifier of a file in a pack.
+ *
+ * @param[out] buf     A buffer for the identifier.
+ * @param[in]  size    A size of the buffer.
+ * @param[in]  pack_id An object identifier of the pack.
+ * @param[in]  offset  An offset of the file's data in the pack.
+ * @param[in]  length  A length of the file's data.
+ *
+ * @return  0: the identifier has been made
+ *         -1: the buffer is too small
+ */
+int pack_member_id(char *buf,
+                   size_t size,
+                   const char *pack_id,
+                   uint64_t offset,
+                   uint64_t length);
+
+/**
+ * @brief pack_parse_member_id Parses an object identifier of a file.
+ *
+ * @param[in]  object_id An object identifier of the file.
+ * @param[out] pack_id   A buffer for an object identifier of the pack.
+ * @param[in]  size      A size of the pack_id buffer.
+ * @param[out] offset    An offset of the file's data in the pack.
+ * @param[out] length    A length of the file's data.
+ *
+ * @return  1: the file is in a pack; output parameters are set
+ *          0: the file is an object on its own; output parameters are intact
+ *         -1: the identifier is malformed or the buffer is too small
+ */
+int pack_parse_member_id(const char *object_id,
+                         char *pack_id,
+                         size_t size,
+                         uint64_t *offset,
+                         uint64_t *length);
+
+#endif    /* CLOUDTIERING_PACK_H */
@@ -24,8 +24,44 @@
 * TODO: write description                                                      *
 *******************************************************************************/
 
+#include <sys/stat.h>
+
 #include "queue.h"
 
 int scan_fs(queue_t *download_queue, queue_t *upload_queue);
 
+/**
+ * @brief init_location_cache Creates the shared location cache (see
+ *                            location.h) if it is enabled.
+ *
+ * @note It should be called before other threads start.
+ *
+ * @return  0: the cache has been created or is disabled
+ *         -1: the cache has not been created
+ */
+int init_location_cache(void);
+
+/**
+ * @brief remember_remote_file Tells scan passes and processes opening the
+ *                             file that a file is remote, so they do not
+ *                             probe its location again while the file's
+ *                             status (ctime) stays the same.
+ *
+ * @note The function is thread-safe; the scan passes learn nothing before
+ *       the first pass or if the filter of remote files is disabled.
+ *
+ * @param[in] sb Stat information of the remote file.
+ */
+void remember_remote_file(const struct stat *sb);
+
+/**
+ * @brief remember_local_file Tells processes opening a file that the file is
+ *                            local while its status (ctime) stays the same.
+ *
+ * @note The function is thread-safe.
+ *
+ * @param[in] sb Stat information of the local file.
+ */
+void remember_local_file(const struct stat *sb);
+
 #endif    /* CLOUDTIERING_POLICY_H */
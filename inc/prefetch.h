@@ -0,0 +1,55 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLOUDTIERING_PREFETCH_H
+#define CLOUDTIERING_PREFETCH_H
+
+/*******************************************************************************
+* PREFETCH                                                                     *
+* --------                                                                     *
+*                                                                              *
+* Jobs which open one file of a directory usually open its other files soon    *
+* after (e.g. numbered shards of a dataset). Every demand recall of a file is  *
+* reported to this module, which remembers the last recalled file of recently  *
+* touched directories. When a directory receives a second recall, the files    *
+* likely to be opened next are enqueued to be recalled in the background:      *
+*   - if names differ by a number incremented by one (data-0007, data-0008),   *
+*     the next numbers are predicted (data-0009, data-0010, ...);              *
+*   - otherwise the directory is swept in lexicographical order of names       *
+*     starting after the recalled file.                                        *
+* Only remote regular files are enqueued and none of them twice per sweep.     *
+*******************************************************************************/
+
+#include "queue.h"
+
+/**
+ * @brief prefetch_recall Registers a demand recall of a file and enqueues
+ *                        recalls of files which are likely to be opened next.
+ *
+ * @note The function is not thread-safe; it is called by the thread which
+ *       handles demand recalls.
+ *
+ * @param[in] path  A real path of the recalled file (symbolic links such as
+ *                  /proc/<pid>/fd/<fd> are not followed).
+ * @param[in] queue A queue of background recalls; it is never waited on.
+ *
+ * @return  0 or more: a number of enqueued files
+ *         -1: the path is invalid
+ */
+int prefetch_recall(const char *path, queue_t *queue);
+
+#endif    /* CLOUDTIERING_PREFETCH_H */
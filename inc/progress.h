@@ -0,0 +1,240 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLOUDTIERING_PROGRESS_H
+#define CLOUDTIERING_PROGRESS_H
+
+/*******************************************************************************
+* RECALL PROGRESS                                                              *
+* ---------------                                                              *
+*                                                                              *
+* A table in a shared memory where the daemon publishes progress of recalls,   *
+* so that a reader of a file being recalled waits only for the bytes it        *
+* reads instead of the whole file.                                             *
+*                                                                              *
+* Data of a file are written sequentially from its beginning, hence progress   *
+* of a recall is a watermark: the number of bytes already written to the file. *
+* A slot of the table describes one recall of a file identified by a device    *
+* and an inode number. A slot stays in the table after the recall has          *
+* finished until it is reused for another recall; a sequence number of the     *
+* slot tells a reader whether the slot still describes the recall it has       *
+* waited for.                                                                  *
+*                                                                              *
+* The daemon is the only writer. It changes a futex word of a slot with every  *
+* update of the slot and a futex word of the table with every new recall, so   *
+* readers, which map the table read-only, sleep in futex(2) until there is     *
+* something new.                                                               *
+*******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "defs.h"
+
+#define PROGRESS_SHM_OBJ    "/" PROGRAM_NAME "-progress"
+
+/* states of a slot */
+enum progress_state_enum {
+        e_progress_free = 0,  /* the slot has never been used */
+        e_progress_active,    /* the recall is in progress */
+        e_progress_done,      /* the file is local */
+        e_progress_failed,    /* the recall has failed */
+};
+
+/* results of progress_wait() */
+enum progress_wait_enum {
+        e_progress_reached = 0, /* the watermark has passed a requested end */
+        e_progress_complete,    /* the recall has been completed */
+        e_progress_error,       /* the recall has failed */
+        e_progress_lost,        /* the slot describes another recall now */
+        e_progress_timeout,     /* nothing of the above before a timeout */
+};
+
+/* a definition of a slot of the table */
+typedef struct {
+        /* a sequence number; odd while the slot is being reused */
+        uint32_t seq;
+
+        /* a state of the recall (see progress_state_enum) */
+        uint32_t state;
+
+        /* a device and an inode number of the file */
+        uint64_t dev;
+        uint64_t ino;
+
+        /* a number of bytes written to the file from its beginning */
+        uint64_t watermark;
+
+        /* a futex word changed on every update of the slot */
+        uint32_t ticks;
+
+        uint32_t reserved[7];
+} progress_slot_t;
+
+/* a definition of the table's header; slots follow the header */
+typedef struct {
+        /* a magic number identifying a completely initialized table */
+        uint32_t magic;
+
+        /* a version of the table's layout */
+        uint32_t version;
+
+        /* a number of slots */
+        uint64_t capacity;
+
+        /* a total size of the table in bytes */
+        uint64_t total_size;
+
+        /* a counter of reuses which selects a slot to be reused */
+        uint64_t clock;
+
+        /* a futex word changed on every new recall */
+        uint32_t starts;
+} progress_t;
+
+/* a reference to a recall in the table */
+typedef struct {
+        /* an index of the slot */
+        uint32_t index;
+
+        /* a sequence number of the slot at the beginning of the recall */
+        uint32_t seq;
+} progress_ref_t;
+
+/**
+ * @brief progress_create Creates a table in a shared memory. Recalls of
+ *                        the previous run of the daemon are marked failed.
+ *
+ * @param[out] prog_p   A pointer to the table to be initialized.
+ * @param[in]  shm_obj  A name of the shared memory object.
+ * @param[in]  capacity A number of slots, i.e. of concurrent recalls whose
+ *                      progress can be published.
+ *
+ * @return  0: the table has been created
+ *         -1: the table has not been created
+ */
+int progress_create(progress_t **prog_p, const char *shm_obj, size_t capacity);
+
+/**
+ * @brief progress_attach Maps an existing table read-only.
+ *
+ * @param[out] prog_p  A pointer to the table to be initialized.
+ * @param[in]  shm_obj A name of the shared memory object.
+ *
+ * @return  0: the table has been attached
+ *         -1: the table does not exist or is not valid
+ */
+int progress_attach(const progress_t **prog_p, const char *shm_obj);
+
+/**
+ * @brief progress_begin Takes a slot for a new recall of a file. A slot of
+ *                       a finished recall is reused if there is no free one.
+ *
+ * @warning A recall of a file should not begin while another recall of
+ *          the same file is active.
+ *
+ * @param[in,out] prog A table.
+ * @param[in]     dev  A device of the file.
+ * @param[in]     ino  An inode number of the file.
+ *
+ * @return the slot or NULL if all slots describe active recalls
+ */
+progress_slot_t *progress_begin(progress_t *prog, uint64_t dev, uint64_t ino);
+
+/**
+ * @brief progress_advance Publishes that more data of a file have been
+ *                         written and wakes up readers of the file.
+ *
+ * @note The data should be visible to other processes, i.e. written with
+ *       write(2), not just buffered.
+ *
+ * @param[in,out] slot  A slot taken by progress_begin().
+ * @param[in]     bytes A number of bytes written after the previous update.
+ */
+void progress_advance(progress_slot_t *slot, uint64_t bytes);
+
+/**
+ * @brief progress_end Finishes a recall and wakes up readers of the file.
+ *
+ * @param[in,out] slot A slot taken by progress_begin().
+ * @param[in]     ok   Non-zero if the file is local now.
+ */
+void progress_end(progress_slot_t *slot, int ok);
+
+/**
+ * @brief progress_find Finds the latest recall of a file.
+ *
+ * @note The function does not write to the table.
+ *
+ * @param[in]  prog  A table.
+ * @param[in]  dev   A device of the file.
+ * @param[in]  ino   An inode number of the file.
+ * @param[out] ref   A reference to the recall.
+ * @param[out] state A state of the recall (see progress_state_enum).
+ *
+ * @return  0: the recall has been found
+ *         -1: the table does not describe any recall of the file
+ */
+int progress_find(const progress_t *prog,
+                  uint64_t dev,
+                  uint64_t ino,
+                  progress_ref_t *ref,
+                  enum progress_state_enum *state);
+
+/**
+ * @brief progress_starts Returns a value of the futex word which changes
+ *                        with every new recall; a reader which has not found
+ *                        a recall passes it to progress_wait_start().
+ *
+ * @param[in] prog A table.
+ *
+ * @return the value of the futex word
+ */
+uint32_t progress_starts(const progress_t *prog);
+
+/**
+ * @brief progress_wait_start Blocks until a new recall begins.
+ *
+ * @note Spurious wake-ups are possible.
+ *
+ * @param[in] prog       A table.
+ * @param[in] starts     A value returned by progress_starts().
+ * @param[in] timeout_ms A maximum time to block in milliseconds.
+ */
+void progress_wait_start(const progress_t *prog,
+                         uint32_t starts,
+                         unsigned int timeout_ms);
+
+/**
+ * @brief progress_wait Blocks until a given number of bytes from the
+ *                      beginning of a file is written, the recall of the file
+ *                      finishes or a timeout expires.
+ *
+ * @param[in] prog       A table.
+ * @param[in] ref        A reference to the recall.
+ * @param[in] end        The number of bytes; UINT64_MAX waits for the end
+ *                       of the recall.
+ * @param[in] timeout_ms A maximum time to block in milliseconds.
+ *
+ * @return one of progress_wait_enum
+ */
+enum progress_wait_enum progress_wait(const progress_t *prog,
+                                      progress_ref_t ref,
+                                      uint64_t end,
+                                      unsigned int timeout_ms);
+
+#endif    /* CLOUDTIERING_PROGRESS_H */
@@ -37,9 +37,26 @@
 * It is safe to use this implementation in the code which supports deffered    *
 * thread cancellation but functions that handle this queue data structure      *
 * do not have cancellation points inside.                                      *
+*                                                                              *
+* Blocking is implemented on top of raw futex words (see futex(2)): the head   *
+* and tail indexes of the circular buffer are themselves the futex words.      *
+* Only an owner of head_mutex (tail_mutex) can wait for a non-empty (non-full) *
+* queue, so every state transition wakes at most one waiter and a wake-up      *
+* system call is issued only when somebody actually waits. The only exception  *
+* is queue_pop_any(), which waits for several queues at once (futex_waitv(2))  *
+* without owning their mutexes; a push wakes all such waiters.                 *
+*                                                                              *
+* Queues in a shared memory survive their creator. Mutexes of such queues are  *
+* robust, and a queue's state is consistent at any moment, so a death of any   *
+* process using the queue does not affect the others. A restarted creator      *
+* attaches to the existing queue and keeps the elements in-flight.             *
+*                                                                              *
+* A queue may also reside in a file (see queue_init_file()); such a queue      *
+* keeps pending elements across restarts and even system crashes.              *
 *******************************************************************************/
 
 #include <pthread.h>      /* included for a pthread_mutex_t type definition */
+#include <stdint.h>       /* included for a uint32_t type definition */
 #include <linux/limits.h>
 #include <sys/types.h>    /* included for a size_t type definition */
 
@@ -47,18 +64,65 @@
 
 #define QUEUE_SHM_OBJ    "/" PROGRAM_NAME "-queue"
 
+/* a macro-function producing a name of the shared memory object of
+   the download queue of a recall class (see RECALL_CLASSES) */
+#define QUEUE_CLASS_SHM_OBJ(elem, ...)    QUEUE_SHM_OBJ "-" #elem
+
+/* a number of buckets in the histogram of time elements spent in the queue;
+   bucket 0 counts latencies lower than 1 us, bucket i (i > 0) counts
+   latencies in [2^(i-1), 2^i) us range; the last bucket is open-ended */
+#define QUEUE_LATENCY_BUCKETS    32
+
+/* a definition of queue's counters; all members are 64-bit counters */
+typedef struct {
+        /* a number of elements pushed into the queue */
+        uint64_t pushes;
+
+        /* a number of elements popped from the queue */
+        uint64_t pops;
+
+        /* a number of push attempts which found the queue full */
+        uint64_t full_events;
+
+        /* a number of pop attempts which found the queue empty */
+        uint64_t empty_events;
+
+        /* total time in nanoseconds suppliers spent blocked on a full queue */
+        uint64_t push_blocked_ns;
+
+        /* a histogram of time elements spent in the queue */
+        uint64_t latency_hist[QUEUE_LATENCY_BUCKETS];
+} queue_stats_t;
+
 /* a definition of a queue data structure */
 typedef struct {
-        /* offset in bytes of the queue's head element
-           starting from the queue pointer */
-        size_t  head_offset;
+        /* futex word; index of the queue's head element; index values are
+           in the [0, 2 * max_size) range, so that full and empty queues are
+           distinguishable; modified only by the head_mutex owner */
+        uint32_t head __attribute__((aligned(64)));
 
-        /* offset in bytes of the queue's tail element
-           starting from the queue pointer */
-        size_t  tail_offset;
+        /* futex word; index of the queue's tail element (see head);
+           modified only by the tail_mutex owner */
+        uint32_t tail __attribute__((aligned(64)));
+
+        /* a number of consumers waiting on the tail futex word */
+        uint32_t pop_waiters;
+
+        /* a number of suppliers waiting on the head futex word */
+        uint32_t push_waiters;
+
+        /* a number of consumers of several queues waiting on the tail futex
+           word without owning head_mutex (see queue_pop_any()) */
+        uint32_t idle_waiters;
 
-        /* a current queue's size */
-        size_t cur_size;
+        /* a magic number identifying a completely initialized queue */
+        uint32_t magic;
+
+        /* a version of this structure's layout */
+        uint32_t version;
+
+        /* non-zero for a queue residing in a file (see queue_init_file()) */
+        uint32_t journaled;
 
         /* a maximum queue's size */
         size_t max_size;
@@ -87,17 +151,9 @@ typedef struct {
         /* a mutex used to sequentionalize queue writers/suppliers */
         pthread_mutex_t tail_mutex;
 
-        /* a mutex used to sequentionalize updates to the queue size variable
-           used by readers and writers (consumers and suppliers) */
-        pthread_mutex_t size_mutex;
-
-        /* conditional variable used to indicate that the queue is capable
-           to accommodate at least one element */
-        pthread_cond_t fullness_cond;
-
-        /* conditional variable used to indicate that the queue contains at
-           least one element */
-        pthread_cond_t emptiness_cond;
+        /* queue's counters; updated with relaxed atomics and can be read
+           with queue_stats() without taking any queue's locks */
+        queue_stats_t stats __attribute__((aligned(64)));
 } queue_t;
 
 /* functions to work with queue_t data structure */
@@ -115,7 +171,11 @@ typedef struct {
  * @param[in]  data_max_size  A maximum size of one element.
  * @param[in]  shm_obj        A name of shared memory object to be created.
  *                            If NULL, then queue will be created in
- *                            process-private memory.
+ *                            process-private memory. If the shared memory
+ *                            object already exists and contains a queue with
+ *                            the same geometry, then the existing queue and
+ *                            its elements are reused; otherwise, it is
+ *                            replaced with a new one.
  *
  * @return  0: queue has been initialized;
  *         -1: queue has not been initialized.
@@ -125,6 +185,47 @@ int queue_init(queue_t **queue_p,
                size_t data_max_size,
                const char *shm_obj);
 
+/**
+ * @brief queue_init_file Maps a file as a queue_t data structure which
+ *                        survives restarts of its user.
+ *
+ * The file works as a write-ahead journal: a pushed element is written to
+ * the disk before the tail index referencing it is published. If the file
+ * already contains a queue with the same geometry, then the queue and its
+ * pending elements are reused; otherwise, the file is reformatted.
+ *
+ * @warning The queue is intended for a single process: its mutexes are
+ *          process-private and are reinitialized when the file is reused.
+ *
+ * @param[out] queue_p        A pointer to the queue to be initialized with
+ *                            mapped memory region.
+ * @param[in]  queue_max_size A maximum size of the queue in elements.
+ * @param[in]  data_max_size  A maximum size of one element.
+ * @param[in]  path           A path of the file backing the queue; the file
+ *                            is created if it does not exist.
+ *
+ * @return  0: queue has been initialized;
+ *         -1: queue has not been initialized.
+ */
+int queue_init_file(queue_t **queue_p,
+                    size_t queue_max_size,
+                    size_t data_max_size,
+                    const char *path);
+
+/**
+ * @brief queue_attach Maps a queue residing in an existing shared memory
+ *                     object created by queue_init().
+ *
+ * @param[out] queue_p A pointer to the queue to be initialized with
+ *                     mapped memory region.
+ * @param[in]  shm_obj A name of existing shared memory object.
+ *
+ * @return  0: queue has been attached;
+ *         -1: shared memory object does not exist, can not be mapped or
+ *             does not contain a valid queue.
+ */
+int queue_attach(queue_t **queue_p, const char *shm_obj);
+
 /**
  * @brief queue_destroy Frees all memory allocated for a given queue.
  *
@@ -133,6 +234,8 @@ int queue_init(queue_t **queue_p,
  *          attempts to use queue operations. Dead locks are also possible for
  *          the same reason.
  *
+ * @note A file backing a queue created with queue_init_file() is not removed.
+ *
  * @param[in,out] queue Pointer to a queue's structure to be freed.
  */
 void queue_destroy(queue_t *queue);
@@ -171,6 +274,27 @@ int  queue_try_push(queue_t *queue,
                     const char *data,
                     size_t data_size);
 
+/**
+ * @brief queue_timed_push Pushes an element into a queue. If the queue is
+ *                         full, blocks until there is available space or
+ *                         until a timeout expires.
+ *
+ * @note This function is thread-safe.
+ *
+ * @param[in,out] queue      The queue into which a new element will be pushed.
+ * @param[in]     data       A provided data.
+ * @param[in]     data_size  A size of the provided data.
+ * @param[in]     timeout_ms A maximum time to wait in milliseconds.
+ *
+ * @return  0: the element pushed successfully into the queue;
+ *         -1: incorrect input parameters provided or there is still no free
+ *             space when the timeout expires.
+ */
+int  queue_timed_push(queue_t *queue,
+                      const char *data,
+                      size_t data_size,
+                      size_t timeout_ms);
+
 /**
  * @brief queue_pop Fills provided buffers for a data and a data's size
  *                  with the front queue element's data and size
@@ -217,4 +341,59 @@ int  queue_try_pop(queue_t *queue,
                    char *data,
                    size_t *data_size);
 
+/**
+ * @brief queue_pop_any Pops the front element of the first non-empty queue
+ *                      of the given ones (see queue_try_pop()). If all the
+ *                      queues are empty, blocks until an element is pushed
+ *                      into any of them or until a timeout expires.
+ *
+ * @note This function is thread-safe.
+ * @note Queues are checked in the order of the array, so the array defines
+ *       queues' priorities.
+ *
+ * @param[in,out] queues     An array of at most 128 queues; NULL elements
+ *                           are skipped.
+ * @param[in]     count      A number of elements in the array.
+ * @param[out]    data       Pointer to a buffer of an appropriate size.
+ * @param[in,out] data_size  Pointer to a buffer where the data's size
+ *                           will be written.
+ * @param[in]     timeout_ms A maximum time to wait in milliseconds.
+ *
+ * @return >= 0: an index of the queue in the array the element has been
+ *               popped from;
+ *           -1: incorrect input parameters provided or all the queues are
+ *               still empty when the timeout expires.
+ */
+int  queue_pop_any(queue_t *const *queues,
+                   size_t count,
+                   char *data,
+                   size_t *data_size,
+                   size_t timeout_ms);
+
+/**
+ * @brief queue_size Returns a current number of elements in a queue.
+ *
+ * @note This function is thread-safe and does not take queue's locks;
+ *       the result may be outdated by the time it is returned.
+ *
+ * @param[in] queue The queue whose size will be returned.
+ *
+ * @return a number of elements in the queue
+ */
+size_t queue_size(const queue_t *queue);
+
+/**
+ * @brief queue_stats Fills provided structure with a snapshot of queue's
+ *                    counters.
+ *
+ * @note This function is thread-safe and does not take queue's locks, hence
+ *       it can be used by an external tool on a queue attached with
+ *       queue_attach(); counters are not guaranteed to be consistent
+ *       with each other.
+ *
+ * @param[in]  queue The queue whose counters will be read.
+ * @param[out] stats A structure to be filled with counters' values.
+ */
+void queue_stats(const queue_t *queue, queue_stats_t *stats);
+
 #endif /* CLOUDTIERING_QUEUE_H */
@@ -0,0 +1,150 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLOUDTIERING_RULES_H
+#define CLOUDTIERING_RULES_H
+
+/*******************************************************************************
+* POLICY RULES                                                                 *
+* ------------                                                                 *
+*                                                                              *
+* Eviction policy is a list of rules from the <Policy> section of the          *
+* configuration file. A rule is an action followed by predicates on a file:    *
+*         Rule exclude path=*.sqlite                                           *
+*         Rule evict   size>=1M atime>7d uid=1000                              *
+*         Rule evict   atime>30d                                               *
+* Rules are checked in order and the first rule whose predicates all hold      *
+* decides what happens to the file; a file matching no rule is kept.           *
+*                                                                              *
+* Predicates have a form <key><op><value> where op is one of =, !=, <, <=, >   *
+* or >=. Supported keys are:                                                   *
+*         path          a glob(7) pattern of the absolute path (= and != only) *
+*         size          a size in bytes; K, M, G and T suffixes are accepted   *
+*         atime, mtime, ctime                                                  *
+*                       an age in seconds; m, h, d and w suffixes are accepted *
+*         uid, gid      an owner of the file                                   *
+*                                                                              *
+* Rules are compiled into a flat array of instructions when configuration is   *
+* read. An instruction tests one predicate against an lstat(2) record and      *
+* either proceeds to the next instruction or jumps to the next rule, so the    *
+* evaluation does not allocate memory and does not touch the file system.      *
+*******************************************************************************/
+
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* a maximum number of instructions of all rules */
+#define RULES_MAX_INSNS       256
+
+/* a size of storage for path patterns of all rules */
+#define RULES_POOL_SIZE       4096
+
+/* an action of a rule */
+enum rule_action_enum {
+        e_rule_keep = 0, /* the file stays in the local storage */
+        e_rule_evict,    /* the file is a candidate for eviction */
+};
+
+/* a definition of an instruction */
+typedef struct {
+        /* a tested attribute of a file (see rule_key_enum in rules.c) */
+        uint8_t  key;
+
+        /* a comparison operator (see rule_op_enum in rules.c) */
+        uint8_t  op;
+
+        /* a number of instructions to skip if the predicate is false,
+           i.e. a distance to the first instruction of the next rule */
+        uint16_t skip;
+
+        /* an offset of a path pattern in the pool */
+        uint32_t pattern;
+
+        /* a value to compare an attribute with or an action of a rule */
+        int64_t  value;
+} rule_insn_t;
+
+/* a definition of compiled rules */
+typedef struct {
+        /* a number of rules */
+        size_t count;
+
+        /* a number of used instructions */
+        size_t insns_count;
+
+        /* a number of used bytes of the pool */
+        size_t pool_size;
+
+        /* instructions of all rules */
+        rule_insn_t insns[RULES_MAX_INSNS];
+
+        /* null-terminated path patterns */
+        char pool[RULES_POOL_SIZE];
+} rules_t;
+
+/**
+ * @brief rules_init Initializes an empty list of rules.
+ *
+ * @param[out] rules Rules to be initialized.
+ */
+void rules_init(rules_t *rules);
+
+/**
+ * @brief rules_add Compiles a rule and appends it to the list.
+ *
+ * @param[in,out] rules Rules.
+ * @param[in]     argc  A number of words of the rule.
+ * @param[in]     argv  Words of the rule: an action ("evict" or "exclude")
+ *                      followed by predicates.
+ *
+ * @return  0: the rule has been added
+ *         -1: the rule is malformed or there is no space for it
+ */
+int rules_add(rules_t *rules, size_t argc, const char *const *argv);
+
+/**
+ * @brief rules_eval Decides what should happen to a file.
+ *
+ * @param[in] rules Rules.
+ * @param[in] path  An absolute path of the file.
+ * @param[in] sb    An lstat(2) information of the file.
+ * @param[in] now   The current time.
+ *
+ * @return an action of the first matching rule or e_rule_keep if no rule
+ *         matches
+ */
+enum rule_action_enum rules_eval(const rules_t *rules,
+                                 const char *path,
+                                 const struct stat *sb,
+                                 time_t now);
+
+/**
+ * @brief rules_min_atime_age Calculates an access age that a file should
+ *                            exceed to be evicted by any rule. This lets the
+ *                            caller discard a file knowing only a lower bound
+ *                            of its access time.
+ *
+ * @param[in] rules Rules.
+ *
+ * @return a number of seconds or -1 if some rule does not restrict the access
+ *         age from below
+ */
+time_t rules_min_atime_age(const rules_t *rules);
+
+#endif    /* CLOUDTIERING_RULES_H */
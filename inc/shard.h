@@ -0,0 +1,145 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLOUDTIERING_SHARD_H
+#define CLOUDTIERING_SHARD_H
+
+/*******************************************************************************
+* SHARDING                                                                     *
+* --------                                                                     *
+*                                                                              *
+* Several daemons on several nodes of a cluster file system split the scan of  *
+* the namespace: every directory is owned by one live node, which alone scans  *
+* and evicts the directory's regular files. Other nodes only descend into      *
+* the directory to reach its subdirectories.                                   *
+*                                                                              *
+* Every node holds a lease: a file named after the node in a lease directory   *
+* on the shared file system. A node renews its lease by updating the file's    *
+* modification time. A lease is live if it has been renewed within the lease   *
+* period; timestamps are set by the shared file system, so nodes' clocks do    *
+* not have to be synchronized.                                                 *
+*                                                                              *
+* An owner of a directory is chosen among live nodes by rendezvous (highest    *
+* random weight) hashing of the directory's path. When a node disappears, its  *
+* lease expires and only its directories move to other nodes; when a node      *
+* joins, it takes over about 1/N of the directories of every other node.       *
+*******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/* a maximum number of nodes sharing a file system */
+#define SHARD_MAX_NODES    256
+
+/* a maximum length of a node's name */
+#define SHARD_NAME_MAX     64
+
+/* leases expired for this many periods are removed by live nodes */
+#define SHARD_REAP_FACTOR  16
+
+/* a definition of a node's view of the shards */
+typedef struct {
+        /* a file descriptor of the node's lease */
+        int lease_fd;
+
+        /* a lease period */
+        time_t lease_sec;
+
+        /* a monotonic time of the next renewal of the lease */
+        uint64_t next_renew_ns;
+
+        /* a path of the lease directory */
+        char dir[4096];
+
+        /* a name of the node */
+        char name[SHARD_NAME_MAX];
+
+        /* hashes of names of live nodes in ascending order; the array is
+           changed only by shard_refresh() */
+        uint64_t nodes[SHARD_MAX_NODES];
+        size_t   nodes_count;
+
+        /* a hash of the node's name */
+        uint64_t self;
+} shard_t;
+
+/**
+ * @brief shard_join Creates a lease of a node; the lease directory is created
+ *                   if it does not exist.
+ *
+ * @param[out] shard     A node's view to be initialized.
+ * @param[in]  dir       A lease directory on the shared file system.
+ * @param[in]  name      A name of the node unique in the cluster.
+ * @param[in]  lease_sec A lease period.
+ *
+ * @return  0: the node has joined
+ *         -1: the lease has not been created
+ */
+int shard_join(shard_t *shard,
+               const char *dir,
+               const char *name,
+               time_t lease_sec);
+
+/**
+ * @brief shard_leave Removes a lease of a node, so that other nodes take
+ *                    over its directories without waiting for expiration.
+ *
+ * @param[in,out] shard A node's view.
+ */
+void shard_leave(shard_t *shard);
+
+/**
+ * @brief shard_renew Renews a lease of a node if a half of the lease period
+ *                    has passed since the last renewal.
+ *
+ * @note The function is thread-safe; it is cheap enough to be called for
+ *       every scanned directory, so that a long scan does not lose the lease.
+ *
+ * @param[in,out] shard A node's view.
+ */
+void shard_renew(shard_t *shard);
+
+/**
+ * @brief shard_refresh Renews a lease of a node and rereads a set of live
+ *                      nodes.
+ *
+ * @warning The function is not thread-safe; it should not be called while
+ *          shard_owns() is used by other threads.
+ *
+ * @param[in,out] shard A node's view.
+ *
+ * @return  1: the set of live nodes has changed
+ *          0: the set of live nodes is the same
+ *         -1: the lease directory is not readable; the set is not changed
+ */
+int shard_refresh(shard_t *shard);
+
+/**
+ * @brief shard_owns Checks whether a node owns a directory.
+ *
+ * @note The function is thread-safe.
+ *
+ * @param[in] shard A node's view.
+ * @param[in] path  A path of the directory.
+ *
+ * @return 1: the directory belongs to the node
+ *         0: the directory belongs to another node
+ */
+int shard_owns(const shard_t *shard, const char *path);
+
+#endif    /* CLOUDTIERING_SHARD_H */
@@ -0,0 +1,109 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLOUDTIERING_STATUS_H
+#define CLOUDTIERING_STATUS_H
+
+/*******************************************************************************
+* STATUS PAGE                                                                  *
+* -----------                                                                  *
+*                                                                              *
+* A small page in a shared memory where the daemon tells processes that it is  *
+* alive, so that the library does not wait forever for recalls which a dead    *
+* daemon will never perform.                                                   *
+*                                                                              *
+* The daemon updates a heartbeat (a CLOCK_MONOTONIC timestamp) of the page     *
+* once per period; the daemon is considered dead if it has missed              *
+* STATUS_MISSED_BEATS heartbeats. Every start of the daemon increments an      *
+* epoch of the page, so a process may notice that the daemon has restarted     *
+* while the process was waiting for it and repeat its requests.                *
+*******************************************************************************/
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "defs.h"
+
+#define STATUS_SHM_OBJ    "/" PROGRAM_NAME "-status"
+
+/* the daemon is considered dead after this number of missed heartbeats */
+#define STATUS_MISSED_BEATS    5
+
+/* a definition of the status page */
+typedef struct {
+        /* a magic number identifying a completely initialized page */
+        uint32_t magic;
+
+        /* a version of the page's layout */
+        uint32_t version;
+
+        /* a process identifier of the daemon */
+        uint64_t pid;
+
+        /* a number of starts of the daemon */
+        uint64_t epoch;
+
+        /* a period of heartbeats in milliseconds */
+        uint64_t period_ms;
+
+        /* a time of the last heartbeat in nanoseconds of CLOCK_MONOTONIC */
+        uint64_t heartbeat_ns;
+} status_t;
+
+/**
+ * @brief status_create Creates a status page in a shared memory or reuses
+ *                      an existing one, starts a new epoch and makes the first
+ *                      heartbeat.
+ *
+ * @param[out] status_p  A pointer to the page to be initialized.
+ * @param[in]  shm_obj   A name of the shared memory object.
+ * @param[in]  period_ms A period of heartbeats in milliseconds.
+ *
+ * @return  0: the page has been created
+ *         -1: the page has not been created
+ */
+int status_create(status_t **status_p, const char *shm_obj, uint32_t period_ms);
+
+/**
+ * @brief status_attach Maps an existing status page read-only.
+ *
+ * @param[out] status_p A pointer to the page to be initialized.
+ * @param[in]  shm_obj  A name of the shared memory object.
+ *
+ * @return  0: the page has been attached
+ *         -1: the page does not exist or is not valid
+ */
+int status_attach(const status_t **status_p, const char *shm_obj);
+
+/**
+ * @brief status_beat Makes a heartbeat.
+ *
+ * @param[in,out] status A status page.
+ */
+void status_beat(status_t *status);
+
+/**
+ * @brief status_is_alive Checks whether the daemon is alive.
+ *
+ * @param[in]  status A status page.
+ * @param[out] epoch  An epoch of the daemon; may be NULL.
+ *
+ * @return 1 if the daemon has made a heartbeat recently, 0 otherwise
+ */
+int status_is_alive(const status_t *status, uint64_t *epoch);
+
+#endif    /* CLOUDTIERING_STATUS_H */
@@ -19,21 +19,79 @@
 #define CLOUDTIERING_SYMS_H
 
 #include <stdio.h>
+#include <aio.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 
-/* Since this library aims to be a POSIX-conformant, there is no need to
-   implement LFS specification because it is an ptional feature in SUSv2+.
-   It is not presented in POSIX */
+/* LFS variants (open64() etc.) are not part of POSIX, but glibc redirects
+   calls of programs compiled with _FILE_OFFSET_BITS=64 to them, hence they
+   are wrapped as well as fortified variants (__open_2() etc.); files
+   including this header should define _LARGEFILE64_SOURCE or _GNU_SOURCE */
 
 typedef struct {
     int (*open)( const char *, int, ... );
     int (*openat)( int, const char *, int, ... );
+    int (*open64)( const char *, int, ... );
+    int (*openat64)( int, const char *, int, ... );
+    int (*__open_2)( const char *, int );
+    int (*__open64_2)( const char *, int );
 
     int (*truncate)( const char *, off_t );
+    int (*ftruncate)( int, off_t );
+    int (*truncate64)( const char *, off64_t );
+    int (*ftruncate64)( int, off64_t );
 
     FILE *(*fopen)( const char *, const char * );
     FILE *(*freopen)( const char *, const char *, FILE * );
+    FILE *(*fopen64)( const char *, const char * );
+    FILE *(*freopen64)( const char *, const char *, FILE * );
+    FILE *(*fdopen)( int, const char * );
+
+    ssize_t (*read)( int, void *, size_t );
+    ssize_t (*pread)( int, void *, size_t, off_t );
+    ssize_t (*pread64)( int, void *, size_t, off64_t );
+    ssize_t (*readv)( int, const struct iovec *, int );
+    ssize_t (*preadv)( int, const struct iovec *, int, off_t );
+    ssize_t (*preadv64)( int, const struct iovec *, int, off64_t );
+    ssize_t (*preadv2)( int, const struct iovec *, int, off_t, int );
+    ssize_t (*preadv64v2)( int, const struct iovec *, int, off64_t, int );
+    ssize_t (*__read_chk)( int, void *, size_t, size_t );
+    ssize_t (*__pread_chk)( int, void *, size_t, off_t, size_t );
+    ssize_t (*__pread64_chk)( int, void *, size_t, off64_t, size_t );
+    ssize_t (*write)( int, const void *, size_t );
+    ssize_t (*pwrite)( int, const void *, size_t, off_t );
+    ssize_t (*pwrite64)( int, const void *, size_t, off64_t );
+    ssize_t (*writev)( int, const struct iovec *, int );
+    ssize_t (*pwritev)( int, const struct iovec *, int, off_t );
+    ssize_t (*pwritev64)( int, const struct iovec *, int, off64_t );
+    ssize_t (*pwritev2)( int, const struct iovec *, int, off_t, int );
+    ssize_t (*pwritev64v2)( int, const struct iovec *, int, off64_t, int );
+    void *(*mmap)( void *, size_t, int, int, int, off_t );
+    void *(*mmap64)( void *, size_t, int, int, int, off64_t );
+
+    ssize_t (*sendfile)( int, int, off_t *, size_t );
+    ssize_t (*sendfile64)( int, int, off64_t *, size_t );
+    ssize_t (*copy_file_range)( int, off64_t *, int, off64_t *, size_t,
+                                unsigned int );
+    ssize_t (*splice)( int, off64_t *, int, off64_t *, size_t, unsigned int );
+
+    int (*aio_read)( struct aiocb * );
+    int (*aio_read64)( struct aiocb64 * );
+    int (*aio_write)( struct aiocb * );
+    int (*aio_write64)( struct aiocb64 * );
+    int (*lio_listio)( int, struct aiocb *const [], int, struct sigevent * );
+    int (*lio_listio64)( int,
+                         struct aiocb64 *const [],
+                         int,
+                         struct sigevent * );
+
+    int (*close)( int );
+    int (*dup)( int );
+    int (*dup2)( int, int );
+    int (*dup3)( int, int, int );
+    int (*fcntl)( int, int, ... );
+    int (*fcntl64)( int, int, ... );
 } symbols_t;
 
 symbols_t *get_syms( void );
@@ -41,6 +99,14 @@ symbols_t *get_syms( void );
 int is_local_file( int fd, int flags );
 int clear_xattrs( int fd );
 int schedule_download( int fd );
-int poll_file_location( int fd, int flags, int should_wait );
+int poll_file_location( int fd, int flags );
+int prepare_opened_file( int fd, int flags, int allow_defer );
+
+int defer_recall( int fd, int flags );
+int finish_deferred_recall( int fd );
+int finish_streamed_recall( int fd );
+int await_file_data( int fd, off_t offset, size_t count );
+void move_deferred_recall( int old_fd, int new_fd );
+void forget_deferred_recall( int fd );
 
 #endif /* CLOUDTIERING_SYMS_H */
@@ -18,8 +18,23 @@
 #ifndef CLOUDTIERING_TEST_H
 #define CLOUDTIERING_TEST_H
 
+int test_bloom(char *err_msg);
+int test_catalog(char *err_msg);
 int test_conf(char *err_msg);
+int test_crc32c(char *err_msg);
+int test_location(char *err_msg);
+int test_lock(char *err_msg);
 int test_log(char *err_msg);
+int test_meta(char *err_msg);
+int test_objid(char *err_msg);
+int test_pace(char *err_msg);
+int test_pack(char *err_msg);
+int test_prefetch(char *err_msg);
+int test_progress(char *err_msg);
 int test_queue(char *err_msg);
+int test_rules(char *err_msg);
+int test_shard(char *err_msg);
+int test_status(char *err_msg);
+int test_walk(char *err_msg);
 
 #endif    /* CLOUDTIERING_TEST_H */
@@ -0,0 +1,124 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLOUDTIERING_WALK_H
+#define CLOUDTIERING_WALK_H
+
+/*******************************************************************************
+* FILE TREE WALK                                                               *
+* --------------                                                               *
+*                                                                              *
+* A multithreaded replacement of nftw(3) for file systems where every          *
+* metadata operation is a network round trip.                                  *
+*                                                                              *
+* Each thread owns a deque of directories to be read. A thread takes           *
+* directories from the bottom of its own deque (depth-first, which keeps the   *
+* deque short) and pushes there subdirectories it finds. An idle thread steals *
+* a directory from the top of another thread's deque, which is usually the     *
+* biggest pending subtree. The walk is finished when there are no queued or    *
+* being read directories.                                                      *
+*                                                                              *
+* Like nftw(3) with FTW_MOUNT | FTW_PHYS flags, the walk stays within the file *
+* system of the root directory and does not follow symbolic links.             *
+*                                                                              *
+* Directories are read with getdents64(2) into large buffers. Unlike nftw(3),  *
+* the walk reports only regular files and relies on d_type of directory        *
+* entries, so that only regular files and entries of unknown type are stat'ed. *
+* A user who keeps its own record of files (see catalog.h) may also tell the   *
+* walk that regular files of a directory do not need to be stat'ed, and a     *
+* user who handles only a part of the file system (see shard.h) may tell it    *
+* to skip regular files of a directory while still descending into its         *
+* subdirectories.                                                              *
+*******************************************************************************/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "pace.h"
+
+/* verdicts of a directory callback */
+#define WALK_STAT_FILES    0    /* stat and visit regular files */
+#define WALK_SKIP_STAT     1    /* visit regular files without stat */
+#define WALK_SKIP_FILES    2    /* do not visit regular files */
+
+/**
+ * @brief walk_cb_t A callback invoked for every visited regular file.
+ *
+ * @note The callback is invoked concurrently from several threads.
+ *
+ * @param[in] path A path of the visited file.
+ * @param[in] ino  An inode number of the visited file.
+ * @param[in] sb   An lstat(2) information of the visited file or NULL if
+ *                 the directory callback has asked to skip stat of files.
+ * @param[in] arg  An argument passed to walk_tree().
+ *
+ * @return  0: continue the walk
+ *         !0: stop the walk; walk_tree() returns this value
+ */
+typedef int (*walk_cb_t)(const char *path,
+                         ino_t ino,
+                         const struct stat *sb,
+                         void *arg);
+
+/**
+ * @brief walk_dir_cb_t A callback invoked for every directory before its
+ *                      entries are read.
+ *
+ * @note The callback is invoked concurrently from several threads.
+ *
+ * @param[in] path A path of the directory.
+ * @param[in] sb   An fstat(2) information of the directory.
+ * @param[in] arg  An argument passed to walk_tree().
+ *
+ * @return WALK_STAT_FILES: regular files of the directory should be stat'ed
+ *         WALK_SKIP_STAT:  regular files of the directory should be visited
+ *                          without stat information
+ *         WALK_SKIP_FILES: regular files of the directory should not be
+ *                          visited; subdirectories are walked anyway
+ */
+typedef int (*walk_dir_cb_t)(const char *path,
+                             const struct stat *sb,
+                             void *arg);
+
+/**
+ * @brief walk_tree Walks a file tree and invokes a callback for each regular
+ *                  file.
+ *
+ * @note Unreadable directories and entries with too long paths are skipped.
+ *
+ * @param[in] root    A root directory of the file tree.
+ * @param[in] threads A number of threads walking the tree (at least 1);
+ *                    the calling thread is one of them.
+ * @param[in] dir_cb  A callback to be invoked for each directory or NULL.
+ * @param[in] cb      A callback to be invoked for each regular file.
+ * @param[in] arg     An argument to be passed to the callback.
+ * @param[in] pace    A pacer which slows the walk down after each directory
+ *                    or NULL.
+ *
+ * @return  0: the whole tree has been walked
+ *         -1: the walk failed (e.g. root directory is not available)
+ *         otherwise: the walk has been stopped by the callback, which has
+ *                    returned this value
+ */
+int walk_tree(const char *root,
+              size_t threads,
+              walk_dir_cb_t dir_cb,
+              walk_cb_t cb,
+              void *arg,
+              pace_t *pace);
+
+#endif    /* CLOUDTIERING_WALK_H */
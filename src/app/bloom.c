@@ -0,0 +1,138 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include "bloom.h"
+
+/* a number of bits per key which gives about 1% of false positives */
+#define BLOOM_BITS_PER_KEY    10
+
+/**
+ * @brief bloom_mix Mixes bits of a 64-bit value (a finalizer of SplitMix64).
+ *
+ * @param[in] x A value.
+ *
+ * @return the mixed value
+ */
+static inline uint64_t bloom_mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        x ^= x >> 31;
+
+        return x;
+}
+
+/**
+ * Allocate an empty filter.
+ * See bloom.h for complete description.
+ */
+int bloom_init(bloom_t *bloom, size_t capacity) {
+        if (bloom == NULL || capacity == 0) {
+                return -1;
+        }
+
+        uint64_t nbits = 64;
+        while (nbits < (uint64_t)capacity * BLOOM_BITS_PER_KEY) {
+                nbits <<= 1;
+        }
+
+        bloom->bits = calloc(nbits / 64, sizeof(uint64_t));
+        if (bloom->bits == NULL) {
+                return -1;
+        }
+
+        bloom->mask = nbits - 1;
+        bloom->capacity = capacity;
+        bloom->count = 0;
+        bloom->seed = 0;
+
+        return 0;
+}
+
+/**
+ * Release memory of a filter.
+ * See bloom.h for complete description.
+ */
+void bloom_free(bloom_t *bloom) {
+        free(bloom->bits);
+        bloom->bits = NULL;
+}
+
+/**
+ * Remove all keys from a filter.
+ * See bloom.h for complete description.
+ */
+void bloom_clear(bloom_t *bloom) {
+        for (uint64_t i = 0; i <= bloom->mask / 64; i++) {
+                __atomic_store_n(&bloom->bits[i], 0, __ATOMIC_RELAXED);
+        }
+
+        __atomic_store_n(&bloom->count, 0, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&bloom->seed, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Add a key to a filter.
+ * See bloom.h for complete description.
+ */
+void bloom_add(bloom_t *bloom, uint64_t key) {
+        uint64_t seed = __atomic_load_n(&bloom->seed, __ATOMIC_RELAXED);
+        uint64_t h1 = bloom_mix(key ^ bloom_mix(seed));
+        uint64_t h2 = bloom_mix(h1) | 1;
+
+        for (int i = 0; i < BLOOM_PROBES; i++) {
+                uint64_t bit = (h1 + i * h2) & bloom->mask;
+                __atomic_fetch_or(&bloom->bits[bit / 64],
+                                  1ULL << (bit % 64),
+                                  __ATOMIC_RELAXED);
+        }
+
+        __atomic_add_fetch(&bloom->count, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Test whether a key has been added to a filter.
+ * See bloom.h for complete description.
+ */
+int bloom_test(const bloom_t *bloom, uint64_t key) {
+        uint64_t seed = __atomic_load_n(&bloom->seed, __ATOMIC_RELAXED);
+        uint64_t h1 = bloom_mix(key ^ bloom_mix(seed));
+        uint64_t h2 = bloom_mix(h1) | 1;
+
+        for (int i = 0; i < BLOOM_PROBES; i++) {
+                uint64_t bit = (h1 + i * h2) & bloom->mask;
+                uint64_t word = __atomic_load_n(&bloom->bits[bit / 64],
+                                                __ATOMIC_RELAXED);
+                if ((word & (1ULL << (bit % 64))) == 0) {
+                        return 0;
+                }
+        }
+
+        return 1;
+}
+
+/**
+ * Check whether a filter has outgrown its capacity.
+ * See bloom.h for complete description.
+ */
+int bloom_full(const bloom_t *bloom) {
+        return __atomic_load_n(&bloom->count, __ATOMIC_RELAXED) >
+               bloom->capacity;
+}
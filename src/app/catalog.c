@@ -0,0 +1,272 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE    200112L
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "catalog.h"
+
+/* "CTCA" in ASCII; identifies a completely initialized catalog */
+#define CATALOG_MAGIC      0x43544341
+
+/* version of the catalog layout; bump on every incompatible change */
+#define CATALOG_VERSION    1
+
+/* the catalog is cleared if it is loaded more than this percentage */
+#define CATALOG_MAX_LOAD_PCT    90
+
+/**
+ * @brief catalog_entries Returns a pointer to the first catalog's entry.
+ *
+ * @param[in] catalog A catalog.
+ *
+ * @return a pointer to the first entry
+ */
+static inline catalog_entry_t *catalog_entries(catalog_t *catalog) {
+        return (catalog_entry_t *)((char *)catalog + catalog->entries_offset);
+}
+
+/**
+ * @brief catalog_hash Calculates a position of an inode number in the table.
+ *
+ * @param[in] catalog A catalog.
+ * @param[in] ino     An inode number.
+ *
+ * @return an index of the first entry to be probed
+ */
+static inline size_t catalog_hash(const catalog_t *catalog, uint64_t ino) {
+        /* inode numbers are often sequential; mix bits to avoid clustering
+           (a finalizer of MurmurHash3) */
+        ino ^= ino >> 33;
+        ino *= 0xff51afd7ed558ccdULL;
+        ino ^= ino >> 33;
+        ino *= 0xc4ceb9fe1a85ec53ULL;
+        ino ^= ino >> 33;
+
+        return ino % catalog->capacity;
+}
+
+/**
+ * @brief catalog_reset Clears a catalog.
+ *
+ * @param[in,out] catalog A catalog.
+ * @param[in]     dev     A device of the file system to be described.
+ */
+static void catalog_reset(catalog_t *catalog, dev_t dev) {
+        memset(catalog_entries(catalog),
+               0,
+               catalog->capacity * sizeof(catalog_entry_t));
+
+        catalog->dev = dev;
+        catalog->count = 0;
+        catalog->complete = 0;
+}
+
+/**
+ * Open a catalog.
+ * See catalog.h for complete description.
+ */
+int catalog_open(catalog_t **catalog_p, const char *path, size_t capacity) {
+        if (catalog_p == NULL || path == NULL || capacity == 0) {
+                return -1;
+        }
+
+        long page_size = sysconf(_SC_PAGESIZE);
+        if (page_size == -1) {
+                return -1;
+        }
+
+        size_t entries_offset = page_size;
+        size_t total_size = entries_offset +
+                            capacity * sizeof(catalog_entry_t);
+
+        int fd = open(path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+        if (fd == -1) {
+                return -1;
+        }
+
+        struct stat sb;
+        if (fstat(fd, &sb) == -1) {
+                close(fd);
+                return -1;
+        }
+
+        /* a file of another size can not contain a suitable catalog;
+           the file is sparse, so unused entries do not occupy disk space */
+        int should_format = ((size_t)sb.st_size != total_size);
+        if (should_format && (ftruncate(fd, 0) == -1 ||
+                              ftruncate(fd, total_size) == -1)) {
+                close(fd);
+                return -1;
+        }
+
+        catalog_t *catalog = mmap(NULL,                        /* addr */
+                                  total_size,                  /* len */
+                                  PROT_READ | PROT_WRITE,      /* prot */
+                                  MAP_SHARED,                  /* flags */
+                                  fd,                          /* fd */
+                                  0);                          /* offset */
+
+        /* no longer needed; do not check close() error because the mapping
+           (if any) stays valid anyway */
+        close(fd);
+
+        if (catalog == MAP_FAILED) {
+                return -1;
+        }
+
+        if (should_format ||
+            catalog->magic != CATALOG_MAGIC ||
+            catalog->version != CATALOG_VERSION ||
+            catalog->capacity != capacity ||
+            catalog->entries_offset != entries_offset ||
+            catalog->total_size != total_size) {
+                catalog->magic = 0;
+                catalog->version = CATALOG_VERSION;
+                catalog->capacity = capacity;
+                catalog->generation = 0;
+                catalog->entries_offset = entries_offset;
+                catalog->total_size = total_size;
+
+                if (!should_format) {
+                        /* the file has been truncated otherwise */
+                        catalog_reset(catalog, 0);
+                }
+
+                catalog->dev = 0;
+                catalog->count = 0;
+                catalog->complete = 0;
+
+                catalog->magic = CATALOG_MAGIC;
+        }
+
+        *catalog_p = catalog;
+
+        return 0;
+}
+
+/**
+ * Close a catalog.
+ * See catalog.h for complete description.
+ */
+void catalog_close(catalog_t *catalog) {
+        if (catalog == NULL) {
+                return;
+        }
+
+        if (munmap(catalog, catalog->total_size) == -1) {
+                /* catalog structure is corrupted */
+        }
+}
+
+/**
+ * Start a new scan pass.
+ * See catalog.h for complete description.
+ */
+int catalog_begin_pass(catalog_t *catalog, dev_t dev) {
+        uint64_t count = __atomic_load_n(&catalog->count, __ATOMIC_RELAXED);
+
+        if (catalog->dev != (uint64_t)dev ||
+            count * 100 > catalog->capacity * CATALOG_MAX_LOAD_PCT) {
+                catalog_reset(catalog, dev);
+        }
+
+        catalog->generation++;
+
+        return catalog->complete;
+}
+
+/**
+ * Finish a scan pass.
+ * See catalog.h for complete description.
+ */
+void catalog_end_pass(catalog_t *catalog, int complete) {
+        if (complete) {
+                catalog->complete = 1;
+        }
+}
+
+/**
+ * Find an entry of a file.
+ * See catalog.h for complete description.
+ */
+catalog_entry_t *catalog_lookup(catalog_t *catalog, ino_t ino) {
+        catalog_entry_t *entries = catalog_entries(catalog);
+        size_t pos = catalog_hash(catalog, ino);
+
+        for (size_t i = 0; i < catalog->capacity; i++) {
+                uint64_t cur = __atomic_load_n(&entries[pos].ino,
+                                               __ATOMIC_ACQUIRE);
+                if (cur == (uint64_t)ino) {
+                        return &entries[pos];
+                }
+
+                if (cur == 0) {
+                        return NULL;
+                }
+
+                pos = (pos + 1 == catalog->capacity) ? 0 : pos + 1;
+        }
+
+        return NULL;
+}
+
+/**
+ * Find an entry of a file or add a new one.
+ * See catalog.h for complete description.
+ */
+catalog_entry_t *catalog_insert(catalog_t *catalog, ino_t ino) {
+        catalog_entry_t *entries = catalog_entries(catalog);
+        size_t pos = catalog_hash(catalog, ino);
+
+        if (ino == 0) {
+                return NULL;
+        }
+
+        for (size_t i = 0; i < catalog->capacity; i++) {
+                uint64_t cur = __atomic_load_n(&entries[pos].ino,
+                                               __ATOMIC_ACQUIRE);
+                if (cur == 0) {
+                        /* claim an empty entry; on failure another thread
+                           has claimed it, so check what it has put there */
+                        if (__atomic_compare_exchange_n(&entries[pos].ino,
+                                                        &cur,
+                                                        (uint64_t)ino,
+                                                        0,
+                                                        __ATOMIC_ACQ_REL,
+                                                        __ATOMIC_ACQUIRE)) {
+                                __atomic_add_fetch(&catalog->count,
+                                                   1,
+                                                   __ATOMIC_RELAXED);
+                                return &entries[pos];
+                        }
+                }
+
+                if (cur == (uint64_t)ino) {
+                        return &entries[pos];
+                }
+
+                pos = (pos + 1 == catalog->capacity) ? 0 : pos + 1;
+        }
+
+        return NULL;
+}
@@ -104,6 +104,131 @@ static DOTCONF_CB(scanfs_iter_tm_sec_cb) {
         return NULL;
 }
 
+static DOTCONF_CB(scanfs_threads_cb) {
+        if (cmd->data.value < 1) {
+                return "at least one scanning thread is required";
+        }
+
+        conf->scanfs_threads = (size_t)cmd->data.value;
+        return NULL;
+}
+
+static DOTCONF_CB(scanfs_max_delay_msec_cb) {
+        conf->scanfs_max_delay_msec = (size_t)cmd->data.value;
+        return NULL;
+}
+
+static DOTCONF_CB(scanfs_io_pressure_limit_cb) {
+        if (cmd->data.dvalue < 0 || cmd->data.dvalue > 100) {
+                return "I/O pressure limit should be in range [0, 100]";
+        }
+
+        conf->scanfs_io_pressure_limit = cmd->data.dvalue;
+        return NULL;
+}
+
+static DOTCONF_CB(catalog_path_cb) {
+        strcpy(conf->catalog_path, cmd->data.str);
+        return NULL;
+}
+
+static DOTCONF_CB(catalog_max_entries_cb) {
+        if (cmd->data.value < 1) {
+                return "catalog should contain at least one entry";
+        }
+
+        conf->catalog_max_entries = (size_t)cmd->data.value;
+        return NULL;
+}
+
+static DOTCONF_CB(catalog_full_scan_passes_cb) {
+        conf->catalog_full_scan_passes = (size_t)cmd->data.value;
+        return NULL;
+}
+
+static DOTCONF_CB(rule_cb) {
+        if (rules_add(&conf->rules,
+                      (size_t)cmd->arg_count,
+                      (const char *const *)cmd->data.list) == -1) {
+                return "invalid policy rule or too many rules";
+        }
+
+        return NULL;
+}
+
+static DOTCONF_CB(shard_dir_cb) {
+        strcpy(conf->shard_dir, cmd->data.str);
+        return NULL;
+}
+
+static DOTCONF_CB(shard_node_name_cb) {
+        if (strlen(cmd->data.str) >= sizeof(conf->shard_node_name) ||
+            strchr(cmd->data.str, '/') != NULL ||
+            cmd->data.str[0] == '.') {
+                return "node name should be a valid file name shorter than "
+                       "64 characters";
+        }
+
+        strcpy(conf->shard_node_name, cmd->data.str);
+        return NULL;
+}
+
+static DOTCONF_CB(shard_lease_sec_cb) {
+        if (cmd->data.value < 1) {
+                return "lease period should be positive";
+        }
+
+        conf->shard_lease_sec = (time_t)cmd->data.value;
+        return NULL;
+}
+
+static DOTCONF_CB(location_cache_entries_cb) {
+        conf->location_cache_entries = (size_t)cmd->data.value;
+        return NULL;
+}
+
+static DOTCONF_CB(remote_filter_max_entries_cb) {
+        conf->remote_filter_max_entries = (size_t)cmd->data.value;
+        return NULL;
+}
+
+static DOTCONF_CB(heartbeat_period_msec_cb) {
+        if (cmd->data.value < 1) {
+                return "heartbeat period should be positive";
+        }
+
+        conf->heartbeat_period_msec = (size_t)cmd->data.value;
+        return NULL;
+}
+
+static DOTCONF_CB(pack_max_file_size_cb) {
+        conf->pack_max_file_size = (uint64_t)cmd->data.value;
+        return NULL;
+}
+
+static DOTCONF_CB(pack_max_object_size_cb) {
+        if (cmd->data.value < 1) {
+                return "pack should be at least one byte long";
+        }
+
+        conf->pack_max_object_size = (uint64_t)cmd->data.value;
+        return NULL;
+}
+
+static DOTCONF_CB(pack_max_files_cb) {
+        if (cmd->data.value < 1) {
+                return "pack should contain at least one file";
+        }
+
+        conf->pack_max_files = (size_t)cmd->data.value;
+        return NULL;
+}
+
+static DOTCONF_CB(prefetch_depth_cb) {
+        conf->prefetch_depth = (size_t)cmd->data.value;
+        return NULL;
+}
+
 static DOTCONF_CB(move_out_start_rate_cb) {
         conf->move_out_start_rate = (double)cmd->data.dvalue;
         return NULL;
@@ -134,6 +259,11 @@ static DOTCONF_CB(secondary_upload_queue_max_size_cb) {
         return NULL;
 }
 
+static DOTCONF_CB(queue_journal_dir_cb) {
+        strcpy(conf->queue_journal_dir, cmd->data.str);
+        return NULL;
+}
+
 static DOTCONF_CB(logger_cb) {
         for (int i = 0; i < log_count; i++) {
                 if (strcmp(cmd->data.str, log_str[i]) == 0) {
@@ -208,14 +338,36 @@ static const configoption_t options[] = {
         /* Internal section */
         { beg_Internal_section_str,        ARG_NONE,   beg_Internal_section_cb,              NULL, CTX_ALL               },
         { "ScanfsIterTimeoutSec",          ARG_INT,    scanfs_iter_tm_sec_cb,                NULL, SECTION_CTX(Internal) },
+        { "ScanfsThreads",                 ARG_INT,    scanfs_threads_cb,                    NULL, SECTION_CTX(Internal) },
+        { "ScanfsMaxDelayMsec",            ARG_INT,    scanfs_max_delay_msec_cb,             NULL, SECTION_CTX(Internal) },
+        { "ScanfsIoPressureLimit",         ARG_DOUBLE, scanfs_io_pressure_limit_cb,          NULL, SECTION_CTX(Internal) },
+        { "CatalogPath",                   ARG_STR,    catalog_path_cb,                      NULL, SECTION_CTX(Internal) },
+        { "CatalogMaxEntries",             ARG_INT,    catalog_max_entries_cb,               NULL, SECTION_CTX(Internal) },
+        { "CatalogFullScanPasses",         ARG_INT,    catalog_full_scan_passes_cb,          NULL, SECTION_CTX(Internal) },
+        { "ShardDir",                      ARG_STR,    shard_dir_cb,                         NULL, SECTION_CTX(Internal) },
+        { "ShardNodeName",                 ARG_STR,    shard_node_name_cb,                   NULL, SECTION_CTX(Internal) },
+        { "ShardLeaseSec",                 ARG_INT,    shard_lease_sec_cb,                   NULL, SECTION_CTX(Internal) },
+        { "LocationCacheEntries",          ARG_INT,    location_cache_entries_cb,            NULL, SECTION_CTX(Internal) },
+        { "RemoteFilterMaxEntries",        ARG_INT,    remote_filter_max_entries_cb,         NULL, SECTION_CTX(Internal) },
+        { "HeartbeatPeriodMsec",           ARG_INT,    heartbeat_period_msec_cb,             NULL, SECTION_CTX(Internal) },
+        { "PackMaxFileSize",               ARG_INT,    pack_max_file_size_cb,                NULL, SECTION_CTX(Internal) },
+        { "PackMaxObjectSize",             ARG_INT,    pack_max_object_size_cb,              NULL, SECTION_CTX(Internal) },
+        { "PackMaxFiles",                  ARG_INT,    pack_max_files_cb,                    NULL, SECTION_CTX(Internal) },
+        { "PrefetchDepth",                 ARG_INT,    prefetch_depth_cb,                    NULL, SECTION_CTX(Internal) },
         { "MoveOutStartRate",              ARG_DOUBLE, move_out_start_rate_cb,               NULL, SECTION_CTX(Internal) },
         { "MoveOutStopRate",               ARG_DOUBLE, move_out_stop_rate_cb,                NULL, SECTION_CTX(Internal) },
         { "PrimaryDownloadQueueMaxSize",   ARG_INT,    primary_download_queue_max_size_cb,   NULL, SECTION_CTX(Internal) },
         { "SecondaryDownloadQueueMaxSize", ARG_INT,    secondary_download_queue_max_size_cb, NULL, SECTION_CTX(Internal) },
         { "PrimaryUploadQueueMaxSize",     ARG_INT,    primary_upload_queue_max_size_cb,     NULL, SECTION_CTX(Internal) },
         { "SecondaryUploadQueueMaxSize",   ARG_INT,    secondary_upload_queue_max_size_cb,   NULL, SECTION_CTX(Internal) },
+        { "QueueJournalDir",               ARG_STR,    queue_journal_dir_cb,                 NULL, SECTION_CTX(Internal) },
         { end_Internal_section_str,        ARG_NONE,   end_Internal_section_cb,              NULL, CTX_ALL               },
 
+        /* Policy section */
+        { beg_Policy_section_str, ARG_NONE, beg_Policy_section_cb, NULL, CTX_ALL             },
+        { "Rule",                 ARG_LIST, rule_cb,               NULL, SECTION_CTX(Policy) },
+        { end_Policy_section_str, ARG_NONE, end_Policy_section_cb, NULL, CTX_ALL             },
+
         /* S3RemoteStore section */
         { beg_S3RemoteStore_section_str, ARG_NONE, beg_S3RemoteStore_section_cb, NULL, CTX_ALL                    },
         { "Hostname",                    ARG_STR,  hostname_cb,                  NULL, SECTION_CTX(S3RemoteStore) },
@@ -291,6 +443,26 @@ int read_conf(const char *conf_path) {
                 return -1;
         }
 
+        /* default values of optional parameters */
+        conf->scanfs_threads = 4;
+        conf->scanfs_max_delay_msec = 100;
+        conf->scanfs_io_pressure_limit = 10.0;
+        conf->catalog_path[0] = '\0';
+        conf->catalog_max_entries = 4194304;
+        conf->catalog_full_scan_passes = 10;
+        conf->shard_dir[0] = '\0';
+        conf->shard_node_name[0] = '\0';
+        conf->shard_lease_sec = 600;
+        conf->location_cache_entries = 262144;
+        conf->remote_filter_max_entries = 4194304;
+        conf->heartbeat_period_msec = 1000;
+        conf->pack_max_file_size = 0;
+        conf->pack_max_object_size = 67108864;
+        conf->pack_max_files = 1024;
+        conf->prefetch_depth = 4;
+        conf->queue_journal_dir[0] = '\0';
+        rules_init(&conf->rules);
+
         configfile_t *config_file;
 
         config_file = dotconf_create((char *)conf_path, options, NULL, NONE);
@@ -304,5 +476,12 @@ int read_conf(const char *conf_path) {
 
         dotconf_cleanup(config_file);
 
+        /* files not accessed for a while are evicted if there is no policy */
+        if (conf->rules.count == 0) {
+                static const char *default_rule[] = { "evict", "atime>30s" };
+
+                rules_add(&conf->rules, 2, default_rule);
+        }
+
         return 0;
 }
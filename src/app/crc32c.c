@@ -0,0 +1,157 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <pthread.h>
+
+#include "crc32c.h"
+
+/* the Castagnoli polynomial in the reversed bit order */
+#define CRC32C_POLY    0x82f63b78
+
+/* tables of the slicing-by-8 algorithm; table[0] is the classic byte-wise
+   table and table[k] advances a byte by k more zero bytes */
+static uint32_t crc32c_table[8][256];
+
+/* an implementation chosen on the first call */
+static uint32_t (*crc32c_impl)(uint32_t, const unsigned char *, size_t);
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief crc32c_slice8 Updates a raw (not inverted) checksum with a chunk of
+ *                      data using the slicing-by-8 tables.
+ *
+ * @param[in] crc A raw checksum.
+ * @param[in] p   A chunk of data.
+ * @param[in] len A length of the chunk.
+ *
+ * @return the updated raw checksum
+ */
+static uint32_t crc32c_slice8(uint32_t crc,
+                              const unsigned char *p,
+                              size_t len) {
+        /* the first word is assembled in little-endian order, so the result
+           does not depend on the host's byte order */
+        while (len >= 8) {
+                uint32_t lo = crc ^ ((uint32_t)p[0] |
+                                     (uint32_t)p[1] << 8 |
+                                     (uint32_t)p[2] << 16 |
+                                     (uint32_t)p[3] << 24);
+
+                crc = crc32c_table[7][lo & 0xff] ^
+                      crc32c_table[6][(lo >> 8) & 0xff] ^
+                      crc32c_table[5][(lo >> 16) & 0xff] ^
+                      crc32c_table[4][lo >> 24] ^
+                      crc32c_table[3][p[4]] ^
+                      crc32c_table[2][p[5]] ^
+                      crc32c_table[1][p[6]] ^
+                      crc32c_table[0][p[7]];
+
+                p += 8;
+                len -= 8;
+        }
+
+        while (len--) {
+                crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+        }
+
+        return crc;
+}
+
+#if defined(__x86_64__)
+
+/**
+ * @brief crc32c_hw Updates a raw (not inverted) checksum with a chunk of data
+ *                  using the crc32 instruction of SSE4.2.
+ *
+ * @param[in] crc A raw checksum.
+ * @param[in] p   A chunk of data.
+ * @param[in] len A length of the chunk.
+ *
+ * @return the updated raw checksum
+ */
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char *p, size_t len) {
+        uint64_t crc64 = crc;
+
+        while (len >= 8) {
+                uint64_t word;
+                memcpy(&word, p, sizeof(word)); /* p may be unaligned */
+                crc64 = __builtin_ia32_crc32di(crc64, word);
+
+                p += 8;
+                len -= 8;
+        }
+
+        crc = (uint32_t)crc64;
+        while (len--) {
+                crc = __builtin_ia32_crc32qi(crc, *p++);
+        }
+
+        return crc;
+}
+
+#endif
+
+/**
+ * @brief crc32c_init Fills the tables and chooses an implementation.
+ */
+static void crc32c_init(void) {
+        for (uint32_t i = 0; i < 256; i++) {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; bit++) {
+                        crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+                }
+                crc32c_table[0][i] = crc;
+        }
+
+        for (uint32_t i = 0; i < 256; i++) {
+                for (int k = 1; k < 8; k++) {
+                        uint32_t prev = crc32c_table[k - 1][i];
+                        crc32c_table[k][i] = crc32c_table[0][prev & 0xff] ^
+                                             (prev >> 8);
+                }
+        }
+
+        crc32c_impl = crc32c_slice8;
+
+#if defined(__x86_64__)
+        if (__builtin_cpu_supports("sse4.2")) {
+                crc32c_impl = crc32c_hw;
+        }
+#endif
+}
+
+/**
+ * Update a checksum with a chunk of data.
+ * See crc32c.h for complete description.
+ */
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len) {
+        pthread_once(&crc32c_once, crc32c_init);
+
+        return ~crc32c_impl(~crc, buf, len);
+}
+
+/**
+ * Update a checksum with a chunk of data without the crc32 instruction.
+ * See crc32c.h for complete description.
+ */
+uint32_t crc32c_sw(uint32_t crc, const void *buf, size_t len) {
+        pthread_once(&crc32c_once, crc32c_init);
+
+        return ~crc32c_slice8(~crc, buf, len);
+}
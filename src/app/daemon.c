@@ -15,18 +15,38 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _GNU_SOURCE    /* needed to use syscall() */
+
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <time.h>
 #include <stdio.h>
 #include <pthread.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include <linux/limits.h>
 
 #include "log.h"
 #include "conf.h"
 #include "queue.h"
 #include "policy.h"
+#include "prefetch.h"
 #include "ops.h"
+#include "status.h"
+
+/* small files wait for other small files this number of seconds at most
+   once the upload queues are drained */
+#define PACK_FLUSH_DELAY_SEC    1
+
+/* transfer threads wake up this often in milliseconds when their queues are
+   empty to do idle work and to notice cancellation */
+#define TRANSFER_IDLE_MSEC      100
+
+/* ioprio_set(2) constants; glibc does not provide a header for them */
+#define IOPRIO_WHO_PROCESS      1
+#define IOPRIO_CLASS_IDLE       3
+#define IOPRIO_CLASS_SHIFT      13
 
 /* a helper structure that unites two arbitrary entities */
 typedef struct {
@@ -34,14 +54,40 @@ typedef struct {
         void *second;
 } pair_t;
 
+/* names of shared memory objects of download queues of recall classes */
+static const char *recall_queue_shm_obj[] = {
+        RECALL_CLASSES(QUEUE_CLASS_SHM_OBJ, COMMA),
+};
+
+/* download queues filled by the library, one per recall class, from the
+   highest priority to the lowest one */
+static queue_t *recall_queues[RECALL_CLASSES_NUM] = { NULL };
+
+/* a page where the daemon tells processes that it is alive */
+static status_t *status = NULL;
+
 /**
+ * @brief monitor_threads Makes heartbeats of the daemon, so that processes
+ *                        waiting for recalls learn when the daemon is dead.
+ *
+ * @note This function never returns.
+ *
  * TODO: implement thread monitoring
  */
 static void monitor_threads(pthread_t *scan_fs_thread,
                             pthread_t *dowload_file_thread,
                             pthread_t *upload_file_thread) {
+        const size_t period_ms = get_conf()->heartbeat_period_msec;
+        const struct timespec period = {
+                .tv_sec = period_ms / 1000,
+                .tv_nsec = (long)(period_ms % 1000) * 1000000L,
+        };
+
         /* TODO: implement thread monitoring */
-        for(;;){}
+        for (;;) {
+                status_beat(status);
+                nanosleep(&period, NULL);
+        }
 }
 
 /**
@@ -52,45 +98,77 @@ static void monitor_threads(pthread_t *scan_fs_thread,
  *
  * @note This function never returns.
  *
- * @param[in] pair        A pair of primary and secondary queues.
+ * @param[in] pair        A pair of primary and secondary queues; primary
+ *                        queues are an array of RECALL_CLASSES_NUM queues
+ *                        ordered by priority or NULL.
  * @param[in] action      A pointer to the function to be invoked with popped
  *                        element as an argument.
  * @param[in] action_name Human-readable name of the action (for logging).
+ * @param[in] prefetch    Non-zero if elements of the primary queue should be
+ *                        reported to the prefetch module, which may add
+ *                        related elements to the secondary queue.
+ * @param[in] idle        A pointer to the function to be invoked when both
+ *                        queues stay empty for TRANSFER_IDLE_MSEC or NULL.
  */
 static void *transfer_files_loop(pair_t *pair,
                                  int (*action)(const char *),
-                                 const char *action_name) {
+                                 const char *action_name,
+                                 int prefetch,
+                                 void (*idle)(void)) {
         const size_t path_max_size = get_conf()->path_max;
         char path[path_max_size];
+        char real_path[PATH_MAX];
         unsigned long long failure_counter = 0;
 
-        queue_t *primary_queue   = pair->first;
-        queue_t *secondary_queue = pair->second;
+        queue_t **primary_queues = pair->first;
+        queue_t  *secondary_queue = pair->second;
+
+        /* a request of a higher class overtakes all requests of lower
+           classes, and all of them overtake the secondary queue */
+        queue_t *queues[RECALL_CLASSES_NUM + 1] = { NULL };
+        size_t queues_num = 0;
+        if (primary_queues != NULL) {
+                for (; queues_num < RECALL_CLASSES_NUM; queues_num++) {
+                        queues[queues_num] = primary_queues[queues_num];
+                }
+        }
+        queues[queues_num++] = secondary_queue;
 
         size_t path_size;
         int pop_res;
+        int from_primary;
+        int resolved;
         for (;;) {
-                pop_res = -1;
                 path_size = path_max_size;
 
-                if (primary_queue != NULL) {
-                    pop_res = queue_try_pop(primary_queue,
-                                            path,
-                                            &path_size);
-                }
+                /* sleeps on the queues' futex words while they are empty */
+                pop_res = queue_pop_any(queues,
+                                        queues_num,
+                                        path,
+                                        &path_size,
+                                        TRANSFER_IDLE_MSEC);
 
-                if (pop_res == -1 && secondary_queue != NULL) {
-                        pop_res = queue_try_pop(secondary_queue,
-                                                path,
-                                                &path_size);
-                }
+                from_primary = (primary_queues != NULL &&
+                                pop_res >= 0 &&
+                                pop_res < RECALL_CLASSES_NUM);
 
                 if (pop_res == -1) {
-                        /* both queues are empty */
+                        /* both queues have stayed empty for a while */
+                        if (idle != NULL) {
+                                idle();
+                        }
+
                         pthread_testcancel();
                         continue;
                 }
 
+                /* a demand request names a descriptor of the requesting
+                   process (/proc/<pid>/fd/<fd>); files next to the recalled
+                   one are found by its real path, which is resolved while
+                   the process still waits with the descriptor open */
+                resolved = prefetch && from_primary &&
+                           realpath(path, real_path) != NULL;
+
                 if (action(path) == -1) {
                         /* continue execution even on failure */
 
@@ -104,6 +182,12 @@ static void *transfer_files_loop(pair_t *pair,
                         }
                 }
 
+                /* a demand request is served first, then files which are
+                   likely to be requested next are queued behind it */
+                if (resolved) {
+                        prefetch_recall(real_path, secondary_queue);
+                }
+
                 pthread_testcancel();
         }
 
@@ -116,12 +200,25 @@ static void *transfer_files_loop(pair_t *pair,
  *
  * @note This function never returns.
  *
- * @param[in] args A pair of primary and secondary dowload queues.
+ * @param[in] args A pair of primary (one per recall class) and secondary
+ *                 dowload queues.
  */
 static void *download_file_routine(void *args) {
         return transfer_files_loop((pair_t *)args,
                                    download_file,
-                                   "download file");
+                                   "download file",
+                                   1,
+                                   NULL);
+}
+
+/**
+ * @brief upload_idle Uploads small files waiting to be packed when there are
+ *                    no more files to be uploaded for a while.
+ */
+static void upload_idle(void) {
+        if (flush_packed_files(PACK_FLUSH_DELAY_SEC) == -1) {
+                LOG(DEBUG, "some of packed files have not been uploaded");
+        }
 }
 
 /**
@@ -135,7 +232,9 @@ static void *download_file_routine(void *args) {
 static void *upload_file_routine(void *args) {
         return transfer_files_loop((pair_t *)args,
                                    upload_file,
-                                   "upload file");
+                                   "upload file",
+                                   0,
+                                   upload_idle);
 }
 
 /**
@@ -143,6 +242,10 @@ static void *upload_file_routine(void *args) {
  *
  * @note This function never returns.
  *
+ * @note Scan passes start not more often than once per ScanfsIterTimeoutSec;
+ *       the scan runs in the idle I/O scheduling class (inherited by walking
+ *       threads), so it does not compete with applications for local disks.
+ *
  * @param[in] args A pair of upload and download queue pairs.
  */
 static void *scan_fs_routine(void *args) {
@@ -153,8 +256,24 @@ static void *scan_fs_routine(void *args) {
         queue_t *download_queue = dow_queue_pair->second;
         queue_t *upload_queue   = upl_queue_pair->second;
 
+        /* 0 stands for the calling thread */
+        if (syscall(SYS_ioprio_set,
+                    IOPRIO_WHO_PROCESS,
+                    0,
+                    IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) == -1) {
+                LOG(DEBUG,
+                    "unable to set idle I/O priority of the scan [reason: %s]",
+                    strerror(errno));
+        }
+
+        const time_t interval = get_conf()->scanfs_iter_tm_sec;
+
         unsigned long long failure_counter = 0;
         for (;;) {
+                struct timespec next_pass;
+                clock_gettime(CLOCK_MONOTONIC, &next_pass);
+                next_pass.tv_sec += interval;
+
                 if (scan_fs(download_queue, upload_queue) == -1) {
                         /* continue execution even on failure */
 
@@ -167,11 +286,73 @@ static void *scan_fs_routine(void *args) {
                                     failure_counter);
                         }
                 }
+
+                /* do not start the next pass before the interval elapses */
+                while (clock_nanosleep(CLOCK_MONOTONIC,
+                                       TIMER_ABSTIME,
+                                       &next_pass,
+                                       NULL) == EINTR) {
+                }
         }
 
         return "unreachable place";
 }
 
+/**
+ * @brief init_secondary_queue Initializes a secondary queue. If a journal
+ *                             directory is configured, then the queue resides
+ *                             in a file, so that its pending elements are
+ *                             replayed after a restart instead of waiting for
+ *                             the file system scanner to rediscover them.
+ *
+ * @param[out] queue_p  A pointer to the queue to be initialized.
+ * @param[in]  max_size A maximum size of the queue.
+ * @param[in]  name     A name of the queue's journal file.
+ *
+ * @return  0: the queue has successfully been initialized
+ *         -1: error happen during queue initialization
+ */
+static int init_secondary_queue(queue_t **queue_p,
+                                size_t max_size,
+                                const char *name) {
+        conf_t *conf = get_conf();
+
+        if (conf->queue_journal_dir[0] == '\0') {
+                return queue_init(queue_p, max_size, conf->path_max, NULL);
+        }
+
+        char path[PATH_MAX];
+        if (snprintf(path,
+                     PATH_MAX,
+                     "%s/%s",
+                     conf->queue_journal_dir,
+                     name) >= PATH_MAX) {
+                LOG(ERROR, "queue journal path is too long [name: %s]", name);
+                return -1;
+        }
+
+        if (queue_init_file(queue_p, max_size, conf->path_max, path) == -1) {
+                return -1;
+        }
+
+        LOG(INFO,
+            "queue journal is attached [path: %s | pending elements: %zu]",
+            path,
+            queue_size(*queue_p));
+
+        return 0;
+}
+
+/**
+ * @brief destroy_recall_queues Frees download queues of recall classes.
+ */
+static void destroy_recall_queues(void) {
+        for (size_t i = 0; i < RECALL_CLASSES_NUM; i++) {
+                queue_destroy(recall_queues[i]);
+                recall_queues[i] = NULL;
+        }
+}
+
 /**
  * @brief init_data Initialization of global valuables and establishment of
  *                  the connection to the remote storage.
@@ -193,24 +374,46 @@ static int init_data(pair_t *dow_queue_pair,
                 return -1;
         }
 
-        if (queue_init((queue_t **)&(dow_queue_pair->first),
-                       conf->primary_download_queue_max_size,
-                       conf->path_max,
-                       QUEUE_SHM_OBJ) == -1) {
+        if (init_location_cache() == -1) {
+                /* processes just check locations of files themselves */
                 LOG(ERROR,
-                    "unable to allocate memory for primary download queue");
-                return -1;
+                    "unable to create shared location cache; continue "
+                    "without it");
+        }
+
+        if (init_recall_progress() == -1) {
+                /* readers of recalled files wait for whole files */
+                LOG(ERROR,
+                    "unable to create shared recall progress table; "
+                    "continue without it");
         }
 
-        if (queue_init((queue_t **)&(dow_queue_pair->second),
-                       conf->secondary_download_queue_max_size,
-                       conf->path_max,
-                       NULL) == -1) {
+        for (size_t i = 0; i < RECALL_CLASSES_NUM; i++) {
+                if (queue_init(&recall_queues[i],
+                               conf->primary_download_queue_max_size,
+                               conf->path_max,
+                               recall_queue_shm_obj[i]) == -1) {
+                        LOG(ERROR,
+                            "unable to allocate memory for primary download "
+                            "queue [name: %s]",
+                            recall_queue_shm_obj[i]);
+
+                        destroy_recall_queues();
+
+                        return -1;
+                }
+        }
+
+        dow_queue_pair->first = recall_queues;
+
+        if (init_secondary_queue((queue_t **)&(dow_queue_pair->second),
+                                 conf->secondary_download_queue_max_size,
+                                 "download.queue") == -1) {
                 LOG(ERROR,
                     "unable to allocate memory for secondary download queue");
 
                 /* cleanup already allocated queues */
-                queue_destroy(dow_queue_pair->first);
+                destroy_recall_queues();
 
                 return -1;
         }
@@ -219,15 +422,14 @@ static int init_data(pair_t *dow_queue_pair,
            established for upload action */
         upl_queue_pair->first = NULL;
 
-        if (queue_init((queue_t **)&(upl_queue_pair->second),
-                       conf->secondary_upload_queue_max_size,
-                       conf->path_max,
-                       NULL) == -1) {
+        if (init_secondary_queue((queue_t **)&(upl_queue_pair->second),
+                                 conf->secondary_upload_queue_max_size,
+                                 "upload.queue") == -1) {
                 LOG(ERROR,
                     "unable to allocate memory for secondary upload queue");
 
                 /* cleanup already allocated queues */
-                queue_destroy(dow_queue_pair->first);
+                destroy_recall_queues();
                 queue_destroy(dow_queue_pair->second);
                 queue_destroy(upl_queue_pair->first);
 
@@ -237,7 +439,7 @@ static int init_data(pair_t *dow_queue_pair,
         if (get_ops()->connect() == -1) {
                 LOG(ERROR, "unable to establish connection to remote storage");
 
-                queue_destroy(dow_queue_pair->first);
+                destroy_recall_queues();
                 queue_destroy(dow_queue_pair->second);
                 queue_destroy(upl_queue_pair->first);
                 queue_destroy(upl_queue_pair->second);
@@ -367,6 +569,15 @@ int main(int argc, char *argv[]) {
                 return EXIT_FAILURE;
         }
 
+        /* processes do not request recalls until the daemon is ready to
+           serve them and tells so with heartbeats */
+        if (status_create(&status,
+                          STATUS_SHM_OBJ,
+                          get_conf()->heartbeat_period_msec) == -1) {
+                LOG(ERROR, "unable to create shared status page");
+                return EXIT_FAILURE;
+        }
+
         /* start all routines composing business logic of this program */
         if (start_routines(&dow_queue_pair,
                            &upl_queue_pair,
@@ -15,7 +15,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#define _POSIX_C_SOURCE    200112L    /* required for strerror_r() */
+#define _POSIX_C_SOURCE    200809L    /* required for strerror_r(), st_mtim */
 
 #include <string.h>
 #include <stdio.h>
@@ -28,6 +28,15 @@
 #include "ops.h"
 #include "log.h"
 #include "file.h"
+#include "lock.h"
+#include "meta.h"
+
+/* open file description locks are Linux-specific and glibc defines their
+   commands only with _GNU_SOURCE, which would replace strerror_r() with
+   its GNU version */
+#ifndef F_OFD_SETLK
+#define F_OFD_SETLK    37
+#endif
 
 /* buffer to store error messages (mostly errno messages) */
 static __thread char err_buf[ERR_MSG_BUF_LEN];
@@ -60,7 +69,7 @@ int set_xattr( int fd,
                 LOG( ERROR,
                      "failed to set extended attribute %s to file"
                      "[fd: %d; reason: %s]",
-                     xattr_str[e_locked],
+                     xattr_str[xattr],
                      fd,
                      err_buf );
 
@@ -175,14 +184,248 @@ int remove_xattr( int fd, enum xattr_enum xattr ) {
 }
 
 /**
- * Try to lock file using extended attribute as an indicator.
+ * Set a meta-data record of an evicted file.
+ * See file.h for complete description.
+ */
+int set_meta( int fd,
+              const meta_t *meta,
+              const char *object_id,
+              size_t object_id_size,
+              int flags ) {
+        char buf[META_HEADER_SIZE + object_id_size];
+
+        size_t len = meta_encode( buf, sizeof( buf ), meta, object_id );
+        if ( len == 0 ) {
+                LOG( ERROR,
+                     "object identifier is too long to be stored "
+                     "[fd: %d; object id: %s]",
+                     fd,
+                     object_id );
+
+                return -1;
+        }
+
+        return set_xattr( fd, e_meta, buf, len, flags );
+}
+
+/**
+ * @brief convert_legacy_stub Replace stub and object_id attributes set by
+ *                            earlier versions with a meta-data record.
+ *
+ * @note The record is set before the legacy attributes are removed, so the
+ *       file never looks local in between.
+ *
+ * @param[in]  fd             File descriptor of the file.
+ * @param[out] meta           A buffer for the record.
+ * @param[out] object_id      A buffer for the object identifier of the file's
+ *                            data.
+ * @param[in]  object_id_size A size of the object_id buffer.
+ *
+ * @return  0: the file is a legacy stub and has been converted
+ *          1: the file has no legacy stub attribute; it is in local storage
+ *         -1: error has happened while converting the file
+ */
+static int convert_legacy_stub( int fd,
+                                meta_t *meta,
+                                char *object_id,
+                                size_t object_id_size ) {
+        int ret = get_xattr_tunable( fd, e_stub, NULL, 0, 1 );
+        if ( ret != 0 ) {
+                return ret;
+        }
+
+        /* the legacy object id is '\0'-terminated and padded with zeros */
+        ssize_t len = fgetxattr( fd,
+                                 xattr_str[e_object_id],
+                                 object_id,
+                                 object_id_size );
+        if (  ( len <= 0 )
+           || ( memchr( object_id, '\0', len ) == NULL ) ) {
+                LOG( ERROR,
+                     "extended attribute %s of legacy stub is missing or "
+                     "malformed [fd: %d]",
+                     xattr_str[e_object_id],
+                     fd );
+
+                return -1;
+        }
+
+        /* size and modification time at the moment of eviction were not
+           recorded; the stub keeps the size, its mtime is the closest one */
+        struct stat stat_buf;
+        if ( fstat( fd, &stat_buf ) == -1 ) {
+                /* strerror_r() with very low probability can fail;
+                 *          ignore such failures */
+                strerror_r( errno, err_buf, ERR_MSG_BUF_LEN );
+
+                LOG( ERROR,
+                     "failed to get status of legacy stub "
+                     "[fd: %d; reason: %s]",
+                     fd,
+                     err_buf );
+
+                return -1;
+        }
+
+        /* legacy stubs are never packed and have no checksum */
+        *meta = (meta_t){
+                .state    = e_meta_remote,
+                .flags    = 0,
+                .size     = stat_buf.st_size,
+                .mtime_ns = (int64_t)stat_buf.st_mtim.tv_sec * 1000000000LL
+                            + stat_buf.st_mtim.tv_nsec,
+                .checksum = 0,
+        };
+
+        if ( set_meta( fd,
+                       meta,
+                       object_id,
+                       object_id_size,
+                       XATTR_CREATE ) == -1 ) {
+                return -1;
+        }
+
+        if ( remove_xattr( fd, e_stub ) == -1 ) {
+                /* NOTE: impossible case in case program's logic is correct;
+                         keep the legacy attributes consistent */
+                remove_xattr( fd, e_meta );
+
+                return -1;
+        }
+
+        /* a stale object_id attribute is harmless once stub is removed */
+        remove_xattr_tunable( fd, e_object_id, 1 );
+
+        LOG( INFO,
+             "legacy stub converted to extended attribute %s [fd: %d]",
+             xattr_str[e_meta],
+             fd );
+
+        return 0;
+}
+
+/**
+ * Get a meta-data record of a file.
+ * See file.h for complete description.
+ */
+int get_meta( int fd,
+              meta_t *meta,
+              char *object_id,
+              size_t object_id_size ) {
+        char buf[META_HEADER_SIZE + object_id_size];
+
+        ssize_t len = fgetxattr( fd, xattr_str[e_meta], buf, sizeof( buf ) );
+        if ( len == -1 ) {
+                if ( errno == ENOATTR ) {
+                        /* no record; the file is local unless it is
+                           a stub of an earlier version */
+                        return convert_legacy_stub( fd,
+                                                    meta,
+                                                    object_id,
+                                                    object_id_size );
+                }
+
+                /* strerror_r() with very low probability can fail;
+                 *          ignore such failures */
+                strerror_r( errno, err_buf, ERR_MSG_BUF_LEN );
+
+                LOG( ERROR,
+                     "failed to get extended attribute %s of file"
+                     "[fd: %d; reason: %s]",
+                     xattr_str[e_meta],
+                     fd,
+                     err_buf );
+
+                return -1;
+        }
+
+        if ( meta_decode( buf,
+                          len,
+                          meta,
+                          object_id,
+                          object_id_size ) == -1 ) {
+                LOG( ERROR,
+                     "extended attribute %s of file is malformed [fd: %d]",
+                     xattr_str[e_meta],
+                     fd );
+
+                return -1;
+        }
+
+        return 0;
+}
+
+/**
+ * @brief set_ofd_lock Set or release a write lock of the whole file owned by
+ *                     an open file description.
+ *
+ * @param[in] fd   File descriptor of the file.
+ * @param[in] type F_WRLCK to set the lock or F_UNLCK to release it.
+ *
+ * @return  0: the lock has been set or released
+ *         -1: the lock is held by another open file description or
+ *             fcntl(2) failed
+ */
+static int set_ofd_lock( int fd, short type ) {
+        struct flock fl = {
+                .l_type   = type,
+                .l_whence = SEEK_SET,
+                .l_start  = 0,
+                .l_len    = 0,    /* up to the end of the file */
+                .l_pid    = 0,    /* required for open file description locks */
+        };
+
+        return fcntl( fd, F_OFD_SETLK, &fl );
+}
+
+/**
+ * Try to lock file using the inode lock table and an open file description
+ * lock.
  * See file.h for complete description.
  */
 int try_lock_file( int fd ) {
-        if ( set_xattr( fd, e_locked, NULL, 0, XATTR_CREATE ) == -1 ) {
-                /* lock file failures is normal, since another thread or
-                   procces may already holding a lock */
-                LOG( DEBUG, "failed to lock file [fd: %d]", fd );
+        struct stat stat_buf;
+
+        if ( fstat( fd, &stat_buf ) == -1 ) {
+                /* strerror_r() with very low probability can fail;
+                 *          ignore such failures */
+                strerror_r( errno, err_buf, ERR_MSG_BUF_LEN );
+
+                LOG( ERROR,
+                     "failed to lock file [fd: %d; reason: %s]",
+                     fd,
+                     err_buf );
+
+                return -1;
+        }
+
+        /* another thread of the daemon is told without a file system
+           request */
+        if ( lock_inode( stat_buf.st_dev, stat_buf.st_ino ) == -1 ) {
+                LOG( DEBUG,
+                     "failed to lock file locked by another thread [fd: %d]",
+                     fd );
+                return -1;
+        }
+
+        if ( set_ofd_lock( fd, F_WRLCK ) == -1 ) {
+                /* lock file failures is normal, since another procces may
+                   already holding a lock */
+                if ( ( errno == EAGAIN ) || ( errno == EACCES ) ) {
+                        LOG( DEBUG, "failed to lock file [fd: %d]", fd );
+                } else {
+                        /* strerror_r() with very low probability can fail;
+                         *          ignore such failures */
+                        strerror_r( errno, err_buf, ERR_MSG_BUF_LEN );
+
+                        LOG( ERROR,
+                             "failed to lock file [fd: %d; reason: %s]",
+                             fd,
+                             err_buf );
+                }
+
+                unlock_inode( stat_buf.st_dev, stat_buf.st_ino );
+
                 return -1;
         }
 
@@ -190,11 +433,17 @@ int try_lock_file( int fd ) {
 }
 
 /**
- * Unlock file via removal of extended attribute.
+ * Unlock file locked by try_lock_file().
  * See file.h for complete description.
  */
 int unlock_file( int fd ) {
-        if ( remove_xattr( fd, e_locked ) == -1 ) {
+        struct stat stat_buf;
+
+        /* the lock of the open file description is released on close(2)
+           anyway, but the file should not look locked in the meantime */
+        if ( ( set_ofd_lock( fd, F_UNLCK ) == -1 )
+             || ( fstat( fd, &stat_buf ) == -1 )
+             || ( unlock_inode( stat_buf.st_dev, stat_buf.st_ino ) == -1 ) ) {
                 /* NOTE: impossible case in case program's logic is correct */
 
                 LOG( ERROR, "failed to unlock file [fd: %d]", fd );
@@ -209,9 +458,11 @@ int unlock_file( int fd ) {
  * See file.h for complete description.
  */
 int is_local_file_fd( int fd ) {
-        /* in case stub attribute is not set returns 1,
-           if set returns 0, on error returns -1 */
-        return get_xattr_tunable( fd, e_stub, NULL, 0, 1 );
+        /* in case neither meta nor legacy stub attribute is set returns 1,
+           if either is set returns 0, on error returns -1 */
+        int ret = get_xattr_tunable( fd, e_meta, NULL, 0, 1 );
+        return ( ret == 1 ) ? get_xattr_tunable( fd, e_stub, NULL, 0, 1 )
+                            : ret;
 }
 
 /**
@@ -219,8 +470,40 @@ int is_local_file_fd( int fd ) {
  * See file.h for complete description.
  */
 int is_local_file_path( const char *path ) {
-        /* TODO: implement */
-        return -1;
+        /* a stub of an earlier version has the stub attribute instead of
+           the meta attribute */
+        static const enum xattr_enum location_xattrs[] = { e_meta, e_stub };
+
+        for ( size_t i = 0;
+              i < sizeof( location_xattrs ) / sizeof( location_xattrs[0] );
+              ++i ) {
+                enum xattr_enum xattr = location_xattrs[i];
+
+                /* do not follow symbolic links; a link is never a stub
+                   itself */
+                if ( lgetxattr( path, xattr_str[xattr], NULL, 0 ) != -1 ) {
+                        return 0;
+                }
+
+                if ( errno == ENOATTR ) {
+                        continue; /* attribute is not set */
+                }
+
+                /* strerror_r() with very low probability can fail;
+                 *          ignore such failures */
+                strerror_r( errno, err_buf, ERR_MSG_BUF_LEN );
+
+                LOG( DEBUG,
+                     "failed to get extended attribute %s of file"
+                     "[path: %s; reason: %s]",
+                     xattr_str[xattr],
+                     path,
+                     err_buf );
+
+                return -1;
+        }
+
+        return 1;
 }
 
 /**
@@ -228,7 +511,7 @@ int is_local_file_path( const char *path ) {
  * See file.h for complete description.
  */
 int is_remote_file_fd( int fd ) {
-        /* in case stub attribute is not set returns 0,
+        /* in case meta attribute is not set returns 0,
            if set returns 1, on error returns -1 */
         int ret = is_local_file_fd( fd );
         return ( ret == -1 ) ? -1 : ( ! ret );
@@ -239,7 +522,7 @@ int is_remote_file_fd( int fd ) {
  * See file.h for complete description.
  */
 int is_remote_file_path( const char *path ) {
-        /* in case stub attribute is not set returns 0,
+        /* in case meta attribute is not set returns 0,
            if set returns 1, on error returns -1 */
         int ret = is_local_file_path( path );
         return ( ret == -1 ) ? -1 : ( ! ret );
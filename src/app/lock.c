@@ -0,0 +1,114 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "lock.h"
+
+/* a number of hash chains; a power of two */
+#define LOCK_BUCKETS    256
+
+/* an entry of the table */
+typedef struct lock_entry {
+        dev_t dev;
+        ino_t ino;
+        struct lock_entry *next;
+} lock_entry_t;
+
+/* chains of entries and a mutex protecting them */
+static lock_entry_t *lock_table[LOCK_BUCKETS];
+static pthread_mutex_t lock_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief lock_hash Calculates a chain of a file.
+ *
+ * @param[in] dev A device of the file.
+ * @param[in] ino An inode number of the file.
+ *
+ * @return an index of the chain
+ */
+static inline size_t lock_hash(dev_t dev, ino_t ino) {
+        /* inode numbers are often sequential; mix bits to avoid clustering
+           (a finalizer of MurmurHash3) */
+        uint64_t x = (uint64_t)ino ^ ((uint64_t)dev << 32);
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+
+        return x & (LOCK_BUCKETS - 1);
+}
+
+/**
+ * Add a file to the table.
+ * See lock.h for complete description.
+ */
+int lock_inode(dev_t dev, ino_t ino) {
+        lock_entry_t **chain = &lock_table[lock_hash(dev, ino)];
+        int ret = 0;
+
+        pthread_mutex_lock(&lock_mutex);
+
+        for (lock_entry_t *e = *chain; e != NULL; e = e->next) {
+                if (e->dev == dev && e->ino == ino) {
+                        ret = -1;
+                        goto out;
+                }
+        }
+
+        lock_entry_t *entry = malloc(sizeof(lock_entry_t));
+        if (entry == NULL) {
+                ret = -1;
+                goto out;
+        }
+
+        entry->dev = dev;
+        entry->ino = ino;
+        entry->next = *chain;
+        *chain = entry;
+
+    out:
+        pthread_mutex_unlock(&lock_mutex);
+
+        return ret;
+}
+
+/**
+ * Remove a file from the table.
+ * See lock.h for complete description.
+ */
+int unlock_inode(dev_t dev, ino_t ino) {
+        lock_entry_t **link = &lock_table[lock_hash(dev, ino)];
+        int ret = -1;
+
+        pthread_mutex_lock(&lock_mutex);
+
+        for (; *link != NULL; link = &(*link)->next) {
+                lock_entry_t *e = *link;
+                if (e->dev == dev && e->ino == ino) {
+                        *link = e->next;
+                        free(e);
+                        ret = 0;
+                        break;
+                }
+        }
+
+        pthread_mutex_unlock(&lock_mutex);
+
+        return ret;
+}
@@ -0,0 +1,155 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "meta.h"
+
+/* "CTMD" in ASCII; identifies a record */
+#define META_MAGIC      0x43544d44
+
+/* version of the record layout; bump on every incompatible change */
+#define META_VERSION    2
+
+/* a size of the header of version 1 records, which have no checksum */
+#define META_V1_HEADER_SIZE    32
+
+/* offsets of the header's fields */
+#define META_MAGIC_OFF        0
+#define META_VERSION_OFF      4
+#define META_STATE_OFF        6
+#define META_FLAGS_OFF        8
+#define META_ID_LEN_OFF       12
+#define META_SIZE_OFF         16
+#define META_MTIME_OFF        24
+#define META_CHECKSUM_OFF     32
+#define META_RESERVED_OFF     36
+
+/**
+ * @brief put_le Stores an integer in little-endian byte order.
+ *
+ * @param[out] buf   A buffer.
+ * @param[in]  value A value to be stored.
+ * @param[in]  bytes A number of bytes to be stored.
+ */
+static void put_le(unsigned char *buf, uint64_t value, size_t bytes) {
+        for (size_t i = 0; i < bytes; i++) {
+                buf[i] = (unsigned char)(value >> (8 * i));
+        }
+}
+
+/**
+ * @brief get_le Loads an integer stored in little-endian byte order.
+ *
+ * @param[in] buf   A buffer.
+ * @param[in] bytes A number of bytes to be loaded.
+ *
+ * @return the loaded value
+ */
+static uint64_t get_le(const unsigned char *buf, size_t bytes) {
+        uint64_t value = 0;
+
+        for (size_t i = 0; i < bytes; i++) {
+                value |= (uint64_t)buf[i] << (8 * i);
+        }
+
+        return value;
+}
+
+/**
+ * Encode a record.
+ * See meta.h for complete description.
+ */
+size_t meta_encode(void *buf,
+                   size_t size,
+                   const meta_t *meta,
+                   const char *object_id) {
+        unsigned char *p = buf;
+        size_t id_len = strlen(object_id);
+
+        if (size < META_HEADER_SIZE || size - META_HEADER_SIZE < id_len) {
+                return 0;
+        }
+
+        put_le(p + META_MAGIC_OFF, META_MAGIC, 4);
+        put_le(p + META_VERSION_OFF, META_VERSION, 2);
+        put_le(p + META_STATE_OFF, meta->state, 2);
+        put_le(p + META_FLAGS_OFF, meta->flags, 4);
+        put_le(p + META_ID_LEN_OFF, id_len, 4);
+        put_le(p + META_SIZE_OFF, meta->size, 8);
+        put_le(p + META_MTIME_OFF, (uint64_t)meta->mtime_ns, 8);
+        put_le(p + META_CHECKSUM_OFF, meta->checksum, 4);
+        put_le(p + META_RESERVED_OFF, 0, 4);
+        memcpy(p + META_HEADER_SIZE, object_id, id_len);
+
+        return META_HEADER_SIZE + id_len;
+}
+
+/**
+ * Decode a record.
+ * See meta.h for complete description.
+ */
+int meta_decode(const void *buf,
+                size_t len,
+                meta_t *meta,
+                char *object_id,
+                size_t object_id_size) {
+        const unsigned char *p = buf;
+
+        if (len < META_V1_HEADER_SIZE ||
+            get_le(p + META_MAGIC_OFF, 4) != META_MAGIC) {
+                return -1;
+        }
+
+        size_t header_size;
+        switch (get_le(p + META_VERSION_OFF, 2)) {
+        case 1:
+                header_size = META_V1_HEADER_SIZE;
+                break;
+        case META_VERSION:
+                header_size = META_HEADER_SIZE;
+                break;
+        default:
+                return -1;
+        }
+
+        /* the identifier fills the rest of the record exactly */
+        uint64_t id_len = get_le(p + META_ID_LEN_OFF, 4);
+        if (len < header_size ||
+            id_len != len - header_size ||
+            id_len >= object_id_size) {
+                return -1;
+        }
+
+        meta->state    = get_le(p + META_STATE_OFF, 2);
+        meta->flags    = get_le(p + META_FLAGS_OFF, 4);
+        meta->size     = get_le(p + META_SIZE_OFF, 8);
+        meta->mtime_ns = (int64_t)get_le(p + META_MTIME_OFF, 8);
+        meta->checksum = 0;
+
+        if (header_size == META_HEADER_SIZE) {
+                meta->checksum = get_le(p + META_CHECKSUM_OFF, 4);
+        } else {
+                /* a flag of a later version can not be set */
+                meta->flags &= ~META_FLAG_CHECKSUM;
+        }
+
+        memcpy(object_id, p + header_size, id_len);
+        object_id[id_len] = '\0';
+
+        return 0;
+}
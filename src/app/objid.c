@@ -0,0 +1,93 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE    200112L    /* needed for clock_gettime() */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "objid.h"
+
+/* parameters of the 64-bit FNV-1a hash */
+#define FNV_OFFSET_BASIS    0xcbf29ce484222325ULL
+#define FNV_PRIME           0x100000001b3ULL
+
+/**
+ * @brief objid_mix Mixes bits of a 64-bit value (a finalizer of SplitMix64).
+ *
+ * @param[in] x A value.
+ *
+ * @return the mixed value
+ */
+static inline uint64_t objid_mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        x ^= x >> 31;
+
+        return x;
+}
+
+/**
+ * @brief objid_hash Hashes a path and an inode generation of a file.
+ *
+ * @param[in] path       A path of the file.
+ * @param[in] generation An inode generation of the file.
+ *
+ * @return the hash
+ */
+static uint64_t objid_hash(const char *path, uint64_t generation) {
+        uint64_t h = FNV_OFFSET_BASIS;
+
+        for (const unsigned char *p = (const unsigned char *)path; *p; p++) {
+                h ^= *p;
+                h *= FNV_PRIME;
+        }
+
+        /* FNV-1a spreads differences of the last characters poorly */
+        return objid_mix(h ^ objid_mix(generation));
+}
+
+/**
+ * Make an object identifier of a file.
+ * See objid.h for complete description.
+ */
+int objid_make(char *buf, size_t size, const char *path, uint64_t generation) {
+        static uint16_t counter = 0;
+        struct timespec ts;
+
+        if (size < OBJID_LEN + 1) {
+                return -1;
+        }
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+
+        uint64_t nonce = ((uint64_t)(uint32_t)ts.tv_sec << 32) |
+                         ((uint64_t)(uint16_t)getpid() << 16) |
+                         __atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED);
+
+        snprintf(buf,
+                 size,
+                 "%016" PRIx64 "%016" PRIx64,
+                 objid_hash(path, generation),
+                 nonce);
+
+        return 0;
+}
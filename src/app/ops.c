@@ -15,7 +15,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#define _POSIX_C_SOURCE    200112L    /* required for strerror_r() */
+#define _POSIX_C_SOURCE    200809L    /* required for strerror_r(), st_mtim */
 #define _XOPEN_SOURCE      500        /* required for truncate() */
 
 #include <string.h>
@@ -25,6 +25,8 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
 #include <sys/resource.h>
 #include <sys/types.h>
 #include <attr/xattr.h>
@@ -32,12 +34,44 @@
 #include <fcntl.h>
 
 #include "ops.h"
+#include "conf.h"
 #include "log.h"
 #include "file.h"
+#include "pack.h"
+#include "policy.h"
+#include "progress.h"
 
 /* buffer to store error messages (mostly errno messages) */
 static __thread char err_buf[ERR_MSG_BUF_LEN];
 
+/* files waiting to be uploaded in a pack; arrays of conf->pack_max_files
+   elements accessed by the upload thread only */
+static int          *pack_fds      = NULL;
+static uint64_t     *pack_sizes    = NULL;
+static uint32_t     *pack_crcs     = NULL;
+static char        **pack_paths    = NULL;
+static struct stat  *pack_stats    = NULL;
+static size_t        pack_count    = 0;
+static uint64_t      pack_bytes    = 0;
+static time_t        pack_start_tm = 0;
+
+/* a number of downloads whose progress can be published at once */
+#define RECALL_PROGRESS_SLOTS    64
+
+/* a table where progress of downloads is published; NULL if it has not been
+   created */
+static progress_t *recall_progress = NULL;
+
+/* a slot of the download performed by the calling thread; NULL if there is
+   no such download or its progress is not published */
+static __thread progress_slot_t *download_progress = NULL;
+
+/* a number of bytes reported by the protocol for the download performed by
+   the calling thread and a limit of the published watermark; data of a file
+   with a checksum are complete only after the checksum has been verified */
+static __thread uint64_t download_reported = 0;
+static __thread uint64_t download_limit    = UINT64_MAX;
+
 /* declare array of extended attributes' keys */
 static const char *xattr_str[] = {
         XATTRS(XATTR_KEY, COMMA),
@@ -71,53 +105,66 @@ static void close_handle_err( int fd,
 }
 
 /**
- * Perform file upload operation from local storage to remote storage.
- * See ops.h for complete description.
+ * @brief stub_uploaded_file Turns a file whose data has been uploaded into
+ *                           a stub: sets the file's meta-data record and
+ *                           releases the file's data blocks.
+ *
+ * @note The file is unlocked and its file descriptor is closed in any case.
+ *
+ * @param[in] fd        File descriptor of the locked file.
+ * @param[in] path      Path to the file.
+ * @param[in] object_id Object id of the file's data; the string should fit
+ *                      get_object_id_xattr_size() bytes.
+ * @param[in] flags     Flags of the file's meta-data record (META_FLAG_*).
+ * @param[in] crc       A CRC32C of the uploaded data.
+ * @param[in] expected  Stat information of the file at the moment its data
+ *                      was read or NULL; the file is kept intact if it has
+ *                      been modified since then.
+ *
+ * @return  0: the file has been turned into a stub
+ *         -1: the file has been kept intact
  */
-int upload_file( const char *path ) {
-        /* in order to prevent race conditions and slightly speed up execution
-           open the file once and then work with file descriptor */
-        int fd = open( path, O_RDWR );
-        if ( fd == -1 ) {
-                /* strerror_r() with very low probability can fail;
-                   ignore such failures */
-                strerror_r( errno, err_buf, ERR_MSG_BUF_LEN );
+static int stub_uploaded_file( int fd,
+                               const char *path,
+                               const char *object_id,
+                               uint32_t flags,
+                               uint32_t crc,
+                               const struct stat *expected ) {
+        size_t object_id_max_size = get_ops()->get_object_id_xattr_size();
+
+        /* get stat structure to determine the file size */
+        struct stat stat_buf;
+        if ( fstat( fd , &stat_buf ) == -1) {
+                /* use thead safe version of strerror() */
+                if ( strerror_r( errno, err_buf, ERR_MSG_BUF_LEN ) == -1 ) {
+                        err_buf[0] = '\0'; /* very unlikely */
+                }
 
                 LOG( ERROR,
-                     "[upload_file] unable to open file "
-                     "[ path: %s | reason: %s ]",
-                     path,
+                     "[upload_file] aborting file upload operation because "
+                     "failed to fstat() file "
+                     "[ fd: %d | reason: %s ]",
+                     fd,
                      err_buf );
 
-                return -1;
-        } else {
-                LOG( DEBUG,
-                     "[upload_file] file opened successfully "
-                     "[ path: %s | fd: %d ]",
-                     path,
-                     fd );
-        }
-
-        /* set lock to file to prevent other threads' and processes'
-           access to file's data */
-        if ( try_lock_file( fd ) == -1 ) {
-                LOG( DEBUG,
-                     "[upload_file] aborting file upload operation because "
-                     "it is locked by another thread or process "
-                     "[ path: %s | fd: %d ]",
-                     path,
-                     fd );
+                /* NOTE: failues in the cleanup functions are impossible
+                         as long as the program's logic is correct */
+                unlock_file( fd );
 
                 close_handle_err( fd, path, "upload_file" );
 
                 return -1;
         }
 
-        /* check file's location */
-        if ( ! is_local_file( fd ) ) {
+        /* the data read for the upload does not match the file anymore */
+        if ( ( expected != NULL )
+             && ( ( stat_buf.st_size != expected->st_size )
+                  || ( stat_buf.st_mtim.tv_sec != expected->st_mtim.tv_sec )
+                  || ( stat_buf.st_mtim.tv_nsec
+                       != expected->st_mtim.tv_nsec ) ) ) {
                 LOG( DEBUG,
                      "[upload_file] aborting file upload operation because "
-                     "it is already in the remote storage "
+                     "file has been modified during upload "
                      "[ path: %s | fd: %d ]",
                      path,
                      fd );
@@ -128,18 +175,29 @@ int upload_file( const char *path ) {
 
                 close_handle_err( fd, path, "upload_file" );
 
-                return 0;
+                return -1;
         }
 
-        /* calculate object id (the key) for the remote object storage */
-        const char *object_id     = get_ops()->get_object_id_xattr_value( path );
-        size_t object_id_max_size = get_ops()->get_object_id_xattr_size();
-
-        /* upload file's data to remote storage */
-        if ( get_ops()->upload( fd, object_id ) == -1 ) {
+        /* object id and location are set at once */
+        meta_t meta = {
+                .state    = e_meta_remote,
+                .flags    = flags | META_FLAG_CHECKSUM,
+                .size     = stat_buf.st_size,
+                .mtime_ns = (int64_t)stat_buf.st_mtim.tv_sec * 1000000000LL
+                            + stat_buf.st_mtim.tv_nsec,
+                .checksum = crc,
+        };
+
+        if ( set_meta( fd,
+                       &meta,
+                       object_id,
+                       object_id_max_size,
+                       XATTR_CREATE ) == -1 ) {
                 LOG( ERROR,
                      "[upload_file] aborting file upload operation because "
-                     "file's data upload failed [ path: %s | fd: %d ]",
+                     "failed to set object identifier and location "
+                     "information as a file's meta-data"
+                     "[ path: %s | fd: %d ]",
                      path,
                      fd );
 
@@ -152,21 +210,25 @@ int upload_file( const char *path ) {
                 return -1;
         }
 
-        /* set object id to a corresponding attribute */
-        if ( set_xattr( fd,
-                        e_object_id,
-                        (void *)object_id,
-                        object_id_max_size,
-                        XATTR_CREATE ) == -1 ) {
+        /* truncate file to length 0 */
+        if ( ftruncate( fd, 0 ) == -1 ) {
+                /* TODO: handle EINTR case */
+
+                /* strerror_r() with very low probability can fail;
+                   ignore such failures */
+                strerror_r( errno, err_buf, ERR_MSG_BUF_LEN );
+
                 LOG( ERROR,
                      "[upload_file] aborting file upload operation because "
-                     "failed to set object identifier as a file's meta-data"
-                     "[ path: %s | fd: %d ]",
+                     "failed to truncate this file "
+                     "[path: %s | fd: %s | reason: %s]",
                      path,
-                     fd );
+                     fd,
+                     err_buf );
 
                 /* NOTE: failues in the cleanup functions are impossible
                          as long as the program's logic is correct */
+                remove_xattr( fd, e_meta );
                 unlock_file( fd );
 
                 close_handle_err( fd, path, "upload_file" );
@@ -174,18 +236,31 @@ int upload_file( const char *path ) {
                 return -1;
         }
 
-        /* set file's location information */
-        if ( set_xattr( fd, e_stub, NULL, 0, XATTR_CREATE ) == -1 ) {
+        /* FIXME: here we have a risk that process that calls stat() from
+                  another process will get st_size == 0;
+                  on single-node file systems we can use fallocate() call with
+                  FALLOC_FL_PUNCH_HOLE mode to transform file to
+                  sparce via single system call */
+
+        /* make the file sparse by extending it to the original length */
+        if ( ftruncate( fd, stat_buf.st_size ) == -1 ) {
+                /* TODO: handle EINTR case */
+
+                /* strerror_r() with very low probability can fail;
+                   ignore such failures */
+                strerror_r( errno, err_buf, ERR_MSG_BUF_LEN );
+
                 LOG( ERROR,
                      "[upload_file] aborting file upload operation because "
-                     "failed to set location information as a file's meta-data"
-                     "[ path: %s | fd: %d ]",
+                     "failed to truncate this file "
+                     "[path: %s | fd: %s | reason: %s]",
                      path,
-                     fd );
+                     fd,
+                     err_buf );
 
                 /* NOTE: failues in the cleanup functions are impossible
                          as long as the program's logic is correct */
-                remove_xattr( fd, e_object_id );
+                remove_xattr( fd, e_meta );
                 unlock_file( fd );
 
                 close_handle_err( fd, path, "upload_file" );
@@ -193,84 +268,283 @@ int upload_file( const char *path ) {
                 return -1;
         }
 
-        /* TODO: check that file still meets eviction requirements */
-        /* get stat structure to determine the file size */
-        struct stat stat_buf;
-        if ( fstat( fd , &stat_buf ) == -1) {
-                /* use thead safe version of strerror() */
-                if ( strerror_r( errno, err_buf, ERR_MSG_BUF_LEN ) == -1 ) {
-                        err_buf[0] = '\0'; /* very unlikely */
+        /* all actions indended to file upload succeeded; just need to unlock */
+        /* NOTE: failues in the cleanup functions are impossible
+                 as long as the program's logic is correct */
+        unlock_file( fd );
+
+        /* ctime of the stub is final only after unlock; a failure merely
+           makes the next scan pass probe the file's location */
+        if ( fstat( fd, &stat_buf ) == 0 ) {
+                remember_remote_file( &stat_buf );
+        }
+
+        close_handle_err( fd, path, "upload_file" );
+
+        return 0;
+}
+
+/**
+ * @brief pack_file Adds a small locked file to the pack being collected.
+ *                  The pack is uploaded when it is full or when a file from
+ *                  another directory arrives.
+ *
+ * @note The file is unlocked and its file descriptor is closed when the pack
+ *       is uploaded or on failure.
+ *
+ * @param[in] fd   File descriptor of the locked file.
+ * @param[in] path Path to the file.
+ * @param[in] sb   Stat information of the file.
+ *
+ * @return  0: the file has been added to the pack
+ *         -1: the file has not been added or the previous pack has failed
+ */
+static int pack_file( int fd, const char *path, const struct stat *sb ) {
+        conf_t *conf = get_conf();
+        int ret = 0;
+
+        if ( pack_fds == NULL ) {
+                pack_fds   = malloc( conf->pack_max_files * sizeof( int ) );
+                pack_sizes = malloc( conf->pack_max_files
+                                     * sizeof( uint64_t ) );
+                pack_crcs  = malloc( conf->pack_max_files
+                                     * sizeof( uint32_t ) );
+                pack_paths = malloc( conf->pack_max_files * sizeof( char * ) );
+                pack_stats = malloc( conf->pack_max_files
+                                     * sizeof( struct stat ) );
+
+                if ( ( pack_fds == NULL ) || ( pack_sizes == NULL )
+                     || ( pack_crcs == NULL ) || ( pack_paths == NULL )
+                     || ( pack_stats == NULL ) ) {
+                        free( pack_fds );
+                        free( pack_sizes );
+                        free( pack_crcs );
+                        free( pack_paths );
+                        free( pack_stats );
+                        pack_fds = NULL;
+
+                        LOG( ERROR,
+                             "[pack_file] unable to allocate memory for pack "
+                             "[ path: %s ]",
+                             path );
+
+                        unlock_file( fd );
+                        close_handle_err( fd, path, "pack_file" );
+
+                        return -1;
+                }
+        }
+
+        /* files of a directory are likely to be recalled together,
+           so packs do not mix directories */
+        if ( pack_count > 0 ) {
+                const char *slash      = strrchr( path, '/' );
+                const char *pack_slash = strrchr( pack_paths[0], '/' );
+                size_t dir_len         = slash ? slash - path : 0;
+                size_t pack_dir_len    = pack_slash ? pack_slash - pack_paths[0]
+                                                    : 0;
+
+                if ( ( dir_len != pack_dir_len )
+                     || ( strncmp( path, pack_paths[0], dir_len ) != 0 )
+                     || ( pack_bytes + sb->st_size
+                          > conf->pack_max_object_size ) ) {
+                        ret = flush_packed_files( 0 );
+                }
+        }
+
+        char *path_copy = strdup( path );
+        if ( path_copy == NULL ) {
+                unlock_file( fd );
+                close_handle_err( fd, path, "pack_file" );
+
+                return -1;
+        }
+
+        if ( pack_count == 0 ) {
+                pack_start_tm = time( NULL );
+        }
+
+        pack_fds[pack_count]   = fd;
+        pack_sizes[pack_count] = sb->st_size;
+        pack_paths[pack_count] = path_copy;
+        pack_stats[pack_count] = *sb;
+        pack_bytes += sb->st_size;
+        pack_count++;
+
+        if ( ( pack_count == conf->pack_max_files )
+             || ( pack_bytes >= conf->pack_max_object_size ) ) {
+                if ( flush_packed_files( 0 ) == -1 ) {
+                        ret = -1;
                 }
+        }
+
+        return ret;
+}
+
+/**
+ * Upload files waiting to be packed.
+ * See ops.h for complete description.
+ */
+int flush_packed_files( time_t min_age ) {
+        if ( ( pack_count == 0 )
+             || ( time( NULL ) - pack_start_tm < min_age ) ) {
+                return 0;
+        }
 
+        size_t object_id_max_size = get_ops()->get_object_id_xattr_size();
+        char pack_id[object_id_max_size];
+        char member_id[object_id_max_size];
+        int ret = 0;
+
+        if ( ( pack_make_id( pack_id, object_id_max_size ) == -1 )
+             || ( get_ops()->upload_pack( pack_fds,
+                                          pack_sizes,
+                                          pack_count,
+                                          pack_id,
+                                          pack_crcs ) == -1 ) ) {
                 LOG( ERROR,
-                     "[upload_file] aborting file upload operation because "
-                     "failed to fstat() file "
-                     "[ fd: %d | reason: %s ]",
-                     fd,
-                     err_buf );
+                     "[flush_packed_files] aborting upload of pack because "
+                     "its data upload failed [ files: %zu | bytes: %llu ]",
+                     pack_count,
+                     (unsigned long long)pack_bytes );
 
                 /* NOTE: failues in the cleanup functions are impossible
                          as long as the program's logic is correct */
-                unlock_file( fd );
+                for ( size_t i = 0; i < pack_count; i++ ) {
+                        unlock_file( pack_fds[i] );
+                        close_handle_err( pack_fds[i],
+                                          pack_paths[i],
+                                          "flush_packed_files" );
+                }
 
-                close_handle_err( fd, path, "upload_file" );
+                ret = -1;
+        } else {
+                uint64_t offset = 0;
+
+                for ( size_t i = 0; i < pack_count; i++ ) {
+                        pack_member_id( member_id,
+                                        object_id_max_size,
+                                        pack_id,
+                                        offset,
+                                        pack_sizes[i] );
+
+                        if ( stub_uploaded_file( pack_fds[i],
+                                                 pack_paths[i],
+                                                 member_id,
+                                                 META_FLAG_PACKED,
+                                                 pack_crcs[i],
+                                                 &pack_stats[i] ) == -1 ) {
+                                ret = -1;
+                        }
+
+                        offset += pack_sizes[i];
+                }
 
-                return -1;
+                LOG( DEBUG,
+                     "[flush_packed_files] pack uploaded "
+                     "[ id: %s | files: %zu | bytes: %llu ]",
+                     pack_id,
+                     pack_count,
+                     (unsigned long long)pack_bytes );
         }
 
-        /* truncate file to length 0 qq*/
-        if ( ftruncate( fd, 0 ) == -1 ) {
-                /* TODO: handle EINTR case */
+        for ( size_t i = 0; i < pack_count; i++ ) {
+                free( pack_paths[i] );
+        }
+
+        pack_count = 0;
+        pack_bytes = 0;
 
+        return ret;
+}
+
+/**
+ * Perform file upload operation from local storage to remote storage.
+ * See ops.h for complete description.
+ */
+int upload_file( const char *path ) {
+        /* in order to prevent race conditions and slightly speed up execution
+           open the file once and then work with file descriptor */
+        int fd = open( path, O_RDWR );
+        if ( fd == -1 ) {
                 /* strerror_r() with very low probability can fail;
                    ignore such failures */
                 strerror_r( errno, err_buf, ERR_MSG_BUF_LEN );
 
                 LOG( ERROR,
-                     "[upload_file] aborting file upload operation because "
-                     "failed to truncate this file "
-                     "[path: %s | fd: %s | reason: %s]",
+                     "[upload_file] unable to open file "
+                     "[ path: %s | reason: %s ]",
                      path,
-                     fd,
                      err_buf );
 
+                return -1;
+        } else {
+                LOG( DEBUG,
+                     "[upload_file] file opened successfully "
+                     "[ path: %s | fd: %d ]",
+                     path,
+                     fd );
+        }
+
+        /* set lock to file to prevent other threads' and processes'
+           access to file's data */
+        if ( try_lock_file( fd ) == -1 ) {
+                LOG( DEBUG,
+                     "[upload_file] aborting file upload operation because "
+                     "it is locked by another thread or process "
+                     "[ path: %s | fd: %d ]",
+                     path,
+                     fd );
+
+                close_handle_err( fd, path, "upload_file" );
+
+                return -1;
+        }
+
+        /* check file's location */
+        if ( ! is_local_file( fd ) ) {
+                LOG( DEBUG,
+                     "[upload_file] aborting file upload operation because "
+                     "it is already in the remote storage "
+                     "[ path: %s | fd: %d ]",
+                     path,
+                     fd );
+
                 /* NOTE: failues in the cleanup functions are impossible
                          as long as the program's logic is correct */
-                remove_xattr( fd, e_object_id );
-                remove_xattr( fd, e_stub );
                 unlock_file( fd );
 
                 close_handle_err( fd, path, "upload_file" );
 
-                return -1;
+                return 0;
         }
 
-        /* FIXME: here we have a risk that process that calls stat() from
-                  another process will get st_size == 0;
-                  on single-node file systems we can use fallocate() call with
-                  FALLOC_FL_PUNCH_HOLE mode to transform file to
-                  sparce via single system call */
-
-        /* make the file sparse by extending it to the original length */
-        if ( ftruncate( fd, stat_buf.st_size ) == -1 ) {
-                /* TODO: handle EINTR case */
+        /* small files are uploaded later together with other small files */
+        conf_t *conf = get_conf();
+        if ( conf->pack_max_file_size > 0 ) {
+                struct stat pack_stat;
+                if ( ( fstat( fd, &pack_stat ) == 0 )
+                     && ( (uint64_t)pack_stat.st_size
+                          <= conf->pack_max_file_size ) ) {
+                        return pack_file( fd, path, &pack_stat );
+                }
+        }
 
-                /* strerror_r() with very low probability can fail;
-                   ignore such failures */
-                strerror_r( errno, err_buf, ERR_MSG_BUF_LEN );
+        /* calculate object id (the key) for the remote object storage */
+        const char *object_id =
+                get_ops()->get_object_id_xattr_value( fd, path );
 
+        /* upload file's data to remote storage */
+        uint32_t crc = 0;
+        if ( get_ops()->upload( fd, object_id, &crc ) == -1 ) {
                 LOG( ERROR,
                      "[upload_file] aborting file upload operation because "
-                     "failed to truncate this file "
-                     "[path: %s | fd: %s | reason: %s]",
+                     "file's data upload failed [ path: %s | fd: %d ]",
                      path,
-                     fd,
-                     err_buf );
+                     fd );
 
                 /* NOTE: failues in the cleanup functions are impossible
                          as long as the program's logic is correct */
-                remove_xattr( fd, e_object_id );
-                remove_xattr( fd, e_stub );
                 unlock_file( fd );
 
                 close_handle_err( fd, path, "upload_file" );
@@ -278,16 +552,89 @@ int upload_file( const char *path ) {
                 return -1;
         }
 
-        /* all actions indended to file upload succeeded; just need to unlock */
-        /* NOTE: failues in the cleanup functions are impossible
-                 as long as the program's logic is correct */
-        unlock_file( fd );
+        return stub_uploaded_file( fd, path, object_id, 0, crc, NULL );
+}
 
-        close_handle_err( fd, path, "upload_file" );
+/**
+ * Create a table where progress of downloads is published.
+ * See ops.h for complete description.
+ */
+int init_recall_progress( void ) {
+        if ( progress_create( &recall_progress,
+                              PROGRESS_SHM_OBJ,
+                              RECALL_PROGRESS_SLOTS ) == -1 ) {
+                recall_progress = NULL;
+                return -1;
+        }
 
         return 0;
 }
 
+/**
+ * Publish that more data of a file being downloaded have been written.
+ * See ops.h for complete description.
+ */
+void report_download_progress( uint64_t bytes ) {
+        if ( download_progress == NULL ) {
+                return;
+        }
+
+        uint64_t before = ( download_reported < download_limit )
+                          ? download_reported
+                          : download_limit;
+
+        download_reported += bytes;
+
+        uint64_t after = ( download_reported < download_limit )
+                         ? download_reported
+                         : download_limit;
+
+        if ( after > before ) {
+                progress_advance( download_progress, after - before );
+        }
+}
+
+/**
+ * @brief begin_download_progress Starts publishing progress of a download
+ *                                performed by the calling thread.
+ *
+ * @param[in] fd     File descriptor of the file being downloaded.
+ * @param[in] verify Non-zero if downloaded data are verified with a checksum
+ *                   once the download is complete; the last byte of the file
+ *                   is published only by a successful end of the download
+ *                   then, so that a reader can not reach the file's end
+ *                   before the verification.
+ */
+static void begin_download_progress( int fd, int verify ) {
+        struct stat stat_buf;
+
+        if ( ( recall_progress != NULL ) && ( fstat( fd, &stat_buf ) == 0 ) ) {
+                download_reported = 0;
+                download_limit = ! verify ? UINT64_MAX
+                                 : ( stat_buf.st_size > 0 )
+                                   ? (uint64_t)stat_buf.st_size - 1
+                                   : 0;
+
+                /* on failure readers of the file wait for the whole file */
+                download_progress = progress_begin( recall_progress,
+                                                    stat_buf.st_dev,
+                                                    stat_buf.st_ino );
+        }
+}
+
+/**
+ * @brief end_download_progress Finishes publishing progress of a download
+ *                              performed by the calling thread.
+ *
+ * @param[in] ok Non-zero if the file is local now.
+ */
+static void end_download_progress( int ok ) {
+        if ( download_progress != NULL ) {
+                progress_end( download_progress, ok );
+                download_progress = NULL;
+        }
+}
+
 /**
  * Perform file download operation from remote storage to local storage.
  * See ops.h for complete description.
@@ -329,8 +676,13 @@ int download_file( const char *path ) {
                 return -1;
         }
 
-        /* check file's location */
-        if ( is_local_file( fd ) ) {
+        /* location and object id of the file are got at once */
+        size_t object_id_max_size = get_ops()->get_object_id_xattr_size();
+        char object_id[object_id_max_size];
+        meta_t meta;
+
+        int location = get_meta( fd, &meta, object_id, object_id_max_size );
+        if ( location == 1 ) {
                 LOG( DEBUG,
                      "[download_file] aborting file %s download operation "
                      "because it is already in the local storage",
@@ -344,18 +696,12 @@ int download_file( const char *path ) {
                 return 0;
         }
 
-        size_t object_id_max_size = get_ops()->get_object_id_xattr_size();
-        char object_id[object_id_max_size];
-
-        if ( get_xattr( fd,
-                        e_object_id,
-                        object_id,
-                        object_id_max_size ) == -1 ) {
+        if ( location == -1 ) {
                 LOG( ERROR,
                      "[download_file] aborting file %s download operation "
                      "because failed to obtain value of %s extended attribute",
-                     xattr_str[e_object_id],
-                     path );
+                     path,
+                     xattr_str[e_meta] );
 
                 unlock_file( fd );
 
@@ -364,56 +710,95 @@ int download_file( const char *path ) {
                 return -1;
         }
 
-        /* download file's data to local storage */
-        if ( get_ops()->download( fd, object_id ) == -1 ) {
+        /* readers of the file wait only for the data they read */
+        begin_download_progress( fd, ( meta.flags & META_FLAG_CHECKSUM ) != 0 );
+
+        /* a file in a pack is a byte range of the pack's object */
+        char pack_id[object_id_max_size];
+        uint64_t offset = 0;
+        uint64_t length = 0;
+        int packed = pack_parse_member_id( object_id,
+                                           pack_id,
+                                           object_id_max_size,
+                                           &offset,
+                                           &length );
+        if ( ( packed == -1 )
+             || ( packed != ( ( meta.flags & META_FLAG_PACKED ) != 0 ) ) ) {
                 LOG( ERROR,
                      "[download_file] aborting file %s download operation "
-                     "because file's data download failed",
+                     "because its object identifier is malformed",
                      path );
 
-                /* NOTE: failues in the cleanup functions are impossible
-                         as long as the program's logic is correct */
                 unlock_file( fd );
 
+                end_download_progress( 0 );
+
                 close_handle_err( fd, path, "download_file" );
 
                 return -1;
         }
 
-        /* FIXME: need to remove all extended attributes or repair attributes
-                  that has already been removed */
+        /* download file's data to local storage; an empty range is not
+           requested, because zero length means the whole object */
+        int download_res = 0;
+        uint32_t crc = 0;
+        if ( ! packed ) {
+                download_res = get_ops()->download( fd, object_id, &crc );
+        } else if ( length > 0 ) {
+                download_res = get_ops()->download_range( fd,
+                                                          pack_id,
+                                                          offset,
+                                                          length,
+                                                          &crc );
+        }
 
-        /* remove file's location information */
-        if ( remove_xattr( fd, e_stub ) == -1 ) {
-                /* NOTE: impossible case in case program's logic is correct */
+        /* the file is kept a stub, so the next recall downloads it again */
+        if ( ( download_res != -1 )
+             && ( meta.flags & META_FLAG_CHECKSUM )
+             && ( crc != meta.checksum ) ) {
+                LOG( ERROR,
+                     "[download_file] checksum of downloaded data of file %s "
+                     "does not match checksum of uploaded data "
+                     "[ expected: %08x | actual: %08x ]",
+                     path,
+                     (unsigned int)meta.checksum,
+                     (unsigned int)crc );
 
+                download_res = -1;
+        }
+
+        if ( download_res == -1 ) {
                 LOG( ERROR,
                      "[download_file] aborting file %s download operation "
-                     "because failed to remove location file's meta-data",
+                     "because file's data download failed",
                      path );
 
                 /* NOTE: failues in the cleanup functions are impossible
                          as long as the program's logic is correct */
                 unlock_file( fd );
 
+                end_download_progress( 0 );
+
                 close_handle_err( fd, path, "download_file" );
 
                 return -1;
         }
 
-        if ( remove_xattr( fd, e_object_id ) == -1 ) {
+        /* remove file's location information and object id */
+        if ( remove_xattr( fd, e_meta ) == -1 ) {
                 /* NOTE: impossible case in case program's logic is correct */
 
                 LOG( ERROR,
                      "[download_file] aborting file %s download operation "
-                     "because failed to remove object identifier "
-                     "file's meta-data",
+                     "because failed to remove file's meta-data",
                      path );
 
                 /* NOTE: failues in the cleanup functions are impossible
                          as long as the program's logic is correct */
                 unlock_file( fd );
 
+                end_download_progress( 0 );
+
                 close_handle_err( fd, path, "download_file" );
 
                 return -1;
@@ -423,6 +808,15 @@ int download_file( const char *path ) {
                  as long as the program's logic is correct */
         unlock_file( fd );
 
+        /* let the library skip the location check of the recalled file;
+           ctime is final only after unlock */
+        struct stat stat_buf;
+        if ( fstat( fd, &stat_buf ) == 0 ) {
+                remember_local_file( &stat_buf );
+        }
+
+        end_download_progress( 1 );
+
         close_handle_err( fd, path, "download_file" );
 
         return 0;
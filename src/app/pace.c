@@ -0,0 +1,149 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE    200112L    /* needed for clock_gettime() */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "pace.h"
+
+/* a path of I/O pressure information (see Documentation/accounting/psi.txt) */
+#define PACE_PSI_IO_PATH    "/proc/pressure/io"
+
+/**
+ * @brief pace_now_ns Returns the current monotonic time.
+ *
+ * @return the time in nanoseconds
+ */
+static uint64_t pace_now_ns(void) {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Initialize a pacer.
+ * See pace.h for complete description.
+ */
+void pace_init(pace_t *pace, uint64_t max_delay_ns, double pressure_limit) {
+        pace->delay_ns = 0;
+        pace->max_delay_ns = max_delay_ns;
+        pace->pressure_limit = pressure_limit;
+        pace->latency_ns = 0;
+        pace->base_latency_ns = 0;
+        pace->next_update_ns = pace_now_ns() + PACE_UPDATE_NS;
+}
+
+/**
+ * Read "some avg10" value of /proc/pressure/io.
+ * See pace.h for complete description.
+ */
+double pace_io_pressure(void) {
+        FILE *stream = fopen(PACE_PSI_IO_PATH, "r");
+        if (stream == NULL) {
+                /* kernel without CONFIG_PSI */
+                return -1.0;
+        }
+
+        double avg10 = -1.0;
+        if (fscanf(stream, "some avg10=%lf", &avg10) != 1) {
+                avg10 = -1.0;
+        }
+
+        fclose(stream);
+
+        return avg10;
+}
+
+/**
+ * Recalculate the delay.
+ * See pace.h for complete description.
+ */
+void pace_update(pace_t *pace, double pressure) {
+        uint64_t latency = __atomic_load_n(&pace->latency_ns, __ATOMIC_RELAXED);
+        uint64_t base = __atomic_load_n(&pace->base_latency_ns,
+                                        __ATOMIC_RELAXED);
+        uint64_t delay = __atomic_load_n(&pace->delay_ns, __ATOMIC_RELAXED);
+
+        /* the baseline follows drops of latency immediately and its rises
+           slowly, so that it approximates latency of an idle file system */
+        if (base == 0 || latency < base) {
+                base = latency;
+        } else {
+                base += (latency - base) / 64;
+        }
+
+        int congested = (base > 0 && latency > PACE_LATENCY_FACTOR * base) ||
+                        (pace->pressure_limit > 0 &&
+                         pressure > pace->pressure_limit);
+
+        if (congested) {
+                delay = (delay == 0) ? PACE_STEP_NS : 2 * delay;
+                if (delay > pace->max_delay_ns) {
+                        delay = pace->max_delay_ns;
+                }
+        } else {
+                delay = (delay > PACE_STEP_NS) ? delay - PACE_STEP_NS : 0;
+        }
+
+        __atomic_store_n(&pace->base_latency_ns, base, __ATOMIC_RELAXED);
+        __atomic_store_n(&pace->delay_ns, delay, __ATOMIC_RELAXED);
+}
+
+/**
+ * Account latency of a directory and sleep for the current delay.
+ * See pace.h for complete description.
+ */
+void pace_dir(pace_t *pace, uint64_t latency_ns) {
+        if (pace->max_delay_ns == 0) {
+                return;
+        }
+
+        /* a moving average with weight 1/8; concurrent updates may lose
+           a sample, which does not matter for an average */
+        uint64_t avg = __atomic_load_n(&pace->latency_ns, __ATOMIC_RELAXED);
+        avg = (avg == 0) ? latency_ns : avg - avg / 8 + latency_ns / 8;
+        __atomic_store_n(&pace->latency_ns, avg, __ATOMIC_RELAXED);
+
+        /* only one of the threads updates the delay */
+        uint64_t now = pace_now_ns();
+        uint64_t next = __atomic_load_n(&pace->next_update_ns,
+                                        __ATOMIC_RELAXED);
+        if (now >= next &&
+            __atomic_compare_exchange_n(&pace->next_update_ns,
+                                        &next,
+                                        now + PACE_UPDATE_NS,
+                                        0,
+                                        __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED)) {
+                double pressure = (pace->pressure_limit > 0) ?
+                                  pace_io_pressure() : -1.0;
+                pace_update(pace, pressure);
+        }
+
+        uint64_t delay = __atomic_load_n(&pace->delay_ns, __ATOMIC_RELAXED);
+        if (delay > 0) {
+                struct timespec ts = {
+                        .tv_sec  = delay / 1000000000ULL,
+                        .tv_nsec = delay % 1000000000ULL,
+                };
+                nanosleep(&ts, NULL);
+        }
+}
@@ -0,0 +1,111 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE    200112L    /* needed for clock_gettime() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pack.h"
+
+/**
+ * Generate a unique object identifier of a new pack.
+ * See pack.h for complete description.
+ */
+int pack_make_id(char *buf, size_t size) {
+        static unsigned int counter = 0;
+        struct timespec ts;
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+
+        /* the time keeps identifiers unique across restarts, the counter
+           within a second, the pid among daemons sharing a bucket */
+        int len = snprintf(buf,
+                           size,
+                           PACK_OBJECT_ID_PREFIX "%llx-%lx-%x-%x",
+                           (unsigned long long)ts.tv_sec,
+                           (unsigned long)ts.tv_nsec,
+                           (unsigned int)getpid(),
+                           counter++);
+
+        return (len < 0 || (size_t)len >= size) ? -1 : 0;
+}
+
+/**
+ * Make an object identifier of a file in a pack.
+ * See pack.h for complete description.
+ */
+int pack_member_id(char *buf,
+                   size_t size,
+                   const char *pack_id,
+                   uint64_t offset,
+                   uint64_t length) {
+        int len = snprintf(buf,
+                           size,
+                           "%s@%" PRIu64 ":%" PRIu64,
+                           pack_id,
+                           offset,
+                           length);
+
+        return (len < 0 || (size_t)len >= size) ? -1 : 0;
+}
+
+/**
+ * Parse an object identifier of a file.
+ * See pack.h for complete description.
+ */
+int pack_parse_member_id(const char *object_id,
+                         char *pack_id,
+                         size_t size,
+                         uint64_t *offset,
+                         uint64_t *length) {
+        if (strchr(object_id, '/') == NULL) {
+                return 0;
+        }
+
+        const char *at = strrchr(object_id, '@');
+        if (at == NULL ||
+            strncmp(object_id,
+                    PACK_OBJECT_ID_PREFIX,
+                    strlen(PACK_OBJECT_ID_PREFIX)) != 0 ||
+            (size_t)(at - object_id) >= size) {
+                return -1;
+        }
+
+        char *end = NULL;
+        unsigned long long off = strtoull(at + 1, &end, 10);
+        if (end == at + 1 || *end != ':') {
+                return -1;
+        }
+
+        const char *len_str = end + 1;
+        unsigned long long len = strtoull(len_str, &end, 10);
+        if (end == len_str || *end != '\0') {
+                return -1;
+        }
+
+        memcpy(pack_id, object_id, at - object_id);
+        pack_id[at - object_id] = '\0';
+        *offset = off;
+        *length = len;
+
+        return 1;
+}
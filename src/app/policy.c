@@ -15,87 +15,437 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#define _XOPEN_SOURCE      500        /* needed to use nftw() */
-#define _POSIX_C_SOURCE    200112L    /* required for rlimit */
+#define _POSIX_C_SOURCE    200809L    /* needed for st_mtim and st_ctim */
 
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <fcntl.h>
-#include <unistd.h>
-#include <ftw.h>
 #include <string.h>
-#include <sys/time.h>
-#include <sys/resource.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "log.h"
 #include "ops.h"
 #include "conf.h"
 #include "queue.h"
 #include "file.h"
+#include "walk.h"
+#include "catalog.h"
+#include "pace.h"
+#include "bloom.h"
+#include "shard.h"
+#include "location.h"
 
 /*******************
  * Scan filesystem *
  * *****************/
 
-#define EVICTION_TIMEOUT    30
-
 static queue_t *in_queue  = NULL;
 static queue_t *out_queue = NULL;
 
+/* a persistent record of the file system; NULL if it is not configured */
+static catalog_t *catalog = NULL;
+
+/* a view of the shards of this daemon; NULL if sharding is not configured */
+static shard_t *shard = NULL;
+
+/* a length of the mount point's path; directories are assigned to shards by
+   their paths relative to the mount point, which may differ between nodes */
+static size_t mount_point_len = 0;
+
+/* a flag indicating that unchanged directories are skipped by the pass */
+static int skip_unchanged = 0;
+
+/* a number of passes done by this process */
+static unsigned long long pass_counter = 0;
+
+/* the filter of remote files is rebuilt at least once per this number of
+   passes, so that a false positive does not keep a file local forever */
+#define REMOTE_FILTER_RESET_PASSES    16
+
+/* a filter of files known to be remote keyed by remote_file_key() */
+static bloom_t remote_filter;
+
+/* non-zero once the filter of remote files is allocated */
+static int remote_filter_ready = 0;
+
+/* a table of known locations shared with the library; NULL if disabled */
+static location_t *locations = NULL;
+
+/* a pacer of the scan shared by all passes */
+static pace_t pace;
+
+/* an access age a file should exceed to be evicted by the policy rules
+   (-1 if there is no such bound) */
+static time_t min_atime_age = -1;
+
+/**
+ * @brief ts_to_ns Converts a timestamp to nanoseconds.
+ *
+ * @param[in] ts A timestamp.
+ *
+ * @return the timestamp in nanoseconds
+ */
+static inline int64_t ts_to_ns( const struct timespec *ts ) {
+        return ( (int64_t)ts->tv_sec * 1000000000LL + ts->tv_nsec );
+}
+
+/**
+ * @brief remote_file_key Calculates a key of a file in the filter of remote
+ *                        files. A change of the file's location changes its
+ *                        extended attributes and hence its ctime, so the key
+ *                        of a recalled file does not match anymore.
+ *
+ * @param[in] sb Stat information of the file.
+ *
+ * @return the key of the file
+ */
+static inline uint64_t remote_file_key( const struct stat *sb ) {
+        return ( ( (uint64_t)sb->st_ino * 0x9e3779b97f4a7c15ULL )
+                 ^ ( (uint64_t)sb->st_dev * 0xc2b2ae3d27d4eb4fULL ) )
+               + (uint64_t)ts_to_ns( &sb->st_ctim );
+}
+
+/**
+ * Remember that a file is remote.
+ * See policy.h for complete description.
+ */
+void remember_remote_file( const struct stat *sb ) {
+        if ( __atomic_load_n( &remote_filter_ready, __ATOMIC_ACQUIRE ) ) {
+                bloom_add( &remote_filter, remote_file_key( sb ) );
+        }
+
+        if ( locations != NULL ) {
+                location_set( locations,
+                              sb->st_dev,
+                              sb->st_ino,
+                              ts_to_ns( &sb->st_ctim ),
+                              e_location_remote );
+        }
+}
+
+/**
+ * Remember that a file is local.
+ * See policy.h for complete description.
+ */
+void remember_local_file( const struct stat *sb ) {
+        if ( locations != NULL ) {
+                location_set( locations,
+                              sb->st_dev,
+                              sb->st_ino,
+                              ts_to_ns( &sb->st_ctim ),
+                              e_location_local );
+        }
+}
+
+/**
+ * Create the shared location cache.
+ * See policy.h for complete description.
+ */
+int init_location_cache( void ) {
+        conf_t *conf = get_conf();
+
+        if ( conf->location_cache_entries == 0 ) {
+                return 0;
+        }
+
+        if ( location_create( &locations,
+                              LOCATION_SHM_OBJ,
+                              conf->location_cache_entries ) == -1 ) {
+                locations = NULL;
+                return -1;
+        }
+
+        return 0;
+}
+
+/**
+ * @brief update_catalog_dir A directory callback of the walk. Records the
+ *                           directory in the catalog and tells the walk
+ *                           whether the directory has changed since the
+ *                           previous pass.
+ *
+ * @param[in] path A path of the directory.
+ * @param[in] sb   An fstat(2) information of the directory.
+ * @param[in] arg  Unused.
+ *
+ * @return WALK_SKIP_STAT if the directory is unchanged, so its files are
+ *         judged by their records in the catalog, WALK_STAT_FILES otherwise
+ */
+static int update_catalog_dir( const char *path,
+                               const struct stat *sb,
+                               void *arg ) {
+        catalog_entry_t *entry = catalog_insert( catalog, sb->st_ino );
+        if ( entry == NULL ) {
+                return WALK_STAT_FILES;
+        }
+
+        int64_t mtime_ns = ts_to_ns( &sb->st_mtim );
+        int64_t ctime_ns = ts_to_ns( &sb->st_ctim );
+
+        /* a set of directory's entries changes mtime and ctime of the
+           directory; changes of files themselves do not, but they are
+           caught by the periodic full pass */
+        int unchanged = skip_unchanged
+                        && ( entry->state == e_catalog_dir )
+                        && ( entry->mtime_ns == mtime_ns )
+                        && ( entry->ctime_ns == ctime_ns );
+
+        entry->state      = e_catalog_dir;
+        entry->mtime_ns   = mtime_ns;
+        entry->ctime_ns   = ctime_ns;
+        entry->generation = catalog->generation;
+
+        return unchanged ? WALK_SKIP_STAT : WALK_STAT_FILES;
+}
+
+/**
+ * @brief scan_dir A directory callback of the walk. Skips files of
+ *                 directories which belong to other daemons and consults
+ *                 the catalog about the others.
+ *
+ * @param[in] path A path of the directory.
+ * @param[in] sb   An fstat(2) information of the directory.
+ * @param[in] arg  Unused.
+ *
+ * @return a verdict of the directory (see walk_dir_cb_t)
+ */
+static int scan_dir( const char *path, const struct stat *sb, void *arg ) {
+        if ( shard != NULL ) {
+                /* a long pass should not lose the lease */
+                shard_renew( shard );
+
+                /* leases are never evicted */
+                if ( ( strcmp( path, shard->dir ) == 0 )
+                     || ! shard_owns( shard, path + mount_point_len ) ) {
+                        return WALK_SKIP_FILES;
+                }
+        }
+
+        return ( catalog != NULL ) ? update_catalog_dir( path, sb, arg )
+                                   : WALK_STAT_FILES;
+}
+
 static int update_evict_queue( const char *path,
+                               ino_t ino,
                                const struct stat *sb,
-                               int typeflag,
-                               struct FTW *ftwbuf ) {
-        /* since we mostly use file descriptors for file operations in other
-           places for certain reasons, use file descriptors here as well;
+                               void *arg ) {
+        /* decide from the stat information the walk has already obtained;
+           checks are ordered by their cost, so that a file is touched by
+           an additional metadata operation only if policy rules select it;
            ignore errors of system calls, we do not want to fail the program
            because of failures in background threads (such as this one) */
+        time_t now = time( NULL );
+        catalog_entry_t *entry = ( catalog != NULL ) ?
+                                 catalog_insert( catalog, ino ) : NULL;
 
-        /* cannot use O_PATH flag because some of the next operations will use
-           fgetxattr(3)
-           (see http://man7.org/linux/man-pages/man2/open.2.html) */
-        int fd  = open( path, O_RDWR );
-        if ( fd == -1 ) {
-                /* just continue with the next files; non-zero will
-                   cause failure of nftw() */
+        struct stat path_stat;
+        if ( sb == NULL ) {
+                /* the directory is unchanged and files have not been stat'ed;
+                   access time only grows, so a file which was accessed
+                   recently according to the catalog is still not a candidate
+                   and a remote file remains remote until its recall (caught
+                   by the periodic full pass) */
+                if ( entry != NULL ) {
+                        entry->generation = catalog->generation;
+
+                        if ( ( entry->state == e_catalog_remote )
+                             || ( ( min_atime_age >= 0 )
+                                  && ( entry->atime + min_atime_age
+                                       >= now ) ) ) {
+                                return 0;
+                        }
+                }
+
+                /* a candidate according to the catalog; verify it */
+                if ( lstat( path, &path_stat ) == -1 ) {
+                        return 0;
+                }
+
+                sb = &path_stat;
+        }
+
+        if ( ! S_ISREG( sb->st_mode ) ) {
                 return 0;
         }
 
-        struct stat path_stat;
-        if ( fstat( fd, &path_stat ) == -1) {
-                /* just continue with the next files; non-zero will
-                   cause failure of nftw() */
+        int evict = ( rules_eval( &get_conf()->rules, path, sb, now )
+                      == e_rule_evict );
+        int64_t ctime_ns = ts_to_ns( &sb->st_ctim );
 
-                if ( close( fd ) == -1 ) {
-                        /* TODO: consider to handle EINTR */
+        /* a change of extended attributes changes ctime, hence a known
+           location is valid as long as ctime is the same */
+        enum catalog_state_enum state = e_catalog_unknown;
+        if ( ( entry != NULL )
+             && ( entry->ctime_ns == ctime_ns )
+             && ( ( entry->state == e_catalog_local )
+                  || ( entry->state == e_catalog_remote ) ) ) {
+                state = entry->state;
+        } else if ( evict
+                    && __atomic_load_n( &remote_filter_ready, __ATOMIC_ACQUIRE )
+                    && bloom_test( &remote_filter, remote_file_key( sb ) ) ) {
+                /* most likely remote; the state stays unknown, so that
+                   a false positive is not recorded in the catalog */
+                evict = 0;
+        } else if ( evict ) {
+                /* lgetxattr(2) on the path; the file itself is opened only by
+                   the upload operation */
+                int ret = is_local_file( path );
+                if ( ret != -1 ) {
+                        state = ret ? e_catalog_local : e_catalog_remote;
                 }
 
+                if ( ret == 0 ) {
+                        remember_remote_file( sb );
+                } else if ( ret == 1 ) {
+                        remember_local_file( sb );
+                }
+        }
+
+        if ( entry != NULL ) {
+                entry->state      = state;
+                entry->size       = sb->st_size;
+                entry->atime      = sb->st_atime;
+                entry->mtime_ns   = ts_to_ns( &sb->st_mtim );
+                entry->ctime_ns   = ctime_ns;
+                entry->generation = catalog->generation;
+        }
+
+        if ( ! evict || ( state != e_catalog_local ) ) {
                 return 0;
         }
 
-        if ( ( is_regular_file( fd ) > 0 )
-             && ( is_local_file( fd )   > 0 )
-             && ( path_stat.st_atime + EVICTION_TIMEOUT ) < time( NULL ) ) {
+        char *data = (char *)path;
+        size_t data_size = strlen( path ) + 1;
+
+        if ( queue_push( out_queue, data, data_size ) == -1 ) {
+                LOG( ERROR,
+                     "queue_push failed [data: %s; data size: %zu, "
+                     "path size max: %zu]",
+                     data,
+                     data_size,
+                     get_conf()->path_max );
+                /* say that error happen, but do not abort execution */
+        }
 
-                char *data = (char *)path;
-                size_t data_size = strlen( path ) + 1;
+        /* non-zero will stop the walk */
+        return 0;
+}
+
+/**
+ * @brief prepare_remote_filter Allocates the filter of remote files on the
+ *                              first pass and clears it when it is overloaded
+ *                              or too old.
+ */
+static void prepare_remote_filter( void ) {
+        conf_t *conf = get_conf();
 
-                if ( queue_push( out_queue, data, data_size ) == -1 ) {
+        if ( pass_counter == 0 ) {
+                if ( conf->remote_filter_max_entries == 0 ) {
+                        return;
+                }
+
+                if ( bloom_init( &remote_filter,
+                                 conf->remote_filter_max_entries ) == -1 ) {
                         LOG( ERROR,
-                             "queue_push failed [data: %s; data size: %zu, "
-                             "path size max: %zu]",
-                             data,
-                             data_size,
-                             get_conf()->path_max );
-                        /* say that error happen, but do not abort execution */
+                             "failed to allocate filter of remote files "
+                             "[entries: %zu]",
+                             conf->remote_filter_max_entries );
+                        return;
                 }
+
+                __atomic_store_n( &remote_filter_ready, 1, __ATOMIC_RELEASE );
+                return;
         }
 
-        if ( close( fd ) == -1 ) {
-                /* TODO: consider to handle EINTR */
+        if ( remote_filter_ready
+             && ( bloom_full( &remote_filter )
+                  || ( pass_counter % REMOTE_FILTER_RESET_PASSES == 0 ) ) ) {
+                bloom_clear( &remote_filter );
         }
+}
 
-        return 0;
+/**
+ * @brief open_shard Joins the daemons sharing the file system if sharding is
+ *                   configured.
+ */
+static void open_shard( void ) {
+        static shard_t shard_view;
+        conf_t *conf = get_conf();
+
+        if ( conf->shard_dir[0] == '\0' ) {
+                return;
+        }
+
+        char name[SHARD_NAME_MAX];
+        if ( conf->shard_node_name[0] != '\0' ) {
+                strcpy( name, conf->shard_node_name );
+        } else if ( gethostname( name, sizeof( name ) ) == -1 ) {
+                LOG( ERROR,
+                     "failed to get host name; this daemon scans the whole "
+                     "file system" );
+                return;
+        }
+        name[sizeof( name ) - 1] = '\0';
+
+        /* the lease is renewed only during passes, so it should outlive
+           a pause between passes */
+        time_t lease_sec = conf->shard_lease_sec;
+        if ( lease_sec <= conf->scanfs_iter_tm_sec ) {
+                lease_sec = 2 * conf->scanfs_iter_tm_sec;
+
+                LOG( INFO,
+                     "lease period is extended to outlive a pause between "
+                     "scan passes [lease: %lld sec]",
+                     (long long)lease_sec );
+        }
+
+        if ( shard_join( &shard_view,
+                         conf->shard_dir,
+                         name,
+                         lease_sec ) == -1 ) {
+                LOG( ERROR,
+                     "failed to join shards; this daemon scans the whole "
+                     "file system [dir: %s | node: %s]",
+                     conf->shard_dir,
+                     name );
+                return;
+        }
+
+        shard = &shard_view;
+
+        LOG( INFO,
+             "joined shards [dir: %s | node: %s]",
+             conf->shard_dir,
+             name );
+}
+
+/**
+ * @brief open_catalog Opens the catalog if it is configured.
+ */
+static void open_catalog( void ) {
+        conf_t *conf = get_conf();
+
+        if ( conf->catalog_path[0] == '\0' ) {
+                return;
+        }
+
+        if ( catalog_open( &catalog,
+                           conf->catalog_path,
+                           conf->catalog_max_entries ) == -1 ) {
+                LOG( ERROR,
+                     "failed to open catalog; every scan pass will visit "
+                     "all files [path: %s]",
+                     conf->catalog_path );
+
+                catalog = NULL;
+                return;
+        }
+
+        LOG( INFO,
+             "catalog opened [path: %s | entries: %llu]",
+             conf->catalog_path,
+             (unsigned long long)catalog->count );
 }
 
 int scan_fs(queue_t *in_q, queue_t *out_q) {
@@ -104,25 +454,63 @@ int scan_fs(queue_t *in_q, queue_t *out_q) {
         in_queue  = in_q;
         out_queue = out_q;
 
-        /* set maximum number of open files for nftw to a half of descriptor table size for current process */
-        struct rlimit rlim;
-        if (getrlimit(RLIMIT_NOFILE, &rlim) == -1) {
-                return -1;
+        if (pass_counter == 0) {
+                mount_point_len = strlen(conf->fs_mount_point);
+                open_shard();
+                open_catalog();
+                pace_init(&pace,
+                          conf->scanfs_max_delay_msec * 1000000ULL,
+                          conf->scanfs_io_pressure_limit);
         }
 
-        /* rlim_cur value will be +1 higher than actual according to documentation */
-        if (rlim.rlim_cur <= 2) {
-                /* there are 1 or less descriptors available */
-                return -1;
+        /* directories change owners when daemons join or leave; files of
+           newly owned directories are not known to the catalog */
+        int shards_changed = 0;
+        if (shard != NULL && shard_refresh(shard) == 1) {
+                LOG(INFO,
+                    "set of daemons sharing the file system has changed "
+                    "[live: %zu]",
+                    shard->nodes_count);
+                shards_changed = 1;
         }
-        int nopenfd = rlim.rlim_cur / 2;
 
-        /* stay within filesystem and do not follow symlinks */
-        int flags = FTW_MOUNT | FTW_PHYS;
+        if (catalog != NULL) {
+                struct stat root_stat;
+                if (stat(conf->fs_mount_point, &root_stat) == -1) {
+                        return -1;
+                }
 
-        if (nftw(conf->fs_mount_point, update_evict_queue, nopenfd, flags) == -1) {
-                return -1;
+                /* the first pass of this process and every n-th pass visit
+                   all files to catch changes not reflected in directories */
+                int full_pass = shards_changed ||
+                                (conf->catalog_full_scan_passes == 0) ||
+                                (pass_counter %
+                                 conf->catalog_full_scan_passes == 0);
+
+                skip_unchanged = catalog_begin_pass(catalog,
+                                                    root_stat.st_dev) &&
+                                 !full_pass;
         }
 
-        return 0;
+        prepare_remote_filter();
+
+        pass_counter++;
+
+        min_atime_age = rules_min_atime_age(&conf->rules);
+
+        /* the callback is invoked concurrently by walking threads;
+           it stays within filesystem and does not follow symlinks */
+        int ret = walk_tree(conf->fs_mount_point,
+                            conf->scanfs_threads,
+                            (catalog != NULL || shard != NULL) ?
+                            scan_dir : NULL,
+                            update_evict_queue,
+                            NULL,
+                            &pace);
+
+        if (catalog != NULL) {
+                catalog_end_pass(catalog, ret == 0);
+        }
+
+        return (ret == 0) ? 0 : -1;
 }
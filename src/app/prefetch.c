@@ -0,0 +1,378 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _DEFAULT_SOURCE    /* needed for DT_* constants */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <dirent.h>
+#include <linux/limits.h>
+
+#include "prefetch.h"
+#include "conf.h"
+#include "file.h"
+#include "log.h"
+
+/* a number of directories tracked at once */
+#define PREFETCH_DIRS          64
+
+/* recalls in a directory further apart in time are not related */
+#define PREFETCH_WINDOW_SEC    60
+
+/* a maximum number of files enqueued per recall */
+#define PREFETCH_MAX_DEPTH     32
+
+/* a state of a tracked directory */
+typedef struct {
+        /* a hash of the directory's path; 0 marks an unused slot */
+        uint64_t dir_hash;
+
+        /* a time of the last recall in the directory */
+        time_t last_tm;
+
+        /* a name of the last recalled file */
+        char last_name[NAME_MAX + 1];
+
+        /* files up to this name (or number) have already been enqueued */
+        char mark[NAME_MAX + 1];
+        unsigned long long seq_mark;
+} prefetch_dir_t;
+
+/* a numbered name split into parts: <prefix><number><suffix> */
+typedef struct {
+        size_t prefix_len;
+        size_t width;
+        unsigned long long number;
+} seq_name_t;
+
+/* directories are direct-mapped into slots; a collision replaces a slot */
+static prefetch_dir_t dirs[PREFETCH_DIRS];
+
+/**
+ * @brief hash_str Calculates FNV-1a hash of a string prefix.
+ *
+ * @param[in] str A string.
+ * @param[in] len A length of the prefix.
+ *
+ * @return the hash (never 0)
+ */
+static uint64_t hash_str(const char *str, size_t len) {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+
+        for (size_t i = 0; i < len; i++) {
+                hash ^= (unsigned char)str[i];
+                hash *= 0x100000001b3ULL;
+        }
+
+        return hash ? hash : 1;
+}
+
+/**
+ * @brief parse_seq_name Finds the last run of digits in a name.
+ *
+ * @param[in]  name A file name.
+ * @param[out] seq  Parts of the name.
+ *
+ * @return  0: the name contains a number
+ *         -1: the name does not contain a number
+ */
+static int parse_seq_name(const char *name, seq_name_t *seq) {
+        size_t end = strlen(name);
+
+        while (end > 0 && !isdigit((unsigned char)name[end - 1])) {
+                end--;
+        }
+
+        size_t beg = end;
+        while (beg > 0 && isdigit((unsigned char)name[beg - 1])) {
+                beg--;
+        }
+
+        /* numbers which do not fit into 18 digits are not sequences */
+        if (beg == end || end - beg > 18) {
+                return -1;
+        }
+
+        seq->prefix_len = beg;
+        seq->width = end - beg;
+        seq->number = strtoull(name + beg, NULL, 10);
+
+        return 0;
+}
+
+/**
+ * @brief is_next_seq_name Checks whether a name follows another one in
+ *                         a numbered sequence.
+ *
+ * @param[in]  prev A previous name.
+ * @param[in]  name A current name.
+ * @param[out] seq  Parts of the current name.
+ *
+ * @return 1 if the name's number is the previous one's plus one and other
+ *         parts of the names are equal, 0 otherwise
+ */
+static int is_next_seq_name(const char *prev,
+                            const char *name,
+                            seq_name_t *seq) {
+        seq_name_t prev_seq;
+
+        if (parse_seq_name(prev, &prev_seq) == -1 ||
+            parse_seq_name(name, seq) == -1) {
+                return 0;
+        }
+
+        const char *prev_suffix = prev + prev_seq.prefix_len + prev_seq.width;
+        const char *suffix = name + seq->prefix_len + seq->width;
+
+        return (prev_seq.prefix_len == seq->prefix_len) &&
+               (strncmp(prev, name, seq->prefix_len) == 0) &&
+               (strcmp(prev_suffix, suffix) == 0) &&
+               (prev_seq.number + 1 == seq->number);
+}
+
+/**
+ * @brief enqueue_if_remote Enqueues a file if it is in the remote storage.
+ *
+ * @note Only regular files are evicted, so a single lgetxattr(2) both checks
+ *       the file's existence and its location.
+ *
+ * @param[in] path  A path of the file.
+ * @param[in] queue A queue of background recalls.
+ *
+ * @return  1: the file has been enqueued
+ *          0: the file is local or the queue is full
+ *         -1: the file does not exist
+ */
+static int enqueue_if_remote(const char *path, queue_t *queue) {
+        int ret = is_remote_file_path(path);
+        if (ret != 1) {
+                return ret;
+        }
+
+        /* the caller consumes the queue, so it must never wait for space */
+        return (queue_try_push(queue, path, strlen(path) + 1) == 0) ? 1 : 0;
+}
+
+/**
+ * @brief prefetch_seq Enqueues next files of a numbered sequence.
+ *
+ * @param[in]     dir   A path of the directory.
+ * @param[in]     name  A name of the recalled file.
+ * @param[in]     seq   Parts of the name.
+ * @param[in]     depth A number of files to look ahead.
+ * @param[in,out] slot  A state of the directory.
+ * @param[in]     queue A queue of background recalls.
+ *
+ * @return a number of enqueued files
+ */
+static int prefetch_seq(const char *dir,
+                        const char *name,
+                        const seq_name_t *seq,
+                        size_t depth,
+                        prefetch_dir_t *slot,
+                        queue_t *queue) {
+        const char *suffix = name + seq->prefix_len + seq->width;
+        char path[PATH_MAX];
+        int enqueued = 0;
+
+        unsigned long long first = seq->number + 1;
+        if (slot->seq_mark >= first) {
+                first = slot->seq_mark + 1;
+        }
+
+        for (unsigned long long num = first;
+             num <= seq->number + depth;
+             num++) {
+                /* keep zero padding of the original name */
+                if (snprintf(path,
+                             PATH_MAX,
+                             "%s/%.*s%0*llu%s",
+                             dir,
+                             (int)seq->prefix_len,
+                             name,
+                             (int)seq->width,
+                             num,
+                             suffix) >= PATH_MAX) {
+                        break;
+                }
+
+                int ret = enqueue_if_remote(path, queue);
+                if (ret == -1) {
+                        /* the sequence has ended */
+                        break;
+                }
+
+                enqueued += ret;
+                slot->seq_mark = num;
+        }
+
+        return enqueued;
+}
+
+/**
+ * @brief prefetch_sweep Enqueues files of a directory which follow the
+ *                       recalled file in lexicographical order, unless they
+ *                       have been enqueued before.
+ *
+ * @param[in]     dir   A path of the directory.
+ * @param[in]     name  A name of the recalled file.
+ * @param[in]     depth A number of files to look ahead.
+ * @param[in,out] slot  A state of the directory.
+ * @param[in]     queue A queue of background recalls.
+ *
+ * @return a number of enqueued files
+ */
+static int prefetch_sweep(const char *dir,
+                          const char *name,
+                          size_t depth,
+                          prefetch_dir_t *slot,
+                          queue_t *queue) {
+        /* the smallest names after the recalled one, sorted */
+        static char next[PREFETCH_MAX_DEPTH][NAME_MAX + 1];
+        size_t next_cnt = 0;
+
+        DIR *dirp = opendir(dir);
+        if (dirp == NULL) {
+                return 0;
+        }
+
+        struct dirent *entry;
+        while ((entry = readdir(dirp)) != NULL) {
+                if ((entry->d_type != DT_REG && entry->d_type != DT_UNKNOWN) ||
+                    strcmp(entry->d_name, name) <= 0) {
+                        continue;
+                }
+
+                /* insert into the sorted array, dropping the largest name */
+                size_t pos = next_cnt;
+                while (pos > 0 && strcmp(next[pos - 1], entry->d_name) > 0) {
+                        pos--;
+                }
+
+                if (pos == depth) {
+                        continue;
+                }
+
+                if (next_cnt < depth) {
+                        next_cnt++;
+                }
+
+                memmove(next[pos + 1],
+                        next[pos],
+                        (next_cnt - pos - 1) * sizeof(next[0]));
+                strcpy(next[pos], entry->d_name);
+        }
+
+        closedir(dirp);
+
+        char path[PATH_MAX];
+        int enqueued = 0;
+
+        for (size_t i = 0; i < next_cnt; i++) {
+                /* enqueued by one of the previous recalls */
+                if (strcmp(next[i], slot->mark) <= 0) {
+                        continue;
+                }
+
+                if (snprintf(path,
+                             PATH_MAX,
+                             "%s/%s",
+                             dir,
+                             next[i]) >= PATH_MAX) {
+                        break;
+                }
+
+                int ret = enqueue_if_remote(path, queue);
+                if (ret != -1) {
+                        enqueued += ret;
+                }
+
+                strcpy(slot->mark, next[i]);
+        }
+
+        return enqueued;
+}
+
+/**
+ * Register a demand recall and enqueue recalls of likely next files.
+ * See prefetch.h for complete description.
+ */
+int prefetch_recall(const char *path, queue_t *queue) {
+        size_t depth = get_conf()->prefetch_depth;
+        if (depth == 0 || queue == NULL) {
+                return 0;
+        }
+
+        if (depth > PREFETCH_MAX_DEPTH) {
+                depth = PREFETCH_MAX_DEPTH;
+        }
+
+        const char *slash = strrchr(path, '/');
+        if (slash == NULL || slash == path || strlen(slash + 1) > NAME_MAX) {
+                return -1;
+        }
+
+        const char *name = slash + 1;
+        size_t dir_len = slash - path;
+        if (dir_len >= PATH_MAX) {
+                return -1;
+        }
+
+        char dir[PATH_MAX];
+        memcpy(dir, path, dir_len);
+        dir[dir_len] = '\0';
+
+        uint64_t dir_hash = hash_str(path, dir_len);
+        prefetch_dir_t *slot = &dirs[dir_hash % PREFETCH_DIRS];
+        time_t now = time(NULL);
+
+        /* a single recall is not a pattern yet */
+        int related = (slot->dir_hash == dir_hash) &&
+                      (now - slot->last_tm <= PREFETCH_WINDOW_SEC) &&
+                      (strcmp(slot->last_name, name) != 0);
+
+        /* a sweep is tracked while names grow; a jump back starts over */
+        if (slot->dir_hash != dir_hash || strcmp(name, slot->last_name) < 0) {
+                slot->dir_hash = dir_hash;
+                slot->mark[0] = '\0';
+                slot->seq_mark = 0;
+        }
+
+        seq_name_t seq;
+        int enqueued = 0;
+        if (related) {
+                enqueued = is_next_seq_name(slot->last_name, name, &seq) ?
+                           prefetch_seq(dir, name, &seq, depth, slot, queue) :
+                           prefetch_sweep(dir, name, depth, slot, queue);
+
+                if (enqueued > 0) {
+                        LOG(DEBUG,
+                            "prefetch after recall [path: %s | enqueued: %d]",
+                            path,
+                            enqueued);
+                }
+        }
+
+        strcpy(slot->last_name, name);
+        slot->last_tm = now;
+
+        return enqueued;
+}
@@ -0,0 +1,353 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fnmatch.h>
+
+#include "rules.h"
+
+/* a tested attribute of a file */
+enum rule_key_enum {
+        e_rule_key_action = 0, /* not a predicate; finishes a matching rule */
+        e_rule_key_path,
+        e_rule_key_size,
+        e_rule_key_atime,
+        e_rule_key_mtime,
+        e_rule_key_ctime,
+        e_rule_key_uid,
+        e_rule_key_gid,
+};
+
+/* a comparison operator */
+enum rule_op_enum {
+        e_rule_op_eq = 0,
+        e_rule_op_ne,
+        e_rule_op_lt,
+        e_rule_op_le,
+        e_rule_op_gt,
+        e_rule_op_ge,
+};
+
+/* a description of a supported key */
+static const struct rule_key {
+        const char *name;
+        enum rule_key_enum key;
+        const char *suffixes;     /* accepted suffixes of a value */
+        const int64_t *factors;   /* multipliers of the suffixes */
+} rule_keys[] = {
+        { "path",  e_rule_key_path,  NULL,    NULL },
+        { "size",  e_rule_key_size,  "KMGT",
+          (const int64_t[]){ 1LL << 10, 1LL << 20, 1LL << 30, 1LL << 40 } },
+        { "atime", e_rule_key_atime, "smhdw",
+          (const int64_t[]){ 1, 60, 3600, 86400, 604800 } },
+        { "mtime", e_rule_key_mtime, "smhdw",
+          (const int64_t[]){ 1, 60, 3600, 86400, 604800 } },
+        { "ctime", e_rule_key_ctime, "smhdw",
+          (const int64_t[]){ 1, 60, 3600, 86400, 604800 } },
+        { "uid",   e_rule_key_uid,   "",      NULL },
+        { "gid",   e_rule_key_gid,   "",      NULL },
+};
+
+/* string representations of operators; two-character operators go first */
+static const struct rule_op {
+        const char *name;
+        enum rule_op_enum op;
+} rule_ops[] = {
+        { "!=", e_rule_op_ne },
+        { "<=", e_rule_op_le },
+        { ">=", e_rule_op_ge },
+        { "=",  e_rule_op_eq },
+        { "<",  e_rule_op_lt },
+        { ">",  e_rule_op_gt },
+};
+
+/**
+ * @brief parse_value Parses a numeric value with an optional suffix.
+ *
+ * @param[in]  key   A description of the key the value belongs to.
+ * @param[in]  str   A string to be parsed.
+ * @param[out] value The parsed value.
+ *
+ * @return  0: the value has been parsed
+ *         -1: the string is not a valid value
+ */
+static int parse_value(const struct rule_key *key,
+                       const char *str,
+                       int64_t *value) {
+        char *end = NULL;
+
+        errno = 0;
+        long long num = strtoll(str, &end, 10);
+        if (errno != 0 || end == str || num < 0) {
+                return -1;
+        }
+
+        if (*end != '\0') {
+                const char *suffix = (end[1] == '\0') ?
+                                     strchr(key->suffixes, *end) : NULL;
+                if (suffix == NULL) {
+                        return -1;
+                }
+
+                int64_t factor = key->factors[suffix - key->suffixes];
+                if (num > INT64_MAX / factor) {
+                        return -1;
+                }
+
+                num *= factor;
+        }
+
+        *value = (int64_t)num;
+
+        return 0;
+}
+
+/**
+ * @brief parse_predicate Compiles a predicate into an instruction.
+ *
+ * @param[in,out] rules Rules; a path pattern is stored to their pool.
+ * @param[in]     str   A predicate in a form <key><op><value>.
+ * @param[out]    insn  The compiled instruction.
+ *
+ * @return  0: the predicate has been compiled
+ *         -1: the predicate is malformed or the pool is exhausted
+ */
+static int parse_predicate(rules_t *rules, const char *str, rule_insn_t *insn) {
+        size_t name_len = 0;
+        while (isalpha((unsigned char)str[name_len])) {
+                name_len++;
+        }
+
+        const struct rule_key *key = NULL;
+        for (size_t i = 0; i < sizeof(rule_keys) / sizeof(rule_keys[0]); i++) {
+                if (strlen(rule_keys[i].name) == name_len &&
+                    strncmp(rule_keys[i].name, str, name_len) == 0) {
+                        key = &rule_keys[i];
+                        break;
+                }
+        }
+
+        if (key == NULL) {
+                return -1;
+        }
+
+        const struct rule_op *op = NULL;
+        for (size_t i = 0; i < sizeof(rule_ops) / sizeof(rule_ops[0]); i++) {
+                size_t op_len = strlen(rule_ops[i].name);
+                if (strncmp(rule_ops[i].name, str + name_len, op_len) == 0) {
+                        op = &rule_ops[i];
+                        break;
+                }
+        }
+
+        if (op == NULL) {
+                return -1;
+        }
+
+        const char *value = str + name_len + strlen(op->name);
+
+        insn->key = key->key;
+        insn->op = op->op;
+        insn->pattern = 0;
+        insn->value = 0;
+
+        if (key->key != e_rule_key_path) {
+                return parse_value(key, value, &insn->value);
+        }
+
+        /* patterns can only be compared for equality */
+        size_t value_size = strlen(value) + 1;
+        if ((op->op != e_rule_op_eq && op->op != e_rule_op_ne) ||
+            value_size == 1 ||
+            value_size > RULES_POOL_SIZE - rules->pool_size) {
+                return -1;
+        }
+
+        memcpy(rules->pool + rules->pool_size, value, value_size);
+        insn->pattern = (uint32_t)rules->pool_size;
+        rules->pool_size += value_size;
+
+        return 0;
+}
+
+/**
+ * Initialize an empty list of rules.
+ * See rules.h for complete description.
+ */
+void rules_init(rules_t *rules) {
+        rules->count = 0;
+        rules->insns_count = 0;
+        rules->pool_size = 0;
+}
+
+/**
+ * Compile a rule and append it to the list.
+ * See rules.h for complete description.
+ */
+int rules_add(rules_t *rules, size_t argc, const char *const *argv) {
+        if (rules == NULL || argc == 0 || argv == NULL) {
+                return -1;
+        }
+
+        enum rule_action_enum action;
+        if (strcmp(argv[0], "evict") == 0) {
+                action = e_rule_evict;
+        } else if (strcmp(argv[0], "exclude") == 0) {
+                action = e_rule_keep;
+        } else {
+                return -1;
+        }
+
+        /* predicates plus the action instruction */
+        if (argc > RULES_MAX_INSNS - rules->insns_count) {
+                return -1;
+        }
+
+        /* a failed rule should not leave its patterns in the pool */
+        size_t pool_size = rules->pool_size;
+        rule_insn_t *insns = rules->insns + rules->insns_count;
+
+        for (size_t i = 1; i < argc; i++) {
+                if (parse_predicate(rules, argv[i], &insns[i - 1]) == -1) {
+                        rules->pool_size = pool_size;
+                        return -1;
+                }
+
+                /* a false predicate jumps over the rest of the rule */
+                insns[i - 1].skip = (uint16_t)(argc - i + 1);
+        }
+
+        insns[argc - 1].key = e_rule_key_action;
+        insns[argc - 1].op = e_rule_op_eq;
+        insns[argc - 1].skip = 1;
+        insns[argc - 1].pattern = 0;
+        insns[argc - 1].value = action;
+
+        rules->insns_count += argc;
+        rules->count++;
+
+        return 0;
+}
+
+/**
+ * Decide what should happen to a file.
+ * See rules.h for complete description.
+ */
+enum rule_action_enum rules_eval(const rules_t *rules,
+                                 const char *path,
+                                 const struct stat *sb,
+                                 time_t now) {
+        size_t pc = 0;
+
+        while (pc < rules->insns_count) {
+                const rule_insn_t *insn = &rules->insns[pc];
+                int64_t attr = 0;
+                int res = 0;
+
+                switch (insn->key) {
+                case e_rule_key_action:
+                        return (enum rule_action_enum)insn->value;
+                case e_rule_key_path:
+                        /* compared with the value for equality below */
+                        attr = (fnmatch(rules->pool + insn->pattern,
+                                        path,
+                                        0) == 0) ? insn->value : -1;
+                        break;
+                case e_rule_key_size:
+                        attr = sb->st_size;
+                        break;
+                case e_rule_key_atime:
+                        attr = now - sb->st_atime;
+                        break;
+                case e_rule_key_mtime:
+                        attr = now - sb->st_mtime;
+                        break;
+                case e_rule_key_ctime:
+                        attr = now - sb->st_ctime;
+                        break;
+                case e_rule_key_uid:
+                        attr = sb->st_uid;
+                        break;
+                case e_rule_key_gid:
+                        attr = sb->st_gid;
+                        break;
+                }
+
+                switch (insn->op) {
+                case e_rule_op_eq: res = (attr == insn->value); break;
+                case e_rule_op_ne: res = (attr != insn->value); break;
+                case e_rule_op_lt: res = (attr <  insn->value); break;
+                case e_rule_op_le: res = (attr <= insn->value); break;
+                case e_rule_op_gt: res = (attr >  insn->value); break;
+                case e_rule_op_ge: res = (attr >= insn->value); break;
+                }
+
+                pc += res ? 1 : insn->skip;
+        }
+
+        return e_rule_keep;
+}
+
+/**
+ * Calculate an access age that a file should exceed to be evicted.
+ * See rules.h for complete description.
+ */
+time_t rules_min_atime_age(const rules_t *rules) {
+        time_t min_age = -1;
+        time_t rule_age = -1;
+        int found = 0;
+
+        for (size_t pc = 0; pc < rules->insns_count; pc++) {
+                const rule_insn_t *insn = &rules->insns[pc];
+
+                if (insn->key == e_rule_key_action) {
+                        if (insn->value == e_rule_evict) {
+                                /* a rule without a bound makes any age
+                                   suitable */
+                                if (!found || rule_age < min_age) {
+                                        min_age = rule_age;
+                                }
+                                found = 1;
+                        }
+
+                        rule_age = -1;
+                        continue;
+                }
+
+                if (insn->key != e_rule_key_atime) {
+                        continue;
+                }
+
+                /* an age strictly greater than the bound is required */
+                time_t bound = -1;
+                if (insn->op == e_rule_op_gt) {
+                        bound = insn->value;
+                } else if (insn->op == e_rule_op_ge ||
+                           insn->op == e_rule_op_eq) {
+                        bound = insn->value - 1;
+                }
+
+                if (bound > rule_age) {
+                        rule_age = bound;
+                }
+        }
+
+        return found ? min_age : -1;
+}
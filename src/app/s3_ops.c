@@ -15,7 +15,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#define _POSIX_C_SOURCE    200112L    /* required for strerror_r() */
+#define _POSIX_C_SOURCE    200809L    /* required for strerror_r(), pread() */
 
 #include <stdio.h>
 #include <string.h>
@@ -23,16 +23,22 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/ioctl.h>
 #include <attr/xattr.h>
+#include <linux/fs.h>
 #include <libs3.h>
 
 #include "ops.h"
 #include "conf.h"
 #include "log.h"
+#include "objid.h"
+#include "crc32c.h"
 
-/* +1 is for '\0' character */
+/* object ids are OBJID_LEN characters long; object ids of files in packs
+   are longer, but still far shorter than S3_MAX_KEY_SIZE; the size
+   includes '\0' character */
 #define S3_XATTR_KEY     "s3_object_id"
-#define S3_XATTR_SIZE    S3_MAX_KEY_SIZE + 1
+#define S3_XATTR_SIZE    128
 
 /* buffer to store error messages (mostly errno messages) */
 static __thread char err_buf[ERR_MSG_BUF_LEN];
@@ -65,13 +71,28 @@ struct s3_cb_data {
 struct s3_put_object_callback_data {
         FILE *file;
         uint64_t content_length;
+        uint32_t crc;  /* a checksum of the data sent */
 };
 
-/* used in s3_get_object_data_callback(); not needed since it has only one
-   member but still defined in order to be consistent with
-   struct s3_put_object_callback_data */
+/* used in s3_put_pack_data_callback(); data of files is read one after
+   another with pread(), so that offsets of file descriptors are intact */
+struct s3_put_pack_callback_data {
+        const int *fds;
+        const uint64_t *sizes;
+        size_t count;
+        size_t index;  /* a file being read */
+        uint64_t pos;  /* a position in the file being read */
+        uint32_t *crcs; /* checksums of the files' data sent */
+};
+
+/* used in s3_get_object_data_callback(); a retried request gets the data
+   from the beginning again, so the data which have already been written are
+   skipped */
 struct s3_get_object_callback_data {
         FILE *file;
+        uint64_t received; /* a number of bytes written to the file */
+        uint64_t skip;     /* a number of bytes to be skipped */
+        uint32_t crc;      /* a checksum of the data written */
 };
 
 /**
@@ -296,11 +317,77 @@ static int s3_put_object_data_callback(
         }
         data->content_length -= ret;
 
+        /* the data are checksummed while they are still in the cache */
+        data->crc = crc32c(data->crc, buffer, ret);
+
         return ret;
 }
 
 /**
- * TODO: write description.
+ * @brief s3_put_pack_data_callback The same as s3_put_object_data_callback(),
+ *                                  but the object's content is a
+ *                                  concatenation of several files.
+ *
+ * @param[in]     bufferSize    Gives the maximum number of bytes that may be
+ *                              written into the buffer parameter by this
+ *                              callback.
+ * @param[in,out] buffer        Gives the buffer to fill with at most bufferSize
+ *                              bytes of data.
+ * @param[in,out] callback_data The callback data as specified when the request
+ *                              was issued.
+ * @return < 0 to abort the request, 0 to indicate the end of data, or > 0 to
+ *         identify the number of bytes that were written into the buffer
+ */
+static int s3_put_pack_data_callback(
+        int buffer_size, char *buffer, void *callback_data) {
+        struct s3_put_pack_callback_data *data =
+                (struct s3_put_pack_callback_data *)
+                                   (((struct s3_cb_data *)callback_data)->data);
+
+        int filled = 0;
+
+        while (filled < buffer_size && data->index < data->count) {
+                uint64_t left = data->sizes[data->index] - data->pos;
+                if (left == 0) {
+                        data->index++;
+                        data->pos = 0;
+                        continue;
+                }
+
+                size_t to_read = (left > (uint64_t)(buffer_size - filled)) ?
+                                 (size_t)(buffer_size - filled) : left;
+
+                ssize_t ret = pread(data->fds[data->index],
+                                    buffer + filled,
+                                    to_read,
+                                    data->pos);
+                if (ret <= 0) {
+                        /* a file has shrunk or can not be read */
+                        return -1;
+                }
+
+                data->crcs[data->index] = crc32c(data->crcs[data->index],
+                                                 buffer + filled,
+                                                 ret);
+
+                filled += ret;
+                data->pos += ret;
+        }
+
+        return filled;
+}
+
+/**
+ * @brief s3_get_object_data_callback This callback is made during a get
+ *                                    object operation, to provide the next
+ *                                    chunk of the object's data.
+ *
+ * @param[in]     buffer_size   A size of the chunk.
+ * @param[in]     buffer        The chunk.
+ * @param[in,out] callback_data The callback data as specified when the request
+ *                              was issued.
+ * @return S3StatusOK to continue processing the request, anything else to
+ *         immediately abort the request
  */
 static S3Status s3_get_object_data_callback(
         int buffer_size, const char *buffer, void *callback_data) {
@@ -308,21 +395,46 @@ static S3Status s3_get_object_data_callback(
                 (struct s3_get_object_callback_data *)
                                    (((struct s3_cb_data *)callback_data)->data);
 
+        if (data->skip >= (uint64_t)buffer_size) {
+                data->skip -= buffer_size;
+                return S3StatusOK;
+        }
+
+        buffer += data->skip;
+        buffer_size -= data->skip;
+        data->skip = 0;
+
         size_t wrote = fwrite(buffer, 1, buffer_size, data->file);
-        return ((wrote < (size_t)buffer_size) ? S3StatusAbortedByCallback :
-                                                S3StatusOK);
+        if (wrote < (size_t)buffer_size) {
+                return S3StatusAbortedByCallback;
+        }
+
+        /* readers of the file wait only for the data they read (see
+           progress.h), so the data have to reach the file before they are
+           reported; chunks are large, so the flush costs little */
+        if (fflush(data->file) == EOF) {
+                return S3StatusAbortedByCallback;
+        }
+
+        data->crc = crc32c(data->crc, buffer, wrote);
+        data->received += wrote;
+
+        report_download_progress(wrote);
+
+        return S3StatusOK;
 }
 
 /**
  * @brief s3_upload Uploads file's data to s3 remote storage.
  *
- * @param[in] path      Path to file which data is going to be uploaded.
- * @param[in] object_id Object id of this file in the remote object storage.
+ * @param[in]  path      Path to file which data is going to be uploaded.
+ * @param[in]  object_id Object id of this file in the remote object storage.
+ * @param[out] crc       A CRC32C of the uploaded data.
  *
  * @return  0: file's data has been successfully uploaded to s3 remote storage
  *         -1: error happen during process of upload of file's data
  */
-int s3_upload( int fd, const char *object_id ) {
+int s3_upload( int fd, const char *object_id, uint32_t *crc ) {
         int retries = get_conf()->s3_operation_retries;
         int ret = 0; /* success by default */
         struct s3_put_object_callback_data put_object_data;
@@ -390,6 +502,11 @@ int s3_upload( int fd, const char *object_id ) {
         };
 
         do {
+                /* every attempt sends the data from the beginning */
+                rewind( put_object_data.file );
+                put_object_data.content_length = statbuf.st_size;
+                put_object_data.crc = 0;
+
                 S3_put_object( &g_bucket_context,
                                object_id,
                                put_object_data.content_length,
@@ -408,6 +525,8 @@ int s3_upload( int fd, const char *object_id ) {
                 ret = -1;
         }
 
+        *crc = put_object_data.crc;
+
         if ( fclose( put_object_data.file ) ) {
                 /* this is usually caused by very serious system error */
 
@@ -426,19 +545,120 @@ int s3_upload( int fd, const char *object_id ) {
         return ret;
 }
 
+/**
+ * @brief s3_upload_pack Uploads data of several files to s3 remote storage
+ *                       as a single object.
+ *
+ * @param[in]  fds       File descriptors of files in the order of their data
+ *                       in the object.
+ * @param[in]  sizes     Sizes of the files' data.
+ * @param[in]  count     A number of files.
+ * @param[in]  object_id Object id of the pack in the remote object storage.
+ * @param[out] crcs      CRC32Cs of the files' data; an array of count
+ *                       elements.
+ *
+ * @return  0: the pack has been successfully uploaded to s3 remote storage
+ *         -1: error happen during process of upload of the pack
+ */
+int s3_upload_pack( const int *fds,
+                    const uint64_t *sizes,
+                    size_t count,
+                    const char *object_id,
+                    uint32_t *crcs ) {
+        int retries = get_conf()->s3_operation_retries;
+        struct s3_put_pack_callback_data put_pack_data = {
+                .fds = fds,
+                .sizes = sizes,
+                .count = count,
+                .crcs = crcs,
+        };
+
+        struct s3_cb_data callback_data = {
+                .type = e_s3_cb_put_object,
+                .error_details = { 0 },
+                .data = &put_pack_data,
+        };
+
+        uint64_t content_length = 0;
+        for ( size_t i = 0; i < count; i++ ) {
+                content_length += sizes[i];
+        }
+
+        S3PutObjectHandler put_object_handler = {
+                .responseHandler = g_response_handler,
+                .putObjectDataCallback = &s3_put_pack_data_callback,
+        };
+
+        do {
+                /* every attempt sends the data from the beginning */
+                put_pack_data.index = 0;
+                put_pack_data.pos = 0;
+                memset( crcs, 0, count * sizeof( uint32_t ) );
+
+                S3_put_object( &g_bucket_context,
+                               object_id,
+                               content_length,
+                               NULL,
+                               NULL,
+                               &put_object_handler,
+                               &callback_data );
+        } while( S3_status_is_retryable( callback_data.status ) && --retries );
+
+        /* fail on any error */
+        if ( callback_data.status != S3StatusOK ) {
+                LOG( ERROR,
+                     "[s3_upload_pack] S3_put_object() failed "
+                     "[ error: %s | files: %zu ]",
+                     S3_get_status_name( callback_data.status ),
+                     count );
+                LOG( ERROR, callback_data.error_details );
+                return -1;
+        }
+
+        return 0;
+}
+
 /**
  * @brief s3_download Downloads file's data from s3 remote storage
  *                    to local storage.
  *
- * @param[in] fd File descriptor of file whose data should be downloaded.
+ * @param[in]  fd  File descriptor of file whose data should be downloaded.
+ * @param[out] crc A CRC32C of the downloaded data.
+ *
+ * @return  0: file's data has been successfully downloaded
+ *         -1: error happen during file's data download
+ */
+int s3_download( int fd, const char *object_id, uint32_t *crc ) {
+        /* zero length means the whole object */
+        return s3_download_range( fd, object_id, 0, 0, crc );
+}
+
+/**
+ * @brief s3_download_range Downloads a byte range of an object from s3 remote
+ *                          storage to the beginning of a local file.
+ *
+ * @param[in]  fd        File descriptor of file whose data should be
+ *                       downloaded.
+ * @param[in]  object_id Object id in the remote object storage.
+ * @param[in]  offset    An offset of the range in the object.
+ * @param[in]  length    A length of the range; 0 means up to the object's
+ *                       end.
+ * @param[out] crc       A CRC32C of the downloaded data.
  *
  * @return  0: file's data has been successfully downloaded
  *         -1: error happen during file's data download
  */
-int s3_download( int fd, const char *object_id ) {
+int s3_download_range( int fd,
+                       const char *object_id,
+                       uint64_t offset,
+                       uint64_t length,
+                       uint32_t *crc ) {
         int retries = get_conf()->s3_operation_retries;
         int ret = 0; /* success by default */
-        struct s3_get_object_callback_data get_object_data;
+        struct s3_get_object_callback_data get_object_data = {
+                .received = 0,
+                .crc = 0,
+        };
 
         /* set call back data type */
         struct s3_cb_data callback_data = {
@@ -483,11 +703,14 @@ int s3_download( int fd, const char *object_id ) {
         };
 
         do {
+                /* data written by a failed attempt are kept */
+                get_object_data.skip = get_object_data.received;
+
                 S3_get_object( &g_bucket_context,
                                object_id,
                                NULL,
-                               0,
-                               0,
+                               offset,
+                               length,
                                NULL,
                                &get_object_handler,
                                &callback_data );
@@ -503,6 +726,8 @@ int s3_download( int fd, const char *object_id ) {
                 ret = -1;
         }
 
+        *crc = get_object_data.crc;
+
         if ( fclose( get_object_data.file ) ) {
                 /* this is usually caused by very serious system error */
 
@@ -598,29 +823,38 @@ void s3_disconnect(void) {
 }
 
 /**
- * TODO: write description.
+ * @brief s3_get_object_id_xattr_value Makes an object id of a file being
+ *                                     uploaded (see objid.h).
+ *
+ * @param[in] fd   File descriptor of the file.
+ * @param[in] path Path to the file.
+ *
+ * @return an object id stored in a thread-local buffer
  */
-char *s3_get_object_id_xattr_value(const char *path) {
-        /* TODO: implement this function later using near-perfect hash function
-                 to compress long paths to keys no more then
-                 S3_MAX_KEY_SIZE in length */
-
-        size_t path_len = strlen(path);
-        size_t key_len  = ( path_len > S3_MAX_KEY_SIZE ) ?
-                          S3_MAX_KEY_SIZE : path_len;
-
-        size_t pos = 0;
-        for (; pos < key_len; pos++) {
-                char c = path[key_len - pos - 1];
-                s3_xattr_buf[pos] = ( c == '/' ) ? '-' : c;
+char *s3_get_object_id_xattr_value(int fd, const char *path) {
+        /* a recreated file with the same path and inode number gets
+           a different hash; file systems without inode generations
+           (ENOTTY) rely on the nonce only */
+        long generation = 0;
+        if (ioctl(fd, FS_IOC_GETVERSION, &generation) == -1) {
+                generation = 0;
         }
-        s3_xattr_buf[pos] = '\0';
+
+        /* the buffer is large enough, so it never fails */
+        objid_make(s3_xattr_buf,
+                   S3_XATTR_SIZE,
+                   path,
+                   (uint64_t)generation);
 
         return s3_xattr_buf;
 }
 
 /**
- * TODO: write description.
+ * @brief s3_get_object_id_xattr_size Returns a size of a buffer large enough
+ *                                    for any object id including object ids
+ *                                    of files in packs (see pack.h).
+ *
+ * @return the size in bytes
  */
 size_t s3_get_object_id_xattr_size(void) {
         return S3_XATTR_SIZE;
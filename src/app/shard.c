@@ -0,0 +1,289 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE    200809L    /* needed for futimens(), fstatat() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "shard.h"
+
+/**
+ * @brief shard_hash Calculates a hash of a string (FNV-1a with a finalizer
+ *                   of SplitMix64 to spread bits of short strings).
+ *
+ * @param[in] str A string.
+ *
+ * @return the hash of the string
+ */
+static uint64_t shard_hash(const char *str) {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (; *str != '\0'; str++) {
+                h ^= (unsigned char)*str;
+                h *= 0x100000001b3ULL;
+        }
+
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+
+        return h;
+}
+
+/**
+ * @brief shard_weight Calculates a weight of a node for a directory.
+ *
+ * @param[in] node A hash of the node's name.
+ * @param[in] path A hash of the directory's path.
+ *
+ * @return the weight; the node with the highest weight owns the directory
+ */
+static inline uint64_t shard_weight(uint64_t node, uint64_t path) {
+        uint64_t x = node ^ path;
+
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+
+        return x;
+}
+
+/**
+ * @brief shard_now_ns Returns the current monotonic time.
+ *
+ * @return the time in nanoseconds
+ */
+static uint64_t shard_now_ns(void) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief cmp_u64 Compares two hashes for qsort(3).
+ *
+ * @param[in] a A pointer to the first hash.
+ * @param[in] b A pointer to the second hash.
+ *
+ * @return a negative, zero or positive value as a is less than, equal to or
+ *         greater than b
+ */
+static int cmp_u64(const void *a, const void *b) {
+        uint64_t x = *(const uint64_t *)a;
+        uint64_t y = *(const uint64_t *)b;
+
+        return (x > y) - (x < y);
+}
+
+/**
+ * Create a lease of a node.
+ * See shard.h for complete description.
+ */
+int shard_join(shard_t *shard,
+               const char *dir,
+               const char *name,
+               time_t lease_sec) {
+        if (shard == NULL || dir == NULL || name == NULL || lease_sec <= 0 ||
+            name[0] == '\0' || name[0] == '.' || strchr(name, '/') != NULL ||
+            strlen(name) >= SHARD_NAME_MAX ||
+            strlen(dir) >= sizeof(shard->dir)) {
+                return -1;
+        }
+
+        if (mkdir(dir, S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH) == -1 &&
+            errno != EEXIST) {
+                return -1;
+        }
+
+        char path[sizeof(shard->dir) + SHARD_NAME_MAX + 1];
+        sprintf(path, "%s/%s", dir, name);
+
+        shard->lease_fd = open(path,
+                               O_WRONLY | O_CREAT | O_CLOEXEC,
+                               S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        if (shard->lease_fd == -1) {
+                return -1;
+        }
+
+        if (futimens(shard->lease_fd, NULL) == -1) {
+                close(shard->lease_fd);
+                return -1;
+        }
+
+        strcpy(shard->dir, dir);
+        strcpy(shard->name, name);
+        shard->lease_sec = lease_sec;
+        shard->next_renew_ns = shard_now_ns() +
+                               (uint64_t)lease_sec * 1000000000ULL / 2;
+
+        /* until the first refresh the node considers itself alone */
+        shard->self = shard_hash(name);
+        shard->nodes[0] = shard->self;
+        shard->nodes_count = 1;
+
+        return 0;
+}
+
+/**
+ * Remove a lease of a node.
+ * See shard.h for complete description.
+ */
+void shard_leave(shard_t *shard) {
+        char path[sizeof(shard->dir) + SHARD_NAME_MAX + 1];
+        sprintf(path, "%s/%s", shard->dir, shard->name);
+
+        unlink(path);
+        close(shard->lease_fd);
+}
+
+/**
+ * Renew a lease of a node if it is due.
+ * See shard.h for complete description.
+ */
+void shard_renew(shard_t *shard) {
+        uint64_t now = shard_now_ns();
+        uint64_t next = __atomic_load_n(&shard->next_renew_ns,
+                                        __ATOMIC_RELAXED);
+
+        /* only one of the threads renews the lease */
+        if (now >= next &&
+            __atomic_compare_exchange_n(&shard->next_renew_ns,
+                                        &next,
+                                        now + (uint64_t)shard->lease_sec *
+                                              1000000000ULL / 2,
+                                        0,
+                                        __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED)) {
+                futimens(shard->lease_fd, NULL);
+        }
+}
+
+/**
+ * Renew a lease of a node and reread a set of live nodes.
+ * See shard.h for complete description.
+ */
+int shard_refresh(shard_t *shard) {
+        /* the renewed lease gives the current time of the shared file
+           system, which all leases are compared with */
+        struct stat sb;
+        if (futimens(shard->lease_fd, NULL) == -1 ||
+            fstat(shard->lease_fd, &sb) == -1) {
+                return -1;
+        }
+
+        time_t now = sb.st_mtime;
+        shard->next_renew_ns = shard_now_ns() +
+                               (uint64_t)shard->lease_sec * 1000000000ULL / 2;
+
+        DIR *dir = opendir(shard->dir);
+        if (dir == NULL) {
+                return -1;
+        }
+
+        uint64_t nodes[SHARD_MAX_NODES];
+        size_t nodes_count = 0;
+        int self_seen = 0;
+
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+                if (entry->d_name[0] == '.') {
+                        continue;
+                }
+
+                if (fstatat(dirfd(dir),
+                            entry->d_name,
+                            &sb,
+                            AT_SYMLINK_NOFOLLOW) == -1 ||
+                    !S_ISREG(sb.st_mode)) {
+                        continue;
+                }
+
+                time_t age = now - sb.st_mtime;
+                if (age > shard->lease_sec * SHARD_REAP_FACTOR) {
+                        /* a node which has gone long ago; the removal may
+                           race with another node, which is harmless */
+                        unlinkat(dirfd(dir), entry->d_name, 0);
+                        continue;
+                }
+
+                if (age > shard->lease_sec ||
+                    nodes_count == SHARD_MAX_NODES) {
+                        continue;
+                }
+
+                uint64_t node = shard_hash(entry->d_name);
+                self_seen |= (node == shard->self);
+                nodes[nodes_count++] = node;
+        }
+
+        closedir(dir);
+
+        /* the own lease may be missing if it has been removed by mistake */
+        if (!self_seen) {
+                if (nodes_count == SHARD_MAX_NODES) {
+                        nodes_count--;
+                }
+                nodes[nodes_count++] = shard->self;
+        }
+
+        qsort(nodes, nodes_count, sizeof(uint64_t), cmp_u64);
+
+        int changed = (nodes_count != shard->nodes_count) ||
+                      (memcmp(nodes,
+                              shard->nodes,
+                              nodes_count * sizeof(uint64_t)) != 0);
+
+        memcpy(shard->nodes, nodes, nodes_count * sizeof(uint64_t));
+        shard->nodes_count = nodes_count;
+
+        return changed;
+}
+
+/**
+ * Check whether a node owns a directory.
+ * See shard.h for complete description.
+ */
+int shard_owns(const shard_t *shard, const char *path) {
+        if (shard->nodes_count <= 1) {
+                return 1;
+        }
+
+        uint64_t hash = shard_hash(path);
+        uint64_t owner = shard->nodes[0];
+        uint64_t best = shard_weight(owner, hash);
+
+        for (size_t i = 1; i < shard->nodes_count; i++) {
+                uint64_t weight = shard_weight(shard->nodes[i], hash);
+                if (weight > best) {
+                        best = weight;
+                        owner = shard->nodes[i];
+                }
+        }
+
+        return owner == shard->self;
+}
@@ -0,0 +1,526 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE    /* needed for fstatat() and DT_* constants */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>    /* defines SYS_getdents64 */
+#include <linux/limits.h>
+
+#include "walk.h"
+#include "pace.h"
+
+/* bounds of an idle thread's sleep between attempts to steal a directory */
+#define WALK_IDLE_MIN_NS    50000L
+#define WALK_IDLE_MAX_NS    5000000L
+
+/* an initial capacity of a deque */
+#define WALK_DEQUE_INIT_CAP    64
+
+/* a size of a buffer for directory entries; a large buffer lets
+   getdents64(2) return a typical directory in a single call */
+#define WALK_DENTS_BUF_SIZE    (256 * 1024)
+
+/* a directory entry returned by getdents64(2) (see getdents(2)) */
+struct walk_dirent64 {
+        ino64_t        d_ino;
+        off64_t        d_off;
+        unsigned short d_reclen;
+        unsigned char  d_type;
+        char           d_name[];
+};
+
+/* a deque of directories' paths; the owner works with the bottom (end),
+   thieves work with the top (beg) */
+typedef struct {
+        pthread_mutex_t mutex;
+        char **items;
+        size_t beg;
+        size_t end;
+        size_t cap;
+} walk_deque_t;
+
+/* a state of a single walk shared by all threads */
+typedef struct {
+        walk_deque_t *deques;
+        size_t threads;
+
+        /* device of the root directory; the walk does not leave it */
+        dev_t dev;
+
+        walk_dir_cb_t dir_cb;
+        walk_cb_t cb;
+        void *arg;
+
+        /* a pacer slowing the walk down or NULL */
+        pace_t *pace;
+
+        /* a number of directories which are queued or being read */
+        size_t pending;
+
+        /* a non-zero value returned by the callback */
+        int stop;
+} walk_t;
+
+/* an argument of a walking thread */
+typedef struct {
+        walk_t *walk;
+        size_t ind;
+} walk_worker_t;
+
+/**
+ * @brief walk_deque_push Pushes a directory to the bottom of a deque.
+ *
+ * @param[in,out] deque A deque.
+ * @param[in]     path  A path of a directory; the deque takes ownership.
+ *
+ * @return  0: the directory has been pushed
+ *         -1: not enough memory
+ */
+static int walk_deque_push(walk_deque_t *deque, char *path) {
+        pthread_mutex_lock(&deque->mutex);
+
+        if (deque->end == deque->cap) {
+                if (deque->beg > 0) {
+                        /* reuse space released by thieves */
+                        memmove(deque->items,
+                                deque->items + deque->beg,
+                                (deque->end - deque->beg) * sizeof(char *));
+                        deque->end -= deque->beg;
+                        deque->beg = 0;
+                } else {
+                        size_t cap = deque->cap ? 2 * deque->cap :
+                                                  WALK_DEQUE_INIT_CAP;
+                        char **items = realloc(deque->items,
+                                               cap * sizeof(char *));
+                        if (items == NULL) {
+                                pthread_mutex_unlock(&deque->mutex);
+                                return -1;
+                        }
+
+                        deque->items = items;
+                        deque->cap = cap;
+                }
+        }
+
+        deque->items[deque->end++] = path;
+
+        pthread_mutex_unlock(&deque->mutex);
+
+        return 0;
+}
+
+/**
+ * @brief walk_deque_take Takes a directory from a deque.
+ *
+ * @param[in,out] deque  A deque.
+ * @param[in]     bottom Non-zero for the owner, zero for a thief.
+ *
+ * @return a path of a directory or NULL if the deque is empty
+ */
+static char *walk_deque_take(walk_deque_t *deque, int bottom) {
+        char *path = NULL;
+
+        pthread_mutex_lock(&deque->mutex);
+
+        if (deque->end > deque->beg) {
+                path = bottom ? deque->items[--deque->end] :
+                                deque->items[deque->beg++];
+
+                if (deque->beg == deque->end) {
+                        deque->beg = deque->end = 0;
+                }
+        }
+
+        pthread_mutex_unlock(&deque->mutex);
+
+        return path;
+}
+
+/**
+ * @brief walk_visit Invokes the walk's callback and remembers its
+ *                   non-zero result.
+ *
+ * @param[in,out] walk A state of the walk.
+ * @param[in]     path A path of the visited file.
+ * @param[in]     ino  An inode number of the visited file.
+ * @param[in]     sb   An lstat(2) information of the visited file or NULL.
+ */
+static void walk_visit(walk_t *walk,
+                       const char *path,
+                       ino_t ino,
+                       const struct stat *sb) {
+        int ret = walk->cb(path, ino, sb, walk->arg);
+        if (ret != 0) {
+                int expected = 0;
+                __atomic_compare_exchange_n(&walk->stop,
+                                            &expected,
+                                            ret,
+                                            0,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED);
+        }
+}
+
+/**
+ * @brief walk_queue_dir Queues a subdirectory into the deque of the calling
+ *                       thread.
+ *
+ * @param[in,out] walk  A state of the walk.
+ * @param[in,out] deque A deque of the calling thread.
+ * @param[in]     path  A path of the subdirectory.
+ */
+static void walk_queue_dir(walk_t *walk,
+                           walk_deque_t *deque,
+                           const char *path) {
+        char *subdir = strdup(path);
+        if (subdir == NULL) {
+                return;
+        }
+
+        /* count the directory before it becomes visible
+           to thieves, so the walk can not finish early */
+        __atomic_add_fetch(&walk->pending, 1, __ATOMIC_SEQ_CST);
+
+        if (walk_deque_push(deque, subdir) == -1) {
+                __atomic_sub_fetch(&walk->pending, 1, __ATOMIC_SEQ_CST);
+                free(subdir);
+        }
+}
+
+/**
+ * @brief walk_dir Reads a directory with getdents64(2), visits its regular
+ *                 files and queues its subdirectories into the deque of the
+ *                 calling thread.
+ *
+ * @note An entry's type is taken from d_type, so subdirectories and
+ *       non-regular files are not stat'ed; only regular files (which need
+ *       stat information for the callback) and entries of DT_UNKNOWN type
+ *       (reported by some file systems) are stat'ed. Regular files are not
+ *       stat'ed either if the directory callback asks so.
+ *
+ * @param[in,out] walk  A state of the walk.
+ * @param[in,out] deque A deque of the calling thread.
+ * @param[in]     buf   A buffer of WALK_DENTS_BUF_SIZE bytes for entries.
+ * @param[in]     dir   A path of the directory.
+ *
+ * @return a number of metadata operations issued to the file system
+ */
+static size_t walk_dir(walk_t *walk,
+                       walk_deque_t *deque,
+                       char *buf,
+                       const char *dir) {
+        size_t ops = 1;
+
+        int fd = open(dir, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd == -1) {
+                /* directory can be removed or unreadable; just skip it */
+                return ops;
+        }
+
+        struct stat sb;
+
+        /* subdirectories are queued without stat, hence a mount point of
+           another file system is detected only here, once per directory */
+        ops++;
+        if (fstat(fd, &sb) == -1 || sb.st_dev != walk->dev) {
+                close(fd);
+                return ops;
+        }
+
+        /* the directory callback may know that stat information of the
+           directory's files is not needed (e.g. the directory is unchanged)
+           or that its files are not needed at all */
+        int verdict = (walk->dir_cb != NULL) ?
+                      walk->dir_cb(dir, &sb, walk->arg) : WALK_STAT_FILES;
+        int skip_stat  = (verdict == WALK_SKIP_STAT);
+        int skip_files = (verdict == WALK_SKIP_FILES);
+
+        char path[PATH_MAX];
+        size_t dir_len = strlen(dir);
+        if (dir_len + 2 > PATH_MAX) {
+                close(fd);
+                return ops;
+        }
+
+        memcpy(path, dir, dir_len);
+        path[dir_len++] = '/';
+
+        /* each getdents64(2) call, including the last one returning nothing,
+           is a metadata operation */
+        long nread;
+        while (ops++, (nread = syscall(SYS_getdents64,
+                                       fd,
+                                       buf,
+                                       WALK_DENTS_BUF_SIZE)) > 0) {
+                for (long off = 0; off < nread;) {
+                        struct walk_dirent64 *entry =
+                                (struct walk_dirent64 *)(buf + off);
+                        off += entry->d_reclen;
+
+                        if (__atomic_load_n(&walk->stop, __ATOMIC_RELAXED)) {
+                                close(fd);
+                                return ops;
+                        }
+
+                        unsigned char type = entry->d_type;
+                        if (type != DT_REG && type != DT_DIR &&
+                            type != DT_UNKNOWN) {
+                                /* symbolic links, devices, pipes, sockets */
+                                continue;
+                        }
+
+                        if (strcmp(entry->d_name, ".") == 0 ||
+                            strcmp(entry->d_name, "..") == 0) {
+                                continue;
+                        }
+
+                        size_t name_len = strlen(entry->d_name);
+                        if (dir_len + name_len + 1 > PATH_MAX) {
+                                continue;
+                        }
+
+                        memcpy(path + dir_len, entry->d_name, name_len + 1);
+
+                        if (type == DT_REG && skip_files) {
+                                continue;
+                        }
+
+                        if (type == DT_REG && skip_stat) {
+                                walk_visit(walk, path, entry->d_ino, NULL);
+                                continue;
+                        }
+
+                        if (type != DT_DIR) {
+                                /* relative to the directory to save
+                                   a path lookup */
+                                ops++;
+                                if (fstatat(fd,
+                                            entry->d_name,
+                                            &sb,
+                                            AT_SYMLINK_NOFOLLOW) == -1 ||
+                                    sb.st_dev != walk->dev) {
+                                        continue;
+                                }
+
+                                if (S_ISDIR(sb.st_mode)) {
+                                        type = DT_DIR;
+                                } else if (!S_ISREG(sb.st_mode) ||
+                                           skip_files) {
+                                        continue;
+                                }
+                        }
+
+                        if (type == DT_DIR) {
+                                walk_queue_dir(walk, deque, path);
+                        } else {
+                                walk_visit(walk, path, sb.st_ino, &sb);
+                        }
+                }
+        }
+
+        close(fd);
+
+        return ops;
+}
+
+/**
+ * @brief walk_now_ns Returns the current monotonic time.
+ *
+ * @return the time in nanoseconds
+ */
+static uint64_t walk_now_ns(void) {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief walk_routine A routine of a walking thread.
+ *
+ * @param[in] args A pointer to walk_worker_t.
+ *
+ * @return NULL
+ */
+static void *walk_routine(void *args) {
+        walk_worker_t *worker = args;
+        walk_t *walk = worker->walk;
+        walk_deque_t *own = &walk->deques[worker->ind];
+        long idle_ns = WALK_IDLE_MIN_NS;
+
+        char *buf = malloc(WALK_DENTS_BUF_SIZE);
+        if (buf == NULL) {
+                /* the walk can not be completed; stop other threads */
+                int expected = 0;
+                __atomic_compare_exchange_n(&walk->stop,
+                                            &expected,
+                                            -1,
+                                            0,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED);
+                return NULL;
+        }
+
+        for (;;) {
+                char *dir = walk_deque_take(own, 1);
+
+                for (size_t i = 1; dir == NULL && i < walk->threads; i++) {
+                        size_t victim = (worker->ind + i) % walk->threads;
+                        dir = walk_deque_take(&walk->deques[victim], 0);
+                }
+
+                if (dir == NULL) {
+                        if (__atomic_load_n(&walk->pending,
+                                            __ATOMIC_SEQ_CST) == 0 ||
+                            __atomic_load_n(&walk->stop, __ATOMIC_RELAXED)) {
+                                break;
+                        }
+
+                        /* other threads are reading directories which may
+                           contain subdirectories to be stolen */
+                        struct timespec ts = { 0, idle_ns };
+                        nanosleep(&ts, NULL);
+
+                        idle_ns = (2 * idle_ns < WALK_IDLE_MAX_NS) ?
+                                  2 * idle_ns : WALK_IDLE_MAX_NS;
+                        continue;
+                }
+
+                idle_ns = WALK_IDLE_MIN_NS;
+
+                if (!__atomic_load_n(&walk->stop, __ATOMIC_RELAXED)) {
+                        uint64_t beg_ns = walk_now_ns();
+                        size_t ops = walk_dir(walk, own, buf, dir);
+
+                        /* callbacks are accounted too, because they also
+                           issue metadata operations */
+                        if (walk->pace != NULL) {
+                                pace_dir(walk->pace,
+                                         (walk_now_ns() - beg_ns) / ops);
+                        }
+                }
+
+                free(dir);
+                __atomic_sub_fetch(&walk->pending, 1, __ATOMIC_SEQ_CST);
+        }
+
+        free(buf);
+
+        return NULL;
+}
+
+/**
+ * Walk a file tree.
+ * See walk.h for complete description.
+ */
+int walk_tree(const char *root,
+              size_t threads,
+              walk_dir_cb_t dir_cb,
+              walk_cb_t cb,
+              void *arg,
+              pace_t *pace) {
+        if (root == NULL || cb == NULL || threads == 0) {
+                return -1;
+        }
+
+        struct stat sb;
+        if (lstat(root, &sb) == -1 || !S_ISDIR(sb.st_mode)) {
+                return -1;
+        }
+
+        walk_t walk = {
+                .threads = threads,
+                .dev     = sb.st_dev,
+                .dir_cb  = dir_cb,
+                .cb      = cb,
+                .arg     = arg,
+                .pace    = pace,
+                .pending = 1,
+                .stop    = 0,
+        };
+
+        walk.deques = calloc(threads, sizeof(walk_deque_t));
+        pthread_t *tids = calloc(threads, sizeof(pthread_t));
+        walk_worker_t *workers = calloc(threads, sizeof(walk_worker_t));
+        char *root_dup = strdup(root);
+        if (walk.deques == NULL || tids == NULL ||
+            workers == NULL || root_dup == NULL) {
+                free(walk.deques);
+                free(tids);
+                free(workers);
+                free(root_dup);
+                return -1;
+        }
+
+        for (size_t i = 0; i < threads; i++) {
+                pthread_mutex_init(&walk.deques[i].mutex, NULL);
+                workers[i] = (walk_worker_t){ &walk, i };
+        }
+
+        int ret = 0;
+        if (walk_deque_push(&walk.deques[0], root_dup) == -1) {
+                free(root_dup);
+                ret = -1;
+        } else {
+                /* the calling thread is the worker 0; if some threads fail
+                   to start, the others will do their work */
+                size_t started = 1;
+                for (; started < threads; started++) {
+                        if (pthread_create(&tids[started],
+                                           NULL,
+                                           walk_routine,
+                                           &workers[started]) != 0) {
+                                break;
+                        }
+                }
+
+                walk_routine(&workers[0]);
+
+                for (size_t i = 1; i < started; i++) {
+                        pthread_join(tids[i], NULL);
+                }
+
+                ret = walk.stop;
+        }
+
+        for (size_t i = 0; i < threads; i++) {
+                /* directories left after the walk has been stopped */
+                char *dir;
+                while ((dir = walk_deque_take(&walk.deques[i], 1)) != NULL) {
+                        free(dir);
+                }
+
+                free(walk.deques[i].items);
+                pthread_mutex_destroy(&walk.deques[i].mutex);
+        }
+
+        free(walk.deques);
+        free(tids);
+        free(workers);
+
+        return ret;
+}
@@ -0,0 +1,426 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*******************************************************************************
+* QUEUE BENCHMARK                                                              *
+* ---------------                                                              *
+*                                                                              *
+* Measures throughput and enqueue-to-dequeue latency of queue_t for different  *
+* numbers of suppliers and consumers, element sizes and queue modes (private   *
+* queue shared by threads vs. shm queue shared by threads or processes).       *
+*                                                                              *
+* Latency is measured with a timestamp embedded into an element's data, so     *
+* the benchmark does not depend on the queue's internals and its results can   *
+* be compared between different queue implementations. Results are printed    *
+* to stdout in CSV format, one line per configuration.                         *
+*******************************************************************************/
+
+#define _GNU_SOURCE /* needed for MAP_ANONYMOUS */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "queue.h"
+
+#define BENCH_SHM_OBJ          "/cloudtiering-bench-queue"
+
+#define DEFAULT_ELEMS          200000
+#define DEFAULT_QUEUE_SIZE     1024
+#define DEFAULT_MAX_WORKERS    4
+
+#define MAX_WORKERS            64
+#define LATENCY_BUCKETS        32
+
+/* an element of this size tells a consumer to stop */
+#define STOP_ELEM_SIZE         1
+
+static const size_t elem_sizes[] = { 8, 64, 256, 4096 };
+
+enum bench_mode {
+        e_private_threads,
+        e_pshared_threads,
+        e_pshared_processes,
+};
+
+static const char *bench_mode_str[] = {
+        "private,threads",
+        "pshared,threads",
+        "pshared,processes",
+};
+
+/* consumer's results; placed into a memory shared with forked processes */
+typedef struct {
+        uint64_t pops;
+        uint64_t latency_sum_ns;
+        uint64_t latency_max_ns;
+        uint64_t latency_hist[LATENCY_BUCKETS];
+} consumer_res_t;
+
+/* a state of a single benchmark run shared by all its workers */
+typedef struct {
+        queue_t           *queue;
+        size_t             elem_size;
+        size_t             elems_per_supplier;
+        pthread_barrier_t  start_barrier;
+        consumer_res_t     res[MAX_WORKERS];
+} bench_t;
+
+typedef struct {
+        bench_t *bench;
+        int      ind;
+} worker_arg_t;
+
+static uint64_t now_ns(void) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static size_t latency_bucket(uint64_t latency_ns) {
+        uint64_t us = latency_ns / 1000;
+        if (us == 0) {
+                return 0;
+        }
+
+        size_t bucket = 64 - __builtin_clzll(us);
+
+        return (bucket < LATENCY_BUCKETS) ? bucket : LATENCY_BUCKETS - 1;
+}
+
+/* returns an upper bound in microseconds of a given percentile */
+static uint64_t latency_percentile_us(const uint64_t *hist,
+                                      uint64_t total,
+                                      double percentile) {
+        uint64_t threshold = (uint64_t)(total * percentile);
+        uint64_t acc = 0;
+
+        for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+                acc += hist[i];
+                if (acc > threshold) {
+                        return 1ULL << i;
+                }
+        }
+
+        return 1ULL << (LATENCY_BUCKETS - 1);
+}
+
+static void *supplier_routine(void *args) {
+        worker_arg_t *arg = args;
+        bench_t *bench = arg->bench;
+        char data[bench->elem_size];
+
+        memset(data, 0, bench->elem_size);
+
+        pthread_barrier_wait(&bench->start_barrier);
+
+        for (size_t i = 0; i < bench->elems_per_supplier; i++) {
+                uint64_t ts = now_ns();
+                memcpy(data, &ts, sizeof(ts));
+
+                queue_push(bench->queue, data, bench->elem_size);
+        }
+
+        return NULL;
+}
+
+static void *consumer_routine(void *args) {
+        worker_arg_t *arg = args;
+        bench_t *bench = arg->bench;
+        consumer_res_t *res = &bench->res[arg->ind];
+        char data[bench->elem_size];
+        size_t data_size;
+
+        memset(res, 0, sizeof(consumer_res_t));
+
+        pthread_barrier_wait(&bench->start_barrier);
+
+        for (;;) {
+                data_size = bench->elem_size;
+                if (queue_pop(bench->queue, data, &data_size)) {
+                        continue;
+                }
+
+                if (data_size == STOP_ELEM_SIZE) {
+                        break;
+                }
+
+                uint64_t ts;
+                memcpy(&ts, data, sizeof(ts));
+
+                uint64_t latency = now_ns() - ts;
+                res->pops++;
+                res->latency_sum_ns += latency;
+                if (latency > res->latency_max_ns) {
+                        res->latency_max_ns = latency;
+                }
+                res->latency_hist[latency_bucket(latency)]++;
+        }
+
+        return NULL;
+}
+
+static int start_worker(enum bench_mode mode,
+                        void *(*routine)(void *),
+                        worker_arg_t *arg,
+                        pthread_t *thread,
+                        pid_t *pid) {
+        if (mode != e_pshared_processes) {
+                return pthread_create(thread, NULL, routine, arg) ? -1 : 0;
+        }
+
+        *pid = fork();
+        if (*pid == 0) {
+                routine(arg);
+                _exit(EXIT_SUCCESS);
+        }
+
+        return (*pid == -1) ? -1 : 0;
+}
+
+static void wait_worker(enum bench_mode mode, pthread_t thread, pid_t pid) {
+        if (mode != e_pshared_processes) {
+                pthread_join(thread, NULL);
+        } else {
+                waitpid(pid, NULL, 0);
+        }
+}
+
+static int run_bench(enum bench_mode mode,
+                     int suppliers,
+                     int consumers,
+                     size_t elem_size,
+                     size_t elems,
+                     size_t queue_size) {
+        pthread_t    sup_threads[MAX_WORKERS], con_threads[MAX_WORKERS];
+        pid_t        sup_pids[MAX_WORKERS], con_pids[MAX_WORKERS];
+        worker_arg_t sup_args[MAX_WORKERS], con_args[MAX_WORKERS];
+        int          sup_started = 0, con_started = 0;
+        int          ret = -1;
+
+        /* a benchmark state should be visible by forked processes */
+        bench_t *bench = mmap(NULL,
+                              sizeof(bench_t),
+                              PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_ANONYMOUS,
+                              -1,
+                              0);
+        if (bench == MAP_FAILED) {
+                perror("mmap");
+                return -1;
+        }
+
+        const char *shm_obj = (mode == e_private_threads) ? NULL :
+                                                            BENCH_SHM_OBJ;
+        if (shm_obj != NULL) {
+                /* a leftover of an interrupted run can have another geometry */
+                shm_unlink(shm_obj);
+        }
+
+        if (queue_init(&bench->queue, queue_size, elem_size, shm_obj)) {
+                fprintf(stderr, "failed to initialize a queue\n");
+                munmap(bench, sizeof(bench_t));
+                return -1;
+        }
+
+        bench->elem_size          = elem_size;
+        bench->elems_per_supplier = elems / suppliers;
+
+        pthread_barrierattr_t attr;
+        pthread_barrierattr_init(&attr);
+        pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_barrier_init(&bench->start_barrier,
+                             &attr,
+                             suppliers + consumers + 1);
+        pthread_barrierattr_destroy(&attr);
+
+        for (; con_started < consumers; con_started++) {
+                con_args[con_started] = (worker_arg_t){ bench, con_started };
+                if (start_worker(mode,
+                                 consumer_routine,
+                                 &con_args[con_started],
+                                 &con_threads[con_started],
+                                 &con_pids[con_started])) {
+                        fprintf(stderr, "failed to start a consumer\n");
+                        goto cleanup;
+                }
+        }
+
+        for (; sup_started < suppliers; sup_started++) {
+                sup_args[sup_started] = (worker_arg_t){ bench, sup_started };
+                if (start_worker(mode,
+                                 supplier_routine,
+                                 &sup_args[sup_started],
+                                 &sup_threads[sup_started],
+                                 &sup_pids[sup_started])) {
+                        fprintf(stderr, "failed to start a supplier\n");
+                        goto cleanup;
+                }
+        }
+
+        pthread_barrier_wait(&bench->start_barrier);
+        uint64_t start = now_ns();
+
+        for (int i = 0; i < sup_started; i++) {
+                wait_worker(mode, sup_threads[i], sup_pids[i]);
+        }
+        sup_started = 0;
+
+        /* every consumer is stopped by its own stop element */
+        for (int i = 0; i < consumers; i++) {
+                char stop = 0;
+                queue_push(bench->queue, &stop, STOP_ELEM_SIZE);
+        }
+
+        for (int i = 0; i < con_started; i++) {
+                wait_worker(mode, con_threads[i], con_pids[i]);
+        }
+        con_started = 0;
+
+        uint64_t elapsed = now_ns() - start;
+
+        consumer_res_t total;
+        memset(&total, 0, sizeof(total));
+        for (int i = 0; i < consumers; i++) {
+                total.pops           += bench->res[i].pops;
+                total.latency_sum_ns += bench->res[i].latency_sum_ns;
+                if (bench->res[i].latency_max_ns > total.latency_max_ns) {
+                        total.latency_max_ns = bench->res[i].latency_max_ns;
+                }
+                for (int j = 0; j < LATENCY_BUCKETS; j++) {
+                        total.latency_hist[j] += bench->res[i].latency_hist[j];
+                }
+        }
+
+        printf("%s,%d,%d,%zu,%zu,%" PRIu64 ",%" PRIu64 ",%.0f,%" PRIu64
+               ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+               bench_mode_str[mode],
+               suppliers,
+               consumers,
+               elem_size,
+               queue_size,
+               total.pops,
+               elapsed,
+               total.pops * 1e9 / (elapsed ? elapsed : 1),
+               total.pops ? total.latency_sum_ns / total.pops : 0,
+               latency_percentile_us(total.latency_hist, total.pops, 0.5),
+               latency_percentile_us(total.latency_hist, total.pops, 0.99),
+               total.latency_max_ns);
+        fflush(stdout);
+
+        ret = 0;
+
+    cleanup:
+        if (ret == -1) {
+                /* workers blocked on the barrier can not be released; threads
+                   die with the process, forked processes should be killed */
+                if (mode == e_pshared_processes) {
+                        for (int i = 0; i < sup_started; i++) {
+                                kill(sup_pids[i], SIGKILL);
+                        }
+                        for (int i = 0; i < con_started; i++) {
+                                kill(con_pids[i], SIGKILL);
+                        }
+                }
+
+                return -1;
+        }
+
+        pthread_barrier_destroy(&bench->start_barrier);
+        queue_destroy(bench->queue);
+        munmap(bench, sizeof(bench_t));
+
+        return 0;
+}
+
+static void usage(const char *name) {
+        fprintf(stderr,
+                "Usage: %s [-n elements] [-p max_suppliers] "
+                "[-c max_consumers] [-q queue_size]\n",
+                name);
+}
+
+int main(int argc, char *argv[]) {
+        size_t elems         = DEFAULT_ELEMS;
+        size_t queue_size    = DEFAULT_QUEUE_SIZE;
+        int    max_suppliers = DEFAULT_MAX_WORKERS;
+        int    max_consumers = DEFAULT_MAX_WORKERS;
+        int    opt;
+
+        while ((opt = getopt(argc, argv, "n:p:c:q:")) != -1) {
+                switch (opt) {
+                case 'n':
+                        elems = strtoul(optarg, NULL, 10);
+                        break;
+                case 'p':
+                        max_suppliers = atoi(optarg);
+                        break;
+                case 'c':
+                        max_consumers = atoi(optarg);
+                        break;
+                case 'q':
+                        queue_size = strtoul(optarg, NULL, 10);
+                        break;
+                default:
+                        usage(argv[0]);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        if (elems == 0 || queue_size == 0 ||
+            max_suppliers < 1 || max_suppliers > MAX_WORKERS ||
+            max_consumers < 1 || max_consumers > MAX_WORKERS) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+
+        printf("mode,workers,suppliers,consumers,elem_size,queue_size,"
+               "elems,elapsed_ns,ops_per_sec,lat_avg_ns,lat_p50_us,"
+               "lat_p99_us,lat_max_ns\n");
+
+        for (int mode = e_private_threads;
+             mode <= e_pshared_processes;
+             mode++) {
+                for (int sup = 1; sup <= max_suppliers; sup *= 2) {
+                        for (int con = 1; con <= max_consumers; con *= 2) {
+                                for (size_t i = 0;
+                                     i < sizeof(elem_sizes) / sizeof(size_t);
+                                     i++) {
+                                        if (run_bench(mode,
+                                                      sup,
+                                                      con,
+                                                      elem_sizes[i],
+                                                      elems,
+                                                      queue_size)) {
+                                                return EXIT_FAILURE;
+                                        }
+                                }
+                        }
+                }
+        }
+
+        return EXIT_SUCCESS;
+}
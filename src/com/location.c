@@ -0,0 +1,321 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE    200112L    /* needed for ftruncate(), fchmod() */
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "location.h"
+
+/* "CTLC" in ASCII; identifies a completely initialized table */
+#define LOCATION_MAGIC      0x43544c43
+
+/* version of the table layout; bump on every incompatible change */
+#define LOCATION_VERSION    1
+
+/* slots start at this offset from the header; keeps them cache aligned */
+#define LOCATION_SLOTS_OFFSET    64
+
+/**
+ * @brief location_slots Returns a pointer to the first slot of a table.
+ *
+ * @param[in] loc A table.
+ *
+ * @return a pointer to the first slot
+ */
+static inline location_slot_t *location_slots(const location_t *loc) {
+        return (location_slot_t *)((char *)loc + LOCATION_SLOTS_OFFSET);
+}
+
+/**
+ * @brief location_bucket Calculates an index of the first slot an entry may
+ *                        occupy.
+ *
+ * @param[in] loc A table.
+ * @param[in] dev A device of a file.
+ * @param[in] ino An inode number of the file.
+ *
+ * @return the index of the first slot of the entry's bucket
+ */
+static inline uint64_t location_bucket(const location_t *loc,
+                                       uint64_t dev,
+                                       uint64_t ino) {
+        /* a finalizer of MurmurHash3 */
+        uint64_t h = ino ^ (dev * 0x9e3779b97f4a7c15ULL);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+
+        return h & (loc->capacity - 1) & ~(uint64_t)(LOCATION_WAYS - 1);
+}
+
+/**
+ * @brief location_is_valid Checks a header of a mapped table.
+ *
+ * @param[in] loc  A table.
+ * @param[in] size A size of the mapping.
+ *
+ * @return 1 if the table is valid, 0 otherwise
+ */
+static int location_is_valid(const location_t *loc, size_t size) {
+        return size >= LOCATION_SLOTS_OFFSET &&
+               __atomic_load_n(&loc->magic, __ATOMIC_ACQUIRE) ==
+               LOCATION_MAGIC &&
+               loc->version == LOCATION_VERSION &&
+               loc->capacity >= LOCATION_WAYS &&
+               (loc->capacity & (loc->capacity - 1)) == 0 &&
+               loc->total_size == size &&
+               loc->total_size == LOCATION_SLOTS_OFFSET +
+                                  loc->capacity * sizeof(location_slot_t);
+}
+
+/**
+ * Create a table in a shared memory.
+ * See location.h for complete description.
+ */
+int location_create(location_t **loc_p, const char *shm_obj, size_t capacity) {
+        if (loc_p == NULL || shm_obj == NULL || capacity == 0) {
+                return -1;
+        }
+
+        uint64_t slots = LOCATION_WAYS;
+        while (slots < capacity) {
+                slots <<= 1;
+        }
+
+        size_t total_size = LOCATION_SLOTS_OFFSET +
+                            slots * sizeof(location_slot_t);
+
+        int fd = shm_open(shm_obj, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+        if (fd == -1) {
+                return -1;
+        }
+
+        struct stat sb;
+        if (fstat(fd, &sb) == -1) {
+                close(fd);
+                return -1;
+        }
+
+        if (sb.st_size != 0 && (size_t)sb.st_size != total_size) {
+                /* readers may still map the old table; shrinking it would
+                   kill them with SIGBUS, so a new object replaces it */
+                close(fd);
+                shm_unlink(shm_obj);
+
+                fd = shm_open(shm_obj, O_RDWR | O_CREAT | O_EXCL,
+                              S_IRUSR | S_IWUSR);
+                if (fd == -1) {
+                        return -1;
+                }
+
+                sb.st_size = 0;
+        }
+
+        /* every process may read the table, only the daemon writes it;
+           umask must not narrow the permissions */
+        if (fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) == -1 ||
+            (sb.st_size == 0 && ftruncate(fd, total_size) == -1)) {
+                close(fd);
+                return -1;
+        }
+
+        location_t *loc = mmap(NULL,                        /* addr */
+                               total_size,                  /* len */
+                               PROT_READ | PROT_WRITE,      /* prot */
+                               MAP_SHARED,                  /* flags */
+                               fd,                          /* fd */
+                               0);                          /* offset */
+
+        /* no longer needed; do not check close() error because the mapping
+           (if any) stays valid anyway */
+        close(fd);
+
+        if (loc == MAP_FAILED) {
+                return -1;
+        }
+
+        /* entries of a valid table stay valid across restarts of the daemon
+           since they are checked against ctime */
+        if (!location_is_valid(loc, total_size)) {
+                __atomic_store_n(&loc->magic, 0, __ATOMIC_RELEASE);
+
+                memset(location_slots(loc),
+                       0,
+                       slots * sizeof(location_slot_t));
+
+                loc->version = LOCATION_VERSION;
+                loc->capacity = slots;
+                loc->total_size = total_size;
+                loc->clock = 0;
+
+                __atomic_store_n(&loc->magic, LOCATION_MAGIC, __ATOMIC_RELEASE);
+        }
+
+        *loc_p = loc;
+
+        return 0;
+}
+
+/**
+ * Map an existing table read-only.
+ * See location.h for complete description.
+ */
+int location_attach(const location_t **loc_p, const char *shm_obj) {
+        if (loc_p == NULL || shm_obj == NULL) {
+                return -1;
+        }
+
+        int fd = shm_open(shm_obj, O_RDONLY, 0);
+        if (fd == -1) {
+                return -1;
+        }
+
+        struct stat sb;
+        if (fstat(fd, &sb) == -1 || sb.st_size < LOCATION_SLOTS_OFFSET) {
+                close(fd);
+                return -1;
+        }
+
+        location_t *loc = mmap(NULL,                        /* addr */
+                               sb.st_size,                  /* len */
+                               PROT_READ,                   /* prot */
+                               MAP_SHARED,                  /* flags */
+                               fd,                          /* fd */
+                               0);                          /* offset */
+
+        /* no longer needed; do not check close() error because the mapping
+           (if any) stays valid anyway */
+        close(fd);
+
+        if (loc == MAP_FAILED) {
+                return -1;
+        }
+
+        if (!location_is_valid(loc, sb.st_size)) {
+                munmap(loc, sb.st_size);
+                return -1;
+        }
+
+        *loc_p = loc;
+
+        return 0;
+}
+
+/**
+ * Record a location of a file.
+ * See location.h for complete description.
+ */
+void location_set(location_t *loc,
+                  uint64_t dev,
+                  uint64_t ino,
+                  int64_t ctime_ns,
+                  enum location_enum state) {
+        location_slot_t *bucket = location_slots(loc) +
+                                  location_bucket(loc, dev, ino);
+        location_slot_t *slot = NULL;
+
+        /* a slot of the same file, then an empty slot, then any slot */
+        for (int i = 0; i < LOCATION_WAYS && slot == NULL; i++) {
+                if (__atomic_load_n(&bucket[i].ino, __ATOMIC_RELAXED) == ino &&
+                    __atomic_load_n(&bucket[i].dev, __ATOMIC_RELAXED) == dev) {
+                        slot = &bucket[i];
+                }
+        }
+
+        for (int i = 0; i < LOCATION_WAYS && slot == NULL; i++) {
+                if (__atomic_load_n(&bucket[i].state, __ATOMIC_RELAXED) ==
+                    e_location_unknown) {
+                        slot = &bucket[i];
+                }
+        }
+
+        if (slot == NULL) {
+                uint64_t turn = __atomic_fetch_add(&loc->clock,
+                                                   1,
+                                                   __ATOMIC_RELAXED);
+                slot = &bucket[turn % LOCATION_WAYS];
+        }
+
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+        if ((seq & 1) != 0 ||
+            !__atomic_compare_exchange_n(&slot->seq,
+                                         &seq,
+                                         seq + 1,
+                                         0,
+                                         __ATOMIC_ACQUIRE,
+                                         __ATOMIC_RELAXED)) {
+                /* another writer changes the slot */
+                return;
+        }
+
+        __atomic_store_n(&slot->state, state, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->dev, dev, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->ino, ino, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->ctime_ns, ctime_ns, __ATOMIC_RELAXED);
+
+        __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * Look a location of a file up.
+ * See location.h for complete description.
+ */
+enum location_enum location_get(const location_t *loc,
+                                uint64_t dev,
+                                uint64_t ino,
+                                int64_t ctime_ns) {
+        const location_slot_t *bucket = location_slots(loc) +
+                                        location_bucket(loc, dev, ino);
+
+        for (int i = 0; i < LOCATION_WAYS; i++) {
+                const location_slot_t *slot = &bucket[i];
+
+                uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+                if ((seq & 1) != 0) {
+                        continue;
+                }
+
+                uint32_t state = __atomic_load_n(&slot->state,
+                                                 __ATOMIC_RELAXED);
+                uint64_t slot_dev = __atomic_load_n(&slot->dev,
+                                                    __ATOMIC_RELAXED);
+                uint64_t slot_ino = __atomic_load_n(&slot->ino,
+                                                    __ATOMIC_RELAXED);
+                int64_t slot_ctime_ns = __atomic_load_n(&slot->ctime_ns,
+                                                        __ATOMIC_RELAXED);
+
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+                if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq) {
+                        continue;
+                }
+
+                if (slot_dev == dev && slot_ino == ino &&
+                    state != e_location_unknown) {
+                        return (slot_ctime_ns == ctime_ns) ?
+                               (enum location_enum)state : e_location_unknown;
+                }
+        }
+
+        return e_location_unknown;
+}
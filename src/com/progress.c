@@ -0,0 +1,455 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _DEFAULT_SOURCE    /* needed for syscall(), fchmod(), ftruncate() */
+
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>    /* defines SYS_futex */
+#include <linux/futex.h>    /* defines FUTEX_* constants */
+
+#include "progress.h"
+
+/* "CTPR" in ASCII; identifies a completely initialized table */
+#define PROGRESS_MAGIC      0x43545052
+
+/* version of the table layout; bump on every incompatible change */
+#define PROGRESS_VERSION    1
+
+/* slots start at this offset from the header; keeps them cache aligned */
+#define PROGRESS_SLOTS_OFFSET    64
+
+/**
+ * @brief progress_slots Returns a pointer to the first slot of a table.
+ *
+ * @param[in] prog A table.
+ *
+ * @return a pointer to the first slot
+ */
+static inline progress_slot_t *progress_slots(const progress_t *prog) {
+        return (progress_slot_t *)((char *)prog + PROGRESS_SLOTS_OFFSET);
+}
+
+/**
+ * @brief progress_is_valid Checks a header of a mapped table.
+ *
+ * @param[in] prog A table.
+ * @param[in] size A size of the mapping.
+ *
+ * @return 1 if the table is valid, 0 otherwise
+ */
+static int progress_is_valid(const progress_t *prog, size_t size) {
+        return size >= PROGRESS_SLOTS_OFFSET &&
+               __atomic_load_n(&prog->magic, __ATOMIC_ACQUIRE) ==
+               PROGRESS_MAGIC &&
+               prog->version == PROGRESS_VERSION &&
+               prog->capacity > 0 &&
+               prog->total_size == size &&
+               prog->total_size == PROGRESS_SLOTS_OFFSET +
+                                   prog->capacity * sizeof(progress_slot_t);
+}
+
+/**
+ * @brief progress_futex Performs futex(2) operation on a futex word of
+ *                       a table shared between processes.
+ *
+ * @param[in] uaddr      A pointer to the futex word.
+ * @param[in] op         FUTEX_WAIT or FUTEX_WAKE.
+ * @param[in] val        An expected value for FUTEX_WAIT.
+ * @param[in] timeout_ms A maximum time to block in FUTEX_WAIT.
+ */
+static void progress_futex(const uint32_t *uaddr,
+                           int op,
+                           uint32_t val,
+                           unsigned int timeout_ms) {
+        struct timespec timeout = {
+                .tv_sec = timeout_ms / 1000,
+                .tv_nsec = (long)(timeout_ms % 1000) * 1000000L,
+        };
+
+        /* errors are not interesting here: callers of FUTEX_WAIT always
+           re-check the condition; readers may wait on a read-only mapping,
+           which is fine for FUTEX_WAIT */
+        if (op == FUTEX_WAIT) {
+                syscall(SYS_futex, uaddr, op, val, &timeout, NULL, 0);
+        } else {
+                syscall(SYS_futex, uaddr, op, INT_MAX, NULL, NULL, 0);
+        }
+}
+
+/**
+ * @brief progress_touch Changes a futex word and wakes up its waiters.
+ *
+ * @param[in,out] uaddr A pointer to the futex word.
+ */
+static void progress_touch(uint32_t *uaddr) {
+        __atomic_add_fetch(uaddr, 1, __ATOMIC_RELEASE);
+        progress_futex(uaddr, FUTEX_WAKE, 0, 0);
+}
+
+/**
+ * Create a table in a shared memory.
+ * See progress.h for complete description.
+ */
+int progress_create(progress_t **prog_p, const char *shm_obj, size_t capacity) {
+        if (prog_p == NULL || shm_obj == NULL || capacity == 0) {
+                return -1;
+        }
+
+        size_t total_size = PROGRESS_SLOTS_OFFSET +
+                            capacity * sizeof(progress_slot_t);
+
+        int fd = shm_open(shm_obj, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+        if (fd == -1) {
+                return -1;
+        }
+
+        struct stat sb;
+        if (fstat(fd, &sb) == -1) {
+                close(fd);
+                return -1;
+        }
+
+        if (sb.st_size != 0 && (size_t)sb.st_size != total_size) {
+                /* readers may still map the old table; shrinking it would
+                   kill them with SIGBUS, so a new object replaces it */
+                close(fd);
+                shm_unlink(shm_obj);
+
+                fd = shm_open(shm_obj, O_RDWR | O_CREAT | O_EXCL,
+                              S_IRUSR | S_IWUSR);
+                if (fd == -1) {
+                        return -1;
+                }
+
+                sb.st_size = 0;
+        }
+
+        /* every process may read the table, only the daemon writes it;
+           umask must not narrow the permissions */
+        if (fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) == -1 ||
+            (sb.st_size == 0 && ftruncate(fd, total_size) == -1)) {
+                close(fd);
+                return -1;
+        }
+
+        progress_t *prog = mmap(NULL,                        /* addr */
+                                total_size,                  /* len */
+                                PROT_READ | PROT_WRITE,      /* prot */
+                                MAP_SHARED,                  /* flags */
+                                fd,                          /* fd */
+                                0);                          /* offset */
+
+        /* no longer needed; do not check close() error because the mapping
+           (if any) stays valid anyway */
+        close(fd);
+
+        if (prog == MAP_FAILED) {
+                return -1;
+        }
+
+        if (!progress_is_valid(prog, total_size)) {
+                __atomic_store_n(&prog->magic, 0, __ATOMIC_RELEASE);
+
+                memset(progress_slots(prog),
+                       0,
+                       capacity * sizeof(progress_slot_t));
+
+                prog->version = PROGRESS_VERSION;
+                prog->capacity = capacity;
+                prog->total_size = total_size;
+                prog->clock = 0;
+
+                __atomic_store_n(&prog->magic,
+                                 PROGRESS_MAGIC,
+                                 __ATOMIC_RELEASE);
+        } else {
+                /* recalls of a previous daemon will never finish; their
+                   readers should not wait forever */
+                progress_slot_t *slots = progress_slots(prog);
+                for (size_t i = 0; i < capacity; i++) {
+                        if (__atomic_load_n(&slots[i].state,
+                                            __ATOMIC_RELAXED) ==
+                            e_progress_active) {
+                                progress_end(&slots[i], 0);
+                        }
+                }
+        }
+
+        *prog_p = prog;
+
+        return 0;
+}
+
+/**
+ * Map an existing table read-only.
+ * See progress.h for complete description.
+ */
+int progress_attach(const progress_t **prog_p, const char *shm_obj) {
+        if (prog_p == NULL || shm_obj == NULL) {
+                return -1;
+        }
+
+        int fd = shm_open(shm_obj, O_RDONLY, 0);
+        if (fd == -1) {
+                return -1;
+        }
+
+        struct stat sb;
+        if (fstat(fd, &sb) == -1 || sb.st_size < PROGRESS_SLOTS_OFFSET) {
+                close(fd);
+                return -1;
+        }
+
+        progress_t *prog = mmap(NULL,                        /* addr */
+                                sb.st_size,                  /* len */
+                                PROT_READ,                   /* prot */
+                                MAP_SHARED,                  /* flags */
+                                fd,                          /* fd */
+                                0);                          /* offset */
+
+        /* no longer needed; do not check close() error because the mapping
+           (if any) stays valid anyway */
+        close(fd);
+
+        if (prog == MAP_FAILED) {
+                return -1;
+        }
+
+        if (!progress_is_valid(prog, sb.st_size)) {
+                munmap(prog, sb.st_size);
+                return -1;
+        }
+
+        *prog_p = prog;
+
+        return 0;
+}
+
+/**
+ * Take a slot for a new recall of a file.
+ * See progress.h for complete description.
+ */
+progress_slot_t *progress_begin(progress_t *prog, uint64_t dev, uint64_t ino) {
+        progress_slot_t *slots = progress_slots(prog);
+        size_t capacity = prog->capacity;
+
+        /* a slot of the same file, then a free slot, then any finished slot
+           in turn; a slot is claimed by making its sequence number odd */
+        for (int pass = 0; pass < 3; pass++) {
+                for (size_t i = 0; i < capacity; i++) {
+                        size_t pos = i;
+                        if (pass == 2) {
+                                pos = __atomic_fetch_add(&prog->clock,
+                                                         1,
+                                                         __ATOMIC_RELAXED) %
+                                      capacity;
+                        }
+
+                        progress_slot_t *slot = &slots[pos];
+                        uint32_t state = __atomic_load_n(&slot->state,
+                                                         __ATOMIC_RELAXED);
+
+                        if ((pass == 0 &&
+                             (slot->dev != dev || slot->ino != ino ||
+                              state == e_progress_free)) ||
+                            (pass == 1 && state != e_progress_free) ||
+                            state == e_progress_active) {
+                                continue;
+                        }
+
+                        uint32_t seq = __atomic_load_n(&slot->seq,
+                                                       __ATOMIC_RELAXED);
+                        if ((seq & 1) != 0 ||
+                            !__atomic_compare_exchange_n(&slot->seq,
+                                                         &seq,
+                                                         seq + 1,
+                                                         0,
+                                                         __ATOMIC_ACQUIRE,
+                                                         __ATOMIC_RELAXED)) {
+                                /* another recall claims the slot */
+                                continue;
+                        }
+
+                        __atomic_store_n(&slot->dev, dev, __ATOMIC_RELAXED);
+                        __atomic_store_n(&slot->ino, ino, __ATOMIC_RELAXED);
+                        __atomic_store_n(&slot->watermark, 0, __ATOMIC_RELAXED);
+                        __atomic_store_n(&slot->state,
+                                         e_progress_active,
+                                         __ATOMIC_RELAXED);
+
+                        __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+
+                        /* readers of the previous recall learn that the slot
+                           is lost, readers of the file learn that the recall
+                           has begun */
+                        progress_touch(&slot->ticks);
+                        progress_touch(&prog->starts);
+
+                        return slot;
+                }
+        }
+
+        return NULL;
+}
+
+/**
+ * Publish that more data of a file have been written.
+ * See progress.h for complete description.
+ */
+void progress_advance(progress_slot_t *slot, uint64_t bytes) {
+        __atomic_add_fetch(&slot->watermark, bytes, __ATOMIC_RELEASE);
+        progress_touch(&slot->ticks);
+}
+
+/**
+ * Finish a recall.
+ * See progress.h for complete description.
+ */
+void progress_end(progress_slot_t *slot, int ok) {
+        __atomic_store_n(&slot->state,
+                         ok ? e_progress_done : e_progress_failed,
+                         __ATOMIC_RELEASE);
+        progress_touch(&slot->ticks);
+}
+
+/**
+ * Find the latest recall of a file.
+ * See progress.h for complete description.
+ */
+int progress_find(const progress_t *prog,
+                  uint64_t dev,
+                  uint64_t ino,
+                  progress_ref_t *ref,
+                  enum progress_state_enum *state) {
+        const progress_slot_t *slots = progress_slots(prog);
+
+        for (size_t i = 0; i < prog->capacity; i++) {
+                const progress_slot_t *slot = &slots[i];
+
+                uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+                if ((seq & 1) != 0) {
+                        continue;
+                }
+
+                uint32_t slot_state = __atomic_load_n(&slot->state,
+                                                      __ATOMIC_ACQUIRE);
+                uint64_t slot_dev = __atomic_load_n(&slot->dev,
+                                                    __ATOMIC_RELAXED);
+                uint64_t slot_ino = __atomic_load_n(&slot->ino,
+                                                    __ATOMIC_RELAXED);
+
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+                if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq) {
+                        continue;
+                }
+
+                if (slot_dev == dev && slot_ino == ino &&
+                    slot_state != e_progress_free) {
+                        ref->index = i;
+                        ref->seq = seq;
+                        *state = (enum progress_state_enum)slot_state;
+                        return 0;
+                }
+        }
+
+        return -1;
+}
+
+/**
+ * Return a value of the futex word changed by new recalls.
+ * See progress.h for complete description.
+ */
+uint32_t progress_starts(const progress_t *prog) {
+        return __atomic_load_n(&prog->starts, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Block until a new recall begins.
+ * See progress.h for complete description.
+ */
+void progress_wait_start(const progress_t *prog,
+                         uint32_t starts,
+                         unsigned int timeout_ms) {
+        progress_futex(&prog->starts, FUTEX_WAIT, starts, timeout_ms);
+}
+
+/**
+ * @brief progress_check Compares progress of a recall with a requested end.
+ *
+ * @param[in] slot A slot of the recall.
+ * @param[in] ref  A reference to the recall.
+ * @param[in] end  A requested number of bytes.
+ *
+ * @return one of progress_wait_enum; e_progress_timeout stands for
+ *         "not yet" here
+ */
+static enum progress_wait_enum progress_check(const progress_slot_t *slot,
+                                              progress_ref_t ref,
+                                              uint64_t end) {
+        uint32_t state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+        uint64_t watermark = __atomic_load_n(&slot->watermark,
+                                             __ATOMIC_ACQUIRE);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != ref.seq) {
+                return e_progress_lost;
+        }
+
+        if (state == e_progress_done) {
+                return e_progress_complete;
+        } else if (state == e_progress_failed) {
+                return e_progress_error;
+        } else if (watermark >= end) {
+                return e_progress_reached;
+        }
+
+        return e_progress_timeout;
+}
+
+/**
+ * Block until a part of a file is written.
+ * See progress.h for complete description.
+ */
+enum progress_wait_enum progress_wait(const progress_t *prog,
+                                      progress_ref_t ref,
+                                      uint64_t end,
+                                      unsigned int timeout_ms) {
+        if (ref.index >= prog->capacity) {
+                return e_progress_lost;
+        }
+
+        const progress_slot_t *slot = &progress_slots(prog)[ref.index];
+
+        /* the futex word is read before the check, so an update between
+           the check and the wait makes the wait return at once */
+        uint32_t ticks = __atomic_load_n(&slot->ticks, __ATOMIC_ACQUIRE);
+
+        enum progress_wait_enum ret = progress_check(slot, ref, end);
+        if (ret != e_progress_timeout) {
+                return ret;
+        }
+
+        progress_futex(&slot->ticks, FUTEX_WAIT, ticks, timeout_ms);
+
+        return progress_check(slot, ref, end);
+}
@@ -21,14 +21,36 @@
 #include <string.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <errno.h>
+#include <limits.h>         /* defines INT_MAX and LONG_MAX */
 #include <fcntl.h>          /* defines O_* constants */
 #include <sys/stat.h>       /* defines mode constants */
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
+#include <sys/syscall.h>    /* defines SYS_futex */
+#include <linux/futex.h>    /* defines FUTEX_* constants */
 
 #include "queue.h"
 
+/* "CTQU" in ASCII; identifies a completely initialized queue */
+#define QUEUE_MAGIC      0x43545155
+
+/* version of the queue_t layout; bump on every incompatible change */
+#define QUEUE_VERSION    4
+
+/* an element's space starts with a data's size followed by a timestamp of
+   the moment the element has been pushed into the queue */
+#define QUEUE_ELEM_HDR_SIZE    ( sizeof( size_t ) + sizeof( uint64_t ) )
+
+/* a maximum number of queues queue_pop_any() waits for (see futex_waitv(2)) */
+#define QUEUE_ANY_MAX          128
+
+/* queue_pop_any() polls other queues this often in nanoseconds on kernels
+   which cannot wait for several futex words at once */
+#define QUEUE_ANY_POLL_NS      10000000ULL
+
 
 /**
  * @brief queue_bytes_per_elem Returns a number of bytes consumed by
@@ -42,37 +64,37 @@
  * @return a number of bytes required to store one element in a queue
  */
 static inline size_t queue_bytes_per_elem( const queue_t *queue ) {
-        return ( sizeof( size_t ) + queue->data_max_size );
+        return ( QUEUE_ELEM_HDR_SIZE + queue->data_max_size );
 }
 
 
 /**
- * @brief queue_buf_end Returns a pointer to queue's buffer end.
+ * @brief queue_elem_size Returns a size in bytes of a given element of a queue.
  *
- * @note This function is thread-safe.
+ * @warning This function in not thread-safe.
  * @warning This function does not check a correctness of input parameters.
  *
- * @param[in] queue A queue whose end of buffer pointer will be returned.
+ * @param[in] elem A pointer to an element's space in a queue's buffer.
  *
- * @return a pointer to an end of queue's buffer
+ * @return size of a data of a given element
  */
-static inline const char *queue_buf_end( const queue_t *queue ) {
-        return ( (char *)queue + queue->buf_offset + queue->buf_size );
+static inline size_t queue_elem_size( const char *elem ) {
+        return ( *( (size_t *)elem ) );
 }
 
 
 /**
- * @brief queue_elem_size Returns a size in bytes of a given element of a queue.
+ * @brief queue_elem_ts A pointer to an element's push timestamp.
  *
  * @warning This function in not thread-safe.
  * @warning This function does not check a correctness of input parameters.
  *
  * @param[in] elem A pointer to an element's space in a queue's buffer.
  *
- * @return size of a data of a given element
+ * @return a pointer to an element's push timestamp in nanoseconds
  */
-static inline size_t queue_elem_size( const char *elem ) {
-        return ( *( (size_t *)elem ) );
+static inline uint64_t *queue_elem_ts( const char *elem ) {
+        return ( (uint64_t *)( elem + sizeof( size_t ) ) );
 }
 
 
@@ -87,120 +109,370 @@ static inline size_t queue_elem_size( const char *elem ) {
  * @return a pointer to an element's data
  */
 static inline char *queue_elem_data( const char *elem ) {
-        return ( (char *)elem + sizeof( size_t ) );
+        return ( (char *)elem + QUEUE_ELEM_HDR_SIZE );
+}
+
+
+/**
+ * @brief queue_now_ns Returns a current value of the monotonic clock,
+ *                     which is the same for all processes.
+ *
+ * @return a current time in nanoseconds
+ */
+static inline uint64_t queue_now_ns( void ) {
+        struct timespec ts;
+        clock_gettime( CLOCK_MONOTONIC, &ts );
+
+        return ( (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec );
 }
 
 
 /**
- * @brief queue_buf_beg A pointer to a queue's buffer.
+ * @brief queue_stat_add Adds a value to one of the queue's counters.
+ *
+ * @note Relaxed atomic is used because counters are only statistics
+ *       and are read without taking queue's locks.
+ *
+ * @param[in,out] counter A pointer to the counter.
+ * @param[in]     val     A value to be added.
+ */
+static inline void queue_stat_add( uint64_t *counter, uint64_t val ) {
+        __atomic_fetch_add( counter, val, __ATOMIC_RELAXED );
+}
+
+
+/**
+ * @brief queue_latency_bucket Returns a latency histogram bucket for the time
+ *                             an element spent in the queue.
+ *
+ * @param[in] latency_ns Time in nanoseconds between push and pop.
+ *
+ * @return an index of the latency histogram bucket
+ */
+static inline size_t queue_latency_bucket( uint64_t latency_ns ) {
+        uint64_t us = latency_ns / 1000;
+        if ( us == 0 ) {
+                return 0;
+        }
+
+        /* bucket i (i > 0) accommodates latencies [2^(i-1), 2^i) us */
+        size_t bucket = 64 - __builtin_clzll( us );
+
+        return ( bucket < QUEUE_LATENCY_BUCKETS ) ? bucket :
+                                                    QUEUE_LATENCY_BUCKETS - 1;
+}
+
+
+/**
+ * @brief queue_elem A pointer to an element's space in a queue's buffer.
  *
  * @note This function is thread-safe.
  * @warning This function does not check a correctness of input parameters.
  *
- *  @param[in] queue A queue whose buffer's pointer will be returned.
+ * @param[in] queue A queue whose element's pointer will be returned.
+ * @param[in] index A head or a tail index of the element.
  *
- * @return a pointer to queue's buffer
+ * @return a pointer to an element's space in a queue's buffer
  */
-static inline char *queue_buf_beg( const queue_t *queue ) {
-        return ( (char *)queue + queue->buf_offset );
+static inline char *queue_elem( const queue_t *queue, uint32_t index ) {
+        size_t slot = ( index < queue->max_size ) ? index :
+                                                    index - queue->max_size;
+
+        return ( (char *)queue + queue->buf_offset +
+                 slot * queue_bytes_per_elem( queue ) );
 }
 
 
 /**
- * @brief queue_head A pointer to a queue's head.
+ * @brief queue_next_index Returns an index following the given one.
  *
- * @warning This function is not thread-safe.
+ * @note This function is thread-safe.
  * @warning This function does not check a correctness of input parameters.
  *
- *  @param[in] queue A queue whose head's pointer will be returned.
+ * @param[in] queue A queue whose index will be advanced.
+ * @param[in] index A head or a tail index.
  *
- * @return a pointer to queue's head
+ * @return an index following the given one
  */
-static inline char *queue_head( const queue_t *queue ) {
-        return ( (char *)queue + queue->head_offset );
+static inline uint32_t queue_next_index( const queue_t *queue,
+                                         uint32_t index ) {
+        return ( ( index + 1 ) == 2 * queue->max_size ) ? 0 : index + 1;
 }
 
 
 /**
- * @brief queue_tail A pointer to a queue's tail.
+ * @brief queue_distance Returns a number of elements between head and tail
+ *                       indexes, i.e. a queue's size.
  *
- * @warning This function is not thread-safe.
+ * @note This function is thread-safe.
  * @warning This function does not check a correctness of input parameters.
  *
- *  @param[in] queue A queue whose tail's pointer will be returned.
+ * @param[in] queue A queue whose size will be calculated.
+ * @param[in] head  A head index.
+ * @param[in] tail  A tail index.
+ *
+ * @return a number of elements between head and tail indexes
+ */
+static inline size_t queue_distance( const queue_t *queue,
+                                     uint32_t head,
+                                     uint32_t tail ) {
+        return ( tail >= head ) ? tail - head :
+                                  tail + 2 * queue->max_size - head;
+}
+
+
+/**
+ * @brief queue_journal_sync Synchronously writes a range of a file-backed
+ *                           queue to the disk.
+ *
+ * @note msync() failures are ignored: the element stays in the page cache and
+ *       is written back by the kernel later, hence it is lost only if the
+ *       system crashes before that.
+ *
+ * @param[in] addr A beginning of the range.
+ * @param[in] len  A length of the range in bytes.
+ */
+static void queue_journal_sync(const void *addr, size_t len) {
+        size_t page_mask = (size_t)sysconf(_SC_PAGESIZE) - 1;
+        uintptr_t beg = (uintptr_t)addr & ~page_mask;
+
+        msync((void *)beg, (uintptr_t)addr + len - beg, MS_SYNC);
+}
+
+
+/**
+ * @brief queue_futex Performs futex(2) operation on one of the queue's futex
+ *                    words. Process-private futex operations are used for
+ *                    queues residing in process-private memory.
+ *
+ * @param[in] queue   A queue whose futex word is used.
+ * @param[in] uaddr   A pointer to the futex word.
+ * @param[in] op      FUTEX_WAIT or FUTEX_WAKE.
+ * @param[in] val     An expected value for FUTEX_WAIT or a number of waiters
+ *                    to wake up for FUTEX_WAKE.
+ * @param[in] timeout A relative timeout for FUTEX_WAIT or NULL to wait
+ *                    infinitely.
+ */
+static inline void queue_futex( const queue_t *queue,
+                                uint32_t *uaddr,
+                                int op,
+                                uint32_t val,
+                                const struct timespec *timeout ) {
+        if ( queue->shm_obj[0] == '\0' ) {
+                op |= FUTEX_PRIVATE_FLAG;
+        }
+
+        /* errors are not interesting here: EAGAIN and EINTR in case of
+           FUTEX_WAIT mean that the caller should re-check the condition,
+           which it always does; so does ETIMEDOUT */
+        syscall( SYS_futex, uaddr, op, val, timeout, NULL, 0 );
+}
+
+
+/**
+ * @brief queue_wait Blocks until a futex word changes its value from the
+ *                   provided one, until a timeout expires or until
+ *                   a spurious wake-up.
+ *
+ * @param[in]     queue   A queue whose futex word is used.
+ * @param[in,out] uaddr   A pointer to the futex word.
+ * @param[in]     val     A value observed in the futex word.
+ * @param[in,out] waiters A counter of waiters on this futex word.
+ * @param[in]     timeout A relative timeout or NULL to wait infinitely.
+ */
+static void queue_wait( const queue_t *queue,
+                        uint32_t *uaddr,
+                        uint32_t val,
+                        uint32_t *waiters,
+                        const struct timespec *timeout ) {
+        /* announce the waiter before re-checking the futex word; paired with
+           a store to the futex word followed by the waiters counter load
+           in queue_wake(), it guarantees that either the store is seen
+           here or the waiter is seen there */
+        __atomic_add_fetch( waiters, 1, __ATOMIC_SEQ_CST );
+
+        if ( __atomic_load_n( uaddr, __ATOMIC_SEQ_CST ) == val ) {
+                queue_futex( queue, uaddr, FUTEX_WAIT, val, timeout );
+        }
+
+        __atomic_sub_fetch( waiters, 1, __ATOMIC_SEQ_CST );
+}
+
+
+/**
+ * @brief queue_wake Publishes a new value of a futex word and wakes up
+ *                   waiters, if any.
  *
- * @return a pointer to queue's tail
+ * @param[in]     queue   A queue whose futex word is used.
+ * @param[in,out] uaddr   A pointer to the futex word.
+ * @param[in]     val     A new value of the futex word.
+ * @param[in]     waiters A counter of waiters on this futex word.
+ * @param[in]     idlers  A counter of waiters of queue_pop_any() on this
+ *                        futex word or NULL.
  */
-static inline char *queue_tail( const queue_t *queue ) {
-        return ( (char *)queue + queue->tail_offset );
+static void queue_wake( const queue_t *queue,
+                        uint32_t *uaddr,
+                        uint32_t val,
+                        uint32_t *waiters,
+                        uint32_t *idlers ) {
+        __atomic_store_n( uaddr, val, __ATOMIC_SEQ_CST );
+
+        /* only an owner of a corresponding mutex waits on the futex word,
+           so there is no need to wake more than one waiter; waiters of
+           queue_pop_any() do not own the mutex and may pick an element
+           from another queue, so all of them are woken up */
+        if ( idlers != NULL &&
+             __atomic_load_n( idlers, __ATOMIC_SEQ_CST ) != 0 ) {
+                queue_futex( queue, uaddr, FUTEX_WAKE, INT_MAX, NULL );
+        } else if ( __atomic_load_n( waiters, __ATOMIC_SEQ_CST ) != 0 ) {
+                queue_futex( queue, uaddr, FUTEX_WAKE, 1, NULL );
+        }
+}
+
+
+/**
+ * @brief queue_lock Locks one of the queue's mutexes. If the previous owner
+ *                   of a mutex died while holding it (possible only for
+ *                   queues shared between processes), the mutex is made
+ *                   consistent again.
+ *
+ * @param[in,out] mutex   The mutex to be locked.
+ * @param[in,out] waiters A counter of waiters which only an owner of
+ *                        the mutex can contribute to.
+ *
+ * @return  0: the mutex has been locked;
+ *         -1: the mutex is not recoverable.
+ */
+static int queue_lock( pthread_mutex_t *mutex, uint32_t *waiters ) {
+        int ret = pthread_mutex_lock( mutex );
+
+        if ( ret == EOWNERDEAD ) {
+                /* the queue's state is consistent at any moment because an
+                   element is published or released by a single store to
+                   the index; the only leftover of the dead owner is its
+                   contribution to the waiters counter */
+                __atomic_store_n( waiters, 0, __ATOMIC_SEQ_CST );
+
+                ret = pthread_mutex_consistent( mutex );
+        }
+
+        return ( ret == 0 ) ? 0 : -1;
 }
 
 
 /**
  * @brief queue_push_common Pushes an element into a queue. The behaviour
  *                          in case of the queue full condition is determined
- *                          by a boolean parameter flag.
- *                          Common part for queue_push and queue_try_push
- *                          fucntions.
+ *                          by a timeout.
+ *                          Common part for queue_push, queue_try_push and
+ *                          queue_timed_push fucntions.
  *
  * @note This function is thread-safe.
  *
- * @param[in,out] queue       The queue into which a new element will be pushed.
- * @param[in]     data        A provided data.
- * @param[in]     data_size   A size of the provided data.
- * @param[in]     should_wait Flag defining blocking/non-blocking behaviour.
+ * @param[in,out] queue      The queue into which a new element will be pushed.
+ * @param[in]     data       A provided data.
+ * @param[in]     data_size  A size of the provided data.
+ * @param[in]     timeout_ms A maximum time to wait for a free space in
+ *                           milliseconds; 0 means non-blocking behaviour,
+ *                           a negative value means waiting infinitely.
  *
  * @return  0: the element pushed successfully into the queue;
- *         -1: incorrect input parameters provided or, in case of
- *             should_wait == true, queue is full.
+ *         -1: incorrect input parameters provided or the queue is still full
+ *             when the timeout expires.
  */
 static int queue_push_common(queue_t *queue,
                              const char *data,
                              size_t data_size,
-                             int should_wait) {
+                             long timeout_ms) {
         /* check an input parameters' correctness */
         if (queue == NULL || data == NULL || data_size == 0 ||
             data_size > queue->data_max_size) {
                 return -1;
         }
 
-        /* modify an internal queue's state under a lock for thread-safety */
-        pthread_mutex_lock(&queue->tail_mutex);
-        pthread_mutex_lock(&queue->size_mutex);
+        /* only one supplier at a time modifies the tail index */
+        if (queue_lock(&queue->tail_mutex, &queue->push_waiters) == -1) {
+                return -1;
+        }
 
-        while(queue->cur_size == queue->max_size) {
-                if (!should_wait) {
-                        pthread_mutex_unlock(&queue->size_mutex);
-                        pthread_mutex_unlock(&queue->tail_mutex);
-                        return -1;
+        uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+        uint32_t head;
+        uint64_t blocked_since = 0;
+
+        for (;;) {
+                /* acquire pairs with the release of the head index in pop;
+                   consumer has finished to read the element's space */
+                head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+                if (queue_distance(queue, head, tail) < queue->max_size) {
+                        break;
                 }
-                pthread_cond_wait(&queue->fullness_cond, &queue->size_mutex);
-        }
 
-        pthread_mutex_unlock(&queue->size_mutex);
+                if (blocked_since == 0) {
+                        queue_stat_add(&queue->stats.full_events, 1);
+
+                        if (timeout_ms == 0) {
+                                pthread_mutex_unlock(&queue->tail_mutex);
+                                return -1;
+                        }
+
+                        blocked_since = queue_now_ns();
+                }
 
-        /* a beginning and an end of a buffer are logically identical */
-        queue->tail_offset = (queue->tail_offset ==
-                             (queue->buf_offset + queue->buf_size)) ?
-                             queue->buf_offset : queue->tail_offset;
+                struct timespec remaining;
+                const struct timespec *timeout = NULL;
 
-        char *ptr = queue_tail(queue);
+                if (timeout_ms > 0) {
+                        uint64_t limit = (uint64_t)timeout_ms * 1000000ULL;
+                        uint64_t waited = queue_now_ns() - blocked_since;
 
-        /* fill an element's space in buffer with a size of the data
-           and the data itself */
+                        if (waited >= limit) {
+                                queue_stat_add(&queue->stats.push_blocked_ns,
+                                               waited);
+                                pthread_mutex_unlock(&queue->tail_mutex);
+                                return -1;
+                        }
+
+                        remaining.tv_sec  = (limit - waited) / 1000000000ULL;
+                        remaining.tv_nsec = (limit - waited) % 1000000000ULL;
+                        timeout = &remaining;
+                }
+
+                queue_wait(queue,
+                           &queue->head,
+                           head,
+                           &queue->push_waiters,
+                           timeout);
+        }
+
+        uint64_t now = queue_now_ns();
+        if (blocked_since != 0) {
+                queue_stat_add(&queue->stats.push_blocked_ns,
+                               now - blocked_since);
+        }
+
+        char *ptr = queue_elem(queue, tail);
+
+        /* fill an element's space in buffer with a size of the data,
+           a push timestamp and the data itself */
         memcpy(ptr, (char *)&data_size, sizeof(size_t));
+        *queue_elem_ts(ptr) = now;
         memcpy(queue_elem_data(ptr), data, data_size);
 
-        /* update the queue's internal state */
-        queue->tail_offset += queue_bytes_per_elem(queue);
+        /* write-ahead: the element should reach the disk before the tail
+           index referencing it does */
+        if (queue->journaled) {
+                queue_journal_sync(ptr, QUEUE_ELEM_HDR_SIZE + data_size);
+        }
 
-        pthread_mutex_lock(&queue->size_mutex);
+        /* publish the element and wake up a consumer, if it waits */
+        queue_wake(queue,
+                   &queue->tail,
+                   queue_next_index(queue, tail),
+                   &queue->pop_waiters,
+                   &queue->idle_waiters);
 
-        if (queue->cur_size++ == 0) {
-                pthread_cond_broadcast(&queue->emptiness_cond);
-        }
+        queue_stat_add(&queue->stats.pushes, 1);
 
-        pthread_mutex_unlock(&queue->size_mutex);
         pthread_mutex_unlock(&queue->tail_mutex);
 
         return 0;
@@ -212,7 +484,7 @@ static int queue_push_common(queue_t *queue,
  * See queue.h for complete description.
  */
 int queue_push(queue_t *queue, const char *data, size_t data_size) {
-        return queue_push_common(queue, data, data_size, 1);
+        return queue_push_common(queue, data, data_size, -1);
 }
 
 
@@ -225,6 +497,23 @@ int queue_try_push(queue_t *queue, const char *data, size_t data_size) {
 }
 
 
+/**
+ * Blocking queue push operation with a timeout.
+ * See queue.h for complete description.
+ */
+int queue_timed_push(queue_t *queue,
+                     const char *data,
+                     size_t data_size,
+                     size_t timeout_ms) {
+        /* a timeout this long is infinite anyway */
+        return queue_push_common(queue,
+                                 data,
+                                 data_size,
+                                 (timeout_ms > LONG_MAX) ? LONG_MAX :
+                                                           (long)timeout_ms);
+}
+
+
 /**
  * @brief queue_pop_common Fills provided buffers for a data and a data's size
  *                         with the front queue element's data and size
@@ -257,22 +546,42 @@ static int queue_pop_common(queue_t *queue,
                 return -1;
         }
 
-        /* modify an internal queue's state under a lock for thread-safety */
-        pthread_mutex_lock(&queue->head_mutex);
-        pthread_mutex_lock(&queue->size_mutex);
+        /* only one consumer at a time modifies the head index */
+        if (queue_lock(&queue->head_mutex, &queue->pop_waiters) == -1) {
+                return -1;
+        }
+
+        uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+        uint32_t tail;
+        int was_empty = 0;
+
+        for (;;) {
+                /* acquire pairs with the release of the tail index in push;
+                   supplier has finished to write the element's space */
+                tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+                if (tail != head) {
+                        break;
+                }
+
+                if (!was_empty) {
+                        was_empty = 1;
+                        queue_stat_add(&queue->stats.empty_events, 1);
+                }
 
-        while(queue->cur_size == 0) {
                 if (!should_wait) {
-                        pthread_mutex_unlock(&queue->size_mutex);
                         pthread_mutex_unlock(&queue->head_mutex);
                         return -1;
                 }
-                pthread_cond_wait(&queue->emptiness_cond, &queue->size_mutex);
-        }
 
-        pthread_mutex_unlock(&queue->size_mutex);
+                queue_wait(queue,
+                           &queue->tail,
+                           tail,
+                           &queue->pop_waiters,
+                           NULL);
+        }
 
-        size_t elem_sz = queue_elem_size(queue_head(queue));
+        char *ptr = queue_elem(queue, head);
+        size_t elem_sz = queue_elem_size(ptr);
 
         /* handle situation when provided buffer is not big enough */
         if (*data_size < elem_sz) {
@@ -284,23 +593,21 @@ static int queue_pop_common(queue_t *queue,
         *data_size = elem_sz;
 
         /* copy data to provided buffer */
-        memcpy(data, queue_elem_data(queue_head(queue)), *data_size);
+        memcpy(data, queue_elem_data(ptr), *data_size);
 
-        /* a beginning and an end of a buffer are logically identical;
-           update the queue's internal state */
-        queue->head_offset = (queue->head_offset ==
-                             (queue->buf_offset + queue->buf_size -
-                             queue_bytes_per_elem(queue))) ?
-                             queue->buf_offset :
-                             queue->head_offset + queue_bytes_per_elem(queue);
+        uint64_t pushed_at = *queue_elem_ts(ptr);
 
-        pthread_mutex_lock(&queue->size_mutex);
+        /* release the element's space and wake up a supplier, if it waits */
+        queue_wake(queue,
+                   &queue->head,
+                   queue_next_index(queue, head),
+                   &queue->push_waiters,
+                   NULL);
 
-        if (queue->cur_size-- == queue->max_size) {
-                pthread_cond_broadcast(&queue->fullness_cond);
-        }
+        queue_stat_add(&queue->stats.pops, 1);
+        size_t bucket = queue_latency_bucket(queue_now_ns() - pushed_at);
+        queue_stat_add(&queue->stats.latency_hist[bucket], 1);
 
-        pthread_mutex_unlock(&queue->size_mutex);
         pthread_mutex_unlock(&queue->head_mutex);
 
         return 0;
@@ -332,13 +639,275 @@ int queue_try_pop(queue_t *queue,
 
 
 /**
- * Initialize queue data structure.
+ * @brief queue_wait_any Blocks until a tail futex word of any of the queues
+ *                       changes its value from the provided one, until
+ *                       a timeout expires or until a spurious wake-up.
+ *
+ * @note Kernels older than 5.16 cannot wait for several futex words at once;
+ *       there the first queue is waited for and the others are polled.
+ *
+ * @param[in,out] queues     An array of queues; NULL elements are skipped.
+ * @param[in]     count      A number of elements in the array.
+ * @param[in]     tails      Values observed in the tail futex words.
+ * @param[in]     timeout_ns A relative timeout in nanoseconds.
+ */
+static void queue_wait_any(queue_t *const *queues,
+                           size_t count,
+                           const uint32_t *tails,
+                           uint64_t timeout_ns) {
+        size_t first = count;
+
+        /* see queue_wait() for the ordering of the announcement */
+        for (size_t i = 0; i < count; i++) {
+                if (queues[i] != NULL) {
+                        __atomic_add_fetch(&queues[i]->idle_waiters,
+                                           1,
+                                           __ATOMIC_SEQ_CST);
+                        first = (first == count) ? i : first;
+                }
+        }
+
+        if (first == count) {
+                return;
+        }
+
+        int waited = 0;
+
+#if defined(SYS_futex_waitv) && defined(FUTEX_WAITV_MAX)
+        struct futex_waitv waitv[count];
+        size_t waitv_num = 0;
+
+        for (size_t i = 0; i < count; i++) {
+                if (queues[i] == NULL) {
+                        continue;
+                }
+
+                waitv[waitv_num] = (struct futex_waitv) {
+                        .val   = tails[i],
+                        .uaddr = (uintptr_t)&queues[i]->tail,
+                        .flags = FUTEX_32 |
+                                 ((queues[i]->shm_obj[0] == '\0') ?
+                                  FUTEX_PRIVATE_FLAG : 0),
+                };
+                waitv_num++;
+        }
+
+        /* futex_waitv(2) takes an absolute timeout */
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec  += timeout_ns / 1000000000ULL;
+        deadline.tv_nsec += timeout_ns % 1000000000ULL;
+        if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+        }
+
+        /* as in queue_futex(), EAGAIN, EINTR and ETIMEDOUT make the caller
+           re-check the queues */
+        waited = (syscall(SYS_futex_waitv,
+                          waitv,
+                          waitv_num,
+                          0,
+                          &deadline,
+                          CLOCK_MONOTONIC) != -1 || errno != ENOSYS);
+#endif
+
+        if (!waited) {
+                if (timeout_ns > QUEUE_ANY_POLL_NS) {
+                        timeout_ns = QUEUE_ANY_POLL_NS;
+                }
+
+                const struct timespec timeout = {
+                        .tv_sec  = 0,
+                        .tv_nsec = (long)timeout_ns,
+                };
+
+                queue_futex(queues[first],
+                            &queues[first]->tail,
+                            FUTEX_WAIT,
+                            tails[first],
+                            &timeout);
+        }
+
+        for (size_t i = 0; i < count; i++) {
+                if (queues[i] != NULL) {
+                        __atomic_sub_fetch(&queues[i]->idle_waiters,
+                                           1,
+                                           __ATOMIC_SEQ_CST);
+                }
+        }
+}
+
+
+/**
+ * Blocking pop operation over several queues.
  * See queue.h for complete description.
  */
-int queue_init(queue_t **queue_p,
-               size_t max_size,
-               size_t data_max_size,
-               const char *shm_obj) {
+int queue_pop_any(queue_t *const *queues,
+                  size_t count,
+                  char *data,
+                  size_t *data_size,
+                  size_t timeout_ms) {
+        /* check an input parameters' correctness */
+        if (queues == NULL || count == 0 || count > QUEUE_ANY_MAX ||
+            data == NULL || data_size == NULL) {
+                return -1;
+        }
+
+        const size_t capacity = *data_size;
+        const uint64_t deadline = queue_now_ns() +
+                                  (uint64_t)timeout_ms * 1000000ULL;
+        uint32_t tails[count];
+
+        for (;;) {
+                /* tails are sampled before the queues are checked, so that
+                   an element pushed after the check changes a futex word
+                   and the wait below returns immediately */
+                for (size_t i = 0; i < count; i++) {
+                        if (queues[i] != NULL) {
+                                tails[i] = __atomic_load_n(&queues[i]->tail,
+                                                           __ATOMIC_SEQ_CST);
+                        }
+                }
+
+                /* queues are checked in the order of their priority */
+                for (size_t i = 0; i < count; i++) {
+                        *data_size = capacity;
+                        if (queues[i] != NULL &&
+                            queue_try_pop(queues[i], data, data_size) == 0) {
+                                return (int)i;
+                        }
+                }
+
+                uint64_t now = queue_now_ns();
+                if (now >= deadline) {
+                        return -1;
+                }
+
+                queue_wait_any(queues, count, tails, deadline - now);
+        }
+}
+
+
+/**
+ * @brief queue_is_valid Checks that a memory region contains a completely
+ *                       initialized queue of the known layout.
+ *
+ * @param[in] queue A queue to be validated.
+ * @param[in] size  A size of the memory region where the queue resides.
+ *
+ * @return 1: the queue is valid;
+ *         0: the queue is not valid.
+ */
+static int queue_is_valid(const queue_t *queue, size_t size) {
+        if (__atomic_load_n(&queue->magic, __ATOMIC_ACQUIRE) != QUEUE_MAGIC ||
+            queue->version != QUEUE_VERSION) {
+                return 0;
+        }
+
+        return (queue->total_size == size &&
+                queue->max_size <= UINT_MAX / 2 &&
+                queue->buf_size == (QUEUE_ELEM_HDR_SIZE +
+                                    queue->data_max_size) *
+                                   queue->max_size &&
+                queue->buf_offset + queue->buf_size <= queue->total_size &&
+                (queue->max_size == 0 ||
+                 (queue->head < 2 * queue->max_size &&
+                  queue->tail < 2 * queue->max_size)) &&
+                memchr(queue->shm_obj, '\0', sizeof(queue->shm_obj)) != NULL);
+}
+
+
+/**
+ * @brief queue_shm_create Creates a shared memory object for a queue
+ *                         accessible by all users.
+ *
+ * @param[in] shm_obj A name of the shared memory object.
+ *
+ * @return file descriptor of the created shared memory object or -1 on
+ *         failure (EEXIST errno if the object already exists)
+ */
+static int queue_shm_create(const char *shm_obj) {
+        int oflags =  O_CREAT | O_EXCL | O_RDWR;
+        mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP |
+                      S_IWGRP | S_IROTH | S_IWOTH;
+        mode_t mask = S_IXUSR | S_IXGRP | S_IXOTH;
+
+        /* temporary set mask for the follwing shm_open call */
+        mask = umask(mask);
+
+        /* create shared memory object */
+        int fd = shm_open(shm_obj, oflags, mode);
+
+        /* restore the previous mask value; umask() never fails */
+        umask(mask);
+
+        return fd;
+}
+
+
+/**
+ * Attach to the queue residing in existing shared memory object.
+ * See queue.h for complete description.
+ */
+int queue_attach(queue_t **queue_p, const char *shm_obj) {
+        if (queue_p == NULL || shm_obj == NULL) {
+                return -1;
+        }
+
+        int fd = shm_open(shm_obj, O_RDWR, 0);
+        if (fd == -1) {
+                return -1;
+        }
+
+        struct stat sb;
+        if (fstat(fd, &sb) == -1 || (size_t)sb.st_size < sizeof(queue_t)) {
+                close(fd);
+                return -1;
+        }
+
+        queue_t *queue = mmap(NULL,                        /* addr */
+                              sb.st_size,                  /* len */
+                              PROT_READ | PROT_WRITE,      /* prot */
+                              MAP_SHARED,                  /* flags */
+                              fd,                          /* fd */
+                              0);                          /* offset */
+
+        /* no longer needed; do not check close() error because the mapping
+           (if any) stays valid anyway */
+        close(fd);
+
+        if (queue == MAP_FAILED) {
+                return -1;
+        }
+
+        if (!queue_is_valid(queue, sb.st_size)) {
+                munmap(queue, sb.st_size);
+                errno = EINVAL;
+                return -1;
+        }
+
+        *queue_p = queue;
+
+        return 0;
+}
+
+
+/**
+ * @brief queue_geometry Calculates a layout of a memory region for a queue.
+ *
+ * @param[in]  max_size      A maximum size of the queue in elements.
+ * @param[in]  data_max_size A maximum size of one element.
+ * @param[out] buf_offset    An offset of the queue's circular buffer.
+ * @param[out] total_size    A total size of the memory region.
+ *
+ * @return  0: the layout has been calculated;
+ *         -1: the queue with such parameters can not be created.
+ */
+static int queue_geometry(size_t max_size,
+                          size_t data_max_size,
+                          size_t *buf_offset,
+                          size_t *total_size) {
         /* get page size value to properly align queue_t structure and
            queue->buf in memory */
         long val = sysconf(_SC_PAGESIZE);
@@ -346,15 +915,118 @@ int queue_init(queue_t **queue_p,
                 return -1;
         }
 
+        /* head and tail indexes are 32-bit futex words
+           in the [0, 2 * max_size) range */
+        if (max_size > UINT_MAX / 2) {
+                return -1;
+        }
+
         size_t page_size            = (size_t)val;
         size_t queue_t_size         = sizeof(queue_t);
         size_t queue_t_size_aligned = queue_t_size + (queue_t_size % page_size);
-        size_t buf_size             = (sizeof(size_t) + data_max_size) *
+        size_t buf_size             = (QUEUE_ELEM_HDR_SIZE + data_max_size) *
                                       max_size;
         size_t buf_size_aligned     = buf_size + (buf_size % page_size);
 
+        *buf_offset = queue_t_size_aligned;
+
         /* total size of memory to be allocated */
-        size_t total_size_aligned = queue_t_size_aligned + buf_size_aligned;
+        *total_size = queue_t_size_aligned + buf_size_aligned;
+
+        return 0;
+}
+
+
+/**
+ * @brief queue_format Initializes members of a queue residing in a memory
+ *                     region; the magic number is set last, so that the queue
+ *                     becomes valid only when it is completely initialized.
+ *
+ * @param[out] queue         A queue to be initialized.
+ * @param[in]  max_size      A maximum size of the queue in elements.
+ * @param[in]  data_max_size A maximum size of one element.
+ * @param[in]  buf_offset    An offset of the queue's circular buffer.
+ * @param[in]  total_size    A total size of the memory region.
+ * @param[in]  shm_obj       A name of shared memory object or NULL.
+ * @param[in]  journaled     Flag indicating a file-backed queue.
+ */
+static void queue_format(queue_t *queue,
+                         size_t max_size,
+                         size_t data_max_size,
+                         size_t buf_offset,
+                         size_t total_size,
+                         const char *shm_obj,
+                         int journaled) {
+        /* initialize structure members; the magic number is set last */
+        queue->magic = 0;
+        queue->version = QUEUE_VERSION;
+
+        queue->head = 0;
+        queue->tail = 0;
+        queue->pop_waiters  = 0;
+        queue->push_waiters = 0;
+        queue->idle_waiters = 0;
+        queue->journaled    = journaled;
+
+        queue->max_size = max_size;
+        queue->data_max_size = data_max_size;
+        queue->total_size = total_size;
+
+        queue->buf_size = (QUEUE_ELEM_HDR_SIZE + data_max_size) * max_size;
+
+        memset(&queue->stats, 0, sizeof(queue->stats));
+        queue->buf_offset = buf_offset;
+
+        if (shm_obj == NULL) {
+                queue->shm_obj[0] = '\0'; /* empty string */
+
+                queue->head_mutex = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
+                queue->tail_mutex = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
+        } else {
+                strcpy(queue->shm_obj, shm_obj);
+
+                pthread_mutexattr_t mutex_attr;
+
+                pthread_mutexattr_init(&mutex_attr);
+
+                pthread_mutexattr_setpshared(&mutex_attr,
+                                             PTHREAD_PROCESS_SHARED);
+
+                /* users of the queue may die while holding a mutex */
+                pthread_mutexattr_setrobust(&mutex_attr, PTHREAD_MUTEX_ROBUST);
+
+                pthread_mutex_init(&(queue->head_mutex), &mutex_attr);
+                pthread_mutex_init(&(queue->tail_mutex), &mutex_attr);
+
+                pthread_mutexattr_destroy(&mutex_attr);
+        }
+
+        if (journaled) {
+                /* a formatted header should reach the disk before any
+                   element is journaled */
+                msync(queue, total_size, MS_SYNC);
+        }
+
+        /* from now on the queue can be attached to */
+        __atomic_store_n(&queue->magic, QUEUE_MAGIC, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * Initialize queue data structure.
+ * See queue.h for complete description.
+ */
+int queue_init(queue_t **queue_p,
+               size_t max_size,
+               size_t data_max_size,
+               const char *shm_obj) {
+        size_t queue_t_size_aligned, total_size_aligned;
+        if (queue_geometry(max_size,
+                           data_max_size,
+                           &queue_t_size_aligned,
+                           &total_size_aligned) == -1) {
+                return -1;
+        }
 
         void *mem_region = NULL;
         if (shm_obj == NULL) {
@@ -370,19 +1042,36 @@ int queue_init(queue_t **queue_p,
                 }
         } else {
                 /* queue will be used by many processes */
-                int oflags =  O_CREAT | O_EXCL | O_RDWR;
-                mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP |
-                              S_IWGRP | S_IROTH | S_IWOTH;
-                mode_t mask = S_IXUSR | S_IXGRP | S_IXOTH;
-
-                /* temporary set mask for the follwing shm_open call */
-                mask = umask(mask);
-
-                /* create shared memory object */
-                int fd = shm_open(shm_obj, oflags, mode);
-
-                /* restore the previous mask value */
-                umask(mask);
+                int fd = queue_shm_create(shm_obj);
+
+                if (fd == -1 && errno == EEXIST) {
+                        /* the queue survived its previous user (e.g. the
+                           daemon has crashed or has been restarted); attach
+                           to it to keep elements in-flight */
+                        queue_t *queue = NULL;
+                        if (queue_attach(&queue, shm_obj) == 0) {
+                                if (queue->max_size == max_size &&
+                                    queue->data_max_size == data_max_size &&
+                                    queue->total_size == total_size_aligned) {
+                                        /* idle waiters are threads of the
+                                           previous user blocked in
+                                           queue_pop_any(), which are gone;
+                                           a stale count would cost every
+                                           push a futile wake-up call */
+                                        queue->idle_waiters = 0;
+
+                                        *queue_p = queue;
+                                        return 0;
+                                }
+
+                                munmap(queue, queue->total_size);
+                        }
+
+                        /* the queue is either corrupted or has incompatible
+                           geometry; replace it with a new one */
+                        shm_unlink(shm_obj);
+                        fd = queue_shm_create(shm_obj);
+                }
 
                 if (fd == -1) {
                         return -1;
@@ -424,56 +1113,136 @@ int queue_init(queue_t **queue_p,
 
         queue_t *queue = mem_region;
 
-        /* initialize structure members */
-        queue->max_size = max_size;
-        queue->cur_size = 0;
-        queue->data_max_size = data_max_size;
-        queue->total_size = total_size_aligned;
+        queue_format(queue,
+                     max_size,
+                     data_max_size,
+                     queue_t_size_aligned,
+                     total_size_aligned,
+                     shm_obj,
+                     0);
 
-        queue->buf_size = (sizeof(size_t) + data_max_size) * max_size;
-        queue->buf_offset = queue_t_size_aligned;
+        *queue_p =  queue;
 
-        queue->head_offset = queue_t_size_aligned;
-        queue->tail_offset = queue_t_size_aligned;
+        return 0;
+}
 
-        if (shm_obj == NULL) {
-                queue->shm_obj[0] = '\0'; /* empty string */
 
-                queue->head_mutex = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
-                queue->tail_mutex = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
-                queue->size_mutex = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
+/**
+ * Initialize a queue residing in a file.
+ * See queue.h for complete description.
+ */
+int queue_init_file(queue_t **queue_p,
+                    size_t max_size,
+                    size_t data_max_size,
+                    const char *path) {
+        if (queue_p == NULL || path == NULL) {
+                return -1;
+        }
 
-                queue->emptiness_cond =
-                        (pthread_cond_t)PTHREAD_COND_INITIALIZER;
-                queue->fullness_cond  =
-                        (pthread_cond_t)PTHREAD_COND_INITIALIZER;
-        } else {
-                strcpy(queue->shm_obj, shm_obj);
+        size_t queue_t_size_aligned, total_size_aligned;
+        if (queue_geometry(max_size,
+                           data_max_size,
+                           &queue_t_size_aligned,
+                           &total_size_aligned) == -1) {
+                return -1;
+        }
 
-                pthread_mutexattr_t mutex_attr;
-                pthread_condattr_t  cond_attr;
+        int fd = open(path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+        if (fd == -1) {
+                return -1;
+        }
 
-                pthread_mutexattr_init(&mutex_attr);
-                pthread_condattr_init(&cond_attr);
+        struct stat sb;
+        if (fstat(fd, &sb) == -1) {
+                close(fd);
+                return -1;
+        }
 
-                pthread_mutexattr_setpshared(&mutex_attr,
-                                             PTHREAD_PROCESS_SHARED);
-                pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
+        /* the file is either new or its size does not match the requested
+           geometry (in which case its elements can not be reused) */
+        int should_format = ((size_t)sb.st_size != total_size_aligned);
+        if (should_format && (ftruncate(fd, 0) == -1 ||
+                              ftruncate(fd, total_size_aligned) == -1)) {
+                close(fd);
+                return -1;
+        }
 
-                pthread_mutex_init(&(queue->head_mutex), &mutex_attr);
-                pthread_mutex_init(&(queue->tail_mutex), &mutex_attr);
-                pthread_mutex_init(&(queue->size_mutex), &mutex_attr);
+        queue_t *queue = mmap(NULL,                        /* addr */
+                              total_size_aligned,          /* len */
+                              PROT_READ | PROT_WRITE,      /* prot */
+                              MAP_SHARED,                  /* flags */
+                              fd,                          /* fd */
+                              0);                          /* offset */
+
+        /* no longer needed; do not check close() error because the mapping
+           (if any) stays valid anyway */
+        close(fd);
 
-                pthread_cond_init(&(queue->emptiness_cond), &cond_attr);
-                pthread_cond_init(&(queue->fullness_cond),  &cond_attr);
+        if (queue == MAP_FAILED) {
+                return -1;
         }
 
-        *queue_p =  queue;
+        if (!should_format &&
+            queue_is_valid(queue, total_size_aligned) &&
+            queue->journaled &&
+            queue->max_size == max_size &&
+            queue->data_max_size == data_max_size) {
+                /* replay elements journaled by the previous user; it was the
+                   only user of the queue, so nobody holds the mutexes and
+                   nobody waits on the futex words */
+                queue->pop_waiters  = 0;
+                queue->push_waiters = 0;
+                queue->idle_waiters = 0;
+
+                queue->head_mutex = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
+                queue->tail_mutex = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
+
+                *queue_p = queue;
+
+                return 0;
+        }
+
+        queue_format(queue,
+                     max_size,
+                     data_max_size,
+                     queue_t_size_aligned,
+                     total_size_aligned,
+                     NULL,
+                     1);
+
+        *queue_p = queue;
 
         return 0;
 }
 
 
+/**
+ * Get a current size of the queue.
+ * See queue.h for complete description.
+ */
+size_t queue_size(const queue_t *queue) {
+        uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+        uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+
+        return queue_distance(queue, head, tail);
+}
+
+
+/**
+ * Get a snapshot of the queue's counters.
+ * See queue.h for complete description.
+ */
+void queue_stats(const queue_t *queue, queue_stats_t *stats) {
+        const uint64_t *src = (const uint64_t *)&queue->stats;
+        uint64_t       *dst = (uint64_t *)stats;
+
+        /* counters are independent, so no need in a consistent snapshot */
+        for (size_t i = 0; i < sizeof(queue_stats_t) / sizeof(uint64_t); i++) {
+                dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+        }
+}
+
+
 /**
  * Destroy queue data structure and free resources.
  * See queue.h for complete description.
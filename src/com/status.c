@@ -0,0 +1,200 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE    200112L    /* needed for ftruncate(), fchmod() */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "status.h"
+
+/* "CTST" in ASCII; identifies a completely initialized page */
+#define STATUS_MAGIC      0x43545354
+
+/* version of the page layout; bump on every incompatible change */
+#define STATUS_VERSION    1
+
+/**
+ * @brief status_now Returns the current time of CLOCK_MONOTONIC, which is
+ *                   the same for all processes.
+ *
+ * @return the time in nanoseconds
+ */
+static uint64_t status_now(void) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief status_is_valid Checks a mapped status page.
+ *
+ * @param[in] status A status page.
+ *
+ * @return 1 if the page is valid, 0 otherwise
+ */
+static int status_is_valid(const status_t *status) {
+        return __atomic_load_n(&status->magic, __ATOMIC_ACQUIRE) ==
+               STATUS_MAGIC &&
+               status->version == STATUS_VERSION;
+}
+
+/**
+ * Create a status page in a shared memory.
+ * See status.h for complete description.
+ */
+int status_create(status_t **status_p,
+                  const char *shm_obj,
+                  uint32_t period_ms) {
+        if (status_p == NULL || shm_obj == NULL || period_ms == 0) {
+                return -1;
+        }
+
+        int fd = shm_open(shm_obj, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+        if (fd == -1) {
+                return -1;
+        }
+
+        struct stat sb;
+        if (fstat(fd, &sb) == -1) {
+                close(fd);
+                return -1;
+        }
+
+        /* every process may read the page, only the daemon writes it;
+           umask must not narrow the permissions */
+        if (fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) == -1 ||
+            ((size_t)sb.st_size < sizeof(status_t) &&
+             ftruncate(fd, sizeof(status_t)) == -1)) {
+                close(fd);
+                return -1;
+        }
+
+        status_t *status = mmap(NULL,                        /* addr */
+                                sizeof(status_t),            /* len */
+                                PROT_READ | PROT_WRITE,      /* prot */
+                                MAP_SHARED,                  /* flags */
+                                fd,                          /* fd */
+                                0);                          /* offset */
+
+        /* no longer needed; do not check close() error because the mapping
+           (if any) stays valid anyway */
+        close(fd);
+
+        if (status == MAP_FAILED) {
+                return -1;
+        }
+
+        /* epochs continue across restarts, so that waiting processes see
+           a restart even if they have missed the dead period */
+        uint64_t epoch = status_is_valid(status) ? status->epoch : 0;
+
+        __atomic_store_n(&status->magic, 0, __ATOMIC_RELEASE);
+
+        status->version = STATUS_VERSION;
+        status->pid = getpid();
+        status->period_ms = period_ms;
+        __atomic_store_n(&status->epoch, epoch + 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&status->heartbeat_ns,
+                         status_now(),
+                         __ATOMIC_RELAXED);
+
+        __atomic_store_n(&status->magic, STATUS_MAGIC, __ATOMIC_RELEASE);
+
+        *status_p = status;
+
+        return 0;
+}
+
+/**
+ * Map an existing status page read-only.
+ * See status.h for complete description.
+ */
+int status_attach(const status_t **status_p, const char *shm_obj) {
+        if (status_p == NULL || shm_obj == NULL) {
+                return -1;
+        }
+
+        int fd = shm_open(shm_obj, O_RDONLY, 0);
+        if (fd == -1) {
+                return -1;
+        }
+
+        struct stat sb;
+        if (fstat(fd, &sb) == -1 || (size_t)sb.st_size < sizeof(status_t)) {
+                close(fd);
+                return -1;
+        }
+
+        status_t *status = mmap(NULL,                        /* addr */
+                                sizeof(status_t),            /* len */
+                                PROT_READ,                   /* prot */
+                                MAP_SHARED,                  /* flags */
+                                fd,                          /* fd */
+                                0);                          /* offset */
+
+        /* no longer needed; do not check close() error because the mapping
+           (if any) stays valid anyway */
+        close(fd);
+
+        if (status == MAP_FAILED) {
+                return -1;
+        }
+
+        *status_p = status;
+
+        return 0;
+}
+
+/**
+ * Make a heartbeat.
+ * See status.h for complete description.
+ */
+void status_beat(status_t *status) {
+        __atomic_store_n(&status->heartbeat_ns,
+                         status_now(),
+                         __ATOMIC_RELEASE);
+}
+
+/**
+ * Check whether the daemon is alive.
+ * See status.h for complete description.
+ */
+int status_is_alive(const status_t *status, uint64_t *epoch) {
+        /* a page which is being (re)initialized belongs to a starting
+           daemon */
+        if (!status_is_valid(status)) {
+                return 1;
+        }
+
+        if (epoch != NULL) {
+                *epoch = __atomic_load_n(&status->epoch, __ATOMIC_RELAXED);
+        }
+
+        uint64_t heartbeat_ns = __atomic_load_n(&status->heartbeat_ns,
+                                                __ATOMIC_ACQUIRE);
+        uint64_t timeout_ns = __atomic_load_n(&status->period_ms,
+                                              __ATOMIC_RELAXED) *
+                              STATUS_MISSED_BEATS * 1000000ULL;
+
+        /* a heartbeat made after status_now() call is not in the past */
+        return status_now() <= heartbeat_ns + timeout_ns;
+}
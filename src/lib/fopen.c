@@ -15,4 +15,161 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-/* TODO: implement wrappers for fopen family of calls */
+#define _GNU_SOURCE        /* needed for fopen64() */
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "syms.h"
+
+/**
+ * @brief mode_to_flags Converts a mode of fopen(3) to flags of open(2).
+ *
+ * @param[in] mode A mode string of fopen(3).
+ *
+ * @return flags equivalent to the mode as far as this library cares
+ */
+static int mode_to_flags( const char *mode ) {
+        int plus = ( strchr( mode, '+' ) != NULL );
+
+        switch ( mode[0] ) {
+        case 'w':
+                return ( plus ? O_RDWR : O_WRONLY ) | O_CREAT | O_TRUNC;
+        case 'a':
+                return ( plus ? O_RDWR : O_WRONLY ) | O_CREAT | O_APPEND;
+        default:
+                return plus ? O_RDWR : O_RDONLY;
+        }
+}
+
+/**
+ * Common part for fopen(3) and freopen(3) redefinitions.
+ */
+static inline FILE *finish_fopen_common( FILE *stream, int flags ) {
+        /* stdio reads and writes data with internal system calls which can
+           not be intercepted, so the recall is never deferred */
+        if ( prepare_opened_file( fileno( stream ), flags, 0 ) == -1 ) {
+                int err = errno;
+                fclose( stream );
+                errno = err;
+
+                return NULL;
+        }
+
+        return stream;
+}
+
+/**
+ * Redefinition of fopen(3).
+ */
+FILE *fopen( const char *path, const char *mode ) {
+        if ( get_syms()->fopen == NULL ) {
+                errno = ELIBACC;
+                return NULL;
+        }
+
+        FILE *stream = get_syms()->fopen( path, mode );
+
+        if ( stream == NULL ) {
+                /* proper errno was set in the fopen() call */
+                return NULL;
+        }
+
+        /* on errno will be set inside finish_fopen_common() */
+        return finish_fopen_common( stream, mode_to_flags( mode ) );
+}
+
+/**
+ * Redefinition of fopen64(); programs compiled with _FILE_OFFSET_BITS=64
+ * call it instead of fopen(3).
+ */
+FILE *fopen64( const char *path, const char *mode ) {
+        if ( get_syms()->fopen64 == NULL ) {
+                errno = ELIBACC;
+                return NULL;
+        }
+
+        FILE *stream = get_syms()->fopen64( path, mode );
+
+        if ( stream == NULL ) {
+                /* proper errno was set in the fopen64() call */
+                return NULL;
+        }
+
+        /* on errno will be set inside finish_fopen_common() */
+        return finish_fopen_common( stream, mode_to_flags( mode ) );
+}
+
+/**
+ * Redefinition of freopen(3).
+ */
+FILE *freopen( const char *path, const char *mode, FILE *stream ) {
+        if ( get_syms()->freopen == NULL ) {
+                errno = ELIBACC;
+                return NULL;
+        }
+
+        stream = get_syms()->freopen( path, mode, stream );
+
+        if ( stream == NULL ) {
+                /* proper errno was set in the freopen() call */
+                return NULL;
+        }
+
+        /* without a path only the mode of the same file is changed and the
+           file is not truncated */
+        int flags = mode_to_flags( mode );
+        if ( path == NULL ) {
+                flags &= ~O_TRUNC;
+        }
+
+        /* on errno will be set inside finish_fopen_common() */
+        return finish_fopen_common( stream, flags );
+}
+
+/**
+ * Redefinition of freopen64().
+ */
+FILE *freopen64( const char *path, const char *mode, FILE *stream ) {
+        if ( get_syms()->freopen64 == NULL ) {
+                errno = ELIBACC;
+                return NULL;
+        }
+
+        stream = get_syms()->freopen64( path, mode, stream );
+
+        if ( stream == NULL ) {
+                /* proper errno was set in the freopen64() call */
+                return NULL;
+        }
+
+        int flags = mode_to_flags( mode );
+        if ( path == NULL ) {
+                flags &= ~O_TRUNC;
+        }
+
+        /* on errno will be set inside finish_fopen_common() */
+        return finish_fopen_common( stream, flags );
+}
+
+/**
+ * Redefinition of fdopen(3).
+ */
+FILE *fdopen( int fd, const char *mode ) {
+        if ( get_syms()->fdopen == NULL ) {
+                errno = ELIBACC;
+                return NULL;
+        }
+
+        /* the stream accesses data with internal system calls which can not
+           be intercepted, so a deferred or streamed recall of the descriptor
+           is completed here */
+        if ( finish_deferred_recall( fd ) == -1 ) {
+                /* errno has been set inside that function */
+                return NULL;
+        }
+
+        return get_syms()->fdopen( fd, mode );
+}
@@ -0,0 +1,861 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE        /* needed for dup3(), splice() and LFS calls */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <aio.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+
+#include "syms.h"
+
+/* Wrappers of calls which access data of a file. A remote file opened with
+   a deferred recall (see LAZY_RECALL_ENV) is recalled by the first of them;
+   until then the file is a stub and its data are not available. Reads wait
+   only until the daemon has written the data they read (see progress.h),
+   other calls wait for the whole file. Calls on descriptors without
+   a deferred recall cost a single table lookup.
+
+   Every libc entry point which accesses file data by a descriptor is
+   wrapped, including LFS, fortified and asynchronous variants. Data read
+   by stdio streams and io_uring can not be intercepted; fdopen() waits for
+   the whole file, and io_uring users should not enable deferred recalls. */
+
+/**
+ * @brief iov_length Returns a total length of I/O vector's buffers.
+ *
+ * @param[in] iov    An I/O vector.
+ * @param[in] iovcnt A number of buffers in the vector.
+ *
+ * @return a total length of the buffers
+ */
+static size_t iov_length( const struct iovec *iov, int iovcnt ) {
+        size_t count = 0;
+        for ( int i = 0; i < iovcnt; i++ ) {
+                count += iov[i].iov_len;
+        }
+
+        return count;
+}
+
+/**
+ * Redefinition of read(2) system call.
+ */
+ssize_t read( int fd, void *buf, size_t count ) {
+        if ( get_syms()->read == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( await_file_data( fd, -1, count ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->read( fd, buf, count );
+}
+
+/**
+ * Redefinition of pread(2) system call.
+ */
+ssize_t pread( int fd, void *buf, size_t count, off_t offset ) {
+        if ( get_syms()->pread == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( await_file_data( fd, offset, count ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->pread( fd, buf, count, offset );
+}
+
+/**
+ * Redefinition of pread64(); programs compiled with _FILE_OFFSET_BITS=64
+ * call it instead of pread(2).
+ */
+ssize_t pread64( int fd, void *buf, size_t count, off64_t offset ) {
+        if ( get_syms()->pread64 == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( await_file_data( fd, offset, count ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->pread64( fd, buf, count, offset );
+}
+
+/**
+ * Redefinition of __read_chk(); programs compiled with _FORTIFY_SOURCE
+ * call it instead of read(2).
+ */
+ssize_t __read_chk( int fd, void *buf, size_t count, size_t buflen ) {
+        if ( get_syms()->__read_chk == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( await_file_data( fd, -1, count ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->__read_chk( fd, buf, count, buflen );
+}
+
+/**
+ * Redefinition of __pread_chk().
+ */
+ssize_t __pread_chk( int fd,
+                     void *buf,
+                     size_t count,
+                     off_t offset,
+                     size_t buflen ) {
+        if ( get_syms()->__pread_chk == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( await_file_data( fd, offset, count ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->__pread_chk( fd, buf, count, offset, buflen );
+}
+
+/**
+ * Redefinition of __pread64_chk().
+ */
+ssize_t __pread64_chk( int fd,
+                       void *buf,
+                       size_t count,
+                       off64_t offset,
+                       size_t buflen ) {
+        if ( get_syms()->__pread64_chk == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( await_file_data( fd, offset, count ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->__pread64_chk( fd, buf, count, offset, buflen );
+}
+
+/**
+ * Redefinition of readv(2) system call.
+ */
+ssize_t readv( int fd, const struct iovec *iov, int iovcnt ) {
+        if ( get_syms()->readv == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( await_file_data( fd, -1, iov_length( iov, iovcnt ) ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->readv( fd, iov, iovcnt );
+}
+
+/**
+ * Redefinition of preadv(2) system call.
+ */
+ssize_t preadv( int fd, const struct iovec *iov, int iovcnt, off_t offset ) {
+        if ( get_syms()->preadv == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( await_file_data( fd, offset, iov_length( iov, iovcnt ) )
+             == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->preadv( fd, iov, iovcnt, offset );
+}
+
+/**
+ * Redefinition of preadv64().
+ */
+ssize_t preadv64( int fd,
+                  const struct iovec *iov,
+                  int iovcnt,
+                  off64_t offset ) {
+        if ( get_syms()->preadv64 == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( await_file_data( fd, offset, iov_length( iov, iovcnt ) )
+             == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->preadv64( fd, iov, iovcnt, offset );
+}
+
+/**
+ * Redefinition of preadv2(2) system call; an offset of -1 stands for the
+ * current file offset.
+ */
+ssize_t preadv2( int fd,
+                 const struct iovec *iov,
+                 int iovcnt,
+                 off_t offset,
+                 int flags ) {
+        if ( get_syms()->preadv2 == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( await_file_data( fd, offset, iov_length( iov, iovcnt ) )
+             == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->preadv2( fd, iov, iovcnt, offset, flags );
+}
+
+/**
+ * Redefinition of preadv64v2().
+ */
+ssize_t preadv64v2( int fd,
+                    const struct iovec *iov,
+                    int iovcnt,
+                    off64_t offset,
+                    int flags ) {
+        if ( get_syms()->preadv64v2 == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( await_file_data( fd, offset, iov_length( iov, iovcnt ) )
+             == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->preadv64v2( fd, iov, iovcnt, offset, flags );
+}
+
+/**
+ * Redefinition of write(2) system call.
+ */
+ssize_t write( int fd, const void *buf, size_t count ) {
+        if ( get_syms()->write == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        /* a partial write to a stub would be lost by the recall */
+        if ( finish_deferred_recall( fd ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->write( fd, buf, count );
+}
+
+/**
+ * Redefinition of pwrite(2) system call.
+ */
+ssize_t pwrite( int fd, const void *buf, size_t count, off_t offset ) {
+        if ( get_syms()->pwrite == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( finish_deferred_recall( fd ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->pwrite( fd, buf, count, offset );
+}
+
+/**
+ * Redefinition of pwrite64().
+ */
+ssize_t pwrite64( int fd, const void *buf, size_t count, off64_t offset ) {
+        if ( get_syms()->pwrite64 == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( finish_deferred_recall( fd ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->pwrite64( fd, buf, count, offset );
+}
+
+/**
+ * Redefinition of writev(2) system call.
+ */
+ssize_t writev( int fd, const struct iovec *iov, int iovcnt ) {
+        if ( get_syms()->writev == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( finish_deferred_recall( fd ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->writev( fd, iov, iovcnt );
+}
+
+/**
+ * Redefinition of pwritev(2) system call.
+ */
+ssize_t pwritev( int fd, const struct iovec *iov, int iovcnt, off_t offset ) {
+        if ( get_syms()->pwritev == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( finish_deferred_recall( fd ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->pwritev( fd, iov, iovcnt, offset );
+}
+
+/**
+ * Redefinition of pwritev64().
+ */
+ssize_t pwritev64( int fd,
+                   const struct iovec *iov,
+                   int iovcnt,
+                   off64_t offset ) {
+        if ( get_syms()->pwritev64 == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( finish_deferred_recall( fd ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->pwritev64( fd, iov, iovcnt, offset );
+}
+
+/**
+ * Redefinition of pwritev2(2) system call.
+ */
+ssize_t pwritev2( int fd,
+                  const struct iovec *iov,
+                  int iovcnt,
+                  off_t offset,
+                  int flags ) {
+        if ( get_syms()->pwritev2 == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( finish_deferred_recall( fd ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->pwritev2( fd, iov, iovcnt, offset, flags );
+}
+
+/**
+ * Redefinition of pwritev64v2().
+ */
+ssize_t pwritev64v2( int fd,
+                     const struct iovec *iov,
+                     int iovcnt,
+                     off64_t offset,
+                     int flags ) {
+        if ( get_syms()->pwritev64v2 == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( finish_deferred_recall( fd ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->pwritev64v2( fd, iov, iovcnt, offset, flags );
+}
+
+/**
+ * Redefinition of mmap(2) system call.
+ */
+void *mmap( void *addr,
+            size_t length,
+            int prot,
+            int flags,
+            int fd,
+            off_t offset ) {
+        if ( get_syms()->mmap == NULL ) {
+                errno = ELIBACC;
+                return MAP_FAILED;
+        }
+
+        /* page faults of a mapping can not be intercepted, so the file is
+           recalled before it is mapped */
+        if ( ( ( flags & MAP_ANONYMOUS ) == 0 )
+             && ( finish_deferred_recall( fd ) == -1 ) ) {
+                /* errno has been set inside that function */
+                return MAP_FAILED;
+        }
+
+        return get_syms()->mmap( addr, length, prot, flags, fd, offset );
+}
+
+/**
+ * Redefinition of mmap64().
+ */
+void *mmap64( void *addr,
+              size_t length,
+              int prot,
+              int flags,
+              int fd,
+              off64_t offset ) {
+        if ( get_syms()->mmap64 == NULL ) {
+                errno = ELIBACC;
+                return MAP_FAILED;
+        }
+
+        if ( ( ( flags & MAP_ANONYMOUS ) == 0 )
+             && ( finish_deferred_recall( fd ) == -1 ) ) {
+                /* errno has been set inside that function */
+                return MAP_FAILED;
+        }
+
+        return get_syms()->mmap64( addr, length, prot, flags, fd, offset );
+}
+
+/**
+ * @brief await_transfer Prepares descriptors of an in-kernel copy: waits
+ *                       until the source range is available and recalls
+ *                       the destination file completely.
+ *
+ * @param[in] in_fd  A source file descriptor.
+ * @param[in] off_in A pointer to a source offset or NULL for the current
+ *                   file offset.
+ * @param[in] out_fd A destination file descriptor.
+ * @param[in] count  A number of bytes to be copied.
+ *
+ * @return  0: the descriptors can be used
+ *         -1: a recall has failed; errno is set
+ */
+static int await_transfer( int in_fd,
+                           const off64_t *off_in,
+                           int out_fd,
+                           size_t count ) {
+        if ( await_file_data( in_fd,
+                              ( off_in != NULL ) ? *off_in : -1,
+                              count ) == -1 ) {
+                return -1;
+        }
+
+        return finish_deferred_recall( out_fd );
+}
+
+/**
+ * Redefinition of sendfile(2) system call.
+ */
+ssize_t sendfile( int out_fd, int in_fd, off_t *offset, size_t count ) {
+        if ( get_syms()->sendfile == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        off64_t off_in = ( offset != NULL ) ? *offset : 0;
+        if ( await_transfer( in_fd,
+                             ( offset != NULL ) ? &off_in : NULL,
+                             out_fd,
+                             count ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->sendfile( out_fd, in_fd, offset, count );
+}
+
+/**
+ * Redefinition of sendfile64().
+ */
+ssize_t sendfile64( int out_fd, int in_fd, off64_t *offset, size_t count ) {
+        if ( get_syms()->sendfile64 == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( await_transfer( in_fd, offset, out_fd, count ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->sendfile64( out_fd, in_fd, offset, count );
+}
+
+/**
+ * Redefinition of copy_file_range(2) system call.
+ */
+ssize_t copy_file_range( int in_fd,
+                         off64_t *off_in,
+                         int out_fd,
+                         off64_t *off_out,
+                         size_t count,
+                         unsigned int flags ) {
+        if ( get_syms()->copy_file_range == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( await_transfer( in_fd, off_in, out_fd, count ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->copy_file_range( in_fd,
+                                            off_in,
+                                            out_fd,
+                                            off_out,
+                                            count,
+                                            flags );
+}
+
+/**
+ * Redefinition of splice(2) system call.
+ */
+ssize_t splice( int in_fd,
+                off64_t *off_in,
+                int out_fd,
+                off64_t *off_out,
+                size_t count,
+                unsigned int flags ) {
+        if ( get_syms()->splice == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( await_transfer( in_fd, off_in, out_fd, count ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->splice( in_fd,
+                                   off_in,
+                                   out_fd,
+                                   off_out,
+                                   count,
+                                   flags );
+}
+
+/**
+ * @brief await_aio Prepares a descriptor of an asynchronous request: waits
+ *                  until the data to be read are available or recalls the
+ *                  file completely before it is written.
+ *
+ * @note The wait happens before the request is queued, since the request
+ *       is served by glibc threads whose calls can not be intercepted.
+ *
+ * @param[in] fd     File descriptor of the request.
+ * @param[in] opcode LIO_READ, LIO_WRITE or LIO_NOP.
+ * @param[in] offset An offset of the request.
+ * @param[in] count  A length of the request.
+ *
+ * @return  0: the descriptor can be used
+ *         -1: the recall has failed; errno is set
+ */
+static int await_aio( int fd, int opcode, off64_t offset, size_t count ) {
+        switch ( opcode ) {
+        case LIO_READ:
+                return await_file_data( fd, offset, count );
+        case LIO_WRITE:
+                return finish_deferred_recall( fd );
+        default:
+                return 0;
+        }
+}
+
+/**
+ * Redefinition of aio_read(3).
+ */
+int aio_read( struct aiocb *cb ) {
+        if ( get_syms()->aio_read == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( await_aio( cb->aio_fildes,
+                        LIO_READ,
+                        cb->aio_offset,
+                        cb->aio_nbytes ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->aio_read( cb );
+}
+
+/**
+ * Redefinition of aio_read64().
+ */
+int aio_read64( struct aiocb64 *cb ) {
+        if ( get_syms()->aio_read64 == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( await_aio( cb->aio_fildes,
+                        LIO_READ,
+                        cb->aio_offset,
+                        cb->aio_nbytes ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->aio_read64( cb );
+}
+
+/**
+ * Redefinition of aio_write(3).
+ */
+int aio_write( struct aiocb *cb ) {
+        if ( get_syms()->aio_write == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( finish_deferred_recall( cb->aio_fildes ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->aio_write( cb );
+}
+
+/**
+ * Redefinition of aio_write64().
+ */
+int aio_write64( struct aiocb64 *cb ) {
+        if ( get_syms()->aio_write64 == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( finish_deferred_recall( cb->aio_fildes ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->aio_write64( cb );
+}
+
+/**
+ * Redefinition of lio_listio(3).
+ */
+int lio_listio( int mode,
+                struct aiocb *const list[],
+                int nent,
+                struct sigevent *sig ) {
+        if ( get_syms()->lio_listio == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        for ( int i = 0; i < nent; i++ ) {
+                if ( ( list[i] != NULL )
+                     && ( await_aio( list[i]->aio_fildes,
+                                     list[i]->aio_lio_opcode,
+                                     list[i]->aio_offset,
+                                     list[i]->aio_nbytes ) == -1 ) ) {
+                        /* errno has been set inside that function */
+                        return -1;
+                }
+        }
+
+        return get_syms()->lio_listio( mode, list, nent, sig );
+}
+
+/**
+ * Redefinition of lio_listio64().
+ */
+int lio_listio64( int mode,
+                  struct aiocb64 *const list[],
+                  int nent,
+                  struct sigevent *sig ) {
+        if ( get_syms()->lio_listio64 == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        for ( int i = 0; i < nent; i++ ) {
+                if ( ( list[i] != NULL )
+                     && ( await_aio( list[i]->aio_fildes,
+                                     list[i]->aio_lio_opcode,
+                                     list[i]->aio_offset,
+                                     list[i]->aio_nbytes ) == -1 ) ) {
+                        /* errno has been set inside that function */
+                        return -1;
+                }
+        }
+
+        return get_syms()->lio_listio64( mode, list, nent, sig );
+}
+
+/**
+ * Redefinition of close(2) system call.
+ */
+int close( int fd ) {
+        if ( get_syms()->close == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        /* the descriptor may be reused by the next open() */
+        forget_deferred_recall( fd );
+
+        return get_syms()->close( fd );
+}
+
+/**
+ * Redefinition of dup(2) system call.
+ */
+int dup( int old_fd ) {
+        if ( get_syms()->dup == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        int new_fd = get_syms()->dup( old_fd );
+        if ( new_fd != -1 ) {
+                move_deferred_recall( old_fd, new_fd );
+        }
+
+        return new_fd;
+}
+
+/**
+ * Redefinition of dup2(2) system call.
+ */
+int dup2( int old_fd, int new_fd ) {
+        if ( get_syms()->dup2 == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        int ret = get_syms()->dup2( old_fd, new_fd );
+        if ( ( ret != -1 ) && ( old_fd != new_fd ) ) {
+                move_deferred_recall( old_fd, new_fd );
+        }
+
+        return ret;
+}
+
+/**
+ * Redefinition of dup3(2) system call.
+ */
+int dup3( int old_fd, int new_fd, int flags ) {
+        if ( get_syms()->dup3 == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        int ret = get_syms()->dup3( old_fd, new_fd, flags );
+        if ( ret != -1 ) {
+                move_deferred_recall( old_fd, new_fd );
+        }
+
+        return ret;
+}
+
+/**
+ * Common part for fcntl(2) and fcntl64() redefinitions.
+ */
+static inline int finish_fcntl_common( int fd, int cmd, int ret ) {
+        /* duplicates of a descriptor follow the same recall */
+        if ( ( ret != -1 )
+             && ( ( cmd == F_DUPFD ) || ( cmd == F_DUPFD_CLOEXEC ) ) ) {
+                move_deferred_recall( fd, ret );
+        }
+
+        return ret;
+}
+
+/**
+ * Redefinition of fcntl(2) system call.
+ */
+int fcntl( int fd, int cmd, ... ) {
+        if ( get_syms()->fcntl == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        /* the argument is either an integer or a pointer, depending on the
+           command; as glibc itself does, it is passed on as a pointer and
+           may contain rubbish for commands without an argument */
+        va_list ap;
+        va_start( ap, cmd );
+        void *arg = va_arg( ap, void * );
+        va_end( ap );
+
+        return finish_fcntl_common( fd,
+                                    cmd,
+                                    get_syms()->fcntl( fd, cmd, arg ) );
+}
+
+/**
+ * Redefinition of fcntl64(); programs compiled with _FILE_OFFSET_BITS=64
+ * against glibc 2.28 or newer call it instead of fcntl(2).
+ */
+int fcntl64( int fd, int cmd, ... ) {
+        if ( get_syms()->fcntl64 == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        va_list ap;
+        va_start( ap, cmd );
+        void *arg = va_arg( ap, void * );
+        va_end( ap );
+
+        return finish_fcntl_common( fd,
+                                    cmd,
+                                    get_syms()->fcntl64( fd, cmd, arg ) );
+}
@@ -32,72 +32,17 @@
  */
 static inline int finish_open_common( int fd, int flags ) {
         /* we are here when open() call succeeded (i. e. fd != -1);
-           we should determine whether file local or remote and if remote,
-           schedule its download in daemon */
+           a remote file is recalled (or its recall is deferred) here;
+           the file descriptor should not leak if it fails */
+        if ( prepare_opened_file( fd, flags, 1 ) == -1 ) {
+                int err = errno;
+                close( fd );
+                errno = err;
 
-        int ret = is_local_file( fd, flags );
-
-        /* handle the case when the file is local */
-        if ( ret && ( ret != -1 ) ) {
-                /* file is local; no need to download it */
-                return fd;
-        }
-
-        /* handle the case when the file is remote */
-        if ( ret == 0 ) {
-                /* check O_TRUNC flag and avoid unnessesary download */
-                if ( ( ( flags & O_TRUNC ) == O_TRUNC ) ) {
-                        /* if O_TRUNC is used with flags other than O_RDWR
-                           and O_WRONLY then open() behaviour is unspecified
-                           (see open(2)) */
-
-                        /* NOTE: errors in clean_xattr, except ENOATTR are
-                                 impossible as long as the programs logic is
-                                 correct */
-                        if ( clear_xattrs( fd ) == -1 ) {
-                                /* can do nothing in case of failure */
-                                close( fd );
-                                errno = EIO;
-                                return -1;
-                        }
-
-                        return fd;
-                }
-
-                if ( schedule_download( fd ) == -1 ) {
-                        /* errno has been set inside that function */
-                        return -1;
-                }
-
-                if ( poll_file_location( fd, flags, 0 ) == -1 ) {
-                        /* errno has been set inside that function */
-                        return -1;
-                }
-
-                /* by now we do not pass file descriptors to the daemon and
-                   that is why we are still on the 0 offset, so just return
-                   a file descriptor */
-                return fd;
-        }
-
-        /* is_file_local() could possibly return errors; we need to map these
-           errors to open() call errors to preserve semantics */
-        if ( ret == -1 ) {
-                /* is_file_local() returned a error, hence stat() errors should
-                   be handled here; the only error that does not have analog in
-                   open() for our case (when we use file descriptor
-                   for fstat()) is EBADF;
-                   for nearly impossible situations, such as "during this call
-                   another thread called close() with this file descriptor",
-                   return EIO error, which is not specified as a possible return
-                   values of this call */
-                errno = ( errno == EBADFD ) ? EIO : errno;
                 return -1;
         }
 
-        /* unreachable place */
-        errno = EIO;
-        return -1;
+        return fd;
 }
 
 /**
@@ -169,3 +114,97 @@ int openat( int dir_fd, const char *path, int flags, ... ) {
         /* on errno will be set inside finish_open_common() */
         return finish_open_common( fd, flags );
 }
+
+/**
+ * Redefinition of open64(2) system call; programs compiled with
+ * _FILE_OFFSET_BITS=64 call it instead of open(2).
+ */
+int open64( const char *path, int flags, ... ) {
+        if ( get_syms()->open64 == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        mode_t mode;
+        va_list ap;
+        va_start( ap, flags );
+        mode = va_arg( ap, mode_t );
+        va_end( ap );
+
+        int fd = get_syms()->open64( path, flags, mode );
+
+        if ( fd == -1 ) {
+                /* proper errno was set in the open64() call */
+                return fd;
+        }
+
+        /* on errno will be set inside finish_open_common() */
+        return finish_open_common( fd, flags );
+}
+
+/**
+ * Redefinition of openat64(2) system call.
+ */
+int openat64( int dir_fd, const char *path, int flags, ... ) {
+        if ( get_syms()->openat64 == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        mode_t mode;
+        va_list ap;
+        va_start( ap, flags );
+        mode = va_arg( ap, mode_t );
+        va_end( ap );
+
+        int fd = get_syms()->openat64( dir_fd, path, flags, mode );
+
+        if ( fd == -1 ) {
+                /* proper errno was set in the openat64() call */
+                return fd;
+        }
+
+        /* on errno will be set inside finish_open_common() */
+        return finish_open_common( fd, flags );
+}
+
+/**
+ * Redefinition of __open_2(); programs compiled with _FORTIFY_SOURCE call it
+ * instead of open(2) when flags are not known at compile time.
+ */
+int __open_2( const char *path, int flags ) {
+        if ( get_syms()->__open_2 == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        int fd = get_syms()->__open_2( path, flags );
+
+        if ( fd == -1 ) {
+                /* proper errno was set in the __open_2() call */
+                return fd;
+        }
+
+        /* on errno will be set inside finish_open_common() */
+        return finish_open_common( fd, flags );
+}
+
+/**
+ * Redefinition of __open64_2(); a fortified variant of open64(2).
+ */
+int __open64_2( const char *path, int flags ) {
+        if ( get_syms()->__open64_2 == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        int fd = get_syms()->__open64_2( path, flags );
+
+        if ( fd == -1 ) {
+                /* proper errno was set in the __open64_2() call */
+                return fd;
+        }
+
+        /* on errno will be set inside finish_open_common() */
+        return finish_open_common( fd, flags );
+}
@@ -24,6 +24,7 @@
 #include <errno.h>
 #include <string.h>
 #include <pthread.h>
+#include <time.h>
 #include <unistd.h>
 #include <fcntl.h>          /* defines O_* constants */
 #include <attr/xattr.h>
@@ -35,6 +36,9 @@
 #include "defs.h"
 #include "syms.h"
 #include "queue.h"
+#include "location.h"
+#include "progress.h"
+#include "status.h"
 
 /* enum of supported extended attributes */
 enum xattr_enum {
@@ -46,17 +50,99 @@ static const char *xattr_str[] = {
         XATTRS(XATTR_KEY, COMMA),
 };
 
-/* pointer to the first priority download queue in shared memory */
+/* pointer to the first priority download queue in shared memory; there is
+   a queue per recall class and a process uses the one of its class */
 static queue_t *queue = NULL;
 
+/* names of recall classes and of their download queues */
+static const char *recall_class_str[] = {
+        RECALL_CLASSES(STRINGIFY, COMMA),
+};
+static const char *recall_queue_shm_obj[] = {
+        RECALL_CLASSES(QUEUE_CLASS_SHM_OBJ, COMMA),
+};
+
+/* a recall class of the process */
+static size_t recall_class = 0;
+
+/* an epoch of the daemon which has created the attached queue */
+static uint64_t queue_epoch = 0;
+
+/* serializes attaching of the queue after the daemon (re)starts */
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* pointer to the status page of the daemon; NULL until the daemon has
+   created it */
+static const status_t *status = NULL;
+
+/* errno reported by calls which need a recall while the daemon is not
+   running (see DAEMON_DOWN_ERRNO_ENV) */
+static int daemon_down_errno = EIO;
+
+/* names of errors which may be reported while the daemon is not running */
+static const struct {
+        const char *name;
+        int value;
+} daemon_down_errors[] = {
+        { "EIO",       EIO       },
+        { "EAGAIN",    EAGAIN    },
+        { "EBUSY",     EBUSY     },
+        { "ETIMEDOUT", ETIMEDOUT },
+        { "EHOSTDOWN", EHOSTDOWN },
+};
+
+/* pointer to the table of known locations published by the daemon;
+   NULL if the daemon does not publish it */
+static const location_t *locations = NULL;
+
+/* pointer to the table of recall progress published by the daemon; NULL if
+   the daemon does not publish it */
+static const progress_t *progress = NULL;
+
 /* functions for which this library has wrappers */
 static symbols_t symbols = { 0 };
 
 static pthread_once_t once_control = PTHREAD_ONCE_INIT;
 
+static void init_vars_once( void );
+
 /* the pid of this process; will be initialized later once */
 static pid_t pid = -1;
 
+/* states of a recall of a file opened through a descriptor */
+enum recall_state_enum {
+        e_recall_none = 0,  /* the file is local or its recall is not tracked */
+        e_recall_deferred,  /* the recall waits for the first access to data */
+        e_recall_streaming, /* the recall is in progress and data are read as
+                               soon as they arrive */
+};
+
+/* a recall of a remote file opened through a descriptor */
+typedef struct {
+        /* a state of the recall (see recall_state_enum) */
+        int state;
+
+        /* flags with which the descriptor was opened */
+        int flags;
+
+        /* the recall in the daemon's progress table; valid in
+           e_recall_streaming state */
+        progress_ref_t ref;
+} recall_t;
+
+/* recalls of remote files, indexed by a file descriptor; NULL if deferred
+   recalls are not enabled */
+static recall_t *recalls = NULL;
+static size_t recalls_size = 0;
+
+/* descriptors beyond this limit are always recalled in open() */
+#define DEFERRED_MAX_FDS    ( 1 << 20 )
+
+/* a period in milliseconds of location checks while waiting for a recall,
+   in case the daemon does not publish its progress, and of daemon checks
+   while waiting for a free space in a full download queue */
+#define RECALL_WAIT_MS    100
+
 symbols_t *get_syms( void ) {
         return &symbols;
 }
@@ -79,14 +165,116 @@ void __attribute__ ((constructor)) init_syms(void) {
            be performed in the places of actual invocation */
         symbols.open       = dlsym( RTLD_NEXT, "open"     );
         symbols.openat     = dlsym( RTLD_NEXT, "openat"   );
+        symbols.open64     = dlsym( RTLD_NEXT, "open64"   );
+        symbols.openat64   = dlsym( RTLD_NEXT, "openat64" );
+        symbols.__open_2   = dlsym( RTLD_NEXT, "__open_2" );
+        symbols.__open64_2 = dlsym( RTLD_NEXT, "__open64_2" );
 
-        symbols.truncate   = dlsym( RTLD_NEXT, "truncate" );
+        symbols.truncate    = dlsym( RTLD_NEXT, "truncate"    );
+        symbols.ftruncate   = dlsym( RTLD_NEXT, "ftruncate"   );
+        symbols.truncate64  = dlsym( RTLD_NEXT, "truncate64"  );
+        symbols.ftruncate64 = dlsym( RTLD_NEXT, "ftruncate64" );
 
         symbols.fopen      = dlsym( RTLD_NEXT, "fopen"    );
         symbols.freopen    = dlsym( RTLD_NEXT, "freopen"  );
+        symbols.fopen64    = dlsym( RTLD_NEXT, "fopen64"  );
+        symbols.freopen64  = dlsym( RTLD_NEXT, "freopen64" );
+        symbols.fdopen     = dlsym( RTLD_NEXT, "fdopen"   );
+
+        symbols.read          = dlsym( RTLD_NEXT, "read"          );
+        symbols.pread         = dlsym( RTLD_NEXT, "pread"         );
+        symbols.pread64       = dlsym( RTLD_NEXT, "pread64"       );
+        symbols.readv         = dlsym( RTLD_NEXT, "readv"         );
+        symbols.preadv        = dlsym( RTLD_NEXT, "preadv"        );
+        symbols.preadv64      = dlsym( RTLD_NEXT, "preadv64"      );
+        symbols.preadv2       = dlsym( RTLD_NEXT, "preadv2"       );
+        symbols.preadv64v2    = dlsym( RTLD_NEXT, "preadv64v2"    );
+        symbols.__read_chk    = dlsym( RTLD_NEXT, "__read_chk"    );
+        symbols.__pread_chk   = dlsym( RTLD_NEXT, "__pread_chk"   );
+        symbols.__pread64_chk = dlsym( RTLD_NEXT, "__pread64_chk" );
+        symbols.write         = dlsym( RTLD_NEXT, "write"         );
+        symbols.pwrite        = dlsym( RTLD_NEXT, "pwrite"        );
+        symbols.pwrite64      = dlsym( RTLD_NEXT, "pwrite64"      );
+        symbols.writev        = dlsym( RTLD_NEXT, "writev"        );
+        symbols.pwritev       = dlsym( RTLD_NEXT, "pwritev"       );
+        symbols.pwritev64     = dlsym( RTLD_NEXT, "pwritev64"     );
+        symbols.pwritev2      = dlsym( RTLD_NEXT, "pwritev2"      );
+        symbols.pwritev64v2   = dlsym( RTLD_NEXT, "pwritev64v2"   );
+        symbols.mmap          = dlsym( RTLD_NEXT, "mmap"          );
+        symbols.mmap64        = dlsym( RTLD_NEXT, "mmap64"        );
+
+        symbols.sendfile        = dlsym( RTLD_NEXT, "sendfile"        );
+        symbols.sendfile64      = dlsym( RTLD_NEXT, "sendfile64"      );
+        symbols.copy_file_range = dlsym( RTLD_NEXT, "copy_file_range" );
+        symbols.splice          = dlsym( RTLD_NEXT, "splice"          );
+
+        symbols.aio_read     = dlsym( RTLD_NEXT, "aio_read"     );
+        symbols.aio_read64   = dlsym( RTLD_NEXT, "aio_read64"   );
+        symbols.aio_write    = dlsym( RTLD_NEXT, "aio_write"    );
+        symbols.aio_write64  = dlsym( RTLD_NEXT, "aio_write64"  );
+        symbols.lio_listio   = dlsym( RTLD_NEXT, "lio_listio"   );
+        symbols.lio_listio64 = dlsym( RTLD_NEXT, "lio_listio64" );
+
+        symbols.close      = dlsym( RTLD_NEXT, "close"    );
+        symbols.dup        = dlsym( RTLD_NEXT, "dup"      );
+        symbols.dup2       = dlsym( RTLD_NEXT, "dup2"     );
+        symbols.dup3       = dlsym( RTLD_NEXT, "dup3"     );
+        symbols.fcntl      = dlsym( RTLD_NEXT, "fcntl"    );
+        symbols.fcntl64    = dlsym( RTLD_NEXT, "fcntl64"  );
+
+        const char *down = getenv( DAEMON_DOWN_ERRNO_ENV );
+        for ( size_t i = 0;
+              ( down != NULL )
+              && ( i < sizeof( daemon_down_errors )
+                       / sizeof( daemon_down_errors[0] ) );
+              i++ ) {
+                if ( strcmp( down, daemon_down_errors[i].name ) == 0 ) {
+                        daemon_down_errno = daemon_down_errors[i].value;
+                }
+        }
+
+        /* deferred recalls are opt-in: descriptors passed to another program
+           through exec() are not tracked there */
+        const char *lazy = getenv( LAZY_RECALL_ENV );
+        if ( ( lazy != NULL ) && ( strcmp( lazy, "1" ) == 0 ) ) {
+                long open_max = sysconf( _SC_OPEN_MAX );
+                if ( ( open_max <= 0 ) || ( open_max > DEFERRED_MAX_FDS ) ) {
+                        open_max = DEFERRED_MAX_FDS;
+                }
+
+                /* on failure every recall simply happens in open() */
+                recalls = calloc( open_max, sizeof( recall_t ) );
+                recalls_size = ( recalls != NULL ) ? open_max : 0;
+        }
 }
 
 
+/**
+ * @brief probe_xattr Check whether a file has an extended attribute.
+ *
+ * @param[in] fd    File descriptor of the file.
+ * @param[in] flags Flags with which file descriptor was opened.
+ * @param[in] xattr Extended attribute id from the list of known
+ *                  extended attributes.
+ *
+ * @return a size of the attribute's value or -1 with errno set
+ */
+static ssize_t probe_xattr( int fd, int flags, enum xattr_enum xattr ) {
+        /* fsetxattr with XATTR_REPLACE is not used as a probe of write-only
+           file descriptors, because it would destroy the file's meta-data
+           record; read it through /proc/self/fd/<fd> file path instead */
+        if ( ( flags & O_WRONLY ) == O_WRONLY ) {
+                char path[PROC_SELF_FD_FD_PATH_MAX_LEN];
+                snprintf(path,
+                         PROC_SELF_FD_FD_PATH_MAX_LEN,
+                         PROC_SELF_FD_FD_PATH_TEMPLATE,
+                         (unsigned long long int)fd);
+                return getxattr( path, xattr_str[xattr], NULL, 0 );
+        }
+
+        return fgetxattr( fd, xattr_str[xattr], NULL, 0 );
+}
+
 /**
  * @brief is_local_file Check a location of file by file descriptor
  *                             (local or remote).
@@ -102,83 +290,79 @@ void __attribute__ ((constructor)) init_syms(void) {
  *         -1: error happen during an attempt to get extended attribute's value
  */
 int is_local_file( int fd, int flags ) {
-        /* if file was opened in write-only mode, use fsetxattr with
-           XATTR_REPLACE which will produce result equivalent to fgetxattr */
-        int ret = ( ( flags & O_WRONLY ) == O_WRONLY )
-                  ? fsetxattr( fd, xattr_str[e_stub], NULL, 0, XATTR_REPLACE )
-                  : fgetxattr( fd, xattr_str[e_stub], NULL, 0 );
+        /* fstat(2) is served from the inode cache, unlike extended attribute
+           requests (and write probes for O_WRONLY descriptors) which are
+           network round trips on a distributed file system */
+        pthread_once( &once_control, init_vars_once );
+        if ( locations != NULL ) {
+                struct stat sb;
+                if ( fstat( fd, &sb ) == 0 ) {
+                        int64_t ctime_ns = (int64_t)sb.st_ctim.tv_sec
+                                           * 1000000000LL
+                                           + sb.st_ctim.tv_nsec;
+
+                        switch ( location_get( locations,
+                                               sb.st_dev,
+                                               sb.st_ino,
+                                               ctime_ns ) ) {
+                        case e_location_local:
+                                return 1;
+                        case e_location_remote:
+                                return 0;
+                        default:
+                                /* unknown or stale; ask the file itself */
+                                break;
+                        }
+                }
+        }
+
+        /* a stub of an earlier version has the stub attribute instead of
+           the meta attribute; it is converted on its first recall */
+        int ret = probe_xattr( fd, flags, e_meta );
+        if ( ( ret == -1 ) && ( errno == ENOATTR ) ) {
+                ret = probe_xattr( fd, flags, e_stub );
+        }
 
         if ( ret == -1 ) {
                 if ( IS_LOCAL_PREDICATE ) {
                         /* if ENOTSUP then the file not in our target filesystem
                            and we not manage lifecycle of this file,
-                           if ERANGE then e_stub attribute should have
-                           a value which is not possible according to then
-                           logic of this program and if ENOATTR then the file is
-                           definitely local by our convention which means that
-                           we can safetly report that file is local */
+                           ERANGE is not possible since only the size of
+                           the attribute is requested and if ENOATTR then
+                           the file is definitely local by our convention
+                           which means that we can safetly report that file
+                           is local */
                         return 1;
-                } else if ( errno == EPERM ) {
-                        /* only fsetxattr can produce this errno; we are here
-                           only in case linux-specific feature inode
-                           flags-attributes plays its role; more specifically
-                           either FS_APPEND_FL or FS_IMMUTABLE_FL flags
-                           are set (see setxattr(2) and ioctl_iflags(2));
-                           in many cases the current process can read the file
-                           either, so we want to get extended attribute using
-                           /proc/self/fd/<fd> file path and, if not works,
-                           give up and return error */
-                        char path[PROC_SELF_FD_FD_PATH_MAX_LEN];
-                        snprintf(path,
-                                 PROC_SELF_FD_FD_PATH_MAX_LEN,
-                                 PROC_SELF_FD_FD_PATH_TEMPLATE,
-                                 (unsigned long long int)fd);
-                        if ( getxattr( path, xattr_str[e_stub], NULL, 0) == -1 ) {
-                                if ( IS_LOCAL_PREDICATE ) {
-                                        /* as before, this conditional branch
-                                           indicates that file is local */
-                                        return 1;
-                                }
-
-                                /* we can do nothing here, return a error
-                                   produced by inner stat call */
-                                return -1;
-                        }
-
-                        /* e_stub atribute is set which means that file
-                           is remote */
-                        return 0;
-                } else {
-                        /* errors from stat(2) which should be handled
-                           separately in each public libc wrapper function
-                           so we return the error here */
-                        return -1;
                 }
+
+                /* errors from stat(2) which should be handled
+                   separately in each public libc wrapper function
+                   so we return the error here */
+                return -1;
         }
 
-        /* e_stub atribute is set which means that file is remote */
+        /* e_meta or e_stub atribute is set which means that file is
+           remote */
         return 0;
 }
 
 /**
- * @brief clear_xattrs Remove all known extended attributes except e_locked.
+ * @brief clear_xattrs Remove all known extended attributes.
  *
- * @return  0: all known extended attributed were removed except e_locked
- *         -1: error happen during known extended attributes removal
- *             except e_locked; ENOATTR error is not an error and ignored
+ * @return  0: all known extended attributed were removed
+ *         -1: error happen during known extended attributes removal;
+ *             ENOATTR error is not an error and ignored
  */
 int clear_xattrs( int fd ) {
         int ret = 0;
-        /* e_locked, if currently set, will be removed by the daemon */
-
-        if (  ( fremovexattr( fd, xattr_str[e_stub] ) == -1 )
-           && ( errno != ENOATTR ) ) {
-                ret = -1;
-        }
 
-        if (  ( fremovexattr( fd, xattr_str[e_object_id] ) == -1 )
-           && ( errno != ENOATTR ) ) {
-                ret = -1;
+        for ( size_t i = 0;
+              i < sizeof( xattr_str ) / sizeof( xattr_str[0] );
+              ++i ) {
+                if (  ( fremovexattr( fd, xattr_str[i] ) == -1 )
+                   && ( errno != ENOATTR ) ) {
+                        ret = -1;
+                }
         }
 
         return ret;
@@ -192,41 +376,82 @@ static void init_vars_once( void ) {
         /* set process' pid */
         pid = getpid();
 
-        /* map shared memory region containing the queue */
-        if ( queue == NULL ) {
-                int fd = shm_open( QUEUE_SHM_OBJ, O_RDWR, 0 );
-                if ( fd == -1 ) {
-                        /* initialization result will be checked
-                           in the caller */
-                        return;
+        /* the queue of the process' recall class is attached on the first
+           recall; an unknown class stands for the default one */
+        const char *name = getenv( RECALL_CLASS_ENV );
+        for ( size_t i = 0;
+              ( name != NULL ) && ( i < RECALL_CLASSES_NUM );
+              i++ ) {
+                if ( strcmp( name, recall_class_str[i] ) == 0 ) {
+                        recall_class = i;
                 }
+        }
 
-                struct stat sb;
-                if ( fstat( fd, &sb ) == -1 ) {
-                        /* initialization result will be checked
-                           in the caller */
-                        return;
-                }
+        /* the daemon may start later; the page is attached then */
+        if ( status == NULL ) {
+                status_attach( &status, STATUS_SHM_OBJ );
+        }
+
+        /* the location cache is optional; locations are checked with
+           extended attributes without it */
+        if ( locations == NULL ) {
+                location_attach( &locations, LOCATION_SHM_OBJ );
+        }
 
-                queue = mmap( NULL,
-                              sb.st_size,
-                              PROT_READ | PROT_WRITE,
-                              MAP_SHARED,
-                              fd,
-                              0 );
+        /* without progress of recalls a reader waits for the whole file */
+        if ( progress == NULL ) {
+                progress_attach( &progress, PROGRESS_SHM_OBJ );
+        }
+}
 
-                if ( queue == MAP_FAILED ) {
-                        queue = NULL;
+/**
+ * @brief check_daemon Checks that the daemon is alive, so that callers do
+ *                     not wait for recalls which will never happen.
+ *
+ * @param[in,out] epoch An epoch of the daemon known to the caller or 0; it is
+ *                      updated if the daemon has restarted since then. May be
+ *                      NULL.
+ *
+ * @return  1: the daemon is alive, but it has restarted and may have lost
+ *             requests of the caller
+ *          0: the daemon is alive
+ *         -1: the daemon is not running; errno is set to a value selected
+ *             with DAEMON_DOWN_ERRNO_ENV (EIO by default)
+ */
+static int check_daemon( uint64_t *epoch ) {
+        pthread_once( &once_control, init_vars_once );
 
-                        /* initialization result will be checked
-                           in the caller */
-                        return;
+        const status_t *page = __atomic_load_n( &status, __ATOMIC_ACQUIRE );
+        if ( page == NULL ) {
+                /* the daemon has not been started before this process;
+                   a page mapped twice by racing threads is just leaked */
+                if ( status_attach( &page, STATUS_SHM_OBJ ) == -1 ) {
+                        errno = daemon_down_errno;
+                        return -1;
                 }
+
+                __atomic_store_n( &status, page, __ATOMIC_RELEASE );
         }
+
+        uint64_t current = 0;
+        if ( ! status_is_alive( page, &current ) ) {
+                errno = daemon_down_errno;
+                return -1;
+        }
+
+        if ( ( epoch == NULL ) || ( *epoch == current ) ) {
+                return 0;
+        }
+
+        int restarted = ( *epoch != 0 );
+        *epoch = current;
+
+        return restarted;
 }
 
 /**
- * @brief schedule_download Push file in the first priority download queue.
+ * @brief schedule_download Push file in the download queue of the process'
+ *                          recall class.
  *
  * @note Set errno to ENOMEM since this is the only kind of error
  *       within open-calls family that reflects system error.
@@ -234,13 +459,32 @@ static void init_vars_once( void ) {
  * @param[in] fd File descriptor to calculate "proc-path" to be pushed to queue.
  *
  * @return  0: file has been successfully pushed to queue;
- *         -1: error happen during opening of shared memory object containing
+ *         -1: the daemon is not running (errno is set by check_daemon()),
+ *             error happen during opening of shared memory object containing
  *             queue or queue push operation failed.
  */
 int schedule_download( int fd ) {
-        /* open shared memory object with queue if not already */
-        pthread_once( &once_control, init_vars_once );
-        if ( queue == NULL ) {
+        uint64_t epoch = 0;
+        if ( check_daemon( &epoch ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        /* a restarted daemon may have replaced the queue; a queue of the
+           previous daemon stays mapped, since other threads may use it */
+        pthread_mutex_lock( &queue_lock );
+        if ( ( queue == NULL ) || ( queue_epoch != epoch ) ) {
+                queue_t *attached = NULL;
+                if ( queue_attach( &attached,
+                                   recall_queue_shm_obj[recall_class] ) == 0 ) {
+                        __atomic_store_n( &queue, attached, __ATOMIC_RELEASE );
+                        queue_epoch = epoch;
+                }
+        }
+        queue_t *q = __atomic_load_n( &queue, __ATOMIC_ACQUIRE );
+        pthread_mutex_unlock( &queue_lock );
+
+        if ( q == NULL ) {
                 /* error happen during mapping of queue from shared memory */
                  errno = ENOMEM;
                 return -1;
@@ -253,10 +497,253 @@ int schedule_download( int fd ) {
                  (unsigned long long int)pid,
                  (unsigned long long int)fd);
 
-        if ( queue_push( queue, path, PROC_PID_FD_FD_PATH_MAX_LEN ) == -1 ) {
-                /* this is very unlikely situation with blocking
-                   push operation */
-                errno = ENOMEM;
+        /* a push into a full queue would block forever if the daemon dies,
+           so the daemon is checked each time the wait times out */
+        while ( queue_timed_push( q,
+                                  path,
+                                  PROC_PID_FD_FD_PATH_MAX_LEN,
+                                  RECALL_WAIT_MS ) == -1 ) {
+                if ( check_daemon( NULL ) == -1 ) {
+                        /* errno has been set inside that function */
+                        return -1;
+                }
+        }
+
+        return 0;
+}
+
+/**
+ * @brief defer_recall Records that a recall of a remote file has to be done
+ *                     on the first access to its data.
+ *
+ * @param[in] fd    File descriptor of the remote file.
+ * @param[in] flags Flags with which file descriptor was opened.
+ *
+ * @return  1: the recall has been deferred
+ *          0: deferred recalls are disabled or the descriptor is out of
+ *             the table; the file should be recalled right away
+ */
+int defer_recall( int fd, int flags ) {
+        if ( ( fd < 0 ) || ( (size_t)fd >= recalls_size ) ) {
+                return 0;
+        }
+
+        recalls[fd].flags = flags;
+        __atomic_store_n( &recalls[fd].state,
+                          e_recall_deferred,
+                          __ATOMIC_RELEASE );
+
+        return 1;
+}
+
+/**
+ * @brief start_recall Schedules a recall of a file and waits until the daemon
+ *                     starts it, so that data can be read as they arrive.
+ *
+ * @param[in]  fd    File descriptor of the file.
+ * @param[in]  flags Flags with which file descriptor was opened.
+ * @param[out] ref   The recall in the daemon's progress table.
+ *
+ * @return  1: the recall has been started; its progress is followed by ref
+ *          0: the file is local
+ *         -1: the recall has not been scheduled
+ */
+static int start_recall( int fd, int flags, progress_ref_t *ref ) {
+        int ret = is_local_file( fd, flags );
+        if ( ret != 0 ) {
+                return ( ret == -1 ) ? -1 : 0;
+        }
+
+        struct stat sb;
+        if ( ( progress == NULL ) || ( fstat( fd, &sb ) == -1 ) ) {
+                /* nothing to follow; wait for the whole file */
+                if ( ( schedule_download( fd ) == -1 )
+                     || ( poll_file_location( fd, flags ) == -1 ) ) {
+                        return -1;
+                }
+
+                return 0;
+        }
+
+        /* a recall in progress makes the file local anyway; a finished one
+           has been made before the file became remote again */
+        enum progress_state_enum state;
+        progress_ref_t stale = { .index = UINT32_MAX, .seq = 0 };
+        if ( progress_find( progress, sb.st_dev, sb.st_ino, ref, &state )
+             == 0 ) {
+                if ( state == e_progress_active ) {
+                        return 1;
+                }
+
+                stale = *ref;
+        }
+
+        if ( schedule_download( fd ) == -1 ) {
+                return -1;
+        }
+
+        uint64_t epoch = 0;
+        for ( ;; ) {
+                /* a restarted daemon may have lost the request */
+                int alive = check_daemon( &epoch );
+                if ( alive == 1 ) {
+                        alive = schedule_download( fd );
+                }
+
+                if ( alive == -1 ) {
+                        return -1;
+                }
+
+                /* read before the lookup, so that a recall started after
+                   the lookup wakes this thread up */
+                uint32_t starts = progress_starts( progress );
+
+                if ( ( progress_find( progress,
+                                      sb.st_dev,
+                                      sb.st_ino,
+                                      ref,
+                                      &state ) == 0 )
+                     && ( ( ref->index != stale.index )
+                          || ( ref->seq != stale.seq ) ) ) {
+                        return 1;
+                }
+
+                /* the daemon does not publish progress of a recall if the
+                   file is already local or its table is full */
+                ret = is_local_file( fd, flags );
+                if ( ret != 0 ) {
+                        return ( ret == -1 ) ? -1 : 0;
+                }
+
+                progress_wait_start( progress, starts, RECALL_WAIT_MS );
+        }
+}
+
+/**
+ * @brief follow_recall Waits until a given number of bytes from the beginning
+ *                      of a file being recalled is written.
+ *
+ * @param[in] fd    File descriptor of the file.
+ * @param[in] flags Flags with which file descriptor was opened.
+ * @param[in] ref   The recall in the daemon's progress table.
+ * @param[in] end   The number of bytes; UINT64_MAX waits for the whole file.
+ *
+ * @return  1: the recall has been completed
+ *          0: the data are available, but the recall is still in progress
+ *         -1: the recall has failed or the daemon is not running; errno is
+ *             set
+ */
+static int follow_recall( int fd,
+                          int flags,
+                          progress_ref_t ref,
+                          uint64_t end ) {
+        for ( ;; ) {
+                switch ( progress_wait( progress, ref, end, RECALL_WAIT_MS ) ) {
+                case e_progress_reached:
+                        return 0;
+
+                case e_progress_complete:
+                        return 1;
+
+                case e_progress_lost:
+                        /* the slot has been reused, so the recall has
+                           finished somehow */
+                        if ( is_local_file( fd, flags ) == 1 ) {
+                                return 1;
+                        }
+
+                        errno = EIO;
+                        return -1;
+
+                case e_progress_error:
+                        errno = EIO;
+                        return -1;
+
+                default:
+                        /* the daemon marks recalls of its previous run
+                           failed on restart, but it may not restart */
+                        if ( check_daemon( NULL ) == -1 ) {
+                                /* errno has been set inside that function */
+                                return -1;
+                        }
+                        break;
+                }
+        }
+}
+
+/**
+ * @brief await_recall Recalls a file if its recall has been deferred and
+ *                     waits until a part of the file is available.
+ *
+ * @note Concurrent accesses to the same descriptor may schedule the download
+ *       twice; the daemon skips a file which is local already.
+ *
+ * @param[in] fd    File descriptor which is about to be accessed.
+ * @param[in] end   A number of bytes from the beginning of the file which
+ *                  are about to be accessed; UINT64_MAX stands for the whole
+ *                  file.
+ * @param[in] start Non-zero if a deferred recall should be started.
+ *
+ * @return  0: the data are available
+ *         -1: the recall has failed; errno is set to EIO or to the error
+ *             selected for a daemon which is not running
+ */
+static int await_recall( int fd, uint64_t end, int start ) {
+        if ( ( fd < 0 ) || ( (size_t)fd >= recalls_size ) ) {
+                return 0;
+        }
+
+        recall_t *recall = &recalls[fd];
+
+        int state = __atomic_load_n( &recall->state, __ATOMIC_ACQUIRE );
+        if ( ( state == e_recall_deferred ) && start ) {
+                progress_ref_t ref;
+
+                int ret = start_recall( fd, recall->flags, &ref );
+                if ( ret == -1 ) {
+                        /* the recall is retried on the next access */
+                        if ( errno != daemon_down_errno ) {
+                                errno = EIO;
+                        }
+                        return -1;
+                }
+
+                if ( ret == 1 ) {
+                        recall->ref = ref;
+                }
+
+                /* do not change an entry of a descriptor which has been
+                   reused */
+                int new_state = ( ret == 1 ) ? e_recall_streaming
+                                             : e_recall_none;
+                if ( __atomic_compare_exchange_n( &recall->state,
+                                                  &state,
+                                                  new_state,
+                                                  0,
+                                                  __ATOMIC_ACQ_REL,
+                                                  __ATOMIC_ACQUIRE ) ) {
+                        state = new_state;
+                }
+        }
+
+        if ( state != e_recall_streaming ) {
+                return 0;
+        }
+
+        int ret = follow_recall( fd, recall->flags, recall->ref, end );
+        if ( ret != 0 ) {
+                /* a failed recall is retried on the next access */
+                __atomic_compare_exchange_n( &recall->state,
+                                             &state,
+                                             ( ret == 1 ) ? e_recall_none
+                                                          : e_recall_deferred,
+                                             0,
+                                             __ATOMIC_RELEASE,
+                                             __ATOMIC_RELAXED );
+        }
+
+        if ( ret == -1 ) {
+                /* errno has been set inside follow_recall() */
                 return -1;
         }
 
@@ -264,19 +751,237 @@ int schedule_download( int fd ) {
 }
 
 /**
- * TODO: completely rewrite and rename; current implementation do many kernel
- *       calls in the loop which is unacceptable; consider using
- *       signal SIGUSR1 or SIGUSR2 as a notification mechanism.
+ * @brief finish_deferred_recall Recalls a file if its recall has been
+ *                               deferred and waits for its completion.
+ *
+ * @param[in] fd File descriptor which is about to be accessed.
+ *
+ * @return  0: the file is local
+ *         -1: the recall has failed; errno is set to EIO
+ */
+int finish_deferred_recall( int fd ) {
+        return await_recall( fd, UINT64_MAX, 1 );
+}
+
+/**
+ * @brief finish_streamed_recall Waits for completion of a recall of a file
+ *                               if the file is being recalled; a deferred
+ *                               recall is not started.
+ *
+ * @param[in] fd File descriptor which is about to be accessed.
+ *
+ * @return  0: the file is not being recalled
+ *         -1: the recall has failed; errno is set to EIO
+ */
+int finish_streamed_recall( int fd ) {
+        return await_recall( fd, UINT64_MAX, 0 );
+}
+
+/**
+ * @brief await_file_data Recalls a file if its recall has been deferred and
+ *                        waits until a byte range of the file is available;
+ *                        sequential readers start reading as soon as the
+ *                        first data of the file arrive.
+ *
+ * @param[in] fd     File descriptor which is about to be read.
+ * @param[in] offset An offset of the range or -1 for the current file offset
+ *                   of the descriptor.
+ * @param[in] count  A length of the range.
+ *
+ * @return  0: the data are available
+ *         -1: the recall has failed; errno is set to EIO
+ */
+int await_file_data( int fd, off_t offset, size_t count ) {
+        if ( ( fd < 0 ) || ( (size_t)fd >= recalls_size )
+             || ( __atomic_load_n( &recalls[fd].state, __ATOMIC_ACQUIRE )
+                  == e_recall_none ) ) {
+                return 0;
+        }
+
+        if ( offset < 0 ) {
+                offset = lseek( fd, 0, SEEK_CUR );
+        }
+
+        /* reads past the file's end wait for the end of the recall */
+        uint64_t end = ( ( offset < 0 ) || ( count > UINT64_MAX - offset ) )
+                       ? UINT64_MAX
+                       : (uint64_t)offset + count;
+
+        return await_recall( fd, end, 1 );
+}
+
+/**
+ * @brief move_deferred_recall Copies a state of a deferred recall to
+ *                             a duplicate of a file descriptor.
+ *
+ * @param[in] old_fd An original file descriptor.
+ * @param[in] new_fd A duplicate of the file descriptor.
+ */
+void move_deferred_recall( int old_fd, int new_fd ) {
+        if ( ( new_fd < 0 ) || ( (size_t)new_fd >= recalls_size ) ) {
+                return;
+        }
+
+        int state = e_recall_none;
+        if ( ( old_fd >= 0 ) && ( (size_t)old_fd < recalls_size ) ) {
+                state = __atomic_load_n( &recalls[old_fd].state,
+                                         __ATOMIC_ACQUIRE );
+                recalls[new_fd].flags = recalls[old_fd].flags;
+                recalls[new_fd].ref = recalls[old_fd].ref;
+        }
+
+        __atomic_store_n( &recalls[new_fd].state, state, __ATOMIC_RELEASE );
+}
+
+/**
+ * @brief forget_deferred_recall Drops a deferred recall of a file descriptor
+ *                               which is being closed.
+ *
+ * @param[in] fd File descriptor.
+ */
+void forget_deferred_recall( int fd ) {
+        if ( ( fd < 0 ) || ( (size_t)fd >= recalls_size ) ) {
+                return;
+        }
+
+        __atomic_store_n( &recalls[fd].state, e_recall_none, __ATOMIC_RELEASE );
+}
+
+/**
+ * @brief prepare_opened_file Makes a just opened file usable: a remote file
+ *                            is recalled (or its recall is deferred) unless
+ *                            it is being truncated to zero length, in which
+ *                            case it simply becomes an empty local file.
+ *
+ * @note The file descriptor is left open in any case.
+ *
+ * @param[in] fd          File descriptor of the opened file.
+ * @param[in] flags       Flags with which file descriptor was opened;
+ *                        O_TRUNC tells that the file is truncated.
+ * @param[in] allow_defer Non-zero if the recall may be deferred until the
+ *                        first access to data (only accesses through the
+ *                        wrapped system calls can be intercepted, which is
+ *                        not the case for stdio streams).
+ *
+ * @return  0: the file can be used
+ *         -1: errors happen; errno is set to a value valid for open(2)
  */
-int poll_file_location( int fd, int flags, int should_wait ) {
-        /* TODO: completely rewrite; current implementation do many kernel
-                 calls in the loop which is unacceptable; consider using
-                 signal SIGUSR1 or SIGUSR2 as a notification mechanism */
+int prepare_opened_file( int fd, int flags, int allow_defer ) {
+        /* determine whether file local or remote and if remote,
+           schedule its download in daemon */
+
+        int ret = is_local_file( fd, flags );
+
+        /* handle the case when the file is local */
+        if ( ret && ( ret != -1 ) ) {
+                /* file is local; no need to download it */
+                return 0;
+        }
+
+        /* handle the case when the file is remote */
+        if ( ret == 0 ) {
+                /* check O_TRUNC flag and avoid unnessesary download */
+                if ( ( ( flags & O_TRUNC ) == O_TRUNC ) ) {
+                        /* if O_TRUNC is used with flags other than O_RDWR
+                           and O_WRONLY then open() behaviour is unspecified
+                           (see open(2)) */
+
+                        /* NOTE: errors in clean_xattr, except ENOATTR are
+                                 impossible as long as the programs logic is
+                                 correct */
+                        if ( clear_xattrs( fd ) == -1 ) {
+                                /* can do nothing in case of failure */
+                                errno = EIO;
+                                return -1;
+                        }
+
+                        return 0;
+                }
+
+                /* the file is recalled on the first access to its data;
+                   open-and-fstat tools never trigger a recall then */
+                if ( allow_defer && defer_recall( fd, flags ) ) {
+                        return 0;
+                }
+
+                if ( schedule_download( fd ) == -1 ) {
+                        /* errno has been set inside that function */
+                        return -1;
+                }
+
+                if ( poll_file_location( fd, flags ) == -1 ) {
+                        /* errno has been set inside that function */
+                        return -1;
+                }
+
+                /* by now we do not pass file descriptors to the daemon and
+                   that is why we are still on the 0 offset */
+                return 0;
+        }
+
+        /* is_file_local() returned a error, hence stat() errors should
+           be handled here; the only error that does not have analog in
+           open() for our case (when we use file descriptor
+           for fstat()) is EBADF;
+           for nearly impossible situations, such as "during this call
+           another thread called close() with this file descriptor",
+           return EIO error, which is not specified as a possible return
+           values of this call */
+        errno = ( errno == EBADFD ) ? EIO : errno;
+        return -1;
+}
+
+/**
+ * @brief poll_file_location Waits until a file being recalled is local.
+ *
+ * @note The location is checked whenever a recall begins, as published in
+ *       the daemon's progress table, and at least every RECALL_WAIT_MS
+ *       milliseconds.
+ *
+ * @param[in] fd    File descriptor of the file.
+ * @param[in] flags Flags with which file descriptor was opened.
+ *
+ * @return  0: the file is local
+ *         -1: error happened; errno is set
+ */
+int poll_file_location( int fd, int flags ) {
         int ret = -1;
+        uint64_t epoch = 0;
+
+        for ( ;; ) {
+                /* a dead daemon will never recall the file, a restarted one
+                   may have lost the request */
+                int alive = check_daemon( &epoch );
+                if ( alive == 1 ) {
+                        alive = schedule_download( fd );
+                }
+
+                if ( alive == -1 ) {
+                        /* errno has been set inside these functions */
+                        return -1;
+                }
+
+                /* read before the check, so that a recall started after
+                   the check wakes this thread up */
+                uint32_t starts = ( progress != NULL )
+                                  ? progress_starts( progress )
+                                  : 0;
 
-        do {
                 ret = is_local_file( fd, flags );
-        } while ( ret == 0 );
+                if ( ret != 0 ) {
+                        break;
+                }
+
+                if ( progress != NULL ) {
+                        progress_wait_start( progress, starts, RECALL_WAIT_MS );
+                } else {
+                        struct timespec ts = {
+                                .tv_sec  = RECALL_WAIT_MS / 1000,
+                                .tv_nsec = ( RECALL_WAIT_MS % 1000 ) * 1000000L,
+                        };
+                        nanosleep( &ts, NULL );
+                }
+        }
 
         return ( ret == -1 ) ? -1 : 0;
 }
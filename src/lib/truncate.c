@@ -15,4 +15,167 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-/* TODO: implement an optimization possible with truncate() call */
+#define _GNU_SOURCE        /* needed for off64_t */
+
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "syms.h"
+
+/**
+ * Common part of truncate(2) and ftruncate(2) system call redefinitions.
+ * A stub truncated to zero length becomes an empty local file without
+ * a download (like open() with O_TRUNC); truncation to another length needs
+ * the file's data, so the file is recalled first.
+ */
+static inline int prepare_truncate_common( int fd, off64_t length ) {
+        int flags = fcntl( fd, F_GETFL );
+        if ( flags == -1 ) {
+                /* proper errno was set in the fcntl() call */
+                return -1;
+        }
+
+        /* a descriptor opened only for reading can not be truncated;
+           let the system call report the error without touching the file */
+        if ( ( flags & O_ACCMODE ) == O_RDONLY ) {
+                return 0;
+        }
+
+        /* data still being written by the daemon would overwrite
+           the truncated file */
+        if ( finish_streamed_recall( fd ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        if ( length == 0 ) {
+                flags |= O_TRUNC;
+        }
+
+        /* on errno will be set inside prepare_opened_file() */
+        return prepare_opened_file( fd, flags, 0 );
+}
+
+/**
+ * Calls truncate(2) or truncate64() of the C library.
+ */
+static inline int real_truncate( const char *path, off64_t length, int large ) {
+        return large ? get_syms()->truncate64( path, length )
+                     : get_syms()->truncate( path, (off_t)length );
+}
+
+/**
+ * Common part of truncate(2) and truncate64() redefinitions.
+ */
+static inline int truncate_common( const char *path,
+                                   off64_t length,
+                                   int large ) {
+        /* the file is truncated through a descriptor, so that the checked
+           file is the truncated one; truncate(2) needs write permission as
+           open(2) with O_WRONLY does; O_NONBLOCK and O_NOCTTY keep opening
+           of a FIFO or a terminal from blocking or changing anything */
+        int fd = get_syms()->open( path,
+                                   O_WRONLY | O_NONBLOCK | O_NOCTTY
+                                   | O_CLOEXEC );
+        if ( fd == -1 ) {
+                /* a FIFO without readers can not be opened in non-blocking
+                   mode, but truncate(2) reports its own error for it */
+                if ( errno == ENXIO ) {
+                        return real_truncate( path, length, large );
+                }
+
+                /* proper errno was set in the open() call */
+                return -1;
+        }
+
+        /* only regular files are managed; whatever else truncate(2) does
+           with a path is left to it */
+        struct stat sb;
+        int ret = fstat( fd, &sb );
+        if ( ( ret == 0 ) && ! S_ISREG( sb.st_mode ) ) {
+                close( fd );
+
+                return real_truncate( path, length, large );
+        }
+
+        if ( ret == 0 ) {
+                ret = prepare_truncate_common( fd, length );
+        }
+
+        if ( ret == 0 ) {
+                ret = get_syms()->ftruncate64( fd, length );
+        }
+
+        int err = errno;
+        close( fd );
+        errno = err;
+
+        return ret;
+}
+
+/**
+ * Redefinition of truncate(2) system call.
+ */
+int truncate( const char *path, off_t length ) {
+        if ( ( get_syms()->open == NULL )
+             || ( get_syms()->truncate == NULL )
+             || ( get_syms()->ftruncate64 == NULL ) ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        return truncate_common( path, length, 0 );
+}
+
+/**
+ * Redefinition of truncate64(); programs compiled with _FILE_OFFSET_BITS=64
+ * call it instead of truncate(2).
+ */
+int truncate64( const char *path, off64_t length ) {
+        if ( ( get_syms()->open == NULL )
+             || ( get_syms()->truncate64 == NULL )
+             || ( get_syms()->ftruncate64 == NULL ) ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        return truncate_common( path, length, 1 );
+}
+
+/**
+ * Redefinition of ftruncate(2) system call.
+ */
+int ftruncate( int fd, off_t length ) {
+        if ( get_syms()->ftruncate == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( prepare_truncate_common( fd, length ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->ftruncate( fd, length );
+}
+
+/**
+ * Redefinition of ftruncate64(); programs compiled with
+ * _FILE_OFFSET_BITS=64 call it instead of ftruncate(2).
+ */
+int ftruncate64( int fd, off64_t length ) {
+        if ( get_syms()->ftruncate64 == NULL ) {
+                errno = ELIBACC;
+                return -1;
+        }
+
+        if ( prepare_truncate_common( fd, length ) == -1 ) {
+                /* errno has been set inside that function */
+                return -1;
+        }
+
+        return get_syms()->ftruncate64( fd, length );
+}
@@ -0,0 +1,92 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bloom.h"
+
+#define KEYS_NUM    10000
+
+int test_bloom(char *err_msg) {
+        bloom_t bloom;
+
+        if (bloom_init(&bloom, 0) != -1) {
+                strcpy(err_msg, "[bloom_init] should fail on zero capacity");
+                return -1;
+        }
+
+        if (bloom_init(&bloom, KEYS_NUM) == -1) {
+                strcpy(err_msg, "[bloom_init] failed");
+                return -1;
+        }
+
+        /* sequential keys resemble inode numbers */
+        for (uint64_t key = 0; key < KEYS_NUM; key++) {
+                bloom_add(&bloom, key);
+        }
+
+        for (uint64_t key = 0; key < KEYS_NUM; key++) {
+                if (!bloom_test(&bloom, key)) {
+                        sprintf(err_msg,
+                                "[bloom_test] added key %llu is not found",
+                                (unsigned long long)key);
+                        goto err;
+                }
+        }
+
+        if (bloom_full(&bloom)) {
+                strcpy(err_msg, "[bloom_full] filter within its capacity is "
+                                "full");
+                goto err;
+        }
+
+        size_t false_positives = 0;
+        for (uint64_t key = KEYS_NUM; key < 2 * KEYS_NUM; key++) {
+                false_positives += bloom_test(&bloom, key);
+        }
+
+        /* about 1% is expected */
+        if (false_positives > KEYS_NUM / 20) {
+                sprintf(err_msg,
+                        "[bloom_test] too many false positives [%zu of %d]",
+                        false_positives,
+                        KEYS_NUM);
+                goto err;
+        }
+
+        bloom_add(&bloom, KEYS_NUM);
+        if (!bloom_full(&bloom)) {
+                strcpy(err_msg, "[bloom_full] filter over its capacity is "
+                                "not full");
+                goto err;
+        }
+
+        bloom_clear(&bloom);
+        if (bloom_test(&bloom, 0) || bloom_full(&bloom)) {
+                strcpy(err_msg, "[bloom_clear] filter is not empty");
+                goto err;
+        }
+
+        bloom_free(&bloom);
+
+        return 0;
+
+    err:
+        bloom_free(&bloom);
+        return -1;
+}
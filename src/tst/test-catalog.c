@@ -0,0 +1,105 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "catalog.h"
+
+#define CATALOG_FILE        "./test-catalog.file"
+#define CATALOG_CAPACITY    64
+#define CATALOG_DEV         7
+
+int test_catalog(char *err_msg) {
+        catalog_t *catalog = NULL;
+
+        unlink(CATALOG_FILE);
+
+        if (catalog_open(&catalog, CATALOG_FILE, CATALOG_CAPACITY) == -1) {
+                strcpy(err_msg, "[catalog_open] failed to create catalog");
+                return -1;
+        }
+
+        if (catalog_begin_pass(catalog, CATALOG_DEV) != 0) {
+                strcpy(err_msg, "[catalog_begin_pass] new catalog should not "
+                                "be complete");
+                goto err;
+        }
+
+        /* inode numbers are mostly sequential */
+        for (ino_t ino = 1; ino <= CATALOG_CAPACITY / 2; ino++) {
+                catalog_entry_t *entry = catalog_insert(catalog, ino);
+                if (entry == NULL || entry->ino != ino) {
+                        strcpy(err_msg, "[catalog_insert] failed to insert "
+                                        "entry");
+                        goto err;
+                }
+
+                entry->state = e_catalog_local;
+                entry->size = (int64_t)ino;
+        }
+
+        if (catalog_insert(catalog, 1) != catalog_lookup(catalog, 1) ||
+            catalog->count != CATALOG_CAPACITY / 2) {
+                strcpy(err_msg, "[catalog_insert] should find existing entry");
+                goto err;
+        }
+
+        if (catalog_lookup(catalog, CATALOG_CAPACITY) != NULL) {
+                strcpy(err_msg, "[catalog_lookup] found nonexistent entry");
+                goto err;
+        }
+
+        catalog_end_pass(catalog, 1);
+        catalog_close(catalog);
+        catalog = NULL;
+
+        /* entries should survive reopening */
+        if (catalog_open(&catalog, CATALOG_FILE, CATALOG_CAPACITY) == -1) {
+                strcpy(err_msg, "[catalog_open] failed to reopen catalog");
+                goto err;
+        }
+
+        catalog_entry_t *entry = catalog_lookup(catalog, 3);
+        if (entry == NULL ||
+            entry->state != e_catalog_local ||
+            entry->size != 3 ||
+            catalog_begin_pass(catalog, CATALOG_DEV) != 1) {
+                strcpy(err_msg, "[catalog_open] catalog has not been "
+                                "persisted");
+                goto err;
+        }
+
+        /* another file system invalidates the catalog */
+        if (catalog_begin_pass(catalog, CATALOG_DEV + 1) != 0 ||
+            catalog_lookup(catalog, 3) != NULL) {
+                strcpy(err_msg, "[catalog_begin_pass] catalog should be "
+                                "reset on device change");
+                goto err;
+        }
+
+        catalog_close(catalog);
+        unlink(CATALOG_FILE);
+
+        return 0;
+
+    err:
+        catalog_close(catalog);
+        unlink(CATALOG_FILE);
+        return -1;
+}
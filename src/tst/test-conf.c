@@ -36,13 +36,34 @@ static const char *test_conf_str = \
         "</General>\n"                                      \
         "<Internal>\n"                                      \
         "    ScanfsIterTimeoutSec          100\n"           \
+        "    ScanfsThreads                 8\n"             \
+        "    ScanfsMaxDelayMsec            50\n"            \
+        "    ScanfsIoPressureLimit         20.5\n"          \
+        "    CatalogPath                   /var/bar\n"      \
+        "    CatalogMaxEntries             1024\n"          \
+        "    CatalogFullScanPasses         5\n"             \
+        "    ShardDir                      /tmp/shards\n"   \
+        "    ShardNodeName                 node-1\n"        \
+        "    ShardLeaseSec                 120\n"           \
+        "    LocationCacheEntries          2048\n"          \
+        "    RemoteFilterMaxEntries        1000\n"          \
+        "    HeartbeatPeriodMsec           250\n"           \
+        "    PackMaxFileSize               4096\n"          \
+        "    PackMaxObjectSize             1048576\n"       \
+        "    PackMaxFiles                  64\n"            \
+        "    PrefetchDepth                 6\n"             \
         "    MoveOutStartRate              0.8\n"           \
         "    MoveOutStopRate               0.7\n"           \
         "    PrimaryDownloadQueueMaxSize   111\n"           \
         "    SecondaryDownloadQueueMaxSize 222\n"           \
         "    PrimaryUploadQueueMaxSize     333\n"           \
         "    SecondaryUploadQueueMaxSize   444\n"           \
+        "    QueueJournalDir               /var/foo\n"      \
         "</Internal>\n"                                     \
+        "<Policy>\n"                                        \
+        "    Rule exclude uid=0 path=/foo/bar/tmp/*\n"      \
+        "    Rule evict   size>=1M atime>7d\n"              \
+        "</Policy>\n"                                       \
         "<S3RemoteStore>\n"                                 \
         "    Hostname                 s3_hostname\n"        \
         "    Bucket                   s3.bucket\n"          \
@@ -102,12 +123,30 @@ int test_conf(char *err_msg) {
             strcmp(conf->remote_store_protocol, "s3") ||
             strcmp(conf->transfer_protocol, "https") ||
             conf->scanfs_iter_tm_sec != 100 ||
+            conf->scanfs_threads != 8 ||
+            conf->scanfs_max_delay_msec != 50 ||
+            conf->scanfs_io_pressure_limit != 20.5 ||
+            strcmp(conf->catalog_path, "/var/bar") ||
+            conf->catalog_max_entries != 1024 ||
+            conf->catalog_full_scan_passes != 5 ||
+            strcmp(conf->shard_dir, "/tmp/shards") != 0 ||
+            strcmp(conf->shard_node_name, "node-1") != 0 ||
+            conf->shard_lease_sec != 120 ||
+            conf->location_cache_entries != 2048 ||
+            conf->remote_filter_max_entries != 1000 ||
+            conf->heartbeat_period_msec != 250 ||
+            conf->pack_max_file_size != 4096 ||
+            conf->pack_max_object_size != 1048576 ||
+            conf->pack_max_files != 64 ||
+            conf->prefetch_depth != 6 ||
             conf->move_out_start_rate != 0.8 ||
             conf->move_out_stop_rate != 0.7 ||
             conf->primary_download_queue_max_size != 111 ||
             conf->secondary_download_queue_max_size != 222 ||
             conf->primary_upload_queue_max_size != 333 ||
             conf->secondary_upload_queue_max_size != 444 ||
+            strcmp(conf->queue_journal_dir, "/var/foo") ||
+            conf->rules.count != 2 ||
             conf->s3_operation_retries != 5 ||
             conf->path_max != (127 + 1) ||
             log->type != e_simple
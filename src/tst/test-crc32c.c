@@ -0,0 +1,128 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "crc32c.h"
+
+#define DATA_SIZE    4096
+
+/* an implementation under test */
+typedef uint32_t (*crc32c_fn)(uint32_t crc, const void *buf, size_t len);
+
+/* a buffer of data which are not a repetition of a short pattern; extra
+   bytes let chunks start at any alignment */
+static unsigned char buf[DATA_SIZE + 8];
+
+/**
+ * Checks an implementation against values of RFC 3720 (iSCSI), appendix B.4,
+ * and checks that a checksum does not depend on how data are split.
+ */
+static int test_impl(const char *name, crc32c_fn fn, char *err_msg) {
+        unsigned char data[32];
+
+        memset(data, 0, sizeof(data));
+        if (fn(0, data, sizeof(data)) != 0x8a9136aa) {
+                sprintf(err_msg, "[%s] wrong checksum of 32 zero bytes",
+                        name);
+                return -1;
+        }
+
+        memset(data, 0xff, sizeof(data));
+        if (fn(0, data, sizeof(data)) != 0x62a8ab43) {
+                sprintf(err_msg, "[%s] wrong checksum of 32 0xff bytes",
+                        name);
+                return -1;
+        }
+
+        for (int i = 0; i < 32; i++) {
+                data[i] = i;
+        }
+        if (fn(0, data, sizeof(data)) != 0x46dd794e) {
+                sprintf(err_msg, "[%s] wrong checksum of 32 incrementing "
+                                 "bytes", name);
+                return -1;
+        }
+
+        if (fn(0, "123456789", 9) != 0xe3069283 || fn(0, NULL, 0) != 0) {
+                sprintf(err_msg, "[%s] wrong checksum of short data", name);
+                return -1;
+        }
+
+        /* a checksum does not depend on how data are split into chunks
+           and on alignment of the chunks */
+        uint32_t whole = fn(0, buf + 1, DATA_SIZE);
+        for (size_t chunk = 1; chunk <= 13; chunk++) {
+                uint32_t crc = 0;
+                for (size_t pos = 0; pos < DATA_SIZE; pos += chunk) {
+                        size_t len = (DATA_SIZE - pos < chunk) ?
+                                     DATA_SIZE - pos : chunk;
+                        crc = fn(crc, buf + 1 + pos, len);
+                }
+
+                if (crc != whole) {
+                        sprintf(err_msg, "[%s] checksum depends on chunks "
+                                         "of data", name);
+                        return -1;
+                }
+        }
+
+        return 0;
+}
+
+int test_crc32c(char *err_msg) {
+        for (int i = 0; i < DATA_SIZE + 8; i++) {
+                buf[i] = (unsigned char)(i * 131 + 7);
+        }
+
+        /* crc32c() uses the crc32 instruction where the processor has it */
+        if (test_impl("crc32c", crc32c, err_msg) == -1 ||
+            test_impl("crc32c_sw", crc32c_sw, err_msg) == -1) {
+                return -1;
+        }
+
+        /* both implementations agree on data of any alignment and length,
+           also when a chunk ends in the middle of a word */
+        for (size_t offset = 0; offset < 8; offset++) {
+                for (size_t len = 0; len <= 64; len++) {
+                        size_t split = len / 3;
+                        uint32_t hw = crc32c(crc32c(0, buf + offset, split),
+                                             buf + offset + split,
+                                             len - split);
+                        uint32_t sw = crc32c_sw(0, buf + offset, len);
+
+                        if (hw != sw ||
+                            crc32c_sw(crc32c(0, buf + offset, split),
+                                      buf + offset + split,
+                                      len - split) != sw) {
+                                strcpy(err_msg, "[crc32c] implementations "
+                                                "disagree");
+                                return -1;
+                        }
+                }
+
+                if (crc32c(0, buf + offset, DATA_SIZE) !=
+                    crc32c_sw(0, buf + offset, DATA_SIZE)) {
+                        strcpy(err_msg, "[crc32c] implementations disagree "
+                                        "on a page of data");
+                        return -1;
+                }
+        }
+
+        return 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE    200112L
+
+#include <string.h>
+#include <sys/mman.h>
+
+#include "location.h"
+
+#define TEST_SHM_OBJ    "/" PROGRAM_NAME "-test-locations"
+#define FILES_NUM       (4 * LOCATION_WAYS)
+
+int test_location(char *err_msg) {
+        location_t *loc;
+        const location_t *reader;
+
+        shm_unlink(TEST_SHM_OBJ);
+
+        /* a single bucket, so that entries replace each other */
+        if (location_create(&loc, TEST_SHM_OBJ, LOCATION_WAYS) == -1) {
+                strcpy(err_msg, "[location_create] failed");
+                return -1;
+        }
+
+        if (location_attach(&reader, TEST_SHM_OBJ) == -1) {
+                strcpy(err_msg, "[location_attach] failed");
+                goto err;
+        }
+
+        if (location_get(reader, 1, 2, 3) != e_location_unknown) {
+                strcpy(err_msg, "[location_get] empty table knows a file");
+                goto err;
+        }
+
+        location_set(loc, 1, 2, 3, e_location_remote);
+        if (location_get(reader, 1, 2, 3) != e_location_remote) {
+                strcpy(err_msg, "[location_get] recorded location is not "
+                                "found");
+                goto err;
+        }
+
+        /* a file whose status has changed is not known */
+        if (location_get(reader, 1, 2, 4) != e_location_unknown ||
+            location_get(reader, 2, 2, 3) != e_location_unknown) {
+                strcpy(err_msg, "[location_get] stale entry is used");
+                goto err;
+        }
+
+        location_set(loc, 1, 2, 4, e_location_local);
+        if (location_get(reader, 1, 2, 4) != e_location_local) {
+                strcpy(err_msg, "[location_set] entry is not updated");
+                goto err;
+        }
+
+        /* the most recent entries survive an overflow of a bucket */
+        for (uint64_t ino = 100; ino < 100 + FILES_NUM; ino++) {
+                location_set(loc, 1, ino, 5, e_location_remote);
+                if (location_get(reader, 1, ino, 5) != e_location_remote) {
+                        strcpy(err_msg, "[location_set] entry is not stored "
+                                        "in a full bucket");
+                        goto err;
+                }
+        }
+
+        shm_unlink(TEST_SHM_OBJ);
+
+        return 0;
+
+    err:
+        shm_unlink(TEST_SHM_OBJ);
+        return -1;
+}
@@ -0,0 +1,66 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "lock.h"
+
+#define FILES_NUM    1024    /* more than the number of hash chains */
+
+int test_lock(char *err_msg) {
+        for (ino_t ino = 1; ino <= FILES_NUM; ino++) {
+                if (lock_inode(1, ino) == -1) {
+                        strcpy(err_msg, "[lock_inode] failed to lock file");
+                        return -1;
+                }
+        }
+
+        if (lock_inode(1, FILES_NUM / 2) != -1) {
+                strcpy(err_msg, "[lock_inode] locked file twice");
+                return -1;
+        }
+
+        /* the same inode number on another device is another file */
+        if (lock_inode(2, FILES_NUM / 2) == -1 ||
+            unlock_inode(2, FILES_NUM / 2) == -1) {
+                strcpy(err_msg, "[lock_inode] files of different devices "
+                                "are not told apart");
+                return -1;
+        }
+
+        for (ino_t ino = 1; ino <= FILES_NUM; ino++) {
+                if (unlock_inode(1, ino) == -1) {
+                        strcpy(err_msg, "[unlock_inode] failed to unlock "
+                                        "locked file");
+                        return -1;
+                }
+        }
+
+        if (unlock_inode(1, 1) != -1) {
+                strcpy(err_msg, "[unlock_inode] unlocked file which is not "
+                                "locked");
+                return -1;
+        }
+
+        /* an unlocked file can be locked again */
+        if (lock_inode(1, 1) == -1 || unlock_inode(1, 1) == -1) {
+                strcpy(err_msg, "[lock_inode] failed to lock unlocked file");
+                return -1;
+        }
+
+        return 0;
+}
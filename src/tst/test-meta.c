@@ -0,0 +1,172 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _DEFAULT_SOURCE    /* needed for fsetxattr() */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/xattr.h>
+
+#include "meta.h"
+#include "file.h"
+#include "defs.h"
+
+#define ID_SIZE        64
+#define BUF_SIZE       ( META_HEADER_SIZE + ID_SIZE )
+#define LEGACY_FILE    "./test-meta-legacy"
+
+/* a stub of an earlier version is remote and is converted to a record */
+static int test_legacy_stub(char *err_msg) {
+        char object_id[ID_SIZE] = "0123456789abcdef";
+        meta_t meta;
+        int ret = -1;
+
+        int fd = open(LEGACY_FILE, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (fd == -1) {
+                strcpy(err_msg, "[legacy stub] failed to create test file");
+                return -1;
+        }
+
+        /* earlier versions padded the object id to its maximum size */
+        if (fsetxattr(fd, XATTR_KEY(object_id), object_id, ID_SIZE, 0) == -1 ||
+            fsetxattr(fd, XATTR_KEY(stub), NULL, 0, 0) == -1) {
+                ret = (errno == ENOTSUP) ? 0 : -1;
+                strcpy(err_msg, "[legacy stub] failed to set attributes");
+                goto out;
+        }
+
+        if (is_remote_file(fd) != 1 || is_remote_file(LEGACY_FILE) != 1) {
+                strcpy(err_msg, "[is_remote_file] legacy stub should be "
+                                "remote");
+                goto out;
+        }
+
+        memset(object_id, 0, ID_SIZE);
+        if (get_meta(fd, &meta, object_id, ID_SIZE) != 0 ||
+            meta.state != e_meta_remote ||
+            meta.flags != 0 ||
+            strcmp(object_id, "0123456789abcdef") != 0) {
+                strcpy(err_msg, "[get_meta] legacy stub should be converted");
+                goto out;
+        }
+
+        /* the record replaces the legacy attributes */
+        if (fgetxattr(fd, XATTR_KEY(meta), NULL, 0) == -1 ||
+            fgetxattr(fd, XATTR_KEY(stub), NULL, 0) != -1 ||
+            fgetxattr(fd, XATTR_KEY(object_id), NULL, 0) != -1 ||
+            is_remote_file(fd) != 1) {
+                strcpy(err_msg, "[get_meta] legacy attributes should be "
+                                "replaced with a record");
+                goto out;
+        }
+
+        ret = 0;
+
+out:
+        close(fd);
+        unlink(LEGACY_FILE);
+
+        return ret;
+}
+
+int test_meta(char *err_msg) {
+        unsigned char buf[BUF_SIZE];
+        char object_id[ID_SIZE];
+        meta_t meta = {
+                .state    = e_meta_remote,
+                .flags    = META_FLAG_PACKED,
+                .size     = 0x123456789ULL,
+                .mtime_ns = -42,
+                .checksum = 0xe3069283,
+        };
+        meta_t decoded;
+
+        size_t len = meta_encode(buf, BUF_SIZE, &meta, "packs/x@0:1");
+        if (len != META_HEADER_SIZE + strlen("packs/x@0:1")) {
+                strcpy(err_msg, "[meta_encode] wrong size of encoded record");
+                return -1;
+        }
+
+        if (meta_decode(buf, len, &decoded, object_id, ID_SIZE) == -1 ||
+            decoded.state != meta.state ||
+            decoded.flags != meta.flags ||
+            decoded.size != meta.size ||
+            decoded.mtime_ns != meta.mtime_ns ||
+            decoded.checksum != meta.checksum ||
+            strcmp(object_id, "packs/x@0:1") != 0) {
+                strcpy(err_msg, "[meta_decode] decoded record differs from "
+                                "encoded one");
+                return -1;
+        }
+
+        /* the layout does not depend on the host's byte order */
+        if (buf[0] != 'D' || buf[1] != 'M' || buf[2] != 'T' || buf[3] != 'C' ||
+            buf[16] != 0x89 || buf[20] != 0x01) {
+                strcpy(err_msg, "[meta_encode] record is not little-endian");
+                return -1;
+        }
+
+        /* records of version 1 have no checksum */
+        unsigned char v1[BUF_SIZE];
+        memcpy(v1, buf, 32);
+        memcpy(v1 + 32, buf + META_HEADER_SIZE, len - META_HEADER_SIZE);
+        v1[4] = 1;
+        v1[8] |= META_FLAG_CHECKSUM;
+        if (meta_decode(v1,
+                        len - META_HEADER_SIZE + 32,
+                        &decoded,
+                        object_id,
+                        ID_SIZE) == -1 ||
+            (decoded.flags & META_FLAG_CHECKSUM) != 0 ||
+            decoded.size != meta.size ||
+            strcmp(object_id, "packs/x@0:1") != 0) {
+                strcpy(err_msg, "[meta_decode] failed to decode record of "
+                                "version 1");
+                return -1;
+        }
+
+        if (meta_encode(buf, META_HEADER_SIZE + 4, &meta, "too-long") != 0) {
+                strcpy(err_msg, "[meta_encode] should fail on small buffer");
+                return -1;
+        }
+
+        if (meta_decode(buf, len, &decoded, object_id, 4) != -1) {
+                strcpy(err_msg, "[meta_decode] should fail on small object "
+                                "identifier buffer");
+                return -1;
+        }
+
+        /* a truncated record and a record of another version are rejected */
+        if (meta_decode(buf, len - 1, &decoded, object_id, ID_SIZE) != -1 ||
+            meta_decode(buf, 8, &decoded, object_id, ID_SIZE) != -1) {
+                strcpy(err_msg, "[meta_decode] should fail on truncated "
+                                "record");
+                return -1;
+        }
+
+        buf[4] = 3;
+        if (meta_decode(buf, len, &decoded, object_id, ID_SIZE) != -1) {
+                strcpy(err_msg, "[meta_decode] should fail on unknown "
+                                "version");
+                return -1;
+        }
+
+        return test_legacy_stub(err_msg);
+}
@@ -0,0 +1,79 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "objid.h"
+#include "pack.h"
+
+#define ID_SIZE    ( OBJID_LEN + 1 )
+#define IDS_NUM    1000
+
+int test_objid(char *err_msg) {
+        char id[ID_SIZE];
+        char prev_id[ID_SIZE];
+        char pack_id[ID_SIZE];
+        uint64_t offset = 0;
+        uint64_t length = 0;
+
+        if (objid_make(id, ID_SIZE, "/mnt/foo/bar", 1) == -1 ||
+            strlen(id) != OBJID_LEN ||
+            strspn(id, "0123456789abcdef") != OBJID_LEN) {
+                strcpy(err_msg, "[objid_make] identifier is not 128-bit "
+                                "hexadecimal number");
+                return -1;
+        }
+
+        /* identifiers of individually uploaded files never contain '/' */
+        if (pack_parse_member_id(id, pack_id, ID_SIZE, &offset, &length) != 0) {
+                strcpy(err_msg, "[objid_make] identifier is treated as "
+                                "identifier of file in pack");
+                return -1;
+        }
+
+        /* the same file uploaded many times gets new identifiers */
+        for (int i = 0; i < IDS_NUM; i++) {
+                strcpy(prev_id, id);
+                if (objid_make(id, ID_SIZE, "/mnt/foo/bar", 1) == -1 ||
+                    strcmp(id, prev_id) == 0) {
+                        strcpy(err_msg, "[objid_make] identifiers repeat");
+                        return -1;
+                }
+        }
+
+        /* the hash part depends on the path and the inode generation */
+        objid_make(prev_id, ID_SIZE, "/mnt/foo/bar", 1);
+        objid_make(id, ID_SIZE, "/mnt/foo/baz", 1);
+        if (strncmp(id, prev_id, OBJID_LEN / 2) == 0) {
+                strcpy(err_msg, "[objid_make] hash does not depend on path");
+                return -1;
+        }
+
+        objid_make(id, ID_SIZE, "/mnt/foo/bar", 2);
+        if (strncmp(id, prev_id, OBJID_LEN / 2) == 0) {
+                strcpy(err_msg, "[objid_make] hash does not depend on inode "
+                                "generation");
+                return -1;
+        }
+
+        if (objid_make(id, OBJID_LEN, "/mnt/foo/bar", 1) != -1) {
+                strcpy(err_msg, "[objid_make] should fail on small buffer");
+                return -1;
+        }
+
+        return 0;
+}
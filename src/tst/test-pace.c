@@ -0,0 +1,82 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "pace.h"
+
+#define MAX_DELAY_NS    (8 * PACE_STEP_NS)
+
+int test_pace(char *err_msg) {
+        pace_t pace;
+
+        pace_init(&pace, MAX_DELAY_NS, 10.0);
+
+        /* steady latency and low pressure do not slow the scan down */
+        pace.latency_ns = 1000;
+        pace_update(&pace, 1.0);
+        pace_update(&pace, 1.0);
+        if (pace.delay_ns != 0) {
+                strcpy(err_msg, "[pace_update] idle file system is paced");
+                return -1;
+        }
+
+        /* high latency doubles the delay up to the maximum */
+        pace.latency_ns = 1000 * 100;
+        pace_update(&pace, 1.0);
+        pace_update(&pace, 1.0);
+        if (pace.delay_ns != 2 * PACE_STEP_NS) {
+                strcpy(err_msg, "[pace_update] delay is not doubled on high "
+                                "latency");
+                return -1;
+        }
+
+        for (int i = 0; i < 8; i++) {
+                pace_update(&pace, 1.0);
+        }
+        if (pace.delay_ns != MAX_DELAY_NS) {
+                strcpy(err_msg, "[pace_update] delay exceeds the maximum");
+                return -1;
+        }
+
+        /* recovered latency reduces the delay step by step */
+        pace.latency_ns = 1000;
+        pace_update(&pace, 1.0);
+        if (pace.delay_ns != MAX_DELAY_NS - PACE_STEP_NS) {
+                strcpy(err_msg, "[pace_update] delay is not reduced by a "
+                                "step");
+                return -1;
+        }
+
+        /* high I/O pressure alone is a congestion */
+        pace_update(&pace, 50.0);
+        if (pace.delay_ns != MAX_DELAY_NS) {
+                strcpy(err_msg, "[pace_update] delay is not increased on "
+                                "high I/O pressure");
+                return -1;
+        }
+
+        /* unknown I/O pressure is ignored */
+        pace_update(&pace, -1.0);
+        if (pace.delay_ns != MAX_DELAY_NS - PACE_STEP_NS) {
+                strcpy(err_msg, "[pace_update] unknown I/O pressure is "
+                                "treated as a congestion");
+                return -1;
+        }
+
+        return 0;
+}
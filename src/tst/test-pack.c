@@ -0,0 +1,91 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pack.h"
+
+#define ID_SIZE    256
+
+int test_pack(char *err_msg) {
+        char pack_id[ID_SIZE];
+        char other_id[ID_SIZE];
+        char member_id[ID_SIZE];
+        char parsed_id[ID_SIZE];
+        uint64_t offset = 0;
+        uint64_t length = 0;
+
+        if (pack_make_id(pack_id, ID_SIZE) == -1 ||
+            pack_make_id(other_id, ID_SIZE) == -1 ||
+            strcmp(pack_id, other_id) == 0) {
+                strcpy(err_msg, "[pack_make_id] should generate unique "
+                                "identifiers");
+                return -1;
+        }
+
+        if (pack_make_id(other_id, 4) != -1) {
+                strcpy(err_msg, "[pack_make_id] should fail on small buffer");
+                return -1;
+        }
+
+        if (pack_member_id(member_id,
+                           ID_SIZE,
+                           pack_id,
+                           4096,
+                           123) == -1 ||
+            pack_parse_member_id(member_id,
+                                 parsed_id,
+                                 ID_SIZE,
+                                 &offset,
+                                 &length) != 1 ||
+            strcmp(parsed_id, pack_id) != 0 ||
+            offset != 4096 ||
+            length != 123) {
+                strcpy(err_msg, "[pack_parse_member_id] failed to parse "
+                                "member identifier");
+                return -1;
+        }
+
+        /* identifiers of individually uploaded files never contain '/' */
+        if (pack_parse_member_id("elif-rab-oof-",
+                                 parsed_id,
+                                 ID_SIZE,
+                                 &offset,
+                                 &length) != 0) {
+                strcpy(err_msg, "[pack_parse_member_id] regular identifier "
+                                "treated as member identifier");
+                return -1;
+        }
+
+        if (pack_parse_member_id(PACK_OBJECT_ID_PREFIX "x@1",
+                                 parsed_id,
+                                 ID_SIZE,
+                                 &offset,
+                                 &length) != -1 ||
+            pack_parse_member_id(member_id,
+                                 parsed_id,
+                                 4,
+                                 &offset,
+                                 &length) != -1) {
+                strcpy(err_msg, "[pack_parse_member_id] malformed identifier "
+                                "accepted");
+                return -1;
+        }
+
+        return 0;
+}
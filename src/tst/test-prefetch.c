@@ -0,0 +1,256 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _DEFAULT_SOURCE    /* needed for lsetxattr() */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <linux/limits.h>
+
+#include "prefetch.h"
+#include "queue.h"
+#include "conf.h"
+#include "defs.h"
+
+#define TEST_DIR         "./test-prefetch"
+#define SEQ_DIR          TEST_DIR "/seq"
+#define SWEEP_DIR        TEST_DIR "/sweep"
+#define PREFETCH_DEPTH   3
+
+/* files of the numbered sequence; all of them are remote */
+static const char *seq_names[] = {
+        "part-01.dat", "part-02.dat", "part-03.dat", "part-04.dat",
+        "part-05.dat", "part-06.dat", "part-07.dat",
+};
+
+/* files of the directory swept in lexicographical order */
+static const struct {
+        const char *name;
+        int remote;
+} sweep_files[] = {
+        { "alpha", 1 }, { "bravo", 1 }, { "charlie", 0 }, { "delta", 1 },
+        { "echo",  1 }, { "foxtrot", 1 },
+};
+
+#define SEQ_NUM      ( sizeof(seq_names) / sizeof(seq_names[0]) )
+#define SWEEP_NUM    ( sizeof(sweep_files) / sizeof(sweep_files[0]) )
+
+static void remove_dirs(void) {
+        char path[PATH_MAX];
+
+        for (size_t i = 0; i < SEQ_NUM; i++) {
+                snprintf(path, PATH_MAX, "%s/%s", SEQ_DIR, seq_names[i]);
+                unlink(path);
+        }
+
+        for (size_t i = 0; i < SWEEP_NUM; i++) {
+                snprintf(path,
+                         PATH_MAX,
+                         "%s/%s",
+                         SWEEP_DIR,
+                         sweep_files[i].name);
+                unlink(path);
+        }
+
+        rmdir(SEQ_DIR);
+        rmdir(SWEEP_DIR);
+        rmdir(TEST_DIR);
+}
+
+/**
+ * @return  1: the file has been created
+ *          0: the file system does not support user extended attributes
+ *         -1: the file has not been created
+ */
+static int create_file(const char *dir, const char *name, int remote) {
+        char path[PATH_MAX];
+        snprintf(path, PATH_MAX, "%s/%s", dir, name);
+
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1) {
+                return -1;
+        }
+        close(fd);
+
+        if (remote && lsetxattr(path, XATTR_KEY(meta), "", 1, 0) == -1) {
+                return (errno == ENOTSUP) ? 0 : -1;
+        }
+
+        return 1;
+}
+
+/**
+ * @return 0 if the queue contains exactly the given files in the given
+ *         order, -1 otherwise
+ */
+static int expect_queued(queue_t *queue,
+                         const char *dir,
+                         const char **names,
+                         size_t names_num) {
+        char expected[PATH_MAX];
+        char data[PATH_MAX];
+        size_t data_size;
+
+        for (size_t i = 0; i < names_num; i++) {
+                data_size = PATH_MAX;
+                snprintf(expected, PATH_MAX, "%s/%s", dir, names[i]);
+
+                if (queue_try_pop(queue, data, &data_size) == -1 ||
+                    strcmp(data, expected) != 0) {
+                        return -1;
+                }
+        }
+
+        data_size = PATH_MAX;
+        return (queue_try_pop(queue, data, &data_size) == -1) ? 0 : -1;
+}
+
+int test_prefetch(char *err_msg) {
+        /* this test should be executed after test_conf where conf_t
+           structure is initialized */
+        conf_t *conf = get_conf();
+        if (conf == NULL) {
+                strcpy(err_msg, "configuration was not initialized "
+                                "(get_conf() returned NULL)");
+                return -1;
+        }
+
+        size_t depth = conf->prefetch_depth;
+        conf->prefetch_depth = PREFETCH_DEPTH;
+
+        queue_t *queue = NULL;
+        char path[PATH_MAX];
+        int ret = -1;
+
+        remove_dirs();
+        if (mkdir(TEST_DIR, 0755) == -1 || mkdir(SEQ_DIR, 0755) == -1 ||
+            mkdir(SWEEP_DIR, 0755) == -1) {
+                strcpy(err_msg, "unable to create test directories");
+                goto out;
+        }
+
+        int created = 1;
+        for (size_t i = 0; i < SEQ_NUM && created == 1; i++) {
+                created = create_file(SEQ_DIR, seq_names[i], 1);
+        }
+        for (size_t i = 0; i < SWEEP_NUM && created == 1; i++) {
+                created = create_file(SWEEP_DIR,
+                                      sweep_files[i].name,
+                                      sweep_files[i].remote);
+        }
+
+        if (created == 0) {
+                /* stubs can not be emulated here; nothing to test */
+                ret = 0;
+                goto out;
+        } else if (created == -1) {
+                strcpy(err_msg, "unable to create test files");
+                goto out;
+        }
+
+        if (queue_init(&queue, 16, PATH_MAX, NULL) == -1) {
+                strcpy(err_msg, "[queue_init] failed");
+                goto out;
+        }
+
+        /* a single recall is not a pattern yet */
+        snprintf(path, PATH_MAX, "%s/%s", SEQ_DIR, seq_names[0]);
+        if (prefetch_recall(path, queue) != 0 ||
+            expect_queued(queue, SEQ_DIR, NULL, 0) == -1) {
+                strcpy(err_msg, "[prefetch_recall] first recall in "
+                                "a directory should not prefetch");
+                goto out;
+        }
+
+        /* consecutive numbers predict the next ones */
+        snprintf(path, PATH_MAX, "%s/%s", SEQ_DIR, seq_names[1]);
+        if (prefetch_recall(path, queue) != PREFETCH_DEPTH ||
+            expect_queued(queue, SEQ_DIR, &seq_names[2], 3) == -1) {
+                strcpy(err_msg, "[prefetch_recall] next numbers of "
+                                "a sequence should be enqueued");
+                goto out;
+        }
+
+        /* files enqueued by the previous recall are not enqueued again */
+        snprintf(path, PATH_MAX, "%s/%s", SEQ_DIR, seq_names[2]);
+        if (prefetch_recall(path, queue) != 1 ||
+            expect_queued(queue, SEQ_DIR, &seq_names[5], 1) == -1) {
+                strcpy(err_msg, "[prefetch_recall] a sequence should be "
+                                "continued after already enqueued files");
+                goto out;
+        }
+
+        /* the sequence ends with the last existing file */
+        snprintf(path, PATH_MAX, "%s/%s", SEQ_DIR, seq_names[3]);
+        if (prefetch_recall(path, queue) != 1 ||
+            expect_queued(queue, SEQ_DIR, &seq_names[6], 1) == -1) {
+                strcpy(err_msg, "[prefetch_recall] a sequence should be "
+                                "enqueued up to the last existing file");
+                goto out;
+        }
+
+        snprintf(path, PATH_MAX, "%s/%s", SEQ_DIR, seq_names[4]);
+        if (prefetch_recall(path, queue) != 0 ||
+            expect_queued(queue, SEQ_DIR, NULL, 0) == -1) {
+                strcpy(err_msg, "[prefetch_recall] a sequence should end "
+                                "with the last existing file");
+                goto out;
+        }
+
+        /* names without a sequence make the directory swept; local files
+           are skipped */
+        snprintf(path, PATH_MAX, "%s/%s", SWEEP_DIR, sweep_files[0].name);
+        prefetch_recall(path, queue);
+
+        const char *swept[] = { "delta", "echo" };
+        snprintf(path, PATH_MAX, "%s/%s", SWEEP_DIR, sweep_files[1].name);
+        if (prefetch_recall(path, queue) != 2 ||
+            expect_queued(queue, SWEEP_DIR, swept, 2) == -1) {
+                strcpy(err_msg, "[prefetch_recall] remote files following "
+                                "the recalled one should be enqueued");
+                goto out;
+        }
+
+        const char *swept_next[] = { "foxtrot" };
+        snprintf(path, PATH_MAX, "%s/%s", SWEEP_DIR, "delta");
+        if (prefetch_recall(path, queue) != 1 ||
+            expect_queued(queue, SWEEP_DIR, swept_next, 1) == -1) {
+                strcpy(err_msg, "[prefetch_recall] a sweep should not "
+                                "enqueue files twice");
+                goto out;
+        }
+
+        if (prefetch_recall("no-directory", queue) != -1) {
+                strcpy(err_msg, "[prefetch_recall] should fail with "
+                                "an invalid path");
+                goto out;
+        }
+
+        ret = 0;
+
+    out:
+        queue_destroy(queue);
+        remove_dirs();
+        conf->prefetch_depth = depth;
+
+        return ret;
+}
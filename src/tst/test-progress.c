@@ -0,0 +1,159 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE    200112L
+
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "progress.h"
+
+#define TEST_SHM_OBJ    "/" PROGRAM_NAME "-test-progress"
+#define SLOTS_NUM       2
+#define CHUNK_SIZE      4096
+#define CHUNKS_NUM      8
+#define WAIT_MS         1000
+
+/* writes a file in chunks like the daemon's download does */
+static void *writer_routine(void *arg) {
+        progress_slot_t *slot = arg;
+        struct timespec delay = { .tv_sec = 0, .tv_nsec = 1000000 };
+
+        for (int i = 0; i < CHUNKS_NUM; i++) {
+                nanosleep(&delay, NULL);
+                progress_advance(slot, CHUNK_SIZE);
+        }
+
+        progress_end(slot, 1);
+
+        return NULL;
+}
+
+int test_progress(char *err_msg) {
+        progress_t *prog;
+        const progress_t *reader;
+        progress_ref_t ref;
+        enum progress_state_enum state;
+
+        shm_unlink(TEST_SHM_OBJ);
+
+        if (progress_create(&prog, TEST_SHM_OBJ, SLOTS_NUM) == -1) {
+                strcpy(err_msg, "[progress_create] failed");
+                return -1;
+        }
+
+        if (progress_attach(&reader, TEST_SHM_OBJ) == -1) {
+                strcpy(err_msg, "[progress_attach] failed");
+                goto err;
+        }
+
+        if (progress_find(reader, 1, 2, &ref, &state) != -1) {
+                strcpy(err_msg, "[progress_find] empty table knows a recall");
+                goto err;
+        }
+
+        uint32_t starts = progress_starts(reader);
+        progress_slot_t *slot = progress_begin(prog, 1, 2);
+        if (slot == NULL ||
+            progress_starts(reader) == starts ||
+            progress_find(reader, 1, 2, &ref, &state) == -1 ||
+            state != e_progress_active) {
+                strcpy(err_msg, "[progress_begin] recall is not published");
+                goto err;
+        }
+
+        /* a reader waits only for the data it reads */
+        progress_advance(slot, CHUNK_SIZE);
+        if (progress_wait(reader, ref, CHUNK_SIZE, 0) != e_progress_reached ||
+            progress_wait(reader, ref, CHUNK_SIZE + 1, 1) !=
+            e_progress_timeout) {
+                strcpy(err_msg, "[progress_wait] watermark is ignored");
+                goto err;
+        }
+
+        pthread_t writer;
+        if (pthread_create(&writer, NULL, writer_routine, slot) != 0) {
+                strcpy(err_msg, "unable to create a writer thread");
+                goto err;
+        }
+
+        /* the last chunk may be reported with the end of the recall */
+        enum progress_wait_enum ret;
+        do {
+                ret = progress_wait(reader,
+                                    ref,
+                                    CHUNK_SIZE * CHUNKS_NUM,
+                                    WAIT_MS);
+        } while (ret == e_progress_timeout);
+
+        pthread_join(writer, NULL);
+
+        if (ret != e_progress_reached && ret != e_progress_complete) {
+                strcpy(err_msg, "[progress_wait] written data are not seen");
+                goto err;
+        }
+
+        if (progress_wait(reader, ref, UINT64_MAX, 0) != e_progress_complete) {
+                strcpy(err_msg, "[progress_end] recall is not completed");
+                goto err;
+        }
+
+        /* slots of finished recalls are reused; readers of them learn it */
+        progress_begin(prog, 1, 3);
+        progress_slot_t *other = progress_begin(prog, 1, 4);
+        if (other == NULL ||
+            progress_wait(reader, ref, 0, 0) != e_progress_lost ||
+            progress_find(reader, 1, 2, &ref, &state) != -1) {
+                strcpy(err_msg, "[progress_begin] finished slot is not "
+                                "reused");
+                goto err;
+        }
+
+        /* there are no slots for more active recalls */
+        if (progress_begin(prog, 1, 5) != NULL) {
+                strcpy(err_msg, "[progress_begin] active slot is reused");
+                goto err;
+        }
+
+        /* a failed recall is reported as such */
+        progress_end(other, 0);
+        if (progress_find(reader, 1, 4, &ref, &state) == -1 ||
+            state != e_progress_failed ||
+            progress_wait(reader, ref, 0, 0) != e_progress_error) {
+                strcpy(err_msg, "[progress_end] failure is not reported");
+                goto err;
+        }
+
+        /* a restarted daemon fails recalls it will never finish */
+        if (progress_create(&prog, TEST_SHM_OBJ, SLOTS_NUM) == -1 ||
+            progress_find(reader, 1, 3, &ref, &state) == -1 ||
+            state != e_progress_failed) {
+                strcpy(err_msg, "[progress_create] recall of previous run "
+                                "stays active");
+                goto err;
+        }
+
+        shm_unlink(TEST_SHM_OBJ);
+
+        return 0;
+
+    err:
+        shm_unlink(TEST_SHM_OBJ);
+        return -1;
+}
@@ -34,6 +34,7 @@
 #define QUEUE_MAX_SIZE    3
 #define DATA_MAX_SIZE     20
 #define SHM_OBJ           "/cloudtiering-shm-obj-test"
+#define JOURNAL_FILE      "./test-queue.journal"
 
 #define ITERATIONS_PER_THREAD    500000
 #define COND_WAIT_SECS_THREAD    5
@@ -41,6 +42,9 @@
 #define DATA_STR_THREAD          "data"
 #define DATA_STR_LEN_THREAD      5
 
+#define POP_ANY_TIMEOUT_MS       50
+#define POP_ANY_DELAY_MS         100
+
 static char *data_arr[] = {
                 "Hello, World!",
                 "This is me.",
@@ -87,13 +91,10 @@ static int queue_print(FILE *stream, queue_t *queue) {
                 return -1;
         }
 
-        if (pthread_mutex_lock(&queue->size_mutex)) {
-                pthread_mutex_unlock(&queue->tail_mutex);
-                pthread_mutex_unlock(&queue->head_mutex);
-                return -1;
-        }
-
-        char *q_ptr = ((char *)queue) + queue->head_offset;
+        uint32_t head = queue->head;
+        size_t   sz   = (queue->tail >= head) ?
+                        queue->tail - head :
+                        queue->tail + 2 * queue->max_size - head;
 
         char buf[queue->data_max_size + 1];
 
@@ -105,26 +106,27 @@ static int queue_print(FILE *stream, queue_t *queue) {
                         "\t< max. queue size : %zu >\n"\
                         "\t< max. item  size : %zu >\n"\
                         "\t< queue buf. size : %zu >\n",
-                queue->cur_size, queue->max_size,
+                sz, queue->max_size,
                 queue->data_max_size, queue->buf_size);
 
         /* data */
-        size_t sz = queue->cur_size;
         while (sz != 0) {
-                if (q_ptr == (((char *)queue) + queue->buf_offset +
-                             queue->buf_size)) {
-                        q_ptr = ((char *)queue) + queue->buf_offset;
-                }
-                memcpy(buf, q_ptr + sizeof(size_t), (size_t)(*q_ptr));
+                size_t slot = (head < queue->max_size) ?
+                              head : head - queue->max_size;
+                char *q_ptr = ((char *)queue) + queue->buf_offset +
+                              slot * (queue->buf_size / queue->max_size);
+
+                memcpy(buf,
+                       q_ptr + sizeof(size_t) + sizeof(uint64_t),
+                       (size_t)(*q_ptr));
                 buf[(size_t)(*q_ptr)] = '\0';
                 fprintf(stream, "\t|--> %zu %s \n", (size_t)(*q_ptr), buf);
-                q_ptr += sizeof(size_t) + queue->data_max_size;
+                head = (head + 1 == 2 * queue->max_size) ? 0 : head + 1;
                 --sz;
         }
 
         fflush(stream);
 
-        pthread_mutex_unlock(&queue->size_mutex);
         pthread_mutex_unlock(&queue->tail_mutex);
         pthread_mutex_unlock(&queue->head_mutex);
 
@@ -686,6 +688,391 @@ static int test_queue_dealock_pshared(char *err_msg, queue_t **queue_p) {
                                    SHM_OBJ);
 }
 
+static int test_queue_reattach(char *err_msg, queue_t **queue_p) {
+        queue_t *queue    = NULL;
+        queue_t *queue_re = NULL;
+        size_t data_size;
+        char data[DATA_MAX_SIZE];
+
+        if (queue_init(&queue, QUEUE_MAX_SIZE, DATA_MAX_SIZE, SHM_OBJ)) {
+                strcpy(err_msg, "[queue_init] should not fail with correct "
+                                "input args");
+                goto err;
+        }
+
+        for (int i = 0; i < 2; i++) {
+                if (queue_push(queue, data_arr[i], strlen(data_arr[i]) + 1)) {
+                        strcpy(err_msg, "[queue_push] should not fail with "
+                                        "non-full queue");
+                        goto err;
+                }
+        }
+
+        /* a process dies while holding both queue's mutexes */
+        pid_t pid = fork();
+        if (!pid) {
+                pthread_mutex_lock(&queue->head_mutex);
+                pthread_mutex_lock(&queue->tail_mutex);
+                _exit(0);
+        }
+
+        if (pid == -1 || waitpid(pid, NULL, 0) == -1) {
+                strcpy(err_msg, "failed to fork or wait a process");
+                goto err;
+        }
+
+        /* the creator is restarted and attaches to the existing queue */
+        if (queue_init(&queue_re, QUEUE_MAX_SIZE, DATA_MAX_SIZE, SHM_OBJ)) {
+                strcpy(err_msg, "[queue_init] should attach to the existing "
+                                "queue");
+                goto err;
+        }
+
+        if (queue_push(queue_re, data_arr[2], strlen(data_arr[2]) + 1)) {
+                strcpy(err_msg, "[queue_push] should recover the mutex "
+                                "abandoned by the dead process");
+                goto err;
+        }
+
+        for (int i = 0; i < 3; i++) {
+                data_size = DATA_MAX_SIZE;
+                if (queue_pop(queue_re, data, &data_size)) {
+                        strcpy(err_msg, "[queue_pop] should recover the mutex "
+                                        "abandoned by the dead process");
+                        goto err;
+                }
+
+                if (strcmp(data, data_arr[i])) {
+                        strcpy(err_msg, "[queue_pop] returned incorrect data "
+                                        "after re-attachment");
+                        goto err;
+                }
+        }
+
+        /* the first mapping is just unmapped, the second one is destroyed */
+        munmap(queue, queue->total_size);
+        queue_destroy(queue_re);
+        *queue_p = NULL;
+
+        return 0;
+
+    err:
+        if (queue_re != NULL) {
+                munmap(queue_re, queue_re->total_size);
+        }
+        *queue_p = queue;
+        return -1;
+}
+
+static int test_queue_stats(char *err_msg, queue_t **queue_p) {
+        queue_stats_t stats;
+        size_t data_size;
+        char data[DATA_MAX_SIZE];
+
+        if (queue_init(queue_p, QUEUE_MAX_SIZE, DATA_MAX_SIZE, NULL)) {
+                strcpy(err_msg, "[queue_init] should not fail with correct "
+                                "input args");
+                return -1;
+        }
+
+        queue_t *queue = *queue_p;
+
+        queue_stats(queue, &stats);
+        if (stats.pushes || stats.pops || stats.full_events ||
+            stats.empty_events || stats.push_blocked_ns) {
+                strcpy(err_msg, "[queue_stats] counters of a new queue "
+                                "should be zero");
+                return -1;
+        }
+
+        for (int i = 0; i < QUEUE_MAX_SIZE; i++) {
+                queue_push(queue, data_arr[i], strlen(data_arr[i]) + 1);
+        }
+
+        /* the queue is full; attempt should be counted */
+        queue_try_push(queue, data_arr[0], strlen(data_arr[0]) + 1);
+
+        if (queue_size(queue) != QUEUE_MAX_SIZE) {
+                strcpy(err_msg, "[queue_size] should return a number of "
+                                "pushed elements");
+                return -1;
+        }
+
+        for (int i = 0; i < QUEUE_MAX_SIZE; i++) {
+                data_size = DATA_MAX_SIZE;
+                queue_pop(queue, data, &data_size);
+        }
+
+        /* the queue is empty; attempt should be counted */
+        data_size = DATA_MAX_SIZE;
+        queue_try_pop(queue, data, &data_size);
+
+        queue_stats(queue, &stats);
+        if (stats.pushes != QUEUE_MAX_SIZE || stats.pops != QUEUE_MAX_SIZE ||
+            stats.full_events != 1 || stats.empty_events != 1 ||
+            stats.push_blocked_ns != 0 || queue_size(queue) != 0) {
+                strcpy(err_msg, "[queue_stats] counters do not match "
+                                "performed operations");
+                return -1;
+        }
+
+        uint64_t popped = 0;
+        for (int i = 0; i < QUEUE_LATENCY_BUCKETS; i++) {
+                popped += stats.latency_hist[i];
+        }
+
+        if (popped != QUEUE_MAX_SIZE) {
+                strcpy(err_msg, "[queue_stats] latency histogram should "
+                                "account every popped element");
+                return -1;
+        }
+
+        queue_destroy(queue);
+        *queue_p = NULL;
+
+        return 0;
+}
+
+static uint64_t now_ms(void) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void *delayed_supplier_routine(void *args) {
+        const struct timespec delay = {
+                .tv_sec  = 0,
+                .tv_nsec = POP_ANY_DELAY_MS * 1000000L,
+        };
+
+        nanosleep(&delay, NULL);
+        queue_push((queue_t *)args, data_arr[3], strlen(data_arr[3]) + 1);
+
+        return NULL;
+}
+
+static int test_queue_pop_any(char *err_msg, queue_t **queue_p) {
+        queue_t *queues[3] = { NULL };
+        size_t data_size;
+        char data[DATA_MAX_SIZE];
+        pthread_t supplier;
+
+        if (queue_init(&queues[0], QUEUE_MAX_SIZE, DATA_MAX_SIZE, NULL) ||
+            queue_init(&queues[2], QUEUE_MAX_SIZE, DATA_MAX_SIZE, NULL)) {
+                strcpy(err_msg, "[queue_init] should not fail with correct "
+                                "input args");
+                goto err;
+        }
+
+        /* the first queue has a priority over the last one; NULL queues are
+           skipped */
+        queue_push(queues[2], data_arr[0], strlen(data_arr[0]) + 1);
+        queue_push(queues[0], data_arr[1], strlen(data_arr[1]) + 1);
+
+        data_size = DATA_MAX_SIZE;
+        if (queue_pop_any(queues, 3, data, &data_size, 0) != 0 ||
+            strcmp(data, data_arr[1])) {
+                strcpy(err_msg, "[queue_pop_any] should pop from the first "
+                                "non-empty queue");
+                goto err;
+        }
+
+        data_size = DATA_MAX_SIZE;
+        if (queue_pop_any(queues, 3, data, &data_size, 0) != 2 ||
+            strcmp(data, data_arr[0]) || data_size != strlen(data) + 1) {
+                strcpy(err_msg, "[queue_pop_any] should pop from the last "
+                                "queue when others are empty");
+                goto err;
+        }
+
+        uint64_t started = now_ms();
+        data_size = DATA_MAX_SIZE;
+        if (queue_pop_any(queues, 3, data, &data_size, POP_ANY_TIMEOUT_MS) !=
+            -1 ||
+            now_ms() - started < POP_ANY_TIMEOUT_MS) {
+                strcpy(err_msg, "[queue_pop_any] should wait for the timeout "
+                                "when all queues are empty");
+                goto err;
+        }
+
+        /* a push into a low priority queue wakes the waiter up long before
+           the timeout */
+        if (pthread_create(&supplier,
+                           NULL,
+                           delayed_supplier_routine,
+                           queues[2])) {
+                strcpy(err_msg, "[pthread_create] failed");
+                goto err;
+        }
+
+        started = now_ms();
+        data_size = DATA_MAX_SIZE;
+        int pop_res = queue_pop_any(queues,
+                                    3,
+                                    data,
+                                    &data_size,
+                                    100 * POP_ANY_DELAY_MS);
+        uint64_t elapsed = now_ms() - started;
+
+        pthread_join(supplier, NULL);
+
+        if (pop_res != 2 || strcmp(data, data_arr[3]) ||
+            elapsed >= 10 * POP_ANY_DELAY_MS) {
+                strcpy(err_msg, "[queue_pop_any] should be woken up by a push "
+                                "into any of the queues");
+                goto err;
+        }
+
+        if (queue_pop_any(NULL, 3, data, &data_size, 0) != -1 ||
+            queue_pop_any(queues, 0, data, &data_size, 0) != -1) {
+                strcpy(err_msg, "[queue_pop_any] should fail with incorrect "
+                                "input args");
+                goto err;
+        }
+
+        queue_destroy(queues[0]);
+        queue_destroy(queues[2]);
+        *queue_p = NULL;
+
+        return 0;
+
+    err:
+        queue_destroy(queues[2]);
+        *queue_p = queues[0];
+        return -1;
+}
+
+static int test_queue_timed_push(char *err_msg, queue_t **queue_p) {
+        size_t data_size;
+        char data[DATA_MAX_SIZE];
+
+        if (queue_init(queue_p, QUEUE_MAX_SIZE, DATA_MAX_SIZE, NULL)) {
+                strcpy(err_msg, "[queue_init] should not fail with correct "
+                                "input args");
+                return -1;
+        }
+
+        queue_t *queue = *queue_p;
+
+        for (int i = 0; i < QUEUE_MAX_SIZE; i++) {
+                if (queue_timed_push(queue,
+                                     data_arr[i],
+                                     strlen(data_arr[i]) + 1,
+                                     0)) {
+                        strcpy(err_msg, "[queue_timed_push] should not fail "
+                                        "with non-full queue");
+                        return -1;
+                }
+        }
+
+        uint64_t started = now_ms();
+        if (queue_timed_push(queue,
+                             data_arr[3],
+                             strlen(data_arr[3]) + 1,
+                             POP_ANY_TIMEOUT_MS) != -1 ||
+            now_ms() - started < POP_ANY_TIMEOUT_MS) {
+                strcpy(err_msg, "[queue_timed_push] should wait for the "
+                                "timeout when the queue is full");
+                return -1;
+        }
+
+        data_size = DATA_MAX_SIZE;
+        if (queue_pop(queue, data, &data_size) ||
+            queue_timed_push(queue,
+                             data_arr[3],
+                             strlen(data_arr[3]) + 1,
+                             POP_ANY_TIMEOUT_MS)) {
+                strcpy(err_msg, "[queue_timed_push] should not fail "
+                                "when there is a free space");
+                return -1;
+        }
+
+        queue_destroy(queue);
+        *queue_p = NULL;
+
+        return 0;
+}
+
+static int test_queue_journal(char *err_msg, queue_t **queue_p) {
+        queue_t *queue = NULL;
+        size_t data_size;
+        char data[DATA_MAX_SIZE];
+
+        unlink(JOURNAL_FILE);
+
+        if (queue_init_file(&queue,
+                            QUEUE_MAX_SIZE,
+                            DATA_MAX_SIZE,
+                            JOURNAL_FILE)) {
+                strcpy(err_msg, "[queue_init_file] should not fail with "
+                                "correct input args");
+                goto err;
+        }
+
+        for (int i = 0; i < 2; i++) {
+                if (queue_push(queue, data_arr[i], strlen(data_arr[i]) + 1)) {
+                        strcpy(err_msg, "[queue_push] should not fail with "
+                                        "non-full queue");
+                        goto err;
+                }
+        }
+
+        /* the user dies without destroying the queue */
+        munmap(queue, queue->total_size);
+        queue = NULL;
+
+        if (queue_init_file(&queue,
+                            QUEUE_MAX_SIZE,
+                            DATA_MAX_SIZE,
+                            JOURNAL_FILE)) {
+                strcpy(err_msg, "[queue_init_file] should reuse the existing "
+                                "journal");
+                goto err;
+        }
+
+        if (queue_size(queue) != 2) {
+                strcpy(err_msg, "[queue_init_file] should replay pending "
+                                "elements");
+                goto err;
+        }
+
+        for (int i = 0; i < 2; i++) {
+                data_size = DATA_MAX_SIZE;
+                if (queue_pop(queue, data, &data_size) ||
+                    strcmp(data, data_arr[i])) {
+                        strcpy(err_msg, "[queue_pop] returned incorrect data "
+                                        "after replay of the journal");
+                        goto err;
+                }
+        }
+
+        queue_destroy(queue);
+        queue = NULL;
+
+        /* a journal with another geometry should be reformatted */
+        if (queue_init_file(&queue,
+                            QUEUE_MAX_SIZE + 1,
+                            DATA_MAX_SIZE,
+                            JOURNAL_FILE) ||
+            queue_size(queue) != 0 ||
+            queue->max_size != QUEUE_MAX_SIZE + 1) {
+                strcpy(err_msg, "[queue_init_file] should reformat journal "
+                                "with incompatible geometry");
+                goto err;
+        }
+
+        queue_destroy(queue);
+        unlink(JOURNAL_FILE);
+        *queue_p = NULL;
+
+        return 0;
+
+    err:
+        *queue_p = queue;
+        return -1;
+}
+
 int test_queue(char *err_msg) {
         queue_t *queue = NULL;
 
@@ -705,6 +1092,36 @@ int test_queue(char *err_msg) {
                 goto err;
         }
 
+        queue = NULL;
+
+        if (test_queue_reattach(err_msg, &queue)) {
+                goto err;
+        }
+
+        queue = NULL;
+
+        if (test_queue_stats(err_msg, &queue)) {
+                goto err;
+        }
+
+        queue = NULL;
+
+        if (test_queue_pop_any(err_msg, &queue)) {
+                goto err;
+        }
+
+        queue = NULL;
+
+        if (test_queue_timed_push(err_msg, &queue)) {
+                goto err;
+        }
+
+        queue = NULL;
+
+        if (test_queue_journal(err_msg, &queue)) {
+                goto err;
+        }
+
         return 0;
 
     err:
@@ -0,0 +1,133 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "rules.h"
+
+#define NOW    1000000
+
+static rules_t rules;
+
+static const char *exclude_rule[] = { "exclude", "path=/mnt/db/*" };
+static const char *owner_rule[]   = { "evict", "uid=1000", "size>=1K" };
+static const char *age_rule[]     = { "evict", "atime>1d", "size<1G" };
+
+static const char *bad_rules[][2] = {
+        { "remove", "size>1" },    /* unknown action */
+        { "evict",  "name=foo" },  /* unknown key */
+        { "evict",  "size~1" },    /* unknown operator */
+        { "evict",  "size>1X" },   /* unknown suffix */
+        { "evict",  "path<foo" },  /* patterns are not ordered */
+        { "evict",  "uid=-1" },    /* negative value */
+};
+
+static struct stat make_stat(off_t size, time_t age, uid_t uid) {
+        struct stat sb;
+
+        memset(&sb, 0, sizeof(sb));
+        sb.st_size = size;
+        sb.st_atime = NOW - age;
+        sb.st_uid = uid;
+
+        return sb;
+}
+
+int test_rules(char *err_msg) {
+        rules_init(&rules);
+
+        for (size_t i = 0; i < sizeof(bad_rules) / sizeof(bad_rules[0]); i++) {
+                if (rules_add(&rules, 2, bad_rules[i]) != -1) {
+                        sprintf(err_msg,
+                                "[rules_add] malformed rule '%s %s' accepted",
+                                bad_rules[i][0],
+                                bad_rules[i][1]);
+                        return -1;
+                }
+        }
+
+        if (rules.count != 0 ||
+            rules.insns_count != 0 ||
+            rules.pool_size != 0) {
+                strcpy(err_msg, "[rules_add] malformed rule changed rules");
+                return -1;
+        }
+
+        /* no rules keep every file */
+        struct stat sb = make_stat(1 << 20, 7 * 86400, 0);
+        if (rules_eval(&rules, "/mnt/a", &sb, NOW) != e_rule_keep ||
+            rules_min_atime_age(&rules) != -1) {
+                strcpy(err_msg, "[rules_eval] empty rules should keep files");
+                return -1;
+        }
+
+        if (rules_add(&rules, 2, exclude_rule) == -1 ||
+            rules_add(&rules, 3, owner_rule) == -1 ||
+            rules_add(&rules, 3, age_rule) == -1) {
+                strcpy(err_msg, "[rules_add] failed to add valid rule");
+                return -1;
+        }
+
+        struct {
+                const char *path;
+                struct stat sb;
+                enum rule_action_enum action;
+        } cases[] = {
+                /* excluded by path although old enough */
+                { "/mnt/db/a", make_stat(4096, 7 * 86400, 1000), e_rule_keep },
+                /* the owner's file is evicted regardless of age */
+                { "/mnt/a",    make_stat(4096, 0, 1000),         e_rule_evict },
+                /* too small for the owner's rule and too young */
+                { "/mnt/a",    make_stat(10, 3600, 1000),        e_rule_keep },
+                /* old enough */
+                { "/mnt/a",    make_stat(10, 86401, 0),          e_rule_evict },
+                /* exactly one day is not older than one day */
+                { "/mnt/a",    make_stat(10, 86400, 0),          e_rule_keep },
+                /* too big */
+                { "/mnt/a",    make_stat(1LL << 30, 86401, 0),   e_rule_keep },
+        };
+
+        for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+                if (rules_eval(&rules,
+                               cases[i].path,
+                               &cases[i].sb,
+                               NOW) != cases[i].action) {
+                        sprintf(err_msg,
+                                "[rules_eval] wrong action in case %zu",
+                                i);
+                        return -1;
+                }
+        }
+
+        /* the owner's rule does not bound the access age */
+        if (rules_min_atime_age(&rules) != -1) {
+                strcpy(err_msg, "[rules_min_atime_age] wrong bound with "
+                                "unbounded rule");
+                return -1;
+        }
+
+        rules_init(&rules);
+        if (rules_add(&rules, 3, age_rule) == -1 ||
+            rules_min_atime_age(&rules) != 86400) {
+                strcpy(err_msg, "[rules_min_atime_age] wrong bound");
+                return -1;
+        }
+
+        return 0;
+}
@@ -0,0 +1,124 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE    200809L    /* needed for utimensat() */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "shard.h"
+
+#define TEST_DIR     "./test-shard"
+#define LEASE_SEC    60
+#define DIRS_NUM     1000
+
+static void remove_dir(void) {
+        unlink(TEST_DIR "/node-a");
+        unlink(TEST_DIR "/node-b");
+        rmdir(TEST_DIR);
+}
+
+int test_shard(char *err_msg) {
+        shard_t a, b;
+
+        remove_dir();
+
+        if (shard_join(&a, TEST_DIR, "node/a", LEASE_SEC) != -1) {
+                strcpy(err_msg, "[shard_join] should fail on invalid name");
+                return -1;
+        }
+
+        if (shard_join(&a, TEST_DIR, "node-a", LEASE_SEC) == -1 ||
+            shard_join(&b, TEST_DIR, "node-b", LEASE_SEC) == -1) {
+                strcpy(err_msg, "[shard_join] failed");
+                remove_dir();
+                return -1;
+        }
+
+        if (shard_refresh(&a) != 1 || shard_refresh(&b) != 1 ||
+            shard_refresh(&a) != 0) {
+                strcpy(err_msg, "[shard_refresh] wrong set of live nodes");
+                goto err;
+        }
+
+        /* every directory belongs to exactly one node */
+        size_t owned_a = 0;
+        for (int i = 0; i < DIRS_NUM; i++) {
+                char path[32];
+                sprintf(path, "/dir%d", i);
+
+                int owns_a = shard_owns(&a, path);
+                if (owns_a == shard_owns(&b, path)) {
+                        sprintf(err_msg,
+                                "[shard_owns] directory %s has %s owner",
+                                path,
+                                owns_a ? "more than one" : "no");
+                        goto err;
+                }
+
+                owned_a += owns_a;
+        }
+
+        if (owned_a < DIRS_NUM / 4 || owned_a > DIRS_NUM * 3 / 4) {
+                sprintf(err_msg,
+                        "[shard_owns] unbalanced shards [%zu of %d]",
+                        owned_a,
+                        DIRS_NUM);
+                goto err;
+        }
+
+        /* an expired lease moves all directories to the live node */
+        struct timespec old[2] = {
+                { .tv_sec = time(NULL) - 2 * LEASE_SEC, .tv_nsec = 0 },
+                { .tv_sec = time(NULL) - 2 * LEASE_SEC, .tv_nsec = 0 },
+        };
+        if (utimensat(AT_FDCWD, TEST_DIR "/node-b", old, 0) == -1) {
+                strcpy(err_msg, "unable to expire a lease");
+                goto err;
+        }
+
+        if (shard_refresh(&a) != 1) {
+                strcpy(err_msg, "[shard_refresh] expired lease is live");
+                goto err;
+        }
+
+        for (int i = 0; i < DIRS_NUM; i++) {
+                char path[32];
+                sprintf(path, "/dir%d", i);
+
+                if (!shard_owns(&a, path)) {
+                        strcpy(err_msg, "[shard_owns] directory of a gone "
+                                        "node is not taken over");
+                        goto err;
+                }
+        }
+
+        shard_leave(&b);
+        shard_leave(&a);
+        remove_dir();
+
+        return 0;
+
+    err:
+        shard_leave(&b);
+        shard_leave(&a);
+        remove_dir();
+        return -1;
+}
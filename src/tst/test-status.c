@@ -0,0 +1,88 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE    200112L
+
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "status.h"
+
+#define TEST_SHM_OBJ    "/" PROGRAM_NAME "-test-status"
+#define PERIOD_MS       10
+
+int test_status(char *err_msg) {
+        status_t *status;
+        const status_t *reader;
+        uint64_t epoch = 0;
+
+        shm_unlink(TEST_SHM_OBJ);
+
+        if (status_attach(&reader, TEST_SHM_OBJ) != -1) {
+                strcpy(err_msg, "[status_attach] attached nonexistent page");
+                return -1;
+        }
+
+        if (status_create(&status, TEST_SHM_OBJ, PERIOD_MS) == -1) {
+                strcpy(err_msg, "[status_create] failed");
+                return -1;
+        }
+
+        if (status_attach(&reader, TEST_SHM_OBJ) == -1) {
+                strcpy(err_msg, "[status_attach] failed");
+                goto err;
+        }
+
+        if (!status_is_alive(reader, &epoch) || epoch != 1) {
+                strcpy(err_msg, "[status_create] started daemon is not alive");
+                goto err;
+        }
+
+        /* a daemon which misses heartbeats is dead */
+        struct timespec delay = {
+                .tv_sec = 0,
+                .tv_nsec = 2 * STATUS_MISSED_BEATS * PERIOD_MS * 1000000L,
+        };
+        nanosleep(&delay, NULL);
+        if (status_is_alive(reader, NULL)) {
+                strcpy(err_msg, "[status_is_alive] silent daemon is alive");
+                goto err;
+        }
+
+        status_beat(status);
+        if (!status_is_alive(reader, NULL)) {
+                strcpy(err_msg, "[status_beat] heartbeat is not seen");
+                goto err;
+        }
+
+        /* a restart is seen by processes which have attached the page */
+        if (status_create(&status, TEST_SHM_OBJ, PERIOD_MS) == -1 ||
+            !status_is_alive(reader, &epoch) ||
+            epoch != 2) {
+                strcpy(err_msg, "[status_create] restart is not seen");
+                goto err;
+        }
+
+        shm_unlink(TEST_SHM_OBJ);
+
+        return 0;
+
+    err:
+        shm_unlink(TEST_SHM_OBJ);
+        return -1;
+}
@@ -24,9 +24,24 @@ static struct test_case {
         const char *name;
         int (*func)(char *);
 } test_suit[] = {
-        { "conf",  test_conf },
-        { "log",   test_log },
-        { "queue", test_queue },
+        { "bloom",    test_bloom },
+        { "catalog",  test_catalog },
+        { "conf",     test_conf },
+        { "crc32c",   test_crc32c },
+        { "location", test_location },
+        { "lock",     test_lock },
+        { "log",      test_log },
+        { "meta",     test_meta },
+        { "objid",    test_objid },
+        { "pace",     test_pace },
+        { "pack",     test_pack },
+        { "prefetch", test_prefetch },
+        { "progress", test_progress },
+        { "queue",    test_queue },
+        { "rules",    test_rules },
+        { "shard",    test_shard },
+        { "status",   test_status },
+        { "walk",     test_walk },
 };
 
 int main(int argc, char *argv[]) {
@@ -0,0 +1,232 @@
+/**
+ * Copyright (C) 2017  Sergey Morozov <sergey@morozov.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _XOPEN_SOURCE    500    /* needed to use nftw() */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "walk.h"
+
+#define TEST_DIR        "./test-walk-tree"
+#define WALK_THREADS    4
+#define DIRS_NUM        8
+#define FILES_NUM       16
+#define STOP_VALUE      42
+#define LAST_DIR        7    /* DIRS_NUM - 1 */
+
+#define STR_(x)         #x
+#define STR(x)          STR_(x)
+
+static size_t files_cnt  = 0;
+static size_t dirs_cnt   = 0;
+static size_t links_cnt  = 0;
+static size_t nostat_cnt = 0;
+
+static int count_cb(const char *path,
+                    ino_t ino,
+                    const struct stat *sb,
+                    void *arg) {
+        if (sb == NULL) {
+                __atomic_add_fetch(&nostat_cnt, 1, __ATOMIC_RELAXED);
+        } else if (S_ISREG(sb->st_mode)) {
+                __atomic_add_fetch(&files_cnt, 1, __ATOMIC_RELAXED);
+        } else if (S_ISDIR(sb->st_mode)) {
+                __atomic_add_fetch(&dirs_cnt, 1, __ATOMIC_RELAXED);
+        } else if (S_ISLNK(sb->st_mode)) {
+                __atomic_add_fetch(&links_cnt, 1, __ATOMIC_RELAXED);
+        }
+
+        return 0;
+}
+
+static int skip_cb(const char *path, const struct stat *sb, void *arg) {
+        return WALK_SKIP_STAT;
+}
+
+static int skip_files_cb(const char *path,
+                         const struct stat *sb,
+                         void *arg) {
+        /* only files of the deepest directory are visited */
+        return (strstr(path, "/d" STR(LAST_DIR)) != NULL) ?
+               WALK_STAT_FILES : WALK_SKIP_FILES;
+}
+
+static int stop_cb(const char *path,
+                   ino_t ino,
+                   const struct stat *sb,
+                   void *arg) {
+        return S_ISREG(sb->st_mode) ? STOP_VALUE : 0;
+}
+
+static int remove_cb(const char *path,
+                     const struct stat *sb,
+                     int typeflag,
+                     struct FTW *ftwbuf) {
+        return remove(path);
+}
+
+static void remove_tree(void) {
+        nftw(TEST_DIR, remove_cb, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+static int create_tree(void) {
+        char path[256];
+
+        if (mkdir(TEST_DIR, S_IRWXU) == -1) {
+                return -1;
+        }
+
+        /* a chain of nested directories, each with several files */
+        strcpy(path, TEST_DIR);
+        for (int i = 0; i < DIRS_NUM; i++) {
+                sprintf(path + strlen(path), "/d%d", i);
+                if (mkdir(path, S_IRWXU) == -1) {
+                        return -1;
+                }
+
+                for (int j = 0; j < FILES_NUM / DIRS_NUM; j++) {
+                        char file[512];
+                        sprintf(file, "%s/f%d", path, j);
+
+                        int fd = open(file, O_CREAT | O_WRONLY, S_IRUSR);
+                        if (fd == -1) {
+                                return -1;
+                        }
+                        close(fd);
+                }
+        }
+
+        /* a symbolic link to the directory which should not be followed */
+        if (symlink("d0", TEST_DIR "/link") == -1) {
+                return -1;
+        }
+
+        return 0;
+}
+
+int test_walk(char *err_msg) {
+        remove_tree();
+
+        if (create_tree() == -1) {
+                strcpy(err_msg, "unable to create test directory tree");
+                remove_tree();
+                return -1;
+        }
+
+        if (walk_tree(TEST_DIR,
+                      WALK_THREADS,
+                      NULL,
+                      count_cb,
+                      NULL,
+                      NULL) != 0) {
+                strcpy(err_msg, "[walk_tree] should not fail on existing "
+                                "directory");
+                goto err;
+        }
+
+        /* only regular files are reported */
+        if (files_cnt != FILES_NUM ||
+            dirs_cnt != 0 ||
+            links_cnt != 0) {
+                sprintf(err_msg,
+                        "[walk_tree] visited wrong number of entries "
+                        "[files: %zu | dirs: %zu | links: %zu]",
+                        files_cnt,
+                        dirs_cnt,
+                        links_cnt);
+                goto err;
+        }
+
+        /* files of "unchanged" directories are visited without stat */
+        if (walk_tree(TEST_DIR,
+                      WALK_THREADS,
+                      skip_cb,
+                      count_cb,
+                      NULL,
+                      NULL) != 0 ||
+            nostat_cnt != FILES_NUM) {
+                strcpy(err_msg, "[walk_tree] should not stat files if "
+                                "directory callback asks so");
+                goto err;
+        }
+
+        /* subdirectories of directories whose files are skipped are walked */
+        files_cnt = 0;
+        if (walk_tree(TEST_DIR,
+                      WALK_THREADS,
+                      skip_files_cb,
+                      count_cb,
+                      NULL,
+                      NULL) != 0 ||
+            files_cnt != FILES_NUM / DIRS_NUM) {
+                strcpy(err_msg, "[walk_tree] should skip files but not "
+                                "subdirectories if directory callback asks so");
+                goto err;
+        }
+
+        /* a paced walk visits the same files */
+        pace_t pace;
+        pace_init(&pace, 1000000, 0);
+        files_cnt = 0;
+        if (walk_tree(TEST_DIR,
+                      WALK_THREADS,
+                      NULL,
+                      count_cb,
+                      NULL,
+                      &pace) != 0 ||
+            files_cnt != FILES_NUM) {
+                strcpy(err_msg, "[walk_tree] paced walk visited wrong number "
+                                "of files");
+                goto err;
+        }
+
+        if (walk_tree(TEST_DIR,
+                      WALK_THREADS,
+                      NULL,
+                      stop_cb,
+                      NULL,
+                      NULL) != STOP_VALUE) {
+                strcpy(err_msg, "[walk_tree] should return a value which "
+                                "stopped the walk");
+                goto err;
+        }
+
+        if (walk_tree(TEST_DIR "/nonexistent",
+                      WALK_THREADS,
+                      NULL,
+                      count_cb,
+                      NULL,
+                      NULL) != -1) {
+                strcpy(err_msg, "[walk_tree] should fail on nonexistent "
+                                "directory");
+                goto err;
+        }
+
+        remove_tree();
+
+        return 0;
+
+    err:
+        remove_tree();
+        return -1;
+}